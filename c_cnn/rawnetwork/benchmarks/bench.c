@@ -0,0 +1,1008 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "types.h"
+#include "functional.h"
+#include "computational.h"
+#include "components.h"
+#include "activators.h"
+#include "arena.h"
+#include "gemm.h"
+#include "simd.h"
+#include "quant.h"
+#include "half.h"
+#include "fft.h"
+#include "blocked.h"
+#include "view.h"
+#include "pack.h"
+#include "thread_pool.h"
+
+// shortest timed sample; fast ops repeat within a sample until it is this long
+#define MIN_SAMPLE 2e-5
+// most tensors a combine case joins
+#define MAX_PARTS 8
+// most kernels of a conv layer case
+#define MAX_KERNELS 16
+// classes per item of a top-k case
+#define TOP_K 5
+// largest magnitude of fill_ values, the calibrated input range of int8 cases
+#define FILL_MAX ((elm_t)0.75)
+// workers and guard elements past the workspace of the split half-precision gemm check
+#define SPLIT_WORKERS 4
+#define SPLIT_GUARD 64
+// largest error of a conv case against direct convolution, per unit of 1 + the largest output magnitude
+#define CONV_TOL ((elm_t)1e-4)
+
+typedef enum {
+    OP_CONV,
+    OP_CONV_DIRECT,
+    OP_CONV_IM2COL,
+    OP_CONV_PACKED,
+    OP_CONV_WINOGRAD,
+    OP_CONV_FFT,
+    OP_CONV_BLOCKED,
+    OP_CONV_INT8,
+    OP_POOL,
+    OP_POOL_BLOCKED,
+    OP_MATMUL,
+    OP_MATMUL_FP16,
+    OP_DENSE,
+    OP_DENSE_PACKED,
+    OP_DENSE_UNFUSED,
+    OP_DENSE_TOPK,
+    OP_DENSE_INT8,
+    OP_SUM,
+    OP_COMBINE,
+    OP_TRANSPOSE,
+    OP_VIEW_COPY,
+    OP_RELU,
+    OP_SIGMOID,
+    OP_SIGMOID_EXACT,
+    OP_SOFTMAX,
+    OP_SOFTMAX_EXACT
+} OpKind;
+
+static const char *op_names_[] = {
+    "conv", "conv_direct", "conv_im2col", "conv_packed", "conv_winograd", "conv_fft", "conv_blocked", "conv_int8",
+    "pool", "pool_blocked", "matmul", "matmul_fp16", "dense", "dense_packed", "dense_unfused", "dense_top5",
+    "dense_int8", "sum", "combine", "transpose", "view_copy", "relu", "sigmoid", "sigmoid_exact", "softmax",
+    "softmax_exact"
+};
+
+// one op at one shape, with every buffer it touches
+typedef struct {
+    OpKind kind;
+    char shape[48];
+    char params[48];
+    double flops;
+    Tensor a, b, res;
+    View view;
+    Tensor *parts[MAX_PARTS];
+    size_t parts_num;
+    Kernel kernel;
+    Kernel kernel_set[MAX_KERNELS];
+    Kernel *kernel_ptrs[MAX_KERNELS];
+    Convolutional layer;
+    QuantWeights *quant;
+    elm_t *wino;
+    FftKernels *fft;
+    elm_t *block;
+    uint16_t *half;
+    Pooler pooler;
+    Dense dense;
+    size_t *classes;
+    // packed cases point layer at the conv or dense layer, packs at its weight panels
+    Layer layer_ref;
+    Packs *packs;
+    // blocked cases read xb, x keeps the channel-major input
+    Batch x, xb, y;
+    Arena *arena;
+} Case;
+
+// timing of one case
+typedef struct {
+    char op[24];
+    char shape[48];
+    char params[48];
+    size_t samples;
+    double median_us;
+    double p99_us;
+    double min_us;
+    double gflops;
+} Record;
+
+// run settings
+typedef struct {
+    size_t samples;
+    size_t warmup;
+    const char *only;
+} Settings;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static double now_(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void fill_(elm_t *arr, const size_t size, const size_t seed) {
+    // deterministic values in [-0.75, 0.75]
+    for (size_t elm = 0; elm < size; elm++) arr[elm] = ((elm_t)((elm * 7 + seed) % 13) - 6) / 8;
+}
+
+static int tensor_(Tensor *tens, const size_t m, const size_t n, const size_t o, const size_t seed) {
+    tens->m = m; tens->n = n; tens->o = o;
+    tens->arr = alloc_arr(m * n * o);
+    if (tens->arr == NULL) {
+        fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", m, n, o);
+        return 0;
+    }
+    fill_(tens->arr, m * n * o, seed);
+    return 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void reference_(elm_t *c, const elm_t *a, const elm_t *b, const size_t m, const size_t n, const size_t k) {
+    // per-element dot product loop, b read column-wise
+    for (size_t row = 0; row < m; row++) {
+        for (size_t col = 0; col < n; col++) {
+            elm_t res = 0;
+            for (size_t elm = 0; elm < k; elm++) {
+                res += a[row * k + elm] * b[elm * n + col];
+            }
+            c[row * n + col] = res;
+        }
+    }
+}
+
+static double time_gemm_(void (*fn)(elm_t *, const elm_t *, const elm_t *, size_t, size_t, size_t),
+    elm_t *c, const elm_t *a, const elm_t *b, const size_t m, const size_t n, const size_t k) {
+    // repeat until the measurement is long enough to be stable
+    fn(c, a, b, m, n, k);
+    size_t reps = 1;
+    for (;;) {
+        const double start = now_();
+        for (size_t rep = 0; rep < reps; rep++) fn(c, a, b, m, n, k);
+        const double elapsed = now_() - start;
+        if (elapsed > 0.2) return elapsed / (double)reps;
+        reps *= 2;
+    }
+}
+
+static int check_half_split_(void) {
+    // half-precision b split across a pool, shapes with a ragged last band whose edge tiles fall below the packed
+    // path; every tile must stay within its worker's slice of the workspace, checked by guard elements past its end
+    const size_t shapes[][3] = {{25, 3, 3000}, {9, 40, 700}, {33, 17, 513}, {130, 70, 300}};
+    const size_t num = sizeof(shapes) / sizeof(shapes[0]);
+    ThreadPool *pool = make_thread_pool(SPLIT_WORKERS);
+    if (pool == NULL) return 1;
+    set_compute_pool(pool);
+    set_parallel_threshold(1);
+    int ok = 1;
+    for (size_t shape = 0; ok && shape < num * 2; shape++) {
+        const size_t m = shapes[shape / 2][0], n = shapes[shape / 2][1], k = shapes[shape / 2][2];
+        const Precision prec = shape % 2 == 0 ? PREC_FP16 : PREC_BF16;
+        const size_t size = gemm_half_workspace(m, n, k);
+
+        // malloc
+        elm_t *a = alloc_arr(m * k), *b = alloc_arr(k * n), *c_ref = alloc_arr(m * n), *c = alloc_arr(m * n);
+        elm_t *work = alloc_arr(size + SPLIT_GUARD);
+        uint16_t *b_half = malloc(k * n * sizeof(uint16_t));
+        ok = a != NULL && b != NULL && c_ref != NULL && c != NULL && work != NULL && b_half != NULL;
+        if (!ok) fprintf(stderr, "Failed malloc: shape %zu x %zu x %zu.\n", m, n, k);
+
+        // reference on the values b holds once narrowed
+        if (ok) {
+            fill_(a, m * k, 1);
+            fill_(b, k * n, 2);
+            for (size_t elm = 0; elm < k * n; elm++) b_half[elm] = narrow_elm(b[elm], prec);
+            widen_arr(b, b_half, k * n, prec);
+            reference_(c_ref, a, b, m, n, k);
+            for (size_t elm = 0; elm < SPLIT_GUARD; elm++) work[size + elm] = (elm_t)-1;
+            ok = gemm_half_ws(c, a, b_half, prec, m, n, k, work) != NULL;
+        }
+        for (size_t elm = 0; ok && elm < SPLIT_GUARD; elm++) {
+            if (work[size + elm] != (elm_t)-1) {
+                fprintf(stderr, "Result mismatch: split half gemm %zu x %zu x %zu wrote past its workspace.\n", m,
+                    n, k);
+                ok = 0;
+            }
+        }
+        for (size_t elm = 0; ok && elm < m * n; elm++) {
+            const elm_t err = c[elm] > c_ref[elm] ? c[elm] - c_ref[elm] : c_ref[elm] - c[elm];
+            if (err > (elm_t)1e-2) {
+                fprintf(stderr, "Result mismatch: split half gemm %zu x %zu x %zu max error %g.\n", m, n, k,
+                    (double)err);
+                ok = 0;
+            }
+        }
+        free(a); free(b); free(c_ref); free(c); free(work); free(b_half);
+    }
+    set_parallel_threshold((size_t)1 << 20);
+    set_compute_pool(NULL);
+    free_thread_pool(pool);
+    if (ok) printf("split half gemm: %zu shapes on %d workers within workspace\n", num * 2, SPLIT_WORKERS);
+    return !ok;
+}
+
+static int run_gemm_(void) {
+    // shapes: m, n, k
+    const size_t shapes[][3] = {
+        {64, 64, 64}, {128, 128, 128}, {256, 256, 256}, {512, 512, 512},
+        {1, 10, 100}, {64, 10, 100}, {1, 1024, 1024}, {256, 16, 1024}, {1024, 1024, 16}, {4096, 64, 64},
+    };
+    const size_t num = sizeof(shapes) / sizeof(shapes[0]);
+
+    printf("kernels: %s\n", simd_ops()->name);
+    printf("%6s %6s %6s | %12s %12s | %8s\n", "m", "n", "k", "loop GFLOP/s", "gemm GFLOP/s", "speedup");
+    for (size_t shape = 0; shape < num; shape++) {
+        const size_t m = shapes[shape][0], n = shapes[shape][1], k = shapes[shape][2];
+
+        // malloc
+        elm_t *a = alloc_arr(m * k);
+        elm_t *b = alloc_arr(k * n);
+        elm_t *c_ref = alloc_arr(m * n);
+        elm_t *c = alloc_arr(m * n);
+        if (a == NULL || b == NULL || c_ref == NULL || c == NULL) {
+            fprintf(stderr, "Failed malloc: shape %zu x %zu x %zu.\n", m, n, k);
+            free(a); free(b); free(c_ref); free(c);
+            return 1;
+        }
+        for (size_t elm = 0; elm < m * k; elm++) a[elm] = ((elm_t)(elm * 7 % 13) - 6) / 8;
+        for (size_t elm = 0; elm < k * n; elm++) b[elm] = ((elm_t)(elm * 5 % 11) - 5) / 8;
+
+        // time
+        const double flops = 2.0 * (double)m * (double)n * (double)k;
+        const double t_ref = time_gemm_(reference_, c_ref, a, b, m, n, k);
+        const double t_gemm = time_gemm_(gemm, c, a, b, m, n, k);
+
+        // verify
+        elm_t max_err = 0;
+        for (size_t elm = 0; elm < m * n; elm++) {
+            const elm_t err = c[elm] > c_ref[elm] ? c[elm] - c_ref[elm] : c_ref[elm] - c[elm];
+            if (err > max_err) max_err = err;
+        }
+        printf("%6zu %6zu %6zu | %12.3f %12.3f | %7.2fx\n", m, n, k, flops / t_ref * 1e-9, flops / t_gemm * 1e-9,
+            t_ref / t_gemm);
+        free(a); free(b); free(c_ref); free(c);
+        if (max_err > (elm_t)1e-2) {
+            fprintf(stderr, "Result mismatch: max error %g.\n", (double)max_err);
+            return 1;
+        }
+    }
+    return check_half_split_();
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void free_case_(Case *cs) {
+    free_packs(cs->packs);
+    free(cs->a.arr); free(cs->b.arr); free(cs->res.arr);
+    for (size_t part = 0; part < cs->parts_num; part++) free_tensor(cs->parts[part]);
+    free(cs->kernel.arr);
+    for (size_t k = 0; k < cs->layer.num; k++) free(cs->kernel_set[k].arr);
+    free(cs->x.arr); free(cs->xb.arr); free(cs->y.arr);
+    free_quant(cs->quant);
+    free(cs->wino);
+    free_fft_kernels(cs->fft);
+    free(cs->block);
+    free(cs->half);
+    free(cs->classes);
+    free_arena(cs->arena);
+    memset(cs, 0, sizeof(Case));
+}
+
+static int make_parts_(Case *cs) {
+    // combine frees its inputs, so they are rebuilt before every call
+    for (size_t part = 0; part < cs->parts_num; part++) {
+        free_tensor(cs->parts[part]);
+        cs->parts[part] = make_tensor(cs->a.m, cs->a.n, cs->a.o);
+        if (cs->parts[part] == NULL) return 0;
+        fill_(cs->parts[part]->arr, cs->a.m * cs->a.n * cs->a.o, part);
+    }
+    return 1;
+}
+
+static int setup_conv_(Case *cs, const size_t m, const size_t n, const size_t o, const size_t k, const size_t s) {
+    // single kernel over all input channels
+    if (!tensor_(&cs->a, m, n, o, 1)) return 0;
+    const size_t m_res = (m - k) / s + 1, n_res = (n - k) / s + 1;
+    cs->kernel = (Kernel){.m=k, .n=k, .o=o, .m_stride=s, .n_stride=s, .bias=(elm_t)0.1, .arr=alloc_arr(k * k * o)};
+    cs->res.arr = alloc_arr(m_res * n_res);
+    if (cs->kernel.arr == NULL || cs->res.arr == NULL) return 0;
+    fill_(cs->kernel.arr, k * k * o, 2);
+    snprintf(cs->shape, sizeof(cs->shape), "%zux%zux%zu", m, n, o);
+    snprintf(cs->params, sizeof(cs->params), "k%zux%zu s%zu", k, k, s);
+    cs->flops = 2.0 * (double)(m_res * n_res * k * k * o);
+    return 1;
+}
+
+static int check_layer_(const Case *cs, const elm_t *y) {
+    // channel-major layer output against direct convolution, error relative to the largest output
+    const Kernel *k_ref = cs->layer.kernels[0];
+    const size_t size = (cs->x.m - k_ref->m + 1) * (cs->x.n - k_ref->n + 1) * cs->layer.num * cs->x.b;
+    Batch ref = {.arr=alloc_arr(size)};
+    if (ref.arr == NULL) return 0;
+    const int ok = batch_conv_direct_into(&ref, &cs->x, &cs->layer) != NULL;
+    elm_t max_err = 0, max_ref = 0;
+    for (size_t elm = 0; ok && elm < size; elm++) {
+        const elm_t err = y[elm] > ref.arr[elm] ? y[elm] - ref.arr[elm] : ref.arr[elm] - y[elm];
+        const elm_t mag = ref.arr[elm] > 0 ? ref.arr[elm] : -ref.arr[elm];
+        if (err > max_err) max_err = err;
+        if (mag > max_ref) max_ref = mag;
+    }
+    free(ref.arr);
+    if (max_err > CONV_TOL * (1 + max_ref)) {
+        fprintf(stderr, "Result mismatch: max error %g over tolerance %g.\n", (double)max_err,
+            (double)(CONV_TOL * (1 + max_ref)));
+        return 0;
+    }
+    return ok;
+}
+
+static int check_quant_(const QuantWeights *quant, const elm_t *y, const elm_t *ref, const size_t size,
+    const size_t cols) {
+    // int8 outputs against fp32, each within the worst case of input and weight rounding over its dot product
+    // (|x| s_w / 2 + |w| s_x / 2 + s_x s_w / 4 per product), plus fp32 slack; output channel of elm is elm / cols
+    const elm_t s_x = quant->in_scale;
+    for (size_t elm = 0; elm < size; elm++) {
+        const size_t row = elm / cols % quant->num;
+        const elm_t s_w = quant->scales[row] / s_x, w_max = s_w * 127;
+        const elm_t tol = (elm_t)quant->len * (FILL_MAX * s_w / 2 + w_max * s_x / 2 + s_x * s_w / 4) + (elm_t)1e-4;
+        const elm_t diff = y[elm] - ref[elm];
+        if (diff > tol || -diff > tol) {
+            fprintf(stderr, "Result mismatch: int8 error %g over tolerance %g.\n", (double)diff, (double)tol);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int setup_layer_(Case *cs, const size_t m, const size_t n, const size_t o, const size_t b, const size_t k,
+    const size_t num) {
+    // conv layer of num kernels over a batch, unit stride
+    const size_t m_res = m - k + 1, n_res = n - k + 1;
+    const size_t o_res = cs->kind == OP_CONV_BLOCKED ? chan_blocks(num) * CHAN_BLOCK : num;
+    cs->x = (Batch){.m=m, .n=n, .o=o, .b=b, .arr=alloc_arr(m * n * o * b)};
+    cs->y = (Batch){.arr=alloc_arr(m_res * n_res * o_res * b)};
+    if (cs->x.arr == NULL || cs->y.arr == NULL) return 0;
+    fill_(cs->x.arr, m * n * o * b, 1);
+    cs->layer = (Convolutional){.kernels=cs->kernel_ptrs, .num=num};
+    for (size_t kern = 0; kern < num; kern++) {
+        cs->kernel_set[kern] = (Kernel){.m=k, .n=k, .o=o, .m_stride=1, .n_stride=1, .bias=(elm_t)0.1,
+            .arr=alloc_arr(k * k * o)};
+        cs->kernel_ptrs[kern] = &cs->kernel_set[kern];
+        if (cs->kernel_set[kern].arr == NULL) return 0;
+        fill_(cs->kernel_set[kern].arr, k * k * o, kern);
+    }
+    if (cs->kind == OP_CONV_IM2COL || cs->kind == OP_CONV_PACKED) {
+        cs->arena = make_arena(arena_bytes(batch_conv_im2col_workspace(&cs->x, &cs->layer)));
+        if (cs->arena == NULL) return 0;
+    }
+    if (cs->kind == OP_CONV_PACKED) {
+        // kernels packed once, as at load
+        cs->layer_ref = (Layer){.type=LAYER_CONV, .conv=&cs->layer};
+        cs->packs = pack_layers(&cs->layer_ref, 1, NULL, 0);
+        if (cs->packs == NULL || batch_conv_im2col_into(&cs->y, &cs->x, &cs->layer, cs->arena) == NULL
+            || !check_layer_(cs, cs->y.arr)) {
+            return 0;
+        }
+    }
+    if (cs->kind == OP_CONV_WINOGRAD) {
+        // kernels transformed once, as at load
+        cs->wino = winograd_kernels(&cs->layer);
+        if (cs->wino == NULL) return 0;
+        cs->arena = make_arena(arena_bytes(batch_conv_winograd_workspace(&cs->x, &cs->layer, cs->wino)));
+        if (cs->arena == NULL) return 0;
+        if (batch_conv_winograd_into(&cs->y, &cs->x, &cs->layer, cs->wino, cs->arena) == NULL
+            || !check_layer_(cs, cs->y.arr)) {
+            return 0;
+        }
+    }
+    if (cs->kind == OP_CONV_FFT) {
+        // kernel spectra computed once, as at load
+        cs->fft = fft_kernels(&cs->layer, m, n);
+        if (cs->fft == NULL) return 0;
+        cs->arena = make_arena(arena_bytes(batch_conv_fft_workspace(&cs->x, &cs->layer)));
+        if (cs->arena == NULL) return 0;
+        if (batch_conv_fft_into(&cs->y, &cs->x, &cs->layer, cs->fft, cs->arena) == NULL
+            || !check_layer_(cs, cs->y.arr)) {
+            return 0;
+        }
+    }
+    if (cs->kind == OP_CONV_BLOCKED) {
+        // kernels packed once, as at load; input already blocked, as behind another blocked layer
+        cs->block = blocked_kernels(&cs->layer);
+        cs->xb.arr = alloc_arr(batch_blocked_size(&cs->x));
+        cs->arena = make_arena(arena_bytes(batch_conv_blocked_workspace(&cs->x, &cs->layer)));
+        if (cs->block == NULL || cs->xb.arr == NULL || cs->arena == NULL) return 0;
+        batch_block_into(&cs->xb, &cs->x);
+        Batch flat = {.arr=alloc_arr(m_res * n_res * num * b)};
+        const int ok = flat.arr != NULL
+            && batch_conv_blocked_into(&cs->y, &cs->xb, 1, &cs->layer, cs->block, cs->arena) != NULL
+            && check_layer_(cs, batch_unblock_into(&flat, &cs->y)->arr);
+        free(flat.arr);
+        if (!ok) return 0;
+    }
+    if (cs->kind == OP_CONV_INT8) {
+        // inputs span fill_ values
+        cs->quant = quantize_conv(&cs->layer, FILL_MAX);
+        if (cs->quant == NULL) return 0;
+        cs->arena = make_arena(arena_bytes(batch_conv_quant_workspace(&cs->x, &cs->layer, cs->quant)));
+        if (cs->arena == NULL) return 0;
+        Batch ref = {.arr=alloc_arr(m_res * n_res * num * b)};
+        const int ok = ref.arr != NULL && batch_conv_quant_into(&cs->y, &cs->x, &cs->layer, cs->quant, cs->arena)
+            != NULL && batch_conv_direct_into(&ref, &cs->x, &cs->layer) != NULL
+            && check_quant_(cs->quant, cs->y.arr, ref.arr, m_res * n_res * num * b, m_res * n_res);
+        free(ref.arr);
+        if (!ok) return 0;
+    }
+    snprintf(cs->shape, sizeof(cs->shape), "%zux%zux%zux%zu", m, n, o, b);
+    snprintf(cs->params, sizeof(cs->params), "k%zux%zu n%zu", k, k, num);
+    cs->flops = 2.0 * (double)(m_res * n_res * k * k * o * num * b);
+    return 1;
+}
+
+static int setup_pool_(Case *cs, const size_t m, const size_t n, const size_t o, const size_t k, const size_t s) {
+    if (!tensor_(&cs->a, m, n, o, 1)) return 0;
+    cs->pooler = (Pooler){.m=k, .n=k, .m_stride=s, .n_stride=s};
+    const size_t size = ((m - k) / s + 1) * ((n - k) / s + 1);
+    cs->res.arr = alloc_arr(size * o);
+    if (cs->res.arr == NULL) return 0;
+    if (cs->kind == OP_POOL_BLOCKED) {
+        // input already blocked, checked against pooling in the channel-major layout
+        const Batch main = {.m=m, .n=n, .o=o, .b=1, .arr=cs->a.arr};
+        cs->xb.arr = alloc_arr(batch_blocked_size(&main));
+        cs->y.arr = alloc_arr(size * chan_blocks(o) * CHAN_BLOCK);
+        Batch flat = {.arr=alloc_arr(size * o)};
+        int ok = cs->xb.arr != NULL && cs->y.arr != NULL && flat.arr != NULL;
+        if (ok) {
+            batch_block_into(&cs->xb, &main);
+            ok = batch_pool_blocked_into(&cs->y, &cs->xb, &cs->pooler) != NULL
+                && pool_into(&cs->res, &cs->a, &cs->pooler) != NULL;
+        }
+        if (ok) batch_unblock_into(&flat, &cs->y);
+        for (size_t elm = 0; ok && elm < size * o; elm++) {
+            if (flat.arr[elm] != cs->res.arr[elm]) {
+                fprintf(stderr, "Result mismatch: element %zu.\n", elm);
+                ok = 0;
+            }
+        }
+        free(flat.arr);
+        if (!ok) return 0;
+    }
+    snprintf(cs->shape, sizeof(cs->shape), "%zux%zux%zu", m, n, o);
+    snprintf(cs->params, sizeof(cs->params), "p%zux%zu s%zu", k, k, s);
+    return 1;
+}
+
+static int setup_matmul_(Case *cs, const size_t m, const size_t n, const size_t k) {
+    if (!tensor_(&cs->a, m, k, 1, 1) || !tensor_(&cs->b, k, n, 1, 2)) return 0;
+    cs->res.arr = alloc_arr(m * n);
+    if (cs->kind == OP_MATMUL_FP16) {
+        // b stored as fp16, widened as it is packed
+        cs->half = malloc(k * n * sizeof(uint16_t));
+        if (cs->half == NULL) return 0;
+        for (size_t elm = 0; elm < k * n; elm++) cs->half[elm] = narrow_elm(cs->b.arr[elm], PREC_FP16);
+    }
+    cs->arena = make_arena(arena_bytes(cs->kind == OP_MATMUL_FP16 ? gemm_half_workspace(m, n, k)
+        : gemm_workspace(m, n, k)));
+    if (cs->res.arr == NULL || cs->arena == NULL) return 0;
+    snprintf(cs->shape, sizeof(cs->shape), "%zux%zux%zu", m, n, k);
+    snprintf(cs->params, sizeof(cs->params), "mnk");
+    cs->flops = 2.0 * (double)(m * n * k);
+    return 1;
+}
+
+static int setup_dense_(Case *cs, const size_t b, const size_t n, const size_t k) {
+    // relu dense layer of k inputs and n outputs over b flattened items, b holds the weights and res the biases
+    if (!tensor_(&cs->b, k, n, 1, 2) || !tensor_(&cs->res, 1, n, 1, 3)) return 0;
+    cs->dense = (Dense){.weights=&cs->b, .biases=&cs->res};
+    cs->x = (Batch){.m=1, .n=k, .o=1, .b=b, .arr=alloc_arr(b * k)};
+    cs->y = (Batch){.arr=alloc_arr(b * n)};
+    cs->classes = malloc(b * TOP_K * sizeof(size_t));
+    cs->arena = make_arena(arena_bytes(batch_dense_topk_workspace(&cs->x, &cs->dense)));
+    if (cs->kind == OP_DENSE_INT8) {
+        // inputs span fill_ values
+        cs->quant = quantize_dense(&cs->dense, FILL_MAX);
+        free_arena(cs->arena);
+        cs->arena = cs->quant != NULL ? make_arena(arena_bytes(batch_dense_quant_workspace(cs->quant))) : NULL;
+        if (cs->arena == NULL) return 0;
+    }
+    if (cs->kind == OP_DENSE_PACKED) {
+        // weights packed once, as at load
+        cs->layer_ref = (Layer){.type=LAYER_DENSE, .dense=&cs->dense};
+        cs->packs = pack_layers(&cs->layer_ref, 1, NULL, 0);
+        if (cs->packs == NULL) return 0;
+    }
+    Batch ref = {.arr=alloc_arr(b * n)};
+    int ok = cs->x.arr != NULL && cs->y.arr != NULL && cs->classes != NULL && cs->arena != NULL && ref.arr != NULL;
+    if (ok) {
+        // int8 against matmul, then bias; fused and top-k against matmul, then bias, then relu
+        fill_(cs->x.arr, b * k, 1);
+        const Tensor ref_view = {.m=1, .n=n, .o=b, .arr=ref.arr};
+        ok = batch_matmul_into(&ref, &cs->x, &cs->b, NULL) != NULL && batch_sum_into(&ref, &ref, &cs->res) != NULL;
+        if (ok && cs->kind == OP_DENSE_INT8) {
+            ok = batch_dense_quant_into(&cs->y, &cs->x, cs->quant, cs->arena) != NULL
+                && check_quant_(cs->quant, cs->y.arr, ref.arr, b * n, 1);
+        } else if (ok) {
+            ok = batch_dense_into(&cs->y, &cs->x, &cs->dense, relu, cs->arena) != NULL
+                && batch_dense_topk_into(cs->classes, NULL, &cs->x, &cs->dense, ACT_RELU, TOP_K, cs->arena) != NULL;
+        }
+        relu(&ref_view);
+        elm_t max_err = 0;
+        for (size_t elm = 0; ok && cs->kind != OP_DENSE_INT8 && elm < b * n; elm++) {
+            const elm_t diff = cs->y.arr[elm] - ref.arr[elm];
+            const elm_t err = diff < 0 ? -diff : diff;
+            if (err > max_err) max_err = err;
+        }
+        for (size_t img = 0; ok && cs->kind != OP_DENSE_INT8 && img < b; img++) {
+            const Tensor item = {.m=1, .n=n, .o=1, .arr=&ref.arr[img * n]};
+            if (item.arr[cs->classes[img * TOP_K]] != item.arr[argmax(&item)]) max_err = 1;
+        }
+        if (ok && max_err > (elm_t)1e-4) {
+            fprintf(stderr, "Result mismatch: max error %g.\n", (double)max_err);
+            ok = 0;
+        }
+    }
+    free(ref.arr);
+    snprintf(cs->shape, sizeof(cs->shape), "%zux%zux%zu", b, n, k);
+    snprintf(cs->params, sizeof(cs->params), "%s", cs->kind == OP_DENSE_INT8 ? "-" : "relu");
+    cs->flops = 2.0 * (double)(b * n * k);
+    return ok;
+}
+
+static int setup_elementwise_(Case *cs, const size_t m, const size_t n, const size_t o) {
+    // sum, transpose, combine and activations over an m x n x o tensor
+    if (!tensor_(&cs->a, m, n, o, 1)) return 0;
+    snprintf(cs->shape, sizeof(cs->shape), "%zux%zux%zu", m, n, o);
+    snprintf(cs->params, sizeof(cs->params), "-");
+    if (cs->kind == OP_SUM) {
+        if (!tensor_(&cs->b, m, n, o, 2)) return 0;
+        cs->res.arr = alloc_arr(m * n * o);
+        cs->flops = (double)(m * n * o);
+        return cs->res.arr != NULL;
+    }
+    if (cs->kind == OP_TRANSPOSE) {
+        cs->res.arr = alloc_arr(m * n * o);
+        return cs->res.arr != NULL;
+    }
+    if (cs->kind == OP_VIEW_COPY) {
+        // transposed view packed, checked against transpose
+        const View view = tensor_view(&cs->a);
+        cs->view = view_transpose(&view);
+        cs->res.arr = alloc_arr(m * n * o);
+        Tensor ref = {.arr=alloc_arr(m * n * o)};
+        int ok = cs->res.arr != NULL && ref.arr != NULL;
+        if (ok) {
+            view_copy_into(&cs->res, &cs->view);
+            transpose_into(&ref, &cs->a);
+            ok = memcmp(cs->res.arr, ref.arr, m * n * o * sizeof(elm_t)) == 0;
+            if (!ok) fprintf(stderr, "Result mismatch: transposed view copy.\n");
+        }
+        free(ref.arr);
+        return ok;
+    }
+    if (cs->kind == OP_COMBINE) {
+        cs->parts_num = 4;
+        snprintf(cs->params, sizeof(cs->params), "x%zu", cs->parts_num);
+        return make_parts_(cs);
+    }
+    return 1;
+}
+
+static int run_(Case *cs) {
+    // one call of the op
+    Tensor *pair[2] = {&cs->a, &cs->b};
+    const Tensor view = {.m=cs->a.m, .n=cs->a.n, .o=cs->a.o, .arr=cs->a.arr};
+    switch (cs->kind) {
+        case OP_CONV: return conv_into(&cs->res, &cs->a, &cs->kernel) != NULL;
+        case OP_CONV_DIRECT: return batch_conv_direct_into(&cs->y, &cs->x, &cs->layer) != NULL;
+        case OP_CONV_IM2COL:
+        case OP_CONV_PACKED:
+            arena_reset(cs->arena);
+            return batch_conv_im2col_into(&cs->y, &cs->x, &cs->layer, cs->arena) != NULL;
+        case OP_CONV_WINOGRAD:
+            arena_reset(cs->arena);
+            return batch_conv_winograd_into(&cs->y, &cs->x, &cs->layer, cs->wino, cs->arena) != NULL;
+        case OP_CONV_FFT:
+            arena_reset(cs->arena);
+            return batch_conv_fft_into(&cs->y, &cs->x, &cs->layer, cs->fft, cs->arena) != NULL;
+        case OP_CONV_BLOCKED:
+            arena_reset(cs->arena);
+            return batch_conv_blocked_into(&cs->y, &cs->xb, 1, &cs->layer, cs->block, cs->arena) != NULL;
+        case OP_CONV_INT8:
+            arena_reset(cs->arena);
+            return batch_conv_quant_into(&cs->y, &cs->x, &cs->layer, cs->quant, cs->arena) != NULL;
+        case OP_POOL: return pool_into(&cs->res, &cs->a, &cs->pooler) != NULL;
+        case OP_POOL_BLOCKED: return batch_pool_blocked_into(&cs->y, &cs->xb, &cs->pooler) != NULL;
+        case OP_MATMUL:
+            arena_reset(cs->arena);
+            return matmul_into(&cs->res, &cs->a, &cs->b, cs->arena) != NULL;
+        case OP_MATMUL_FP16: {
+            arena_reset(cs->arena);
+            const size_t m = cs->a.m, n = cs->b.n, k = cs->a.n;
+            const size_t work_size = gemm_half_workspace(m, n, k);
+            elm_t *work = work_size != 0 ? arena_alloc(cs->arena, work_size) : NULL;
+            return gemm_half_ws(cs->res.arr, cs->a.arr, cs->half, PREC_FP16, m, n, k, work) != NULL;
+        }
+        case OP_DENSE:
+        case OP_DENSE_PACKED:
+            arena_reset(cs->arena);
+            return batch_dense_into(&cs->y, &cs->x, &cs->dense, relu, cs->arena) != NULL;
+        case OP_DENSE_UNFUSED: {
+            arena_reset(cs->arena);
+            const Tensor y_view = {.m=1, .n=cs->b.n, .o=cs->x.b, .arr=cs->y.arr};
+            if (batch_matmul_into(&cs->y, &cs->x, &cs->b, cs->arena) == NULL) return 0;
+            if (batch_sum_into(&cs->y, &cs->y, &cs->res) == NULL) return 0;
+            relu(&y_view);
+            return 1;
+        }
+        case OP_DENSE_TOPK:
+            arena_reset(cs->arena);
+            return batch_dense_topk_into(cs->classes, NULL, &cs->x, &cs->dense, ACT_RELU, TOP_K, cs->arena) != NULL;
+        case OP_DENSE_INT8:
+            arena_reset(cs->arena);
+            return batch_dense_quant_into(&cs->y, &cs->x, cs->quant, cs->arena) != NULL;
+        case OP_SUM: return sum_into(&cs->res, pair, 2) != NULL;
+        case OP_COMBINE: {
+            Tensor *res = combine(cs->parts, cs->parts_num);
+            // parts[0] now holds the result, the others are freed
+            for (size_t part = 1; part < cs->parts_num; part++) cs->parts[part] = NULL;
+            return res != NULL;
+        }
+        case OP_TRANSPOSE: return transpose_into(&cs->res, &cs->a) != NULL;
+        case OP_VIEW_COPY: return view_copy_into(&cs->res, &cs->view) != NULL;
+        case OP_RELU: relu(&view); return 1;
+        case OP_SIGMOID: sigmoid(&view); return 1;
+        case OP_SOFTMAX: softmax(&view); return 1;
+        case OP_SIGMOID_EXACT:
+        case OP_SOFTMAX_EXACT: {
+            const ExpMode mode = get_exp_mode();
+            set_exp_mode(EXP_EXACT);
+            if (cs->kind == OP_SIGMOID_EXACT) sigmoid(&view); else softmax(&view);
+            set_exp_mode(mode);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_doubles_(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int measure_(Case *cs, const Settings *settings, Record *rec) {
+    // calls per sample, so that clock resolution stays negligible; combine inputs are rebuilt outside the clock
+    const int rebuild = cs->kind == OP_COMBINE;
+    size_t inner = 1;
+    if (!rebuild) {
+        for (;;) {
+            const double start = now_();
+            for (size_t rep = 0; rep < inner; rep++) if (!run_(cs)) return 0;
+            if (now_() - start >= MIN_SAMPLE) break;
+            inner *= 2;
+        }
+    }
+
+    // warmup, then samples
+    double times[settings->samples];
+    for (size_t sample = 0; sample < settings->warmup + settings->samples; sample++) {
+        if (rebuild && !make_parts_(cs)) return 0;
+        const double start = now_();
+        for (size_t rep = 0; rep < inner; rep++) if (!run_(cs)) return 0;
+        const double elapsed = (now_() - start) / (double)inner;
+        if (sample >= settings->warmup) times[sample - settings->warmup] = elapsed;
+    }
+    qsort(times, settings->samples, sizeof(double), compare_doubles_);
+
+    // median, p99 and min
+    const size_t num = settings->samples;
+    const double median = num % 2 ? times[num / 2] : (times[num / 2 - 1] + times[num / 2]) / 2;
+    size_t p99 = (num * 99 + 99) / 100;
+    if (p99 > num) p99 = num;
+    snprintf(rec->op, sizeof(rec->op), "%s", op_names_[cs->kind]);
+    snprintf(rec->shape, sizeof(rec->shape), "%s", cs->shape);
+    snprintf(rec->params, sizeof(rec->params), "%s", cs->params);
+    rec->samples = num;
+    rec->median_us = median * 1e6;
+    rec->p99_us = times[p99 - 1] * 1e6;
+    rec->min_us = times[0] * 1e6;
+    rec->gflops = cs->flops / median * 1e-9;
+    return 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void print_record_(FILE *fp, const Record *rec, const char format, const int first) {
+    if (format == 'c') {
+        fprintf(fp, "%s,%s,%s,%zu,%.4f,%.4f,%.4f,%.4f\n", rec->op, rec->shape, rec->params, rec->samples,
+            rec->median_us, rec->p99_us, rec->min_us, rec->gflops);
+    } else if (format == 'j') {
+        // one record per line, read back by compare
+        fprintf(fp, "%s  {\"op\": \"%s\", \"shape\": \"%s\", \"params\": \"%s\", \"samples\": %zu, "
+            "\"median_us\": %.4f, \"p99_us\": %.4f, \"min_us\": %.4f, \"gflops\": %.4f}", first ? "" : ",\n",
+            rec->op, rec->shape, rec->params, rec->samples, rec->median_us, rec->p99_us, rec->min_us, rec->gflops);
+    } else {
+        fprintf(fp, "%-14s %-14s %-10s | %10.3f %10.3f %10.3f | %8.3f\n", rec->op, rec->shape, rec->params,
+            rec->median_us, rec->p99_us, rec->min_us, rec->gflops);
+    }
+    fflush(fp);
+}
+
+static int run_ops_(const Settings *settings, const char format, FILE *fp) {
+    // sweep
+    typedef struct {
+        OpKind kind;
+        size_t d[6];
+    } Sweep;
+    const Sweep sweep[] = {
+        // conv: m, n, o, kernel, stride
+        {OP_CONV, {28, 28, 1, 3, 1}}, {OP_CONV, {28, 28, 1, 5, 1}}, {OP_CONV, {28, 28, 1, 5, 2}},
+        {OP_CONV, {64, 64, 3, 3, 1}}, {OP_CONV, {64, 64, 3, 5, 2}}, {OP_CONV, {128, 128, 16, 3, 1}},
+        {OP_CONV, {128, 128, 16, 3, 2}},
+        // conv layers: m, n, o, batch, kernel, kernels
+        {OP_CONV_DIRECT, {28, 28, 1, 16, 5, 2}}, {OP_CONV_DIRECT, {12, 12, 2, 16, 3, 4}},
+        {OP_CONV_DIRECT, {64, 64, 3, 4, 3, 16}}, {OP_CONV_DIRECT, {32, 32, 16, 4, 3, 16}},
+        {OP_CONV_DIRECT, {64, 64, 3, 4, 7, 16}}, {OP_CONV_DIRECT, {128, 128, 3, 1, 11, 8}},
+        {OP_CONV_IM2COL, {28, 28, 1, 16, 5, 2}}, {OP_CONV_IM2COL, {12, 12, 2, 16, 3, 4}},
+        {OP_CONV_IM2COL, {64, 64, 3, 4, 3, 16}}, {OP_CONV_IM2COL, {32, 32, 16, 4, 3, 16}},
+        {OP_CONV_PACKED, {28, 28, 1, 16, 5, 2}}, {OP_CONV_PACKED, {12, 12, 2, 16, 3, 4}},
+        {OP_CONV_PACKED, {64, 64, 3, 4, 3, 16}}, {OP_CONV_PACKED, {32, 32, 16, 4, 3, 16}},
+        {OP_CONV_WINOGRAD, {12, 12, 2, 16, 3, 4}}, {OP_CONV_WINOGRAD, {64, 64, 3, 4, 3, 16}},
+        {OP_CONV_WINOGRAD, {32, 32, 16, 4, 3, 16}},
+        {OP_CONV_FFT, {28, 28, 1, 16, 5, 2}}, {OP_CONV_FFT, {64, 64, 3, 4, 7, 16}},
+        {OP_CONV_FFT, {128, 128, 3, 1, 11, 8}},
+        {OP_CONV_BLOCKED, {28, 28, 1, 16, 5, 2}}, {OP_CONV_BLOCKED, {12, 12, 2, 16, 3, 4}},
+        {OP_CONV_BLOCKED, {64, 64, 3, 4, 3, 16}}, {OP_CONV_BLOCKED, {32, 32, 16, 4, 3, 16}},
+        {OP_CONV_BLOCKED, {64, 64, 3, 4, 7, 16}}, {OP_CONV_BLOCKED, {24, 24, 5, 4, 5, 12}},
+        {OP_CONV_INT8, {28, 28, 1, 16, 5, 2}}, {OP_CONV_INT8, {12, 12, 2, 16, 3, 4}},
+        {OP_CONV_INT8, {64, 64, 3, 4, 3, 16}},
+        // pool: m, n, o, window, stride
+        {OP_POOL, {24, 24, 2, 2, 2}}, {OP_POOL, {128, 128, 16, 2, 2}}, {OP_POOL, {128, 128, 16, 3, 2}},
+        {OP_POOL_BLOCKED, {24, 24, 2, 2, 2}}, {OP_POOL_BLOCKED, {128, 128, 16, 2, 2}},
+        {OP_POOL_BLOCKED, {128, 128, 16, 3, 2}},
+        // matmul: m, n, k
+        {OP_MATMUL, {1, 10, 100}}, {OP_MATMUL, {64, 10, 100}}, {OP_MATMUL, {128, 128, 128}},
+        {OP_MATMUL, {256, 256, 256}}, {OP_MATMUL, {64, 256, 1024}},
+        {OP_MATMUL_FP16, {1, 10, 100}}, {OP_MATMUL_FP16, {64, 10, 100}}, {OP_MATMUL_FP16, {128, 128, 128}},
+        {OP_MATMUL_FP16, {256, 256, 256}}, {OP_MATMUL_FP16, {64, 256, 1024}},
+        // dense: batch, outputs, inputs
+        {OP_DENSE, {1, 10, 100}}, {OP_DENSE, {64, 10, 100}}, {OP_DENSE, {64, 1000, 512}}, {OP_DENSE, {1, 1000, 2048}},
+        {OP_DENSE_PACKED, {1, 10, 100}}, {OP_DENSE_PACKED, {64, 10, 100}}, {OP_DENSE_PACKED, {64, 1000, 512}},
+        {OP_DENSE_PACKED, {1, 1000, 2048}},
+        {OP_DENSE_UNFUSED, {1, 10, 100}}, {OP_DENSE_UNFUSED, {64, 10, 100}}, {OP_DENSE_UNFUSED, {64, 1000, 512}},
+        {OP_DENSE_UNFUSED, {1, 1000, 2048}},
+        {OP_DENSE_TOPK, {1, 10, 100}}, {OP_DENSE_TOPK, {64, 10, 100}}, {OP_DENSE_TOPK, {64, 1000, 512}},
+        {OP_DENSE_TOPK, {1, 1000, 2048}},
+        {OP_DENSE_INT8, {1, 10, 100}}, {OP_DENSE_INT8, {64, 10, 100}}, {OP_DENSE_INT8, {64, 1000, 512}},
+        {OP_DENSE_INT8, {1, 1000, 2048}},
+        // elementwise: m, n, o
+        {OP_SUM, {1, 10, 1}}, {OP_SUM, {256, 256, 1}}, {OP_SUM, {512, 512, 4}},
+        {OP_COMBINE, {24, 24, 2}}, {OP_COMBINE, {256, 256, 4}},
+        {OP_TRANSPOSE, {64, 64, 1}}, {OP_TRANSPOSE, {1024, 1024, 1}}, {OP_TRANSPOSE, {100, 10, 8}},
+        {OP_VIEW_COPY, {64, 64, 1}}, {OP_VIEW_COPY, {1024, 1024, 1}}, {OP_VIEW_COPY, {100, 10, 8}},
+        {OP_RELU, {1, 1024, 1}}, {OP_RELU, {256, 256, 1}}, {OP_RELU, {1024, 1024, 1}},
+        {OP_SIGMOID, {1, 1024, 1}}, {OP_SIGMOID, {256, 256, 1}}, {OP_SIGMOID, {1024, 1024, 1}},
+        {OP_SIGMOID_EXACT, {1, 1024, 1}}, {OP_SIGMOID_EXACT, {256, 256, 1}}, {OP_SIGMOID_EXACT, {1024, 1024, 1}},
+        {OP_SOFTMAX, {1, 10, 1}}, {OP_SOFTMAX, {1, 1000, 64}}, {OP_SOFTMAX, {256, 256, 1}},
+        {OP_SOFTMAX_EXACT, {1, 10, 1}}, {OP_SOFTMAX_EXACT, {1, 1000, 64}}, {OP_SOFTMAX_EXACT, {256, 256, 1}},
+    };
+    const size_t num = sizeof(sweep) / sizeof(sweep[0]);
+
+    // header
+    if (format == 'c') {
+        fprintf(fp, "op,shape,params,samples,median_us,p99_us,min_us,gflops\n");
+    } else if (format == 'j') {
+        fprintf(fp, "[\n");
+    } else {
+        fprintf(fp, "kernels: %s\n", simd_ops()->name);
+        fprintf(fp, "%-14s %-14s %-10s | %10s %10s %10s | %8s\n", "op", "shape", "params", "median us", "p99 us",
+            "min us", "GFLOP/s");
+    }
+
+    int first = 1;
+    for (size_t idx = 0; idx < num; idx++) {
+        const Sweep *sw = &sweep[idx];
+        if (settings->only != NULL && strcmp(settings->only, op_names_[sw->kind]) != 0) continue;
+        Case cs;
+        memset(&cs, 0, sizeof(Case));
+        cs.kind = sw->kind;
+        int ok;
+        if (sw->kind == OP_CONV) {
+            ok = setup_conv_(&cs, sw->d[0], sw->d[1], sw->d[2], sw->d[3], sw->d[4]);
+        } else if (sw->kind == OP_CONV_DIRECT || sw->kind == OP_CONV_IM2COL || sw->kind == OP_CONV_PACKED
+            || sw->kind == OP_CONV_WINOGRAD || sw->kind == OP_CONV_FFT || sw->kind == OP_CONV_BLOCKED
+            || sw->kind == OP_CONV_INT8) {
+            ok = setup_layer_(&cs, sw->d[0], sw->d[1], sw->d[2], sw->d[3], sw->d[4], sw->d[5]);
+        } else if (sw->kind == OP_POOL || sw->kind == OP_POOL_BLOCKED) {
+            ok = setup_pool_(&cs, sw->d[0], sw->d[1], sw->d[2], sw->d[3], sw->d[4]);
+        } else if (sw->kind == OP_MATMUL || sw->kind == OP_MATMUL_FP16) {
+            ok = setup_matmul_(&cs, sw->d[0], sw->d[1], sw->d[2]);
+        } else if (sw->kind == OP_DENSE || sw->kind == OP_DENSE_PACKED || sw->kind == OP_DENSE_UNFUSED
+            || sw->kind == OP_DENSE_TOPK || sw->kind == OP_DENSE_INT8) {
+            ok = setup_dense_(&cs, sw->d[0], sw->d[1], sw->d[2]);
+        } else {
+            ok = setup_elementwise_(&cs, sw->d[0], sw->d[1], sw->d[2]);
+        }
+        Record rec;
+        ok = ok && measure_(&cs, settings, &rec);
+        free_case_(&cs);
+        if (!ok) {
+            fprintf(stderr, "Failed benchmark: %s case %zu.\n", op_names_[sw->kind], idx);
+            return 1;
+        }
+        print_record_(fp, &rec, format, first);
+        first = 0;
+    }
+    if (format == 'j') fprintf(fp, "\n]\n");
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static int json_str_(const char *line, const char *key, char *dst, const size_t size) {
+    // "key": "value"
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    const char *start = strstr(line, pattern);
+    if (start == NULL) return 0;
+    start += strlen(pattern);
+    const char *end = strchr(start, '"');
+    if (end == NULL || (size_t)(end - start) >= size) return 0;
+    memcpy(dst, start, (size_t)(end - start));
+    dst[end - start] = '\0';
+    return 1;
+}
+
+static int json_num_(const char *line, const char *key, double *dst) {
+    // "key": number
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *start = strstr(line, pattern);
+    return start != NULL && sscanf(start + strlen(pattern), "%lf", dst) == 1;
+}
+
+static int parse_record_(const char *line, Record *rec) {
+    // json record line, or csv row
+    if (strchr(line, '{') != NULL) {
+        double samples;
+        return json_str_(line, "op", rec->op, sizeof(rec->op))
+            && json_str_(line, "shape", rec->shape, sizeof(rec->shape))
+            && json_str_(line, "params", rec->params, sizeof(rec->params))
+            && json_num_(line, "samples", &samples) && json_num_(line, "median_us", &rec->median_us)
+            && json_num_(line, "p99_us", &rec->p99_us) && json_num_(line, "min_us", &rec->min_us)
+            && json_num_(line, "gflops", &rec->gflops) && (rec->samples = (size_t)samples, 1);
+    }
+    return sscanf(line, "%23[^,],%47[^,],%47[^,],%zu,%lf,%lf,%lf,%lf", rec->op, rec->shape, rec->params,
+        &rec->samples, &rec->median_us, &rec->p99_us, &rec->min_us, &rec->gflops) == 8;
+}
+
+static Record *read_records_(const char *filename, size_t *num) {
+    // get file ptr
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed opening file: %s.\n", filename);
+        return NULL;
+    }
+
+    // every line that parses as a record; headers and brackets are skipped
+    size_t cap = 64;
+    Record *recs = malloc(cap * sizeof(Record));
+    *num = 0;
+    char line[512];
+    while (recs != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        if (*num == cap) {
+            cap *= 2;
+            Record *grown = realloc(recs, cap * sizeof(Record));
+            if (grown == NULL) free(recs);
+            recs = grown;
+            if (recs == NULL) break;
+        }
+        if (parse_record_(line, &recs[*num])) (*num)++;
+    }
+    fclose(fp);
+    if (recs == NULL) fprintf(stderr, "Failed malloc: records of %s.\n", filename);
+    return recs;
+}
+
+static int run_compare_(const char *base_file, const char *cur_file, const double threshold) {
+    size_t base_num, cur_num;
+    Record *base = read_records_(base_file, &base_num);
+    Record *cur = base != NULL ? read_records_(cur_file, &cur_num) : NULL;
+    if (cur == NULL) {
+        free(base);
+        return 2;
+    }
+
+    // match by op, shape and params; medians further apart than the threshold are flagged
+    size_t regressions = 0;
+    printf("%-14s %-14s %-10s | %10s %10s | %8s\n", "op", "shape", "params", "base us", "current us", "change");
+    for (size_t idx = 0; idx < cur_num; idx++) {
+        const Record *rec = &cur[idx];
+        const Record *ref = NULL;
+        for (size_t other = 0; other < base_num && ref == NULL; other++) {
+            if (strcmp(base[other].op, rec->op) == 0 && strcmp(base[other].shape, rec->shape) == 0
+                && strcmp(base[other].params, rec->params) == 0) ref = &base[other];
+        }
+        if (ref == NULL) {
+            printf("%-14s %-14s %-10s | %10s %10.3f | %8s new\n", rec->op, rec->shape, rec->params, "-",
+                rec->median_us, "-");
+            continue;
+        }
+        const double change = (rec->median_us / ref->median_us - 1) * 100;
+        const char *flag = change > threshold ? "REGRESSION" : change < -threshold ? "improved" : "";
+        if (change > threshold) regressions++;
+        printf("%-14s %-14s %-10s | %10.3f %10.3f | %+7.1f%% %s\n", rec->op, rec->shape, rec->params,
+            ref->median_us, rec->median_us, change, flag);
+    }
+    printf("\n%zu regressions over %.1f%% in %zu cases.\n", regressions, threshold, cur_num);
+    free(base); free(cur);
+    return regressions != 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Benchmark program.
+ *
+ * @param argc: num args.
+ * @param argv: command, default gemm.
+ *              gemm: GFLOP/s of gemm against the per-element reference loop, then the half-precision gemm split
+ *              across a pool checked against its workspace size.
+ *              ops [-f table|csv|json] [-o file] [-r samples] [-w warmup] [-s op]: median, p99 and min time of every op
+ *              over a sweep of shapes, kernel sizes and strides; -s runs a single op.
+ *              compare <baseline> <current> [-t percent]: flags cases whose median regressed by more than percent
+ *              (default 10) against a baseline written by ops in csv or json.
+ *
+ * @return: exit code: 1 for a failed run, result mismatch or regression; 2 for bad arguments; 0 otherwise.
+ */
+int main(const int argc, const char *argv[]) {
+    simd_init();
+    if (argc < 2 || strcmp(argv[1], "gemm") == 0) return run_gemm_();
+
+    char *ptr;
+    if (strcmp(argv[1], "ops") == 0) {
+        // get flags
+        Settings settings = {.samples=51, .warmup=5, .only=NULL};
+        char format = 't';
+        const char *out = NULL;
+        for (int arg = 2; arg + 1 < argc; arg += 2) {
+            if (strcmp(argv[arg], "-f") == 0) {
+                format = strcmp(argv[arg + 1], "csv") == 0 ? 'c' : strcmp(argv[arg + 1], "json") == 0 ? 'j' : 't';
+            } else if (strcmp(argv[arg], "-o") == 0) {
+                out = argv[arg + 1];
+            } else if (strcmp(argv[arg], "-r") == 0) {
+                settings.samples = (size_t)strtol(argv[arg + 1], &ptr, 10);
+            } else if (strcmp(argv[arg], "-w") == 0) {
+                settings.warmup = (size_t)strtol(argv[arg + 1], &ptr, 10);
+            } else if (strcmp(argv[arg], "-s") == 0) {
+                settings.only = argv[arg + 1];
+            }
+        }
+        if (settings.samples == 0) settings.samples = 1;
+
+        // output file
+        FILE *fp = out != NULL ? fopen(out, "w") : stdout;
+        if (fp == NULL) {
+            fprintf(stderr, "Failed opening file: %s.\n", out);
+            return 2;
+        }
+        const int res = run_ops_(&settings, format, fp);
+        if (fp != stdout) fclose(fp);
+        return res;
+    }
+
+    if (strcmp(argv[1], "compare") == 0 && argc >= 4) {
+        const double threshold = argc >= 6 && strcmp(argv[4], "-t") == 0 ? strtod(argv[5], &ptr) : 10.0;
+        return run_compare_(argv[2], argv[3], threshold);
+    }
+
+    printf("Usage: %s [gemm | ops [-f table|csv|json] [-o file] [-r samples] [-w warmup] [-s op]"
+        " | compare <baseline> <current> [-t percent]]\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,340 @@
+// generated by aot from /tmp/work/m_bfloat16.bin, do not edit
+// 28 x 28 x 1 input, 10 outputs
+#include <math.h>
+#include <stddef.h>
+
+const size_t predict_input[3] = {28, 28, 1};
+const size_t predict_classes = 10;
+
+static _Alignas(64) const float conv_w0_[50] = {
+    -6.52343750e-01f, -8.63281250e-01f, -4.64843750e-01f, -2.75390625e-01f, 2.18750000e-01f, -6.60156250e-01f,
+    -7.14843750e-01f, -9.17968750e-02f, 3.20312500e-01f, 6.64062500e-01f, 1.00781250e+00f, 5.50781250e-01f,
+    3.49609375e-01f, 5.50781250e-01f, 7.65625000e-01f, 1.52343750e+00f, 1.23437500e+00f, 6.67968750e-01f,
+    8.16406250e-01f, 8.47656250e-01f, 1.00781250e+00f, 8.63281250e-01f, 5.46875000e-01f, 4.14062500e-01f,
+    4.85839844e-02f, 5.82031250e-01f, 4.19921875e-01f, 5.85937500e-01f, 1.44531250e-01f, -6.21093750e-01f,
+    9.41406250e-01f, 5.58593750e-01f, 6.75781250e-01f, 1.54296875e-01f, -1.10156250e+00f, 8.51562500e-01f,
+    7.65625000e-01f, 7.14843750e-01f, 1.31835938e-01f, -1.23437500e+00f, 9.45312500e-01f, 7.46093750e-01f,
+    5.50781250e-01f, -1.45507812e-01f, -1.03125000e+00f, 4.58984375e-01f, 4.80468750e-01f, 1.34765625e-01f,
+    -4.45312500e-01f, -4.64843750e-01f
+};
+
+static _Alignas(64) const float conv_b0_[2] = {
+    2.09220037e-01f, 3.82282406e-01f
+};
+
+static _Alignas(64) const float conv_w2_[72] = {
+    5.11718750e-01f, -4.31640625e-01f, -1.01562500e+00f, -2.06054688e-01f, -2.10937500e-01f, -2.40234375e-01f,
+    1.01562500e+00f, 9.02343750e-01f, 5.03906250e-01f, -4.74609375e-01f, 2.39257812e-01f, 1.75781250e-01f,
+    -4.37500000e-01f, -8.67187500e-01f, -3.75000000e-01f, 3.82812500e-01f, -1.48437500e-01f, -1.86523438e-01f,
+    6.09375000e-01f, 8.16406250e-01f, 6.44531250e-01f, -5.42968750e-01f, -5.17578125e-02f, 1.68945312e-01f,
+    1.61132812e-01f, -1.35742188e-01f, -8.63281250e-01f, 2.07031250e-01f, 2.59765625e-01f, -1.07910156e-01f,
+    -4.76562500e-01f, -1.13769531e-01f, -3.06640625e-01f, -8.67187500e-01f, -6.71875000e-01f, -7.38281250e-01f,
+    7.86132812e-02f, -1.03515625e-01f, -9.49218750e-01f, -8.98437500e-02f, -5.66406250e-01f, -6.99218750e-01f,
+    2.32421875e-01f, -4.06250000e-01f, -3.78906250e-01f, -3.57421875e-01f, 2.67578125e-01f, 4.19921875e-01f,
+    -4.84375000e-01f, 4.14062500e-01f, 3.67187500e-01f, 4.84375000e-01f, 9.45312500e-01f, -5.78613281e-02f,
+    -2.53906250e-01f, -1.06250000e+00f, -2.73437500e-01f, 1.34765625e-01f, 3.33984375e-01f, 5.11718750e-01f,
+    8.63281250e-01f, 1.35742188e-01f, -3.18359375e-01f, 5.85937500e-01f, 9.64843750e-01f, -7.96875000e-01f,
+    -1.41406250e+00f, -8.32031250e-01f, -6.64062500e-01f, -3.08593750e-01f, -5.82031250e-01f, -5.31250000e-01f
+};
+
+static _Alignas(64) const float conv_b2_[4] = {
+    -9.56270933e-01f, -2.09046340e+00f, 8.98038089e-01f, 1.05526674e+00f
+};
+
+static _Alignas(64) const float dense_w4_[1000] = {
+    1.74804688e-01f, -5.78125000e-01f, -1.01562500e-01f, -3.37890625e-01f, 3.22265625e-01f, -3.22265625e-01f,
+    -2.31445312e-01f, 3.06640625e-01f, 5.35156250e-01f, 8.00781250e-02f, 4.55078125e-01f, -5.31250000e-01f,
+    -5.58593750e-01f, -5.58593750e-01f, 4.41406250e-01f, 9.86328125e-02f, -1.44531250e-01f, 6.95800781e-03f,
+    4.17968750e-01f, 1.95312500e-01f, 2.65625000e-01f, 3.26171875e-01f, -6.36718750e-01f, -2.87109375e-01f,
+    2.71484375e-01f, -1.36718750e-01f, -8.88671875e-02f, -2.72216797e-02f, -4.15039062e-03f, 2.45117188e-01f,
+    2.96875000e-01f, 1.80664062e-01f, -3.33984375e-01f, 2.74658203e-02f, 2.22656250e-01f, -4.72656250e-01f,
+    -5.42968750e-01f, 1.77734375e-01f, 1.51367188e-01f, 4.02343750e-01f, 6.36718750e-01f, -6.64062500e-01f,
+    -4.22363281e-02f, -6.64062500e-02f, 2.08984375e-01f, -4.47265625e-01f, -9.21875000e-01f, 1.55273438e-01f,
+    5.54687500e-01f, 1.93359375e-01f, 4.60937500e-01f, -4.37500000e-01f, 5.50781250e-01f, -2.53906250e-01f,
+    8.34960938e-02f, -5.11718750e-01f, 2.02148438e-01f, -3.08593750e-01f, -1.80664062e-01f, 3.51562500e-01f,
+    -1.51367188e-01f, -1.03515625e-01f, -2.91748047e-02f, 4.98046875e-01f, 5.46875000e-01f, -6.09375000e-01f,
+    2.30468750e-01f, 1.98242188e-01f, -1.24511719e-01f, -4.04296875e-01f, -9.21875000e-01f, -8.39843750e-01f,
+    -8.10546875e-02f, 5.23437500e-01f, 8.64257812e-02f, -2.12890625e-01f, 6.67968750e-01f, -8.82812500e-01f,
+    6.48437500e-01f, 3.69140625e-01f, -1.46875000e+00f, -7.81250000e-01f, -1.03027344e-01f, 6.00585938e-02f,
+    -1.37329102e-03f, 1.81884766e-02f, 6.21093750e-01f, -1.05468750e+00f, 1.02343750e+00f, 6.21093750e-01f,
+    1.72119141e-02f, -7.42187500e-01f, -1.57226562e-01f, -4.92187500e-01f, -2.85156250e-01f, 2.55859375e-01f,
+    4.82421875e-01f, -3.37890625e-01f, 7.27539062e-02f, 7.38281250e-01f, -1.19140625e-01f, -1.73828125e-01f,
+    7.89062500e-01f, 2.15820312e-01f, 2.07031250e-01f, -4.78515625e-02f, -4.70703125e-01f, 2.03125000e-01f,
+    -1.42822266e-02f, -1.52343750e+00f, -6.32812500e-01f, -2.71484375e-01f, 4.90234375e-01f, -1.27929688e-01f,
+    -2.27539062e-01f, -1.69921875e-01f, -3.35937500e-01f, -3.20312500e-01f, 8.98437500e-01f, -2.51953125e-01f,
+    1.23046875e-01f, -1.12500000e+00f, 4.37500000e-01f, -4.29687500e-01f, 2.58789062e-02f, -1.85546875e-01f,
+    -1.52343750e-01f, 2.20703125e-01f, 1.34765625e-01f, -1.23535156e-01f, 4.51660156e-02f, -9.60937500e-01f,
+    3.65234375e-01f, 1.73828125e-01f, 4.19921875e-01f, 1.87500000e-01f, 3.55468750e-01f, -4.43359375e-01f,
+    2.45117188e-01f, -9.96093750e-01f, -5.66406250e-01f, -2.50000000e-01f, 4.88281250e-02f, 2.94921875e-01f,
+    7.12890625e-02f, 7.03125000e-01f, 2.19726562e-01f, -5.35156250e-01f, 2.91015625e-01f, -9.92187500e-01f,
+    -8.39843750e-01f, 3.84765625e-01f, -4.46777344e-02f, 7.22656250e-01f, -1.56250000e-01f, 8.86718750e-01f,
+    -1.52343750e+00f, -5.46875000e-02f, -9.76562500e-02f, -5.00000000e-01f, -3.10546875e-01f, -1.20849609e-02f,
+    -6.59179688e-02f, 4.80468750e-01f, 1.20117188e-01f, 8.86718750e-01f, -8.63281250e-01f, -2.17773438e-01f,
+    -6.01562500e-01f, 2.81250000e-01f, 6.75781250e-01f, -1.54687500e+00f, -7.27539062e-02f, 6.05468750e-01f,
+    -7.96875000e-01f, 7.10937500e-01f, -1.77001953e-02f, -8.90625000e-01f, -1.56250000e-01f, 2.59765625e-01f,
+    1.25976562e-01f, 2.67578125e-01f, -8.10546875e-02f, 5.42968750e-01f, -1.00781250e+00f, 2.75390625e-01f,
+    2.23632812e-01f, -1.13281250e+00f, 7.26562500e-01f, -8.35937500e-01f, -6.67968750e-01f, 6.52343750e-01f,
+    6.36718750e-01f, -3.63281250e-01f, -4.02343750e-01f, 5.20019531e-02f, 9.17968750e-02f, -1.00781250e+00f,
+    6.71875000e-01f, -4.17968750e-01f, -6.56250000e-01f, -1.02050781e-01f, -6.01562500e-01f, 5.54687500e-01f,
+    5.39062500e-01f, 1.31835938e-01f, -7.57812500e-01f, 6.01562500e-01f, -1.05468750e+00f, 3.49609375e-01f,
+    -3.59375000e-01f, -6.01562500e-01f, -4.68750000e-01f, 5.85937500e-01f, -9.08203125e-02f, 1.98242188e-01f,
+    -1.50000000e+00f, -1.24511719e-01f, -4.27734375e-01f, 9.57031250e-01f, 3.61328125e-01f, -1.08593750e+00f,
+    1.35742188e-01f, 6.52343750e-01f, -1.45312500e+00f, 6.79687500e-01f, -2.42919922e-02f, -1.31250000e+00f,
+    9.96093750e-01f, -6.25000000e-01f, 4.78515625e-02f, -1.29882812e-01f, 4.00390625e-01f, -2.49023438e-02f,
+    -7.42187500e-01f, 3.55468750e-01f, 1.37939453e-02f, -3.76953125e-01f, 2.02148438e-01f, -1.26953125e-01f,
+    -2.69531250e-01f, -2.12402344e-02f, 5.11718750e-01f, -2.92968750e-01f, 1.12792969e-01f, -1.31835938e-01f,
+    -2.33398438e-01f, -2.79296875e-01f, -1.93359375e-01f, 4.00390625e-01f, -2.00195312e-01f, -7.12890625e-02f,
+    3.45703125e-01f, 4.08203125e-01f, -2.75390625e-01f, -2.57812500e-01f, -4.92187500e-01f, 5.11718750e-01f,
+    -8.44726562e-02f, -4.31640625e-01f, -3.47656250e-01f, 1.22070312e-01f, 4.12109375e-01f, 1.13281250e+00f,
+    -1.10156250e+00f, -8.98437500e-01f, -1.40625000e+00f, 8.43750000e-01f, -5.03906250e-01f, -7.57812500e-01f,
+    1.16210938e-01f, -6.91406250e-01f, 7.61718750e-01f, 4.35546875e-01f, -9.64843750e-01f, -9.27734375e-02f,
+    -1.54687500e+00f, 6.05468750e-01f, 2.04467773e-03f, 3.91006470e-05f, 4.14062500e-01f, -7.46093750e-01f,
+    2.81250000e-01f, -8.63281250e-01f, -1.46093750e+00f, 1.07812500e+00f, -5.54199219e-02f, -4.19921875e-01f,
+    4.45312500e-01f, 2.11914062e-01f, -3.71093750e-01f, -1.24023438e-01f, -4.94140625e-01f, -1.53125000e+00f,
+    -1.21875000e+00f, 1.07031250e+00f, 1.17187500e+00f, -4.19921875e-01f, -2.92968750e-01f, 1.63085938e-01f,
+    -5.50781250e-01f, -2.94921875e-01f, 9.02343750e-01f, 4.68750000e-01f, -4.78515625e-01f, -4.08203125e-01f,
+    -1.06250000e+00f, 6.87500000e-01f, 3.34472656e-02f, -7.22656250e-01f, -9.92187500e-01f, 2.65625000e-01f,
+    9.25781250e-01f, 9.45312500e-01f, -1.64062500e+00f, -3.63281250e-01f, -2.23437500e+00f, 6.52343750e-01f,
+    -1.50390625e-01f, -1.73828125e-01f, 1.91650391e-02f, -8.44726562e-02f, 6.60156250e-01f, 3.78906250e-01f,
+    -1.59375000e+00f, 2.65625000e-01f, -1.24218750e+00f, 1.10156250e+00f, -6.17187500e-01f, -2.17773438e-01f,
+    4.82421875e-01f, -1.53125000e+00f, -1.85546875e-02f, -6.25000000e-01f, -1.94531250e+00f, 1.57031250e+00f,
+    3.96484375e-01f, 2.50000000e-01f, -2.11914062e-01f, -1.02539062e-01f, -2.81250000e-01f, -2.38281250e-01f,
+    -1.82812500e+00f, -8.32031250e-01f, -1.17187500e+00f, 2.03125000e+00f, 9.29687500e-01f, -1.13281250e+00f,
+    -1.54296875e-01f, -7.46093750e-01f, -7.42187500e-01f, -3.06640625e-01f, -2.44140625e-02f, -1.84570312e-01f,
+    3.12500000e-01f, 2.96875000e-01f, -5.93750000e-01f, 1.36718750e-01f, 9.13085938e-02f, 2.75390625e-01f,
+    -1.57812500e+00f, 8.44726562e-02f, -3.78906250e-01f, 1.02343750e+00f, 1.51367188e-01f, 1.02343750e+00f,
+    -1.93750000e+00f, 8.30078125e-02f, -3.53515625e-01f, 3.05175781e-02f, -5.39062500e-01f, -4.57031250e-01f,
+    -1.16406250e+00f, 7.92968750e-01f, 5.78125000e-01f, 5.07812500e-01f, -1.42187500e+00f, -1.59179688e-01f,
+    -6.87500000e-01f, 7.34375000e-01f, -2.02148438e-01f, -1.00000000e+00f, -1.04687500e+00f, 6.56250000e-01f,
+    -5.35156250e-01f, 7.77343750e-01f, -1.03515625e-01f, 5.54687500e-01f, 5.49316406e-02f, -5.54687500e-01f,
+    -2.98828125e-01f, -3.78906250e-01f, -5.15625000e-01f, 1.54296875e-01f, 1.69921875e-01f, 3.63281250e-01f,
+    -7.53906250e-01f, -4.33593750e-01f, 1.43750000e+00f, -7.96875000e-01f, 3.85742188e-02f, -1.07812500e+00f,
+    -4.62890625e-01f, -3.45703125e-01f, 5.78125000e-01f, 4.66796875e-01f, 4.72656250e-01f, 2.21679688e-01f,
+    -6.36718750e-01f, 8.74023438e-02f, -5.35156250e-01f, -2.44140625e-01f, -8.98437500e-01f, 4.96093750e-01f,
+    5.31250000e-01f, 5.74218750e-01f, 9.86328125e-02f, 4.57763672e-03f, -9.37500000e-01f, 5.62500000e-01f,
+    -9.80468750e-01f, -1.27929688e-01f, -4.66796875e-01f, 5.39062500e-01f, 6.05468750e-01f, 3.27148438e-02f,
+    -9.17968750e-01f, -8.63281250e-01f, -7.71484375e-02f, 1.06250000e+00f, 9.08203125e-02f, -4.02343750e-01f,
+    4.08203125e-01f, -2.09960938e-01f, 8.47656250e-01f, -6.71875000e-01f, -5.74218750e-01f, 6.49414062e-02f,
+    3.86718750e-01f, -2.96875000e-01f, 5.42968750e-01f, -4.19921875e-01f, 1.03906250e+00f, -1.31250000e+00f,
+    6.95312500e-01f, -1.49218750e+00f, -3.63769531e-02f, 1.07812500e+00f, -1.45874023e-02f, -1.26562500e+00f,
+    4.08203125e-01f, -1.69921875e-01f, 3.53515625e-01f, -2.59765625e-01f, -2.45117188e-01f, 3.78906250e-01f,
+    3.47656250e-01f, -1.01562500e+00f, 1.94335938e-01f, -2.18750000e-01f, 3.55468750e-01f, 3.73046875e-01f,
+    3.43750000e-01f, -6.13281250e-01f, -1.28906250e-01f, 8.78906250e-02f, 3.06640625e-01f, -8.78906250e-01f,
+    6.01562500e-01f, -5.89843750e-01f, 4.47265625e-01f, 2.09960938e-01f, 5.39062500e-01f, -3.90625000e-01f,
+    1.11816406e-01f, -1.91650391e-02f, 5.15625000e-01f, -7.61718750e-01f, -2.05078125e-01f, -4.21875000e-01f,
+    6.87500000e-01f, -3.33984375e-01f, 7.89062500e-01f, 7.47680664e-03f, -2.57812500e-01f, -1.48437500e-01f,
+    7.77343750e-01f, -1.15625000e+00f, -2.75390625e-01f, -5.03906250e-01f, 3.32031250e-01f, 3.18359375e-01f,
+    1.37500000e+00f, -8.28125000e-01f, -1.31835938e-01f, -7.03125000e-01f, 4.96093750e-01f, -1.07910156e-01f,
+    -3.55468750e-01f, -6.64062500e-01f, 3.36914062e-02f, 6.83593750e-01f, -4.55078125e-01f, -6.13281250e-01f,
+    -5.29785156e-02f, 2.05078125e-01f, 2.47070312e-01f, -5.78125000e-01f, 1.92382812e-01f, 1.96289062e-01f,
+    2.36328125e-01f, 9.80468750e-01f, -9.02343750e-01f, -1.52343750e+00f, 1.25781250e+00f, 2.57812500e-01f,
+    1.32812500e+00f, -5.95703125e-02f, -4.82421875e-01f, -1.78906250e+00f, -6.17187500e-01f, 1.64062500e+00f,
+    -3.90625000e-01f, -6.99218750e-01f, 1.59375000e+00f, -2.92968750e-01f, 8.55468750e-01f, 1.18652344e-01f,
+    -1.21093750e+00f, -2.42187500e+00f, -1.18652344e-01f, 7.65625000e-01f, 7.51953125e-02f, 6.07910156e-02f,
+    2.85156250e-01f, -4.10156250e-01f, 4.47265625e-01f, -2.09960938e-01f, -8.28125000e-01f, -1.19140625e-01f,
+    2.85156250e-01f, 7.91015625e-02f, 1.25976562e-01f, 7.81250000e-02f, -5.73730469e-02f, -1.14062500e+00f,
+    2.79296875e-01f, 2.56347656e-02f, 1.03515625e-01f, 5.50781250e-01f, -2.27539062e-01f, 3.88671875e-01f,
+    -2.57812500e-01f, 3.11279297e-02f, -5.71289062e-02f, 3.51562500e-01f, 3.41796875e-01f, -9.64843750e-01f,
+    -2.18750000e-01f, 4.47265625e-01f, 3.28125000e-01f, 8.39843750e-01f, 1.07910156e-01f, -9.64843750e-01f,
+    6.17187500e-01f, -6.32812500e-01f, 4.25781250e-01f, -4.08203125e-01f, -6.25000000e-01f, 2.36328125e-01f,
+    4.06250000e-01f, 7.65625000e-01f, 1.00585938e-01f, -2.15820312e-01f, 4.90234375e-01f, -4.78515625e-01f,
+    7.77343750e-01f, -8.55468750e-01f, -5.11718750e-01f, -8.59375000e-01f, -5.93750000e-01f, 7.34375000e-01f,
+    -7.91015625e-02f, 4.12109375e-01f, 2.36328125e-01f, -1.16699219e-01f, -3.00781250e-01f, -2.22656250e-01f,
+    -4.25781250e-01f, 6.44531250e-02f, -3.53515625e-01f, -2.89062500e-01f, -8.30078125e-02f, -8.23974609e-04f,
+    3.14453125e-01f, -1.63085938e-01f, -2.05078125e-01f, 7.47070312e-02f, 3.02734375e-01f, 3.78906250e-01f,
+    3.59375000e-01f, 6.28906250e-01f, -7.22656250e-01f, 6.83593750e-01f, -6.44531250e-01f, -7.30468750e-01f,
+    3.75000000e-01f, 4.33593750e-01f, -3.90625000e-01f, 1.99218750e-01f, 6.36718750e-01f, -4.71191406e-02f,
+    -6.71875000e-01f, -1.88476562e-01f, -3.22265625e-01f, 3.27148438e-02f, 2.87109375e-01f, 1.65625000e+00f,
+    -2.12500000e+00f, -5.70312500e-01f, 9.41406250e-01f, 8.20312500e-01f, -3.10546875e-01f, -4.98046875e-01f,
+    -1.19531250e+00f, 7.71484375e-02f, 4.73632812e-02f, -2.65625000e-01f, -6.25000000e-01f, -6.99218750e-01f,
+    -5.11718750e-01f, 4.45312500e-01f, 2.40234375e-01f, -2.92968750e-01f, 3.84765625e-01f, -2.87109375e-01f,
+    -7.65625000e-01f, -1.08886719e-01f, 1.87500000e-01f, 3.22265625e-01f, 9.86328125e-02f, -4.90234375e-01f,
+    -7.18750000e-01f, 6.65283203e-03f, 1.51367188e-02f, -1.31835938e-01f, 6.44531250e-02f, 3.24707031e-02f,
+    5.23437500e-01f, 2.07031250e-01f, 2.57812500e-01f, 2.75390625e-01f, 2.07031250e-01f, -8.67187500e-01f,
+    4.49218750e-01f, -1.12500000e+00f, -1.24023438e-01f, 8.04687500e-01f, 3.08593750e-01f, -3.86718750e-01f,
+    8.32031250e-01f, 6.56250000e-01f, -1.34765625e-01f, -8.71093750e-01f, 3.47656250e-01f, -3.30078125e-01f,
+    -5.07812500e-01f, 8.00781250e-01f, 1.58203125e-01f, -5.03906250e-01f, -3.61328125e-01f, 2.23632812e-01f,
+    -2.42187500e-01f, -6.95312500e-01f, 4.95605469e-02f, -1.23046875e-01f, -9.02343750e-01f, 5.07812500e-01f,
+    4.72656250e-01f, 2.92968750e-01f, -2.59765625e-01f, 6.22558594e-02f, -4.43359375e-01f, -3.51562500e-01f,
+    4.60937500e-01f, 8.48388672e-03f, -4.62890625e-01f, 2.53906250e-01f, -1.92382812e-01f, 3.35937500e-01f,
+    3.88671875e-01f, -1.42578125e-01f, -6.25000000e-01f, 1.57226562e-01f, 1.14257812e-01f, -2.03125000e-01f,
+    3.00781250e-01f, -2.17773438e-01f, 4.76562500e-01f, -1.40625000e-01f, -4.94140625e-01f, -1.06933594e-01f,
+    5.07812500e-01f, -8.28125000e-01f, 3.41796875e-01f, -1.81640625e-01f, -3.84765625e-01f, 4.19921875e-01f,
+    -1.63085938e-01f, 2.30468750e-01f, -6.40625000e-01f, 6.67968750e-01f, 3.73046875e-01f, -1.10156250e+00f,
+    3.96484375e-01f, -4.02343750e-01f, -6.98242188e-02f, 7.26562500e-01f, -1.54687500e+00f, 6.56250000e-01f,
+    -2.37304688e-01f, 3.12500000e-01f, 3.39355469e-02f, -3.06640625e-01f, 1.18652344e-01f, -2.30468750e-01f,
+    1.37695312e-01f, -3.24707031e-02f, -4.90234375e-01f, 3.49609375e-01f, 2.59765625e-01f, -1.81640625e-01f,
+    -6.52343750e-01f, 1.69921875e-01f, 8.36181641e-03f, -5.15136719e-02f, 2.55859375e-01f, 2.04101562e-01f,
+    1.43554688e-01f, -1.20117188e-01f, 3.51562500e-01f, -1.78710938e-01f, 1.98242188e-01f, -1.05957031e-01f,
+    -1.80664062e-01f, -1.04492188e-01f, 8.20312500e-02f, -3.51562500e-01f, 5.03906250e-01f, 1.00097656e-01f,
+    1.45507812e-01f, -2.63671875e-01f, 1.21582031e-01f, -4.12597656e-02f, -3.28125000e-01f, -2.26562500e-01f,
+    -2.20703125e-01f, 2.22656250e-01f, 2.92968750e-01f, 8.30078125e-02f, 2.91015625e-01f, -1.31835938e-01f,
+    -1.34765625e-01f, 7.51953125e-02f, -8.67187500e-01f, -2.50000000e-01f, -3.04687500e-01f, 9.86328125e-02f,
+    4.88281250e-01f, 6.79687500e-01f, 1.18652344e-01f, -6.60156250e-01f, -3.10546875e-01f, 1.24511719e-01f,
+    -5.19531250e-01f, -1.11389160e-03f, -5.68847656e-02f, 3.45703125e-01f, -7.47070312e-02f, 7.03125000e-01f,
+    -1.21093750e-01f, -6.40625000e-01f, -4.12109375e-01f, 5.85937500e-02f, -1.05468750e+00f, 3.43750000e-01f,
+    -7.17773438e-02f, 8.59375000e-01f, -3.94531250e-01f, 7.69531250e-01f, -9.57031250e-02f, -9.10156250e-01f,
+    -2.89062500e-01f, -5.74218750e-01f, -1.25000000e+00f, 1.07812500e+00f, 1.96289062e-01f, 9.64843750e-01f,
+    -2.92968750e-01f, 5.58593750e-01f, 3.41796875e-01f, -1.10351562e-01f, 4.19921875e-01f, -9.47265625e-02f,
+    1.96533203e-02f, -1.16699219e-01f, 1.77734375e-01f, -3.30078125e-01f, 6.29882812e-02f, 1.24023438e-01f,
+    2.43164062e-01f, 5.62500000e-01f, 2.83203125e-01f, 8.59375000e-01f, -6.52343750e-01f, -5.85937500e-01f,
+    7.27539062e-02f, -1.87988281e-02f, -6.56250000e-01f, -1.81640625e-01f, 1.11816406e-01f, 8.32031250e-01f,
+    2.23388672e-02f, 3.47656250e-01f, -4.21875000e-01f, -3.55468750e-01f, 3.55468750e-01f, 4.43359375e-01f,
+    -6.40625000e-01f, -3.61328125e-01f, -8.39843750e-01f, -1.10839844e-01f, -5.93750000e-01f, -4.35546875e-01f,
+    -6.87500000e-01f, 7.18750000e-01f, 1.33593750e+00f, 4.68750000e-02f, 2.89062500e-01f, -4.00390625e-01f,
+    -1.35937500e+00f, 8.78906250e-02f, -8.98437500e-01f, 1.98242188e-01f, -9.10156250e-01f, 1.28125000e+00f,
+    1.53125000e+00f, 2.11914062e-01f, -8.51562500e-01f, -5.78125000e-01f, -2.58789062e-02f, -2.77343750e-01f,
+    6.56250000e-01f, 5.07812500e-01f, 1.21093750e-01f, -1.30859375e-01f, 6.16455078e-03f, 8.88671875e-02f,
+    -3.53515625e-01f, -6.56250000e-01f, -6.05468750e-01f, 7.38281250e-01f, 1.00000000e+00f, 1.41406250e+00f,
+    -1.50000000e+00f, -7.38281250e-01f, -4.74609375e-01f, 5.39062500e-01f, -8.28125000e-01f, -1.39062500e+00f,
+    -2.63671875e-01f, 9.17968750e-02f, 6.91406250e-01f, 1.35742188e-01f, -1.61132812e-02f, -9.06250000e-01f,
+    -5.23437500e-01f, 8.32031250e-01f, -1.17968750e+00f, 2.05078125e-01f, 3.49609375e-01f, -1.42187500e+00f,
+    2.46093750e-01f, 9.61914062e-02f, -3.53515625e-01f, 1.31835938e-01f, 7.92968750e-01f, -1.15625000e+00f,
+    -5.73730469e-02f, 2.55859375e-01f, -2.28125000e+00f, 5.03906250e-01f, 1.77734375e-01f, 7.07031250e-01f,
+    -6.01562500e-01f, 4.45312500e-01f, 6.22558594e-02f, -3.88183594e-02f, 4.76562500e-01f, -6.25000000e-01f,
+    -2.67578125e-01f, 1.92382812e-01f, -9.61914062e-02f, 6.25000000e-02f, -6.87500000e-01f, -1.83105469e-02f,
+    1.33789062e-01f, 5.54687500e-01f, 6.01562500e-01f, -5.85937500e-01f, -1.03906250e+00f, 1.10156250e+00f,
+    2.40234375e-01f, 4.17968750e-01f, -4.00390625e-01f, -1.99218750e-01f, -8.98437500e-01f, 9.21875000e-01f,
+    -2.18750000e-01f, -7.53906250e-01f, 8.49609375e-02f, -2.59765625e-01f, -3.80859375e-02f, 3.32031250e-01f,
+    -2.67578125e-01f, 4.62890625e-01f, -6.48437500e-01f, 8.86718750e-01f, -1.43750000e+00f, 2.33398438e-01f,
+    6.75781250e-01f, 3.93066406e-02f, 5.70312500e-01f, -1.85546875e-01f, -1.33789062e-01f, -2.21679688e-01f,
+    -1.37329102e-02f, 2.18200684e-03f, -5.27343750e-01f, -2.06054688e-01f, -3.49609375e-01f, 5.89843750e-01f,
+    1.04687500e+00f, -6.25000000e-01f, 3.82812500e-01f, -7.69531250e-01f, -7.77343750e-01f, 1.68945312e-01f,
+    5.78613281e-02f, -1.65039062e-01f, -2.87109375e-01f, 2.26562500e-01f, -3.67187500e-01f, -6.36718750e-01f,
+    4.04296875e-01f, -8.00781250e-02f, -1.19018555e-02f, 1.28906250e-01f, 2.63671875e-01f, 7.99560547e-03f,
+    -1.23437500e+00f, 7.34375000e-01f, -2.37304688e-01f, 2.89062500e-01f, 6.01562500e-01f, 1.82617188e-01f,
+    -1.69531250e+00f, 5.50781250e-01f, -8.63281250e-01f, 2.25585938e-01f, -2.98828125e-01f, 2.05078125e-01f,
+    3.24218750e-01f, 3.30078125e-01f, -1.80664062e-02f, 5.50781250e-01f, -1.61718750e+00f, -4.84375000e-01f,
+    -9.57031250e-02f, 3.43750000e-01f, 7.22656250e-01f, -1.78222656e-02f, -6.03027344e-02f, 2.79296875e-01f,
+    -3.78906250e-01f, 3.37890625e-01f, 5.83496094e-02f, -1.20605469e-01f, -4.33593750e-01f, 9.61914062e-02f,
+    4.76562500e-01f, -1.65039062e-01f, -3.37890625e-01f, -1.66992188e-01f, -1.33789062e-01f, -2.57812500e-01f,
+    4.84375000e-01f, 5.82031250e-01f, -3.39843750e-01f, -1.25976562e-01f
+};
+
+static _Alignas(64) const float dense_b4_[10] = {
+    9.16309878e-02f, 1.03313565e-01f, -2.02568561e-01f, -1.73731372e-01f, 4.12424393e-02f, -1.35777757e-01f,
+    -1.74029693e-02f, -2.51879871e-01f, 4.74061817e-01f, 3.35940123e-02f
+};
+
+static void softmax_(float *arr, const size_t len) {
+    float max = arr[0], sum = 0;
+    for (size_t elm = 1; elm < len; elm++) max = arr[elm] > max ? arr[elm] : max;
+    for (size_t elm = 0; elm < len; elm++) {
+        arr[elm] = expf(arr[elm] - max);
+        sum += arr[elm];
+    }
+    for (size_t elm = 0; elm < len; elm++) arr[elm] /= sum;
+}
+
+static void conv0_(const float *restrict x, float *restrict y) {
+    // 28 x 28 x 1 -> 24 x 24 x 2, 5 x 5 kernels, stride 1 x 1
+    for (size_t k = 0; k < 2; k++) {
+        for (size_t i = 0; i < 24; i++) {
+            float *out = &y[(k * 24 + i) * 24];
+            for (size_t j = 0; j < 24; j++) out[j] = conv_b0_[k];
+            for (size_t c = 0; c < 1; c++) {
+                const float *w = &conv_w0_[(k * 1 + c) * 25];
+                const float *r0 = &x[(c * 28 + i * 1) * 28 + 0];
+                const float *r1 = &x[(c * 28 + i * 1) * 28 + 28];
+                const float *r2 = &x[(c * 28 + i * 1) * 28 + 56];
+                const float *r3 = &x[(c * 28 + i * 1) * 28 + 84];
+                const float *r4 = &x[(c * 28 + i * 1) * 28 + 112];
+                for (size_t j = 0; j < 24; j++) {
+                    out[j] += w[0] * r0[j + 0] + w[1] * r0[j + 1] + w[2] * r0[j + 2]
+                        + w[3] * r0[j + 3] + w[4] * r0[j + 4] + w[5] * r1[j + 0]
+                        + w[6] * r1[j + 1] + w[7] * r1[j + 2] + w[8] * r1[j + 3]
+                        + w[9] * r1[j + 4] + w[10] * r2[j + 0] + w[11] * r2[j + 1]
+                        + w[12] * r2[j + 2] + w[13] * r2[j + 3] + w[14] * r2[j + 4]
+                        + w[15] * r3[j + 0] + w[16] * r3[j + 1] + w[17] * r3[j + 2]
+                        + w[18] * r3[j + 3] + w[19] * r3[j + 4] + w[20] * r4[j + 0]
+                        + w[21] * r4[j + 1] + w[22] * r4[j + 2] + w[23] * r4[j + 3]
+                        + w[24] * r4[j + 4];
+                }
+            }
+        }
+    }
+}
+
+static void pool1_(const float *restrict x, float *restrict y) {
+    // 24 x 24 x 2 -> 12 x 12 x 2, 2 x 2 max, stride 2 x 2
+    for (size_t c = 0; c < 2; c++) {
+        for (size_t i = 0; i < 12; i++) {
+            float *out = &y[(c * 12 + i) * 12];
+            const float *r0 = &x[(c * 24 + i * 2) * 24 + 0];
+            const float *r1 = &x[(c * 24 + i * 2) * 24 + 24];
+            for (size_t j = 0; j < 12; j++) {
+                float v = r0[j * 2];
+                if (r0[j * 2 + 1] > v) v = r0[j * 2 + 1];
+                if (r1[j * 2 + 0] > v) v = r1[j * 2 + 0];
+                if (r1[j * 2 + 1] > v) v = r1[j * 2 + 1];
+                out[j] = v;
+            }
+        }
+    }
+}
+
+static void conv2_(const float *restrict x, float *restrict y) {
+    // 12 x 12 x 2 -> 10 x 10 x 4, 3 x 3 kernels, stride 1 x 1
+    for (size_t k = 0; k < 4; k++) {
+        for (size_t i = 0; i < 10; i++) {
+            float *out = &y[(k * 10 + i) * 10];
+            for (size_t j = 0; j < 10; j++) out[j] = conv_b2_[k];
+            for (size_t c = 0; c < 2; c++) {
+                const float *w = &conv_w2_[(k * 2 + c) * 9];
+                const float *r0 = &x[(c * 12 + i * 1) * 12 + 0];
+                const float *r1 = &x[(c * 12 + i * 1) * 12 + 12];
+                const float *r2 = &x[(c * 12 + i * 1) * 12 + 24];
+                for (size_t j = 0; j < 10; j++) {
+                    out[j] += w[0] * r0[j + 0] + w[1] * r0[j + 1] + w[2] * r0[j + 2]
+                        + w[3] * r1[j + 0] + w[4] * r1[j + 1] + w[5] * r1[j + 2]
+                        + w[6] * r2[j + 0] + w[7] * r2[j + 1] + w[8] * r2[j + 2];
+                }
+            }
+        }
+    }
+}
+
+static void pool3_(const float *restrict x, float *restrict y) {
+    // 10 x 10 x 4 -> 5 x 5 x 4, 2 x 2 max, stride 2 x 2
+    for (size_t c = 0; c < 4; c++) {
+        for (size_t i = 0; i < 5; i++) {
+            float *out = &y[(c * 5 + i) * 5];
+            const float *r0 = &x[(c * 10 + i * 2) * 10 + 0];
+            const float *r1 = &x[(c * 10 + i * 2) * 10 + 10];
+            for (size_t j = 0; j < 5; j++) {
+                float v = r0[j * 2];
+                if (r0[j * 2 + 1] > v) v = r0[j * 2 + 1];
+                if (r1[j * 2 + 0] > v) v = r1[j * 2 + 0];
+                if (r1[j * 2 + 1] > v) v = r1[j * 2 + 1];
+                out[j] = v;
+            }
+        }
+    }
+}
+
+static void dense4_(const float *restrict x, float *restrict y) {
+    // 100 -> 10
+    for (size_t j = 0; j < 10; j++) y[j] = dense_b4_[j];
+    for (size_t i = 0; i < 100; i++) {
+        const float *w = &dense_w4_[i * 10];
+        for (size_t j = 0; j < 10; j++) y[j] += x[i] * w[j];
+    }
+}
+
+/**
+ * Forward pass of one image.
+ *
+ * @param img: 28 x 28 x 1 input, channel after channel.
+ * @param out: 10 outputs.
+ */
+void predict(const float *img, float *out) {
+    static _Thread_local _Alignas(64) float scratch[2][1152];
+    conv0_(img, scratch[0]);
+    for (size_t elm = 0; elm < 1152; elm++) scratch[0][elm] = scratch[0][elm] > 0 ? scratch[0][elm] : 0;
+    pool1_(scratch[0], scratch[1]);
+    conv2_(scratch[1], scratch[0]);
+    for (size_t elm = 0; elm < 400; elm++) scratch[0][elm] = 1 / (1 + expf(-scratch[0][elm]));
+    pool3_(scratch[0], scratch[1]);
+    dense4_(scratch[1], out);
+    for (size_t mat = 0; mat < 1; mat++) softmax_(&out[mat * 10], 10);
+}
@@ -0,0 +1,364 @@
+#include "types.h"
+#include "functional.h"
+#include "helpers.h"
+#include "computational.h"
+#include "model.h"
+#include "half.h"
+#include <stdio.h>
+#include <string.h>
+
+// kernel and pooling windows up to this many elements per channel are written out tap by tap
+#define AOT_UNROLL 49
+// weights per line of a generated array
+#define AOT_LINE 6
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void emit_array_(FILE *fp, const char *name, const size_t idx, const elm_t *arr, const size_t len,
+    const elm_t scale) {
+    // aligned read-only array, every value written with enough digits to round-trip
+    fprintf(fp, "static _Alignas(64) const float %s%zu_[%zu] = {", name, idx, len);
+    for (size_t elm = 0; elm < len; elm++) {
+        fprintf(fp, "%s%.8ef", elm % AOT_LINE == 0 ? "\n    " : " ", arr[elm] * scale);
+        if (elm + 1 < len) fprintf(fp, ",");
+    }
+    fprintf(fp, "\n};\n\n");
+}
+
+static void emit_rows_(FILE *fp, const char *indent, const size_t rows, const char *base, const size_t n) {
+    // input row pointers of one output row
+    for (size_t row = 0; row < rows; row++) {
+        fprintf(fp, "%sconst float *r%zu = &x[%s + %zu];\n", indent, row, base, row * n);
+    }
+}
+
+static void emit_taps_(FILE *fp, const size_t m, const size_t n, const size_t stride, const int weighted) {
+    // one term per window element, weights indexed by position, stride folded into the column
+    for (size_t row = 0; row < m; row++) {
+        for (size_t col = 0; col < n; col++) {
+            const size_t tap = row * n + col;
+            char src[64];
+            if (stride == 1) snprintf(src, sizeof(src), "r%zu[j + %zu]", row, col);
+            else snprintf(src, sizeof(src), "r%zu[j * %zu + %zu]", row, stride, col);
+            if (weighted) {
+                fprintf(fp, "%s w[%zu] * %s", tap == 0 ? "" : (tap % 3 == 0 ? "\n                        +" : " +"),
+                    tap, src);
+            } else if (tap != 0) {
+                fprintf(fp, "                if (%s > v) v = %s;\n", src, src);
+            }
+        }
+    }
+}
+
+static void emit_conv_(FILE *fp, const size_t idx, const Convolutional *conv, const Batch *in, const Batch *out) {
+    const Kernel *k_ref = conv->kernels[0];
+    const size_t m_k = k_ref->m, n_k = k_ref->n, o = in->o, len = m_k * n_k;
+    const size_t m_stride = k_ref->m_stride, n_stride = k_ref->n_stride;
+
+    // kernel after kernel, every channel's window in a row; the runtime adds the bias once per channel
+    fprintf(fp, "static void conv%zu_(const float *restrict x, float *restrict y) {\n", idx);
+    fprintf(fp, "    // %zu x %zu x %zu -> %zu x %zu x %zu, %zu x %zu kernels, stride %zu x %zu\n",
+        in->m, in->n, in->o, out->m, out->n, out->o, m_k, n_k, m_stride, n_stride);
+    fprintf(fp, "    for (size_t k = 0; k < %zu; k++) {\n", out->o);
+    fprintf(fp, "        for (size_t i = 0; i < %zu; i++) {\n", out->m);
+    fprintf(fp, "            float *out = &y[(k * %zu + i) * %zu];\n", out->m, out->n);
+    fprintf(fp, "            for (size_t j = 0; j < %zu; j++) out[j] = conv_b%zu_[k];\n", out->n, idx);
+    fprintf(fp, "            for (size_t c = 0; c < %zu; c++) {\n", o);
+    fprintf(fp, "                const float *w = &conv_w%zu_[(k * %zu + c) * %zu];\n", idx, o, len);
+    char base[64];
+    snprintf(base, sizeof(base), "(c * %zu + i * %zu) * %zu", in->m, m_stride, in->n);
+    if (len <= AOT_UNROLL) {
+        emit_rows_(fp, "                ", m_k, base, in->n);
+        fprintf(fp, "                for (size_t j = 0; j < %zu; j++) {\n", out->n);
+        fprintf(fp, "                    out[j] +=");
+        emit_taps_(fp, m_k, n_k, n_stride, 1);
+        fprintf(fp, ";\n                }\n");
+    } else {
+        fprintf(fp, "                for (size_t r = 0; r < %zu; r++) {\n", m_k);
+        fprintf(fp, "                    const float *r0 = &x[%s + r * %zu];\n", base, in->n);
+        fprintf(fp, "                    for (size_t s = 0; s < %zu; s++) {\n", n_k);
+        fprintf(fp, "                        const float weight = w[r * %zu + s];\n", n_k);
+        fprintf(fp, "                        for (size_t j = 0; j < %zu; j++) out[j] += weight * r0[j * %zu + s];\n",
+            out->n, n_stride);
+        fprintf(fp, "                    }\n                }\n");
+    }
+    fprintf(fp, "            }\n        }\n    }\n}\n\n");
+}
+
+static void emit_pool_(FILE *fp, const size_t idx, const Pooler *pool, const Batch *in, const Batch *out) {
+    const size_t m_p = pool->m, n_p = pool->n;
+
+    // max over the window, first element as the start value
+    fprintf(fp, "static void pool%zu_(const float *restrict x, float *restrict y) {\n", idx);
+    fprintf(fp, "    // %zu x %zu x %zu -> %zu x %zu x %zu, %zu x %zu max, stride %zu x %zu\n",
+        in->m, in->n, in->o, out->m, out->n, out->o, m_p, n_p, pool->m_stride, pool->n_stride);
+    fprintf(fp, "    for (size_t c = 0; c < %zu; c++) {\n", out->o);
+    fprintf(fp, "        for (size_t i = 0; i < %zu; i++) {\n", out->m);
+    fprintf(fp, "            float *out = &y[(c * %zu + i) * %zu];\n", out->m, out->n);
+    char base[64];
+    snprintf(base, sizeof(base), "(c * %zu + i * %zu) * %zu", in->m, pool->m_stride, in->n);
+    if (m_p * n_p <= AOT_UNROLL) {
+        emit_rows_(fp, "            ", m_p, base, in->n);
+        fprintf(fp, "            for (size_t j = 0; j < %zu; j++) {\n", out->n);
+        fprintf(fp, "                float v = r0[j * %zu];\n", pool->n_stride);
+        emit_taps_(fp, m_p, n_p, pool->n_stride, 0);
+        fprintf(fp, "                out[j] = v;\n            }\n");
+    } else {
+        fprintf(fp, "            const float *first = &x[%s];\n", base);
+        fprintf(fp, "            for (size_t j = 0; j < %zu; j++) out[j] = first[j * %zu];\n", out->n,
+            pool->n_stride);
+        fprintf(fp, "            for (size_t r = 0; r < %zu; r++) {\n", m_p);
+        fprintf(fp, "                const float *r0 = &x[%s + r * %zu];\n", base, in->n);
+        fprintf(fp, "                for (size_t s = 0; s < %zu; s++) {\n", n_p);
+        fprintf(fp, "                    for (size_t j = 0; j < %zu; j++) {\n", out->n);
+        fprintf(fp, "                        if (r0[j * %zu + s] > out[j]) out[j] = r0[j * %zu + s];\n",
+            pool->n_stride, pool->n_stride);
+        fprintf(fp, "                    }\n                }\n            }\n");
+    }
+    fprintf(fp, "        }\n    }\n}\n\n");
+}
+
+static void emit_dense_(FILE *fp, const size_t idx, const Dense *dense) {
+    const size_t m = dense->weights->m, n = dense->weights->n;
+
+    // one input element against a whole weight row at a time
+    fprintf(fp, "static void dense%zu_(const float *restrict x, float *restrict y) {\n", idx);
+    fprintf(fp, "    // %zu -> %zu\n", m, n);
+    fprintf(fp, "    for (size_t j = 0; j < %zu; j++) y[j] = dense_b%zu_[j];\n", n, idx);
+    fprintf(fp, "    for (size_t i = 0; i < %zu; i++) {\n", m);
+    fprintf(fp, "        const float *w = &dense_w%zu_[i * %zu];\n", idx, n);
+    fprintf(fp, "        for (size_t j = 0; j < %zu; j++) y[j] += x[i] * w[j];\n", n);
+    fprintf(fp, "    }\n}\n\n");
+}
+
+static void emit_activation_(FILE *fp, const Activation activation, const char *arr, const size_t planes,
+    const size_t len) {
+    // in place over a layer output; softmax per m x n plane, as at runtime
+    if (activation == ACT_RELU) {
+        fprintf(fp, "    for (size_t elm = 0; elm < %zu; elm++) %s[elm] = %s[elm] > 0 ? %s[elm] : 0;\n",
+            planes * len, arr, arr, arr);
+    } else if (activation == ACT_SIGMOID) {
+        fprintf(fp, "    for (size_t elm = 0; elm < %zu; elm++) %s[elm] = 1 / (1 + expf(-%s[elm]));\n",
+            planes * len, arr, arr);
+    } else if (activation == ACT_SOFTMAX) {
+        fprintf(fp, "    for (size_t mat = 0; mat < %zu; mat++) softmax_(&%s[mat * %zu], %zu);\n", planes, arr, len,
+            len);
+    }
+}
+
+static void emit_softmax_(FILE *fp) {
+    // max-subtracted, exps stored on the way to the sum
+    fprintf(fp, "static void softmax_(float *arr, const size_t len) {\n");
+    fprintf(fp, "    float max = arr[0], sum = 0;\n");
+    fprintf(fp, "    for (size_t elm = 1; elm < len; elm++) max = arr[elm] > max ? arr[elm] : max;\n");
+    fprintf(fp, "    for (size_t elm = 0; elm < len; elm++) {\n");
+    fprintf(fp, "        arr[elm] = expf(arr[elm] - max);\n");
+    fprintf(fp, "        sum += arr[elm];\n");
+    fprintf(fp, "    }\n");
+    fprintf(fp, "    for (size_t elm = 0; elm < len; elm++) arr[elm] /= sum;\n");
+    fprintf(fp, "}\n\n");
+}
+
+static int shapes_(const Layer *layers, const size_t num, Batch *shapes) {
+    // output shape of every layer, shapes[0] holds the input
+    for (size_t idx = 0; idx < num; idx++) {
+        const Batch *in = &shapes[idx];
+        const Layer *layer = &layers[idx];
+        if (layer->type == LAYER_CONV) {
+            shapes[idx + 1] = batch_conv_shape(in, layer->conv);
+        } else if (layer->type == LAYER_POOL) {
+            shapes[idx + 1] = batch_pool_shape(in, layer->pool);
+        } else {
+            Batch flat = *in;
+            batch_flatten(&flat);
+            shapes[idx + 1] = (Batch){.m=1, .n=layer->dense->weights->n, .o=1, .b=1};
+            if (flat.n != layer->dense->weights->m || layer->dense->biases->n != layer->dense->weights->n) {
+                shapes[idx + 1].b = 0;
+            }
+        }
+        if (shapes[idx + 1].b != 1) {
+            fprintf(stderr, "Invalid model: layer %zu does not fit a %zu x %zu x %zu input.\n", idx, in->m, in->n,
+                in->o);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int emit_model_(FILE *fp, const Layer *layers, const size_t num, const Batch *shapes, const char *source) {
+    // header
+    const Batch *last = &shapes[num];
+    const size_t classes = last->m * last->n * last->o;
+    fprintf(fp, "// generated by aot from %s, do not edit\n", source);
+    fprintf(fp, "// %zu x %zu x %zu input, %zu outputs\n", shapes[0].m, shapes[0].n, shapes[0].o, classes);
+    fprintf(fp, "#include <math.h>\n#include <stddef.h>\n\n");
+    fprintf(fp, "const size_t predict_input[3] = {%zu, %zu, %zu};\n", shapes[0].m, shapes[0].n, shapes[0].o);
+    fprintf(fp, "const size_t predict_classes = %zu;\n\n", classes);
+
+    // weights, conv biases pre-multiplied by the channel count
+    size_t scratch = 0;
+    int softmax = 0;
+    for (size_t idx = 0; idx < num; idx++) {
+        const Layer *layer = &layers[idx];
+        const size_t size = shapes[idx + 1].m * shapes[idx + 1].n * shapes[idx + 1].o;
+        if (idx + 1 < num && size > scratch) scratch = size;
+        if (layer->activation == ACT_SOFTMAX) softmax = 1;
+        if (layer->type == LAYER_CONV) {
+            const Convolutional *conv = layer->conv;
+            const size_t len = conv->kernels[0]->m * conv->kernels[0]->n * conv->kernels[0]->o;
+            elm_t *weights = malloc(conv->num * len * sizeof(elm_t));
+            elm_t *biases = malloc(conv->num * sizeof(elm_t));
+            if (weights == NULL || biases == NULL) {
+                fprintf(stderr, "Failed malloc: weights of %zu kernels.\n", conv->num);
+                free(weights); free(biases);
+                return 0;
+            }
+            for (size_t kern = 0; kern < conv->num; kern++) {
+                memcpy(&weights[kern * len], conv->kernels[kern]->arr, len * sizeof(elm_t));
+                biases[kern] = conv->kernels[kern]->bias;
+            }
+            emit_array_(fp, "conv_w", idx, weights, conv->num * len, 1);
+            emit_array_(fp, "conv_b", idx, biases, conv->num, (elm_t)shapes[idx].o);
+            free(weights); free(biases);
+        } else if (layer->type == LAYER_DENSE) {
+            const Dense *dense = layer->dense;
+            emit_array_(fp, "dense_w", idx, dense->weights->arr, dense->weights->m * dense->weights->n, 1);
+            emit_array_(fp, "dense_b", idx, dense->biases->arr, dense->biases->n, 1);
+        }
+    }
+
+    // layers
+    if (softmax) emit_softmax_(fp);
+    for (size_t idx = 0; idx < num; idx++) {
+        if (layers[idx].type == LAYER_CONV) emit_conv_(fp, idx, layers[idx].conv, &shapes[idx], &shapes[idx + 1]);
+        else if (layers[idx].type == LAYER_POOL) emit_pool_(fp, idx, layers[idx].pool, &shapes[idx], &shapes[idx + 1]);
+        else emit_dense_(fp, idx, layers[idx].dense);
+    }
+
+    // entry point, two thread-local scratch buffers taking turns
+    fprintf(fp, "/**\n * Forward pass of one image.\n *\n");
+    fprintf(fp, " * @param img: %zu x %zu x %zu input, channel after channel.\n", shapes[0].m, shapes[0].n,
+        shapes[0].o);
+    fprintf(fp, " * @param out: %zu outputs.\n */\n", classes);
+    fprintf(fp, "void predict(const float *img, float *out) {\n");
+    if (num > 1) fprintf(fp, "    static _Thread_local _Alignas(64) float scratch[2][%zu];\n", scratch);
+    for (size_t idx = 0; idx < num; idx++) {
+        const Batch *shape = &shapes[idx + 1];
+        char src[32], dst[32];
+        if (idx == 0) snprintf(src, sizeof(src), "img");
+        else snprintf(src, sizeof(src), "scratch[%zu]", (idx - 1) % 2);
+        if (idx + 1 == num) snprintf(dst, sizeof(dst), "out");
+        else snprintf(dst, sizeof(dst), "scratch[%zu]", idx % 2);
+        const char *name = layers[idx].type == LAYER_CONV ? "conv" : layers[idx].type == LAYER_POOL ? "pool" : "dense";
+        fprintf(fp, "    %s%zu_(%s, %s);\n", name, idx, src, dst);
+        emit_activation_(fp, layers[idx].activation, dst, shape->o, shape->m * shape->n);
+    }
+    fprintf(fp, "}\n");
+    return 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Ahead-of-time model compiler. Writes a standalone C source computing the network with every shape, stride and
+ * weight fixed at compile time: kernel and pooling windows unrolled, weights in aligned static const arrays, and a
+ * single void predict(const float *img, float *out) entry point. The source needs nothing but libm.
+ *
+ * @param argc: num args.
+ * @param argv: output source file.
+ *              optional flags: -m <path> model container file (default one file per layer in parameters);
+ *              -i <m> <n> <o> input shape the network is specialized for (default 28 28 1).
+ *
+ * @return: exit code: -1 for model load fail; 1 for write fail; 2 for start fail; 0 for complete run.
+ */
+int main(const int argc, const char *argv[]) {
+    // arguments
+    if (argc < 2) {
+        printf("Usage: %s <output> [-m model] [-i m n o]\n", argv[0]);
+        return 2;
+    }
+    const char *out_path = argv[1];
+    const char *model_path = NULL;
+    Batch in = {.m=28, .n=28, .o=1, .b=1};
+    char *ptr;
+    for (int arg = 2; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            model_path = argv[++arg];
+        } else if (strcmp(argv[arg], "-i") == 0 && arg + 3 < argc) {
+            in.m = (size_t)strtol(argv[++arg], &ptr, 10);
+            in.n = (size_t)strtol(argv[++arg], &ptr, 10);
+            in.o = (size_t)strtol(argv[++arg], &ptr, 10);
+        } else {
+            printf("Usage: %s <output> [-m model] [-i m n o]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // read parameters, from a mapped model container or one file per layer
+    Model *model = NULL;
+    Convolutional *conv1 = NULL, *conv2 = NULL;
+    Pooler *pool1 = NULL, *pool2 = NULL;
+    Dense *dense1 = NULL;
+    Layer files[5];
+    Layer *wide = NULL;
+    const Layer *layers = files;
+    size_t num_layers = 5;
+    if (model_path != NULL) {
+        // half-precision weights widened, the generated arrays are single precision
+        model = open_model(model_path);
+        wide = model != NULL ? widen_layers(model->layers, model->num) : NULL;
+        if (wide == NULL) {
+            fprintf(stderr, "Error reading network parameters.\n");
+            free_model(model);
+            return -1;
+        }
+        layers = wide;
+        num_layers = model->num;
+    } else {
+        conv1 = read_convolutional("parameters/conv1.bin");
+        pool1 = read_pool("parameters/pool1.bin");
+        conv2 = read_convolutional("parameters/conv2.bin");
+        pool2 = read_pool("parameters/pool2.bin");
+        dense1 = read_dense("parameters/dense1.bin");
+        // check errors
+        if (conv1 == NULL || pool1 == NULL || conv2 == NULL || pool2 == NULL || dense1 == NULL) {
+            fprintf(stderr, "Error reading network parameters.\n");
+            return -1;
+        }
+        files[0] = (Layer){.type=LAYER_CONV, .activation=ACT_RELU, .conv=conv1};
+        files[1] = (Layer){.type=LAYER_POOL, .activation=ACT_NONE, .pool=pool1};
+        files[2] = (Layer){.type=LAYER_CONV, .activation=ACT_SIGMOID, .conv=conv2};
+        files[3] = (Layer){.type=LAYER_POOL, .activation=ACT_NONE, .pool=pool2};
+        files[4] = (Layer){.type=LAYER_DENSE, .activation=ACT_SOFTMAX, .dense=dense1};
+    }
+
+    // layer shapes, then the source
+    int ok = 0;
+    Batch *shapes = malloc((num_layers + 1) * sizeof(Batch));
+    FILE *fp = NULL;
+    if (shapes == NULL) {
+        fprintf(stderr, "Failed malloc: shapes of %zu layers.\n", num_layers);
+    } else if (num_layers == 0) {
+        fprintf(stderr, "Invalid model: no layers.\n");
+    } else {
+        shapes[0] = in;
+        if (shapes_(layers, num_layers, shapes)) {
+            fp = fopen(out_path, "w");
+            if (fp == NULL) fprintf(stderr, "Failed opening file: %s.\n", out_path);
+            else ok = emit_model_(fp, layers, num_layers, shapes, model_path != NULL ? model_path : "parameters");
+        }
+    }
+    if (fp != NULL && fclose(fp) != 0) {
+        fprintf(stderr, "Failed writing file: %s.\n", out_path);
+        ok = 0;
+    }
+
+    // free
+    free(shapes);
+    free_wide_layers(wide, num_layers);
+    free_model(model);
+    free_convolutional(conv1); free(pool1);
+    free_convolutional(conv2); free(pool2);
+    free_dense(dense1);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#define _POSIX_C_SOURCE 199309L
+#include "types.h"
+#include "functional.h"
+#include "dataset.h"
+#include "prefetch.h"
+#include "predict.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static double now_(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Runs the ahead-of-time compiled model (see aot.c) for a number of points, one point per call.
+ *
+ * @param argc: num args.
+ * @param argv: two arguments. mode to execute: n=normal, d=debug; and number of points.
+ *              optional flags: -d <path> packed dataset file, memory-mapped (default one file per image and label in
+ *              ../data).
+ *
+ * @return: exit code: 1 for run fail; 2 for start fail; 0 for complete run.
+ */
+int main(const int argc, const char *argv[]) {
+    // arguments
+    if (argc < 3) {
+        printf("Usage: %s <mode> <number> [-d dataset]\n", argv[0]);
+        return 2;
+    }
+    const char mode = argv[1][0];
+    char *ptr;
+    const size_t number = (size_t)strtol(argv[2], &ptr, 10);
+    const char *data_path = NULL;
+    for (int arg = 3; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc) {
+            data_path = argv[++arg];
+        } else {
+            printf("Usage: %s <mode> <number> [-d dataset]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // packed dataset
+    Dataset *dataset = NULL;
+    if (data_path != NULL) {
+        dataset = open_dataset(data_path);
+        if (dataset == NULL) return 1;
+        if (number > dataset->count) {
+            fprintf(stderr, "Invalid number: dataset holds %zu points.\n", dataset->count);
+            return 1;
+        }
+    }
+
+    // malloc
+    const size_t classes = predict_classes;
+    elm_t *out = alloc_arr(classes);
+    if (out == NULL) {
+        fprintf(stderr, "Failed malloc: output of %zu.\n", classes);
+        return 1;
+    }
+
+    // forward passes, only predict timed
+    size_t correct = 0;
+    double elapsed = 0;
+    for (size_t pt = 0; pt < number; pt++) {
+        Sample sample;
+        if (!read_sample(dataset, pt, &sample)) return 1;
+        if (sample.img.m != predict_input[0] || sample.img.n != predict_input[1] || sample.img.o != predict_input[2]) {
+            fprintf(stderr, "Invalid image: %zu x %zu x %zu, model compiled for %zu x %zu x %zu.\n", sample.img.m,
+                sample.img.n, sample.img.o, predict_input[0], predict_input[1], predict_input[2]);
+            return 1;
+        }
+        const double start = now_();
+        predict(sample.img.arr, out);
+        elapsed += now_() - start;
+
+        // terminal outputs
+        const Tensor y = {.m=1, .n=classes, .o=1, .arr=out};
+        if (argmax(&y) == sample.label) correct++;
+        if (mode == 'n') {
+            const float acc = (float)correct / (float)(pt + 1);
+            printf("\r%zu/%zu points; %zu/%zu correct; %.4g%% accuracy;", pt + 1, number, correct, pt + 1, 100 * acc);
+        } else if (mode == 'd') {
+            printf("expected %zu; raw output [", sample.label);
+            for (size_t elm = 0; elm < classes - 1; elm++) printf("%f  ", out[elm]);
+            printf("%f];\n", out[classes - 1]);
+        }
+        free_sample(&sample);
+    }
+
+    // end
+    const float acc = number != 0 ? (float)correct / (float)number : 0;
+    printf("\naot: %.4g us per point;", number != 0 ? 1e6 * elapsed / (double)number : 0);
+    printf("\nend: %zu correct; %zu total; %.4g%% accuracy;\n", correct, number, 100 * acc);
+    free(out);
+    close_dataset(dataset);
+    return 0;
+}
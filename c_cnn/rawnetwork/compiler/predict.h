@@ -0,0 +1,13 @@
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include <stddef.h>
+
+// input dims m, n, o the model was compiled for
+extern const size_t predict_input[3];
+
+extern const size_t predict_classes;
+
+void predict(const float *img, float *out);
+
+#endif // PREDICT_H
@@ -3,6 +3,10 @@
 
 #include "types.h"
 
+void set_exp_mode(ExpMode mode);
+
+ExpMode get_exp_mode(void);
+
 void noop(const Tensor *tens);
 
 void relu(const Tensor *tens);
@@ -11,4 +15,8 @@ void sigmoid(const Tensor *tens);
 
 void softmax(const Tensor *tens);
 
+void (*activator(Activation activation))(const Tensor *);
+
+void (*elementwise(void (*fn)(const Tensor *)))(elm_t *, size_t);
+
 #endif // ACTIVATORS_H
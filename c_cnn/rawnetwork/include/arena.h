@@ -0,0 +1,20 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "types.h"
+
+size_t arena_bytes(size_t size);
+
+Arena *make_arena(size_t bytes);
+
+void free_arena(Arena *arena);
+
+elm_t *arena_alloc(Arena *arena, size_t size);
+
+void arena_reset(Arena *arena);
+
+elm_t *arena_scratch(Arena *arena, size_t size);
+
+void arena_drop(Arena *arena, elm_t *arr, size_t mark);
+
+#endif // ARENA_H
@@ -0,0 +1,25 @@
+#ifndef BLOCKED_H
+#define BLOCKED_H
+
+#include "types.h"
+
+size_t chan_blocks(size_t o);
+
+size_t batch_blocked_size(const Batch *shape);
+
+Tensor blocked_view(const Batch *batch);
+
+Batch *batch_block_into(Batch *res, const Batch *main);
+
+Batch *batch_unblock_into(Batch *res, const Batch *main);
+
+elm_t *blocked_kernels(const Convolutional *kernels);
+
+size_t batch_conv_blocked_workspace(const Batch *channels, const Convolutional *kernels);
+
+Batch *batch_conv_blocked_into(Batch *res, const Batch *channels, int in_blocked, const Convolutional *kernels,
+    const elm_t *packed, Arena *arena);
+
+Batch *batch_pool_blocked_into(Batch *res, const Batch *main, const Pooler *pooler);
+
+#endif // BLOCKED_H
@@ -1,8 +1,49 @@
 #ifndef COMPONENTS_H
 #define COMPONENTS_H
 
+#include "types.h"
+
+void set_conv_backend(ConvBackend backend);
+
+ConvBackend get_conv_backend(void);
+
+void set_conv_winograd(int enabled);
+
+int conv_winograd(const Convolutional *kernels);
+
+void set_conv_fft(FftMode mode);
+
+int conv_fft(const Batch *input, const Convolutional *kernels);
+
+void set_conv_layout(Layout layout);
+
+int conv_blocked(const Convolutional *kernels);
+
 Tensor *dense(const Tensor *input, const Dense *dense, void (*fn)(const Tensor *));
 
 Tensor *convolution(const Tensor *input, const Convolutional *kernels, void (*fn)(const Tensor*));
 
+Batch *batch_dense(const Batch *input, const Dense *dense, void (*fn)(const Tensor *));
+
+Batch *batch_convolution(const Batch *input, const Convolutional *kernels, void (*fn)(const Tensor*));
+
+Batch *batch_convolution_pool(const Batch *input, const Convolutional *kernels, void (*fn)(const Tensor*),
+    const Pooler *pooler);
+
+Batch *batch_dense_into(Batch *res, const Batch *input, const Dense *dense, void (*fn)(const Tensor*),
+    Arena *arena);
+
+size_t batch_dense_topk_workspace(const Batch *input, const Dense *dense);
+
+size_t *batch_dense_topk_into(size_t *classes, elm_t *scores, const Batch *input, const Dense *dense,
+    Activation activation, size_t k, Arena *arena);
+
+size_t batch_convolution_workspace(const Batch *input, const Convolutional *kernels);
+
+Batch *batch_convolution_into(Batch *res, const Batch *input, const Convolutional *kernels,
+    void (*fn)(const Tensor*), Arena *arena);
+
+Batch *batch_convolution_pool_into(Batch *res, const Batch *input, const Convolutional *kernels,
+    void (*fn)(const Tensor*), const Pooler *pooler, Arena *arena);
+
 #endif // COMPONENTS_H
@@ -3,12 +3,76 @@
 
 #include "types.h"
 
+Tensor *sum_into(Tensor *res, Tensor **tensors, size_t num);
+
 Tensor *sum(Tensor **tensors, size_t num);
 
+Tensor *matmul_into(Tensor *res, const Tensor *main, const Tensor *opp, Arena *arena);
+
 Tensor *matmul(const Tensor *main, const Tensor *opp);
 
+Tensor *conv_into(Tensor *res, const Tensor *channels, const Kernel *kernels);
+
 Tensor *conv(const Tensor *channels, const Kernel *kernels);
 
+Tensor *pool_into(Tensor *res, const Tensor *main, const Pooler *pooler);
+
 Tensor *pool(const Tensor *main, const Pooler *pooler);
 
+Batch *batch_sum_into(Batch *res, const Batch *main, const Tensor *opp);
+
+Batch *batch_sum(const Batch *main, const Tensor *opp);
+
+size_t batch_matmul_workspace(const Batch *main, const Tensor *opp);
+
+Batch *batch_matmul_into(Batch *res, const Batch *main, const Tensor *opp, Arena *arena);
+
+Batch *batch_matmul_epilogue_into(Batch *res, const Batch *main, const Tensor *opp, const GemmEpilogue *epi,
+    Arena *arena);
+
+Batch *batch_matmul_packed_into(Batch *res, const Batch *main, const PackedWeights *opp, const GemmEpilogue *epi,
+    Arena *arena);
+
+Batch *batch_matmul(const Batch *main, const Tensor *opp);
+
+Batch *batch_conv_into(Batch *res, const Batch *channels, const Kernel *kernels);
+
+Batch *batch_conv(const Batch *channels, const Kernel *kernels);
+
+Batch *batch_pool_into(Batch *res, const Batch *main, const Pooler *pooler);
+
+Batch *batch_pool(const Batch *main, const Pooler *pooler);
+
+Batch batch_conv_shape(const Batch *channels, const Convolutional *kernels);
+
+Batch batch_pool_shape(const Batch *main, const Pooler *pooler);
+
+Batch *batch_conv_direct_into(Batch *res, const Batch *channels, const Convolutional *kernels);
+
+Batch *batch_conv_direct(const Batch *channels, const Convolutional *kernels);
+
+size_t batch_conv_im2col_workspace(const Batch *channels, const Convolutional *kernels);
+
+Batch *batch_conv_im2col_into(Batch *res, const Batch *channels, const Convolutional *kernels, Arena *arena);
+
+Batch *batch_conv_im2col(const Batch *channels, const Convolutional *kernels);
+
+size_t batch_conv_pool_workspace(const Batch *channels, const Convolutional *kernels, const Pooler *pooler);
+
+Batch *batch_conv_pool_into(Batch *res, const Batch *channels, const Convolutional *kernels, const Pooler *pooler,
+    Arena *arena);
+
+Batch *batch_conv_pool(const Batch *channels, const Convolutional *kernels, const Pooler *pooler);
+
+int batch_conv_winograd_fits(const Convolutional *kernels);
+
+elm_t *winograd_kernels_into(elm_t *res, const Convolutional *kernels);
+
+elm_t *winograd_kernels(const Convolutional *kernels);
+
+size_t batch_conv_winograd_workspace(const Batch *channels, const Convolutional *kernels, const elm_t *transformed);
+
+Batch *batch_conv_winograd_into(Batch *res, const Batch *channels, const Convolutional *kernels,
+    const elm_t *transformed, Arena *arena);
+
 #endif // COMPUTATIONAL_H
@@ -0,0 +1,16 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "types.h"
+
+Dataset *open_dataset(const char *filename);
+
+void close_dataset(Dataset *dataset);
+
+Tensor dataset_image(const Dataset *dataset, size_t idx);
+
+size_t dataset_label(const Dataset *dataset, size_t idx);
+
+int dataset_batch(const Dataset *dataset, size_t start, size_t num, Batch *batch);
+
+#endif // DATASET_H
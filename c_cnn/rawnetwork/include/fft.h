@@ -0,0 +1,19 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include "types.h"
+
+int batch_conv_fft_fits(const Convolutional *kernels);
+
+size_t batch_conv_fft_work(const Batch *channels, const Convolutional *kernels);
+
+FftKernels *fft_kernels(const Convolutional *kernels, size_t m, size_t n);
+
+void free_fft_kernels(FftKernels *fk);
+
+size_t batch_conv_fft_workspace(const Batch *channels, const Convolutional *kernels);
+
+Batch *batch_conv_fft_into(Batch *res, const Batch *channels, const Convolutional *kernels,
+    const FftKernels *spectra, Arena *arena);
+
+#endif // FFT_H
@@ -3,6 +3,16 @@
 
 #include "types.h"
 
+elm_t *alloc_arr(size_t size);
+
+elm_t *calloc_arr(size_t size);
+
+size_t alloc_count(void);
+
+Tensor *make_tensor(size_t m, size_t n, size_t o);
+
+Batch *make_batch(size_t m, size_t n, size_t o, size_t b);
+
 void free_tensor(Tensor *tensor);
 
 void free_kernel(Kernel *kernel);
@@ -11,12 +21,28 @@ void free_dense(Dense *dense);
 
 void free_convolutional(Convolutional *convolutional);
 
+void free_batch(Batch *batch);
+
 Tensor *combine(Tensor **tensors, size_t num);
 
+Tensor *transpose_into(Tensor *res, const Tensor *tens);
+
 Tensor *transpose(const Tensor *tens);
 
 void flatten(Tensor *tensor);
 
 size_t argmax(const Tensor *tensor);
 
+Batch *stack_into(Batch *res, Tensor **tensors, size_t num);
+
+Batch *stack(Tensor **tensors, size_t num);
+
+Batch *batch_combine(Batch **batches, size_t num);
+
+void batch_flatten(Batch *batch);
+
+Tensor batch_view(const Batch *batch);
+
+Tensor batch_item(const Batch *batch, size_t idx);
+
 #endif // FUNCTIONAL_H
@@ -0,0 +1,34 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "types.h"
+
+size_t gemm_workspace(size_t m, size_t n, size_t k);
+
+void gemm_ws(elm_t *c, const elm_t *a, const elm_t *b, size_t m, size_t n, size_t k, elm_t *work);
+
+void gemm_epilogue_ws(elm_t *c, const elm_t *a, const elm_t *b, size_t m, size_t n, size_t k, const GemmEpilogue *epi,
+    elm_t *work);
+
+void gemm(elm_t *c, const elm_t *a, const elm_t *b, size_t m, size_t n, size_t k);
+
+size_t gemm_half_workspace(size_t m, size_t n, size_t k);
+
+elm_t *gemm_half_ws(elm_t *c, const elm_t *a, const uint16_t *b, Precision prec, size_t m, size_t n, size_t k,
+    elm_t *work);
+
+size_t gemm_pack_a_size(size_t m, size_t k);
+
+elm_t *gemm_pack_a(elm_t *dst, const elm_t *a, size_t lda, size_t m, size_t k);
+
+size_t gemm_pack_b_size(size_t k, size_t n);
+
+elm_t *gemm_pack_b(elm_t *dst, const elm_t *b, size_t ldb, size_t k, size_t n);
+
+void gemm_packed_a_ws(elm_t *c, const PackedWeights *a, const elm_t *b, size_t n, const GemmEpilogue *epi,
+    elm_t *work);
+
+void gemm_packed_b_ws(elm_t *c, const elm_t *a, const PackedWeights *b, size_t m, const GemmEpilogue *epi,
+    elm_t *work);
+
+#endif // GEMM_H
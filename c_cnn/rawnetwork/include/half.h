@@ -0,0 +1,34 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include "types.h"
+
+uint16_t narrow_elm(elm_t val, Precision prec);
+
+void widen_arr(elm_t *dst, const uint16_t *src, size_t len, Precision prec);
+
+HalfWeights *narrow_conv(const Convolutional *conv, Precision prec);
+
+HalfWeights *narrow_dense(const Dense *dense, Precision prec);
+
+void free_half(HalfWeights *half);
+
+Layer *narrow_layers(const Layer *layers, size_t num, Precision prec);
+
+void free_half_layers(Layer *layers, size_t num);
+
+Layer *widen_layers(const Layer *layers, size_t num);
+
+void free_wide_layers(Layer *layers, size_t num);
+
+size_t batch_conv_half_workspace(const Batch *channels, const Convolutional *kernels, const Pooler *pooler);
+
+Batch *batch_conv_half_into(Batch *res, const Batch *channels, const Convolutional *kernels, const HalfWeights *half,
+    const Pooler *pooler, Arena *arena);
+
+size_t batch_dense_half_workspace(const Batch *input, const HalfWeights *half);
+
+Batch *batch_dense_half_into(Batch *res, const Batch *input, const Dense *dense, const HalfWeights *half,
+    Arena *arena);
+
+#endif // HALF_H
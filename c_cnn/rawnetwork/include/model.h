@@ -0,0 +1,14 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "types.h"
+
+Model *open_model(const char *filename);
+
+uint64_t model_fingerprint(const Model *model);
+
+uint32_t model_crc32(const void *bytes, size_t size);
+
+void free_model(Model *model);
+
+#endif // MODEL_H
@@ -0,0 +1,10 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include "types.h"
+
+Packs *pack_layers(const Layer *layers, size_t num, const char *cache, uint64_t key);
+
+void free_packs(Packs *packs);
+
+#endif // PACK_H
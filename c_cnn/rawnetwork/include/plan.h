@@ -0,0 +1,19 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "types.h"
+
+Plan *make_plan(const Layer *layers, size_t num, size_t m, size_t n, size_t o, size_t batch, int fuse, int keep,
+    int top);
+
+void free_plan(Plan *plan);
+
+size_t plan_arena_bytes(const Plan *plan);
+
+elm_t *plan_begin(const Plan *plan, Arena *arena);
+
+Batch plan_value(const Plan *plan, elm_t *region, size_t idx, size_t num);
+
+int plan_run(const Plan *plan, elm_t *region, const Batch *x, Arena *arena);
+
+#endif // PLAN_H
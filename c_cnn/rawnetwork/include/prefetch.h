@@ -0,0 +1,20 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "types.h"
+
+typedef struct Prefetcher Prefetcher;
+
+int read_sample(const Dataset *dataset, size_t pt, Sample *sample);
+
+void free_sample(Sample *sample);
+
+Prefetcher *make_prefetcher(const Dataset *dataset, size_t number, size_t depth);
+
+void free_prefetcher(Prefetcher *prefetcher);
+
+int prefetch_next(Prefetcher *prefetcher, Sample *sample);
+
+PrefetchStats prefetch_stats(Prefetcher *prefetcher);
+
+#endif // PREFETCH_H
@@ -0,0 +1,16 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+
+typedef struct Profile Profile;
+
+Profile *make_profile(const Plan *plan);
+
+void free_profile(Profile *profile);
+
+int profile_run(Profile *profile, const Plan *plan, elm_t *region, const Batch *x, Arena *arena);
+
+void print_profile(const Profile *profile);
+
+#endif // PROFILE_H
@@ -0,0 +1,27 @@
+#ifndef QUANT_H
+#define QUANT_H
+
+#include "types.h"
+
+QuantWeights *quantize_conv(const Convolutional *conv, elm_t range);
+
+QuantWeights *quantize_dense(const Dense *dense, elm_t range);
+
+void free_quant(QuantWeights *quant);
+
+void calibrate_plan(const Plan *plan, elm_t *region, size_t num, elm_t *ranges);
+
+Layer *quantize_layers(const Plan *plan, const elm_t *ranges);
+
+void free_quant_layers(Layer *layers, size_t num);
+
+size_t batch_conv_quant_workspace(const Batch *channels, const Convolutional *kernels, const QuantWeights *quant);
+
+Batch *batch_conv_quant_into(Batch *res, const Batch *channels, const Convolutional *kernels,
+    const QuantWeights *quant, Arena *arena);
+
+size_t batch_dense_quant_workspace(const QuantWeights *quant);
+
+Batch *batch_dense_quant_into(Batch *res, const Batch *input, const QuantWeights *quant, Arena *arena);
+
+#endif // QUANT_H
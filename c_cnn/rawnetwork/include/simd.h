@@ -0,0 +1,41 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "types.h"
+
+typedef struct {
+    const char *name;
+    // y += alpha * x, contiguous
+    void (*axpy)(elm_t *y, const elm_t *x, elm_t alpha, size_t len);
+    // y = max(y, x[i * stride])
+    void (*max_stride)(elm_t *y, const elm_t *x, size_t len, size_t stride);
+    // in-place activations over a contiguous array
+    void (*relu)(elm_t *arr, size_t len);
+    void (*sigmoid)(elm_t *arr, size_t len);
+    void (*softmax)(elm_t *arr, size_t len);
+    // gemm register tile over packed panels: mr x nr block of c (+)= a_panel * b_panel
+    void (*gemm_kernel)(size_t kc, const elm_t *a, const elm_t *b, elm_t *c, size_t ldc,
+        size_t mr, size_t nr, int first);
+    size_t gemm_mr;
+    size_t gemm_nr;
+    // int8 dot products of a with rows consecutive len-long rows of b, int32 accumulation; len a multiple of 16
+    void (*dot_s8)(int32_t *res, const int8_t *a, const int8_t *b, size_t len, size_t rows);
+    // half-precision values widened to elm_t
+    void (*widen_f16)(elm_t *dst, const uint16_t *src, size_t len);
+    void (*widen_bf16)(elm_t *dst, const uint16_t *src, size_t len);
+    // split complex, contiguous: radix-2 butterfly t = w * b, b = a - t, a += t; and y += x * w
+    void (*butterfly)(elm_t *a_re, elm_t *a_im, elm_t *b_re, elm_t *b_im, elm_t w_re, elm_t w_im, size_t len);
+    void (*cmac)(elm_t *y_re, elm_t *y_im, const elm_t *x_re, const elm_t *x_im, const elm_t *w_re, const elm_t *w_im,
+        size_t len);
+    // blocked layout, CHAN_BLOCK lanes per column: y[col][l] += sum of x[offs[t] + col * stride] * w[t][l] over taps;
+    // and y[col][l] = max(y[col][l], x[col * stride + l])
+    void (*conv_block)(elm_t *y, const elm_t *x, const size_t *offs, const elm_t *w, size_t taps, size_t cols,
+        size_t stride);
+    void (*max_block)(elm_t *y, const elm_t *x, size_t cols, size_t stride);
+} SimdOps;
+
+void simd_init(void);
+
+const SimdOps *simd_ops(void);
+
+#endif // SIMD_H
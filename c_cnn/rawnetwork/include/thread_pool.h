@@ -0,0 +1,24 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "types.h"
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool *make_thread_pool(size_t threads);
+
+void free_thread_pool(ThreadPool *pool);
+
+size_t thread_pool_size(const ThreadPool *pool);
+
+void thread_pool_run(ThreadPool *pool, size_t tasks, void (*fn)(void *ctx, size_t task, size_t worker), void *ctx);
+
+void set_compute_pool(ThreadPool *pool);
+
+ThreadPool *compute_pool(void);
+
+void set_parallel_threshold(size_t work);
+
+size_t compute_workers(size_t work);
+
+#endif // THREAD_POOL_H
@@ -1,10 +1,17 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
 typedef float elm_t;
 
+// alignment of element arrays, one cache line / one AVX-512 register
+#define ELM_ALIGN 64
+
+// channels interleaved per group in the blocked layout, one AVX2 register
+#define CHAN_BLOCK 8
+
 typedef struct {
     size_t m;
     size_t n;
@@ -12,6 +19,28 @@ typedef struct {
     elm_t *arr;
 } Tensor;
 
+typedef struct {
+    size_t m;
+    size_t n;
+    size_t o;
+    size_t b;
+    elm_t *arr;
+} Batch;
+
+// strided window onto a tensor: element (row, col, chan) at arr[offset + row * m_stride + col * n_stride +
+// chan * o_stride]; arr is freed with the view only when owned
+typedef struct {
+    size_t m;
+    size_t n;
+    size_t o;
+    size_t m_stride;
+    size_t n_stride;
+    size_t o_stride;
+    size_t offset;
+    int owned;
+    elm_t *arr;
+} View;
+
 typedef struct {
     size_t m;
     size_t n;
@@ -29,14 +58,194 @@ typedef struct {
     size_t n_stride;
 } Pooler;
 
+// layer weights rearranged once, at load, into the panels the gemm kernel streams: full-depth row panels of tile rows
+// for a left operand, column panels of tile columns for a right one, zero padded; see gemm_pack_a and gemm_pack_b
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t tile;
+    const elm_t *matrix;
+    const elm_t *panels;
+    const elm_t *bias;
+} PackedWeights;
+
 typedef struct {
     Tensor *weights;
     Tensor *biases;
+    const PackedWeights *packed;
 } Dense;
 
 typedef struct {
     Kernel **kernels;
     size_t num;
+    const PackedWeights *packed;
 } Convolutional;
 
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+} Arena;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    size_t count;
+    size_t m;
+    size_t n;
+    size_t o;
+    size_t stride;
+    const elm_t *images;
+    const size_t *labels;
+} Dataset;
+
+typedef struct {
+    Tensor img;
+    size_t label;
+    int owned;
+} Sample;
+
+typedef struct {
+    size_t taken;
+    size_t depth_sum;
+    size_t depth_max;
+    size_t consumer_stalls;
+    size_t producer_stalls;
+} PrefetchStats;
+
+typedef enum {
+    LAYER_CONV = 1,
+    LAYER_POOL = 2,
+    LAYER_DENSE = 3
+} LayerType;
+
+typedef enum {
+    ACT_NONE,
+    ACT_RELU,
+    ACT_SIGMOID,
+    ACT_SOFTMAX
+} Activation;
+
+typedef struct {
+    size_t num;
+    size_t len;
+    size_t stride;
+    int8_t *weights;
+    elm_t *scales;
+    elm_t *biases;
+    elm_t in_scale;
+} QuantWeights;
+
+typedef enum {
+    PREC_FP32,
+    PREC_FP16,
+    PREC_BF16
+} Precision;
+
+// applied to a gemm result as each output tile completes: a bias per row and per column, then an element-wise
+// activation
+typedef struct {
+    const elm_t *bias;
+    const elm_t *row_bias;
+    void (*fn)(elm_t *arr, size_t len);
+} GemmEpilogue;
+
+typedef struct {
+    Precision prec;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+    const uint16_t *arr;
+    int owned;
+} HalfWeights;
+
+typedef struct {
+    size_t m;
+    size_t n;
+    size_t o;
+    size_t pairs;
+    elm_t *twiddles;
+    elm_t *spectra;
+} FftKernels;
+
+typedef struct {
+    LayerType type;
+    Activation activation;
+    Convolutional *conv;
+    Pooler *pool;
+    Dense *dense;
+    QuantWeights *quant;
+    HalfWeights *half;
+} Layer;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    size_t num;
+    Layer *layers;
+} Model;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    char *block;
+    size_t num;
+    const Layer *layers;
+    PackedWeights *packed;
+} Packs;
+
+typedef struct {
+    const Layer *layer;
+    const Pooler *pool;
+    elm_t *wino;
+    FftKernels *fft;
+    elm_t *block;
+    void (*fn)(const Tensor *);
+    int top;
+    size_t in;
+    size_t out;
+    size_t work;
+} PlanStep;
+
+typedef struct {
+    size_t m;
+    size_t n;
+    size_t o;
+    int blocked;
+    size_t offset;
+    size_t first;
+    size_t last;
+} PlanValue;
+
+typedef struct {
+    size_t batch;
+    size_t num_steps;
+    PlanStep *steps;
+    size_t num_values;
+    PlanValue *values;
+    size_t region;
+    size_t work;
+} Plan;
+
+typedef enum {
+    CONV_DIRECT,
+    CONV_IM2COL
+} ConvBackend;
+
+typedef enum {
+    LAYOUT_PLANAR,
+    LAYOUT_BLOCKED
+} Layout;
+
+typedef enum {
+    FFT_OFF,
+    FFT_AUTO,
+    FFT_ON
+} FftMode;
+
+typedef enum {
+    EXP_FAST,
+    EXP_EXACT
+} ExpMode;
+
 #endif // TYPES_H
@@ -0,0 +1,28 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include "types.h"
+
+View tensor_view(const Tensor *tens);
+
+View view_transpose(const View *view);
+
+View view_slice(const View *view, size_t row, size_t rows, size_t col, size_t cols);
+
+View view_channels(const View *view, size_t chan, size_t num);
+
+View view_reshape(const View *view, size_t m, size_t n, size_t o);
+
+int view_contiguous(const View *view);
+
+elm_t view_get(const View *view, size_t row, size_t col, size_t chan);
+
+Tensor *view_copy_into(Tensor *res, const View *view);
+
+Tensor *view_tensor_into(Tensor *res, const View *view, elm_t *scratch);
+
+View view_copy(const View *view);
+
+void free_view(View *view);
+
+#endif // VIEW_H
@@ -1,6 +1,54 @@
 #include <math.h>
 #include "types.h"
 #include "activators.h"
+#include "simd.h"
+
+static ExpMode exp_mode_ = EXP_FAST;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void sigmoid_exact_(elm_t *arr, const size_t len) {
+    // double-precision exp, rounded once
+    for (size_t elm = 0; elm < len; elm++) {
+        arr[elm] = (elm_t)(1.0 / (1.0 + exp(-(double)arr[elm])));
+    }
+}
+
+static void softmax_exact_(elm_t *arr, const size_t len) {
+    // max-subtracted, double-precision exps and sum; exps stored on the way to the sum
+    elm_t max = -INFINITY;
+    for (size_t elm = 0; elm < len; elm++) {
+        if (arr[elm] > max) max = arr[elm];
+    }
+    double sum = 0;
+    for (size_t elm = 0; elm < len; elm++) {
+        const double e = exp((double)arr[elm] - max);
+        arr[elm] = (elm_t)e;
+        sum += e;
+    }
+    for (size_t elm = 0; elm < len; elm++) arr[elm] = (elm_t)(arr[elm] / sum);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Selects how sigmoid and softmax evaluate exp.
+ *
+ * @param mode: EXP_FAST for the vectorized single-precision polynomial, within 1 ulp of exp over its normal range;
+ *              EXP_EXACT for the scalar double-precision libm exp.
+ */
+void set_exp_mode(const ExpMode mode) {
+    exp_mode_ = mode;
+}
+
+/**
+ * Gets how sigmoid and softmax evaluate exp.
+ *
+ * @return: current exp mode.
+ */
+ExpMode get_exp_mode(void) {
+    return exp_mode_;
+}
 
 /**
  * No-op for testing.
@@ -15,9 +63,7 @@ void noop(const Tensor *tens) {}
  * @param tens: tensor to have ReLU applied.
  */
 void relu(const Tensor *tens) {
-    for (size_t elm = 0; elm < tens->m * tens->n * tens->o; elm++) {
-        if (tens->arr[elm] < 0.0) tens->arr[elm] = (elm_t)0.0;
-    }
+    simd_ops()->relu(tens->arr, tens->m * tens->n * tens->o);
 }
 
 /**
@@ -26,25 +72,54 @@ void relu(const Tensor *tens) {
  * @param tens: tensor to have sigmoid applied.
  */
 void sigmoid(const Tensor *tens) {
-    for (size_t elm = 0; elm < tens->m * tens->n * tens->o; elm++) {
-        tens->arr[elm] = (elm_t)(1.0 / (1.0 + exp(-tens->arr[elm])));
+    if (exp_mode_ == EXP_EXACT) {
+        sigmoid_exact_(tens->arr, tens->m * tens->n * tens->o);
+        return;
     }
+    simd_ops()->sigmoid(tens->arr, tens->m * tens->n * tens->o);
 }
 
 /**
  * Softmax applied element-wise on a tensor.
  * elements spanning the o-th dimension are treated separately, i.e. the o-th dimension is the batch dimension.
+ * The row max is subtracted first, so large logits cannot overflow.
  *
  * @param tens: tensor to have softmax applied.
  */
 void softmax(const Tensor *tens) {
+    void (*fn)(elm_t *, size_t) = exp_mode_ == EXP_EXACT ? softmax_exact_ : simd_ops()->softmax;
     for (size_t mat = 0; mat < tens->o; mat++) {
-        elm_t sum = 0;
-        for (size_t elm = 0; elm < tens->m * tens->n; elm++) {
-            sum += (elm_t)exp(tens->arr[mat * tens->m * tens->n + elm]);
-        }
-        for (size_t elm = 0; elm < tens->m * tens->n; elm++) {
-            tens->arr[mat * tens->m * tens->n + elm] = (elm_t)(exp(tens->arr[mat * tens->m * tens->n + elm]) / sum);
-        }
+        fn(&tens->arr[mat * tens->m * tens->n], tens->m * tens->n);
     }
 }
+
+/**
+ * Looks up the activation function for a model activation tag.
+ *
+ * @param activation: activation tag.
+ *
+ * @return: activation function; noop for ACT_NONE or an unknown tag.
+ */
+void (*activator(const Activation activation))(const Tensor *) {
+    switch (activation) {
+        case ACT_RELU: return relu;
+        case ACT_SIGMOID: return sigmoid;
+        case ACT_SOFTMAX: return softmax;
+        default: return noop;
+    }
+}
+
+/**
+ * Looks up the array form of an element-wise activation function, e.g. to apply it within a gemm epilogue. Follows
+ * the exp mode selected at the time of the call.
+ *
+ * @param fn: activation function.
+ *
+ * @return: array activation for relu and sigmoid; NULL for noop, softmax or any other function that is not
+ * element-wise.
+ */
+void (*elementwise(void (*fn)(const Tensor *)))(elm_t *, size_t) {
+    if (fn == relu) return simd_ops()->relu;
+    if (fn == sigmoid) return exp_mode_ == EXP_EXACT ? sigmoid_exact_ : simd_ops()->sigmoid;
+    return NULL;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include "types.h"
+#include "functional.h"
+#include "arena.h"
+
+/**
+ * Bytes an arena allocation of a number of elements takes, including alignment padding.
+ * Used to size an arena up front.
+ *
+ * @param size: number of elements.
+ *
+ * @return: arena bytes.
+ */
+size_t arena_bytes(const size_t size) {
+    return (size * sizeof(elm_t) + ELM_ALIGN - 1) / ELM_ALIGN * ELM_ALIGN;
+}
+
+/**
+ * Creates a bump-allocated workspace arena.
+ * Caller is responsible for freeing returned arena with free_arena.
+ *
+ * @param bytes: arena capacity, see arena_bytes.
+ *
+ * @return: empty arena. NULL for malloc fail.
+ */
+Arena *make_arena(const size_t bytes) {
+    // malloc
+    Arena *arena = malloc(sizeof(Arena));
+    char *base = (char *)alloc_arr(bytes / sizeof(elm_t) + 1);
+    if (arena == NULL || base == NULL) {
+        fprintf(stderr, "Failed malloc: Arena sized %zu bytes.\n", bytes);
+        free(arena); free(base);
+        return NULL;
+    }
+
+    // struct setup
+    arena->base = base;
+    arena->size = bytes;
+    arena->used = 0;
+    return arena;
+}
+
+/**
+ * Frees all memory associated with an arena, including every array allocated from it. If arena is NULL, passes.
+ *
+ * @param arena: arena to be freed.
+ */
+void free_arena(Arena *arena) {
+    if (arena == NULL) return;
+    free(arena->base);
+    free(arena);
+}
+
+/**
+ * Allocates an ELM_ALIGN-aligned element array from an arena. Arrays are never freed individually.
+ *
+ * @param arena: arena.
+ * @param size: number of elements.
+ *
+ * @return: uninitialized array. NULL if the arena is exhausted.
+ */
+elm_t *arena_alloc(Arena *arena, const size_t size) {
+    const size_t bytes = arena_bytes(size);
+    if (arena->used + bytes > arena->size) return NULL;
+    elm_t *arr = (elm_t *)(arena->base + arena->used);
+    arena->used += bytes;
+    return arr;
+}
+
+/**
+ * Releases every array allocated from an arena at once.
+ *
+ * @param arena: arena.
+ */
+void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+/**
+ * Allocates a temporary array from an arena, or from the heap when the arena is NULL or exhausted.
+ * Release with arena_drop, passing arena->used as it was before the call (0 for a NULL arena).
+ *
+ * @param arena: arena, or NULL.
+ * @param size: number of elements.
+ *
+ * @return: uninitialized array. NULL for malloc fail.
+ */
+elm_t *arena_scratch(Arena *arena, const size_t size) {
+    elm_t *arr = arena != NULL ? arena_alloc(arena, size) : NULL;
+    return arr != NULL ? arr : alloc_arr(size);
+}
+
+/**
+ * Releases a temporary array from arena_scratch.
+ *
+ * @param arena: arena the array was requested from, or NULL.
+ * @param arr: temporary array.
+ * @param mark: arena->used before the array was requested.
+ */
+void arena_drop(Arena *arena, elm_t *arr, const size_t mark) {
+    if (arena != NULL && (char *)arr >= arena->base && (char *)arr < arena->base + arena->size) {
+        arena->used = mark;
+        return;
+    }
+    free(arr);
+}
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "functional.h"
+#include "computational.h"
+#include "arena.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "blocked.h"
+
+// blocked layout: channels in groups of CHAN_BLOCK, each group stored pixel after pixel with its channels interleaved,
+// i.e. arr[((img * blocks + chan / CHAN_BLOCK) * m * n + row * n + col) * CHAN_BLOCK + chan % CHAN_BLOCK]; lanes past
+// the last channel are padding
+
+// blocked layer convolution or pooling, split across the compute pool by item, channel block and row band
+typedef struct {
+    Batch *res;
+    const Batch *channels;
+    const Convolutional *kernels;
+    const Pooler *pooler;
+    const elm_t *packed;
+    const size_t *offs;
+    size_t taps;
+    size_t lanes;
+    size_t bands;
+} BlockSplit;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static size_t bands_(const size_t workers, const size_t items, const size_t rows) {
+    // enough row bands per item to give every worker about two tasks
+    if (workers == 1) return 1;
+    const size_t bands = (2 * workers + items - 1) / items;
+    return bands < rows ? bands : rows;
+}
+
+static void conv_task_(void *ctx, const size_t task, const size_t worker) {
+    (void)worker;
+    const BlockSplit *split = ctx;
+    const Batch *channels = split->channels, *res = split->res;
+    const Kernel *k_ref = split->kernels->kernels[0];
+    const size_t m = channels->m, n = channels->n, lanes = split->lanes;
+    const size_t m_res = res->m, n_res = res->n, blocks = chan_blocks(res->o);
+    const size_t item = lanes == 1 ? m * n * channels->o : chan_blocks(channels->o) * m * n * CHAN_BLOCK;
+
+    // item, kernel block and output row band
+    const size_t img = task / (blocks * split->bands), block = task / split->bands % blocks;
+    const size_t band = task % split->bands;
+    const size_t lo = m_res * band / split->bands, hi = m_res * (band + 1) / split->bands;
+
+    // every output row starts at the block's biases, then accumulates all taps CHAN_BLOCK kernels at a time
+    const SimdOps *ops = simd_ops();
+    const elm_t *w = &split->packed[block * (split->taps + 1) * CHAN_BLOCK];
+    const elm_t *main = &channels->arr[img * item];
+    elm_t *targ = &res->arr[(img * blocks + block) * m_res * n_res * CHAN_BLOCK];
+    for (size_t row = lo; row < hi; row++) {
+        elm_t *out = &targ[row * n_res * CHAN_BLOCK];
+        for (size_t col = 0; col < n_res; col++) memcpy(&out[col * CHAN_BLOCK], w, CHAN_BLOCK * sizeof(elm_t));
+        ops->conv_block(out, &main[row * k_ref->m_stride * n * lanes], split->offs, &w[CHAN_BLOCK], split->taps,
+            n_res, k_ref->n_stride * lanes);
+    }
+}
+
+static void pool_task_(void *ctx, const size_t task, const size_t worker) {
+    (void)worker;
+    const BlockSplit *split = ctx;
+    const Batch *main = split->channels, *res = split->res;
+    const Pooler *pooler = split->pooler;
+    const size_t n = main->n, m_res = res->m, n_res = res->n;
+    const size_t col_stride = pooler->n_stride * CHAN_BLOCK;
+
+    // one channel block of one item, each output row starts at its first window element
+    const SimdOps *ops = simd_ops();
+    const elm_t *src = &main->arr[task * main->m * n * CHAN_BLOCK];
+    elm_t *targ = &res->arr[task * m_res * n_res * CHAN_BLOCK];
+    for (size_t row = 0; row < m_res; row++) {
+        elm_t *out = &targ[row * n_res * CHAN_BLOCK];
+        const elm_t *first = &src[row * pooler->m_stride * n * CHAN_BLOCK];
+        for (size_t col = 0; col < n_res; col++) {
+            memcpy(&out[col * CHAN_BLOCK], &first[col * col_stride], CHAN_BLOCK * sizeof(elm_t));
+        }
+        for (size_t row_k = 0; row_k < pooler->m; row_k++) {
+            for (size_t col_k = 0; col_k < pooler->n; col_k++) {
+                ops->max_block(out, &first[(row_k * n + col_k) * CHAN_BLOCK], n_res, col_stride);
+            }
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Number of channel blocks holding o channels in the blocked layout.
+ *
+ * @param o: channels.
+ *
+ * @return: channel blocks.
+ */
+size_t chan_blocks(const size_t o) {
+    return (o + CHAN_BLOCK - 1) / CHAN_BLOCK;
+}
+
+/**
+ * Elements a batch takes in the blocked layout, channels padded to whole blocks.
+ *
+ * @param shape: batch dimensions.
+ *
+ * @return: size in elements.
+ */
+size_t batch_blocked_size(const Batch *shape) {
+    return chan_blocks(shape->o) * CHAN_BLOCK * shape->m * shape->n * shape->b;
+}
+
+/**
+ * Views a blocked batch as one flat tensor over every lane, padding included, for element-wise activations. Softmax
+ * does not apply to blocked values.
+ *
+ * @param batch: blocked batch.
+ *
+ * @return: tensor view.
+ */
+Tensor blocked_view(const Batch *batch) {
+    const Tensor view = {.m=batch->m, .n=batch->n, .o=chan_blocks(batch->o) * CHAN_BLOCK * batch->b, .arr=batch->arr};
+    return view;
+}
+
+/**
+ * Converts a batch from the channel-major layout into the blocked layout, into a caller-provided batch. Padding lanes
+ * are zeroed.
+ * res->arr must hold batch_blocked_size elements; res dimensions are set by the call.
+ *
+ * @param res: result batch, blocked.
+ * @param main: channel-major batch.
+ *
+ * @return: res.
+ */
+Batch *batch_block_into(Batch *res, const Batch *main) {
+    const size_t size = main->m * main->n, o = main->o, blocks = chan_blocks(o);
+    res->m = main->m; res->n = main->n; res->o = o; res->b = main->b;
+    memset(res->arr, 0, batch_blocked_size(main) * sizeof(elm_t));
+    for (size_t img = 0; img < main->b; img++) {
+        for (size_t chan = 0; chan < o; chan++) {
+            const elm_t *src = &main->arr[(img * o + chan) * size];
+            elm_t *dst = &res->arr[(img * blocks + chan / CHAN_BLOCK) * size * CHAN_BLOCK + chan % CHAN_BLOCK];
+            for (size_t px = 0; px < size; px++) dst[px * CHAN_BLOCK] = src[px];
+        }
+    }
+    return res;
+}
+
+/**
+ * Converts a batch from the blocked layout back into the channel-major layout, into a caller-provided batch.
+ * res->arr must hold m x n x o x b elements; res dimensions are set by the call.
+ *
+ * @param res: result batch, channel-major.
+ * @param main: blocked batch.
+ *
+ * @return: res.
+ */
+Batch *batch_unblock_into(Batch *res, const Batch *main) {
+    const size_t size = main->m * main->n, o = main->o, blocks = chan_blocks(o);
+    res->m = main->m; res->n = main->n; res->o = o; res->b = main->b;
+    for (size_t img = 0; img < main->b; img++) {
+        for (size_t chan = 0; chan < o; chan++) {
+            const elm_t *src = &main->arr[(img * blocks + chan / CHAN_BLOCK) * size * CHAN_BLOCK + chan % CHAN_BLOCK];
+            elm_t *dst = &res->arr[(img * o + chan) * size];
+            for (size_t px = 0; px < size; px++) dst[px] = src[px * CHAN_BLOCK];
+        }
+    }
+    return res;
+}
+
+/**
+ * Packs a layer's kernels for blocked convolution: per block of CHAN_BLOCK kernels, their biases, then for every input
+ * channel and kernel element the CHAN_BLOCK weights side by side. Lanes past the last kernel are zero. Biases are
+ * scaled by the input channel count, matching the per-channel bias accumulation of batch_conv_direct_into.
+ * Computed once per layer and reused by every batch_conv_blocked_into call.
+ * Caller is responsible for freeing returned array with free.
+ *
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ *
+ * @return: packed kernels. NULL for an empty layer or malloc fail.
+ */
+elm_t *blocked_kernels(const Convolutional *kernels) {
+    if (kernels->num == 0) return NULL;
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t taps = k_ref->m * k_ref->n * k_ref->o, blocks = chan_blocks(kernels->num);
+    elm_t *res = calloc_arr(blocks * (taps + 1) * CHAN_BLOCK);
+    if (res == NULL) {
+        fprintf(stderr, "Failed malloc: blocked kernels of %zu kernels.\n", kernels->num);
+        return NULL;
+    }
+    for (size_t kern = 0; kern < kernels->num; kern++) {
+        const Kernel *kernel = kernels->kernels[kern];
+        elm_t *dst = &res[kern / CHAN_BLOCK * (taps + 1) * CHAN_BLOCK + kern % CHAN_BLOCK];
+        dst[0] = kernel->bias * (elm_t)k_ref->o;
+        for (size_t tap = 0; tap < taps; tap++) dst[(tap + 1) * CHAN_BLOCK] = kernel->arr[tap];
+    }
+    return res;
+}
+
+/**
+ * Workspace elements batch_conv_blocked_into takes from its arena.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_conv_blocked_workspace(const Batch *channels, const Convolutional *kernels) {
+    // input offset of every tap
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t taps = channels->o * k_ref->m * k_ref->n;
+    return (taps * sizeof(size_t) + sizeof(elm_t) - 1) / sizeof(elm_t);
+}
+
+/**
+ * Convolution of every item of a batch with a full convolutional layer, producing the blocked layout, into a
+ * caller-provided batch. Each SIMD lane computes a different kernel of the same output pixel, so the vector width is
+ * used fully for any input channel count. The input is read in either layout, which makes the first conv layer the
+ * entry into the blocked layout at no extra cost.
+ * Matches batch_conv_direct_into to rounding, including the per-channel bias accumulation.
+ * res->arr must hold batch_blocked_size elements of the output; res dimensions are set by the call.
+ *
+ * @param res: result batch, blocked.
+ * @param channels: batch of tensors to be convolved.
+ * @param in_blocked: channels in the blocked layout rather than channel-major.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ * @param packed: kernels from blocked_kernels.
+ * @param arena: arena for the tap offsets, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_blocked_into(Batch *res, const Batch *channels, const int in_blocked,
+    const Convolutional *kernels, const elm_t *packed, Arena *arena) {
+    // dimension setup
+    const size_t b = channels->b, m = channels->m, n = channels->n, o = channels->o;
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != b) return NULL;
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t taps = o * k_ref->m * k_ref->n;
+
+    // tap offsets from the top left of a window, in input elements
+    const size_t mark = arena != NULL ? arena->used : 0;
+    elm_t *work = arena_scratch(arena, batch_conv_blocked_workspace(channels, kernels));
+    if (work == NULL) {
+        fprintf(stderr, "Failed malloc: blocked convolution offsets of %zu taps.\n", taps);
+        return NULL;
+    }
+    size_t *offs = (size_t *)work;
+    for (size_t chan = 0; chan < o; chan++) {
+        for (size_t row_k = 0; row_k < k_ref->m; row_k++) {
+            for (size_t col_k = 0; col_k < k_ref->n; col_k++) {
+                const size_t tap = (chan * k_ref->m + row_k) * k_ref->n + col_k;
+                offs[tap] = in_blocked
+                    ? ((chan / CHAN_BLOCK * m + row_k) * n + col_k) * CHAN_BLOCK + chan % CHAN_BLOCK
+                    : (chan * m + row_k) * n + col_k;
+            }
+        }
+    }
+
+    // struct setup
+    res->m = shape.m; res->n = shape.n; res->o = shape.o; res->b = b;
+
+    // convolution operation, split into item, kernel block and row band tasks above the parallel threshold
+    const size_t blocks = chan_blocks(shape.o);
+    const size_t workers = compute_workers(b * blocks * CHAN_BLOCK * shape.m * shape.n * taps);
+    BlockSplit split = {.res=res, .channels=channels, .kernels=kernels, .packed=packed, .offs=offs, .taps=taps,
+        .lanes=in_blocked ? CHAN_BLOCK : 1, .bands=bands_(workers, b * blocks, shape.m)};
+    thread_pool_run(workers > 1 ? compute_pool() : NULL, b * blocks * split.bands, conv_task_, &split);
+    arena_drop(arena, work, mark);
+    return res;
+}
+
+/**
+ * Max pooling of every item of a blocked batch, into a caller-provided blocked batch. Every comparison covers
+ * CHAN_BLOCK channels.
+ * res->arr must hold batch_blocked_size elements of the output; res dimensions are set by the call.
+ *
+ * @param res: result batch, blocked.
+ * @param main: blocked batch to be pooled.
+ * @param pooler: pooling kernel.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Batch *batch_pool_blocked_into(Batch *res, const Batch *main, const Pooler *pooler) {
+    // dimension setup
+    const Batch shape = batch_pool_shape(main, pooler);
+    if (shape.b != main->b) return NULL;
+
+    // struct setup
+    res->m = shape.m; res->n = shape.n; res->o = shape.o; res->b = shape.b;
+
+    // pooling operation, one task per item and channel block
+    const size_t tasks = main->b * chan_blocks(main->o);
+    const size_t workers = compute_workers(tasks * CHAN_BLOCK * shape.m * shape.n * pooler->m * pooler->n);
+    BlockSplit split = {.res=res, .channels=main, .pooler=pooler};
+    thread_pool_run(workers > 1 ? compute_pool() : NULL, tasks, pool_task_, &split);
+    return res;
+}
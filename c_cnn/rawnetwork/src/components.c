@@ -1,12 +1,151 @@
 #include <stdio.h>
+#include <math.h>
 #include "types.h"
 #include "computational.h"
 #include "functional.h"
+#include "activators.h"
+#include "arena.h"
 #include "components.h"
+#include "fft.h"
+
+static ConvBackend conv_backend_ = CONV_DIRECT;
+static int conv_winograd_ = 1;
+static FftMode conv_fft_ = FFT_AUTO;
+static Layout conv_layout_ = LAYOUT_PLANAR;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static Batch *dense_matmul_(Batch *res, const Batch *flat, const Dense *dense, const GemmEpilogue *epi, Arena *arena) {
+    // flattened matmul with epilogue, from the weight panels when the layer is prepacked
+    const PackedWeights *packed = dense->packed;
+    if (packed != NULL && packed->rows == dense->weights->m && packed->cols == dense->weights->n) {
+        return batch_matmul_packed_into(res, flat, packed, epi, arena);
+    }
+    return batch_matmul_epilogue_into(res, flat, dense->weights, epi, arena);
+}
+
+static void topk_(size_t *classes, const elm_t *row, const size_t n, const size_t k) {
+    // insertion into the k best so far, ties to the lower class as with argmax
+    size_t num = 0;
+    for (size_t col = 0; col < n; col++) {
+        if (num == k && row[col] <= row[classes[k - 1]]) continue;
+        size_t pos = num < k ? num++ : k - 1;
+        while (pos > 0 && row[classes[pos - 1]] < row[col]) {
+            classes[pos] = classes[pos - 1];
+            pos--;
+        }
+        classes[pos] = col;
+    }
+}
+
+static void topk_scores_(elm_t *scores, const size_t *classes, const elm_t *row, const size_t n, const size_t k,
+    const Activation activation) {
+    // activated values of the selected classes only; softmax normalised over the whole row, nothing else written
+    for (size_t idx = 0; idx < k; idx++) scores[idx] = row[classes[idx]];
+    if (activation == ACT_SOFTMAX) {
+        const double max = row[classes[0]];
+        double sum = 0;
+        for (size_t col = 0; col < n; col++) sum += exp((double)row[col] - max);
+        for (size_t idx = 0; idx < k; idx++) scores[idx] = (elm_t)(exp((double)scores[idx] - max) / sum);
+        return;
+    }
+    void (*fn)(elm_t *, size_t) = elementwise(activator(activation));
+    if (fn != NULL) fn(scores, k);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
 
 /**
- * Dense layer function.
- * Automatically frees any intermediate values.
+ * Selects the backend used by convolutional layers.
+ *
+ * @param backend: CONV_DIRECT for per-kernel direct convolution, CONV_IM2COL for column lowering + matmul.
+ */
+void set_conv_backend(const ConvBackend backend) {
+    conv_backend_ = backend;
+}
+
+/**
+ * Gets the backend used by convolutional layers.
+ *
+ * @return: current convolution backend.
+ */
+ConvBackend get_conv_backend(void) {
+    return conv_backend_;
+}
+
+/**
+ * Enables or disables winograd convolution. When enabled, layers of 3x3 stride-1 kernels run as winograd F(2x2, 3x3)
+ * and every other layer falls back to the backend selected with set_conv_backend.
+ *
+ * @param enabled: 1 to run eligible layers as winograd, 0 to run every layer on the selected backend.
+ */
+void set_conv_winograd(const int enabled) {
+    conv_winograd_ = enabled;
+}
+
+/**
+ * Whether a convolutional layer runs as winograd: enabled with set_conv_winograd and of 3x3 stride-1 kernels.
+ *
+ * @param kernels: convolutional kernels.
+ *
+ * @return: 1 for a layer run as winograd; 0 otherwise.
+ */
+int conv_winograd(const Convolutional *kernels) {
+    return conv_winograd_ && batch_conv_winograd_fits(kernels);
+}
+
+/**
+ * Selects when stride-1 conv layers run in the frequency domain. Winograd takes precedence for the layers it fits.
+ *
+ * @param mode: FFT_OFF never; FFT_AUTO when the cost model expects it to beat direct convolution; FFT_ON always.
+ */
+void set_conv_fft(const FftMode mode) {
+    conv_fft_ = mode;
+}
+
+/**
+ * Whether a convolutional layer runs in the frequency domain on inputs of a given shape: stride 1, not run as
+ * winograd, and either forced with set_conv_fft or estimated cheaper than the multiply-adds of direct convolution.
+ *
+ * @param input: batch of channels, only dimensions are read.
+ * @param kernels: convolutional kernels.
+ *
+ * @return: 1 for a layer run in the frequency domain; 0 otherwise.
+ */
+int conv_fft(const Batch *input, const Convolutional *kernels) {
+    if (conv_fft_ == FFT_OFF || conv_winograd(kernels) || !batch_conv_fft_fits(kernels)) return 0;
+    const Batch shape = batch_conv_shape(input, kernels);
+    if (shape.b == 0) return 0;
+    if (conv_fft_ == FFT_ON) return 1;
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t macs = shape.b * shape.o * shape.m * shape.n * input->o * k_ref->m * k_ref->n;
+    return batch_conv_fft_work(input, kernels) < macs;
+}
+
+/**
+ * Selects the activation layout of conv layers run through a plan. Blocked layers take precedence over winograd and
+ * the frequency domain.
+ *
+ * @param layout: LAYOUT_PLANAR for channel-major activations; LAYOUT_BLOCKED for channels interleaved in groups of
+ * CHAN_BLOCK between conv and pool layers.
+ */
+void set_conv_layout(const Layout layout) {
+    conv_layout_ = layout;
+}
+
+/**
+ * Whether a convolutional layer runs in the blocked layout, selected with set_conv_layout.
+ *
+ * @param kernels: convolutional kernels.
+ *
+ * @return: 1 for a layer run in the blocked layout; 0 otherwise.
+ */
+int conv_blocked(const Convolutional *kernels) {
+    return conv_layout_ == LAYOUT_BLOCKED && kernels->num > 0;
+}
+
+/**
+ * Dense layer function. Bias and element-wise activations are applied within the matmul, see batch_dense_into.
  * Caller is responsible for freeing returned tensor & array.
  *
  * @param input: activations.
@@ -16,97 +155,338 @@
  * @return: next layer activations. NULL for any failed operation or malloc fail.
  */
 Tensor *dense(const Tensor *input, const Dense *dense, void (*fn)(const Tensor*)) {
-    // matmul
-    Tensor *alpha = matmul(input, dense->weights);
-
     // malloc
-    Tensor **tensors = malloc(2 * sizeof(Tensor*));
-    if (alpha == NULL || tensors == NULL) {
-        // malloc fail
-        fprintf(stderr, "Failed malloc: Tensor* or internal matmul fail.\n");
-        free_tensor(alpha);
-        if (tensors != NULL) {
-            free_tensor(tensors[0]);
-            free_tensor(tensors[1]);
-        }
-        free(tensors);
+    Tensor *res = make_tensor(input->m, dense->weights->n, input->o);
+    if (res == NULL) return NULL;
+
+    // single-item batch
+    const Batch b_input = {.m=input->m, .n=input->n, .o=input->o, .b=1, .arr=input->arr};
+    Batch b_res = {.arr=res->arr};
+    if (batch_dense_into(&b_res, &b_input, dense, fn, NULL) == NULL) {
+        free_tensor(res);
         return NULL;
     }
+    return res;
+}
 
-    // bias
-    tensors[0] = alpha; tensors[1] = dense->biases;
-    Tensor *res = sum(tensors, 2);
+/**
+ * Convolutional layer function. Runs as winograd or in the frequency domain when eligible (see set_conv_winograd and
+ * set_conv_fft), else on the backend selected with set_conv_backend.
+ * Automatically frees any intermediate values.
+ * Caller is responsible for freeing returned tensor & array.
+ *
+ * @param input: channels.
+ * @param kernels: convolutional kernels.
+ * @param fn: activation function.
+ *
+ * @return: next layer channels. NULL for any failed operation or malloc fail.
+ */
+Tensor *convolution(const Tensor *input, const Convolutional *kernels, void (*fn)(const Tensor*)) {
+    // single-item batch
+    const Batch b_input = {.m=input->m, .n=input->n, .o=input->o, .b=1, .arr=input->arr};
+    const Batch shape = batch_conv_shape(&b_input, kernels);
+    if (shape.b != 1) {
+        fprintf(stderr, "Failed operation: internal conv fail.\n");
+        return NULL;
+    }
 
-    // free
-    free_tensor(alpha); free(tensors);
+    // malloc
+    Tensor *res = make_tensor(shape.m, shape.n, shape.o);
+    if (res == NULL) return NULL;
 
-    if (res == NULL) {
-        // sum fail
-        fprintf(stderr, "Failed operation: internal sum fail.\n");
+    // convolution operation
+    Batch b_res = {.arr=res->arr};
+    if (batch_convolution_into(&b_res, &b_input, kernels, fn, NULL) == NULL) {
+        free_tensor(res);
         return NULL;
     }
+    return res;
+}
 
-    // activation function
-    fn(res);
+/**
+ * Batched dense layer function. The whole batch runs through a single matmul.
+ * Automatically frees any intermediate values.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param input: batch of activations.
+ * @param dense: dense layer.
+ * @param fn: activation function, applied once over the whole batch.
+ *
+ * @return: next layer activations. NULL for any failed operation or malloc fail.
+ */
+Batch *batch_dense(const Batch *input, const Dense *dense, void (*fn)(const Tensor*)) {
+    // malloc
+    Batch *res = make_batch(input->m, dense->weights->n, input->o, input->b);
+    if (res == NULL) return NULL;
 
-    // return
+    // dense operation
+    if (batch_dense_into(res, input, dense, fn, NULL) == NULL) {
+        free_batch(res);
+        return NULL;
+    }
     return res;
 }
 
 /**
- * Convolutional layer function.
+ * Batched convolutional layer function. Runs as winograd or in the frequency domain when eligible (see
+ * set_conv_winograd and set_conv_fft), else on the backend selected with set_conv_backend.
  * Automatically frees any intermediate values.
- * Caller is responsible for freeing returned tensor & array.
+ * Caller is responsible for freeing returned batch & array.
  *
- * @param input: channels.
+ * @param input: batch of channels.
  * @param kernels: convolutional kernels.
- * @param fn: activation function.
+ * @param fn: activation function, applied once over the whole batch.
  *
  * @return: next layer channels. NULL for any failed operation or malloc fail.
  */
-Tensor *convolution(const Tensor *input, const Convolutional *kernels, void (*fn)(const Tensor*)) {
+Batch *batch_convolution(const Batch *input, const Convolutional *kernels, void (*fn)(const Tensor*)) {
+    // result dimension setup
+    const Batch shape = batch_conv_shape(input, kernels);
+    if (shape.b != input->b) {
+        fprintf(stderr, "Failed operation: internal conv fail.\n");
+        return NULL;
+    }
+
     // malloc
-    Tensor **alpha = malloc(kernels->num * sizeof(Tensor*));
-    if (alpha == NULL) {
-        // malloc fail
-        fprintf(stderr, "Failed malloc: Tensor*.\n");
+    Batch *res = make_batch(shape.m, shape.n, shape.o, shape.b);
+    if (res == NULL) return NULL;
+
+    // convolution operation
+    if (batch_convolution_into(res, input, kernels, fn, NULL) == NULL) {
+        free_batch(res);
+        return NULL;
+    }
+    return res;
+}
+
+/**
+ * Batched convolutional layer function fused with max pooling.
+ * The activation is applied to pooled values only, which equals pooling the activated convolution as long as fn is
+ * element-wise and non-decreasing (noop, relu, sigmoid; not softmax).
+ * Automatically frees any intermediate values.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param input: batch of channels.
+ * @param kernels: convolutional kernels.
+ * @param fn: element-wise, non-decreasing activation function.
+ * @param pooler: pooling kernel.
+ *
+ * @return: pooled next layer channels. NULL for any failed operation or malloc fail.
+ */
+Batch *batch_convolution_pool(const Batch *input, const Convolutional *kernels, void (*fn)(const Tensor*),
+    const Pooler *pooler) {
+    // result dimension setup
+    const Batch conv_shape = batch_conv_shape(input, kernels);
+    const Batch shape = batch_pool_shape(&conv_shape, pooler);
+    if (conv_shape.b != input->b || shape.b != input->b) {
+        fprintf(stderr, "Failed operation: internal conv pool fail.\n");
         return NULL;
     }
 
-    for (size_t kernel = 0; kernel < kernels->num; kernel++) {
-        // conv
-        Tensor *out = conv(input, kernels->kernels[kernel]);
-        if (out == NULL) {
-            // conv fail
-            fprintf(stderr, "Failed operation: internal conv fail.\n");
-            // dump memory
-            for (size_t idx = 0; idx < kernel; idx++) {
-                free_tensor(alpha[idx]);
-            }
-            free(alpha);
+    // malloc
+    Batch *res = make_batch(shape.m, shape.n, shape.o, shape.b);
+    if (res == NULL) return NULL;
+
+    // fused operation
+    if (batch_convolution_pool_into(res, input, kernels, fn, pooler, NULL) == NULL) {
+        free_batch(res);
+        return NULL;
+    }
+    return res;
+}
+
+/**
+ * Batched dense layer function into a caller-provided batch. For flattened inputs the bias, and fn when element-wise
+ * (see elementwise), are applied in the gemm epilogue as each output tile completes, so the result is written once;
+ * row-wise activations such as softmax run after the matmul, and weights prepacked at load (see pack_layers) are read
+ * from their panels in place. Other inputs add the bias in place on the matmul result.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param input: batch of activations.
+ * @param dense: dense layer.
+ * @param fn: activation function, applied once over the whole batch.
+ * @param arena: arena for matmul workspace, or NULL to use the heap.
+ *
+ * @return: res. NULL for any failed operation.
+ */
+Batch *batch_dense_into(Batch *res, const Batch *input, const Dense *dense, void (*fn)(const Tensor*),
+    Arena *arena) {
+    const Tensor *biases = dense->biases;
+    if (input->m == 1 && input->o == 1 && biases->m == 1 && biases->o == 1 && biases->n == dense->weights->n) {
+        // matmul, bias and element-wise activation in one pass
+        const GemmEpilogue epi = {.bias=biases->arr, .fn=elementwise(fn)};
+        if (dense_matmul_(res, input, dense, &epi, arena) == NULL) {
+            fprintf(stderr, "Failed operation: internal matmul fail.\n");
             return NULL;
         }
-        // conv accumulation
-        alpha[kernel] = out;
-    }
-
-    // combine outputs
-    Tensor *res = combine(alpha, kernels->num);
-    if (res == NULL) {
-        // combine fail
-        fprintf(stderr, "Failed operation: internal combine fail.\n");
-        // dump memory
-        for (size_t idx = 0; idx < kernels->num; idx++) {
-            free_tensor(alpha[idx]);
+        if (epi.fn == NULL) {
+            const Tensor view = batch_view(res);
+            fn(&view);
         }
-        free(alpha);
+        return res;
+    }
+
+    // matmul
+    if (batch_matmul_into(res, input, dense->weights, arena) == NULL) {
+        fprintf(stderr, "Failed operation: internal matmul fail.\n");
+        return NULL;
+    }
+
+    // bias
+    if (batch_sum_into(res, res, dense->biases) == NULL) {
+        fprintf(stderr, "Failed operation: internal sum fail.\n");
         return NULL;
     }
 
     // activation function
-    fn(res);
+    const Tensor view = batch_view(res);
+    fn(&view);
+    return res;
+}
 
-    // free and return
-    free(alpha);
+/**
+ * Workspace elements batch_dense_topk_into takes from its arena.
+ *
+ * @param input: batch of activations.
+ * @param dense: dense layer.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_dense_topk_workspace(const Batch *input, const Dense *dense) {
+    // pre-activation rows, then gemm packing
+    Batch flat = *input;
+    batch_flatten(&flat);
+    const size_t line = ELM_ALIGN / sizeof(elm_t);
+    const size_t rows = (flat.b * dense->weights->n + line - 1) / line * line;
+    return rows + batch_matmul_workspace(&flat, dense->weights);
+}
+
+/**
+ * Dense layer over every item of a batch that returns only the k highest-scoring classes of each item, best first.
+ * The bias is applied in the gemm epilogue and the classes are ranked on the pre-activation values, which every
+ * activation keeps in order (relu ties are ranked by the values underneath), so no activated output is materialized
+ * and softmax runs over no row. Ties go to the lower class, as with argmax.
+ *
+ * @param classes: k classes per item, written.
+ * @param scores: activated values of the returned classes, k per item, or NULL to skip them. Softmax scores are
+ * normalised over the whole row with exact double-precision exp, ignoring set_exp_mode (-e); other activations follow
+ * it.
+ * @param input: batch of activations, read flattened.
+ * @param dense: dense layer.
+ * @param activation: activation of the layer.
+ * @param k: classes per item, 1 for argmax.
+ * @param arena: arena for the pre-activation rows and gemm packing, or NULL to use the heap.
+ *
+ * @return: classes. NULL for k out of range, any failed operation or malloc fail.
+ */
+size_t *batch_dense_topk_into(size_t *classes, elm_t *scores, const Batch *input, const Dense *dense,
+    const Activation activation, const size_t k, Arena *arena) {
+    // dimension setup
+    Batch flat = *input;
+    batch_flatten(&flat);
+    const size_t n = dense->weights->n;
+    if (k == 0 || k > n || dense->biases->m * dense->biases->n * dense->biases->o != n) {
+        fprintf(stderr, "Invalid top-k: %zu of %zu classes with %zu biases.\n", k, n,
+            dense->biases->m * dense->biases->n * dense->biases->o);
+        return NULL;
+    }
+
+    // pre-activation rows, bias fused
+    const size_t mark = arena != NULL ? arena->used : 0;
+    Batch logits = {.arr=arena_scratch(arena, flat.b * n)};
+    if (logits.arr == NULL) {
+        fprintf(stderr, "Failed malloc: top-k rows of %zu items.\n", flat.b);
+        return NULL;
+    }
+    const GemmEpilogue epi = {.bias=dense->biases->arr};
+    size_t *res = classes;
+    if (dense_matmul_(&logits, &flat, dense, &epi, arena) == NULL) {
+        fprintf(stderr, "Failed operation: internal matmul fail.\n");
+        res = NULL;
+    }
+
+    // selection per item
+    for (size_t img = 0; res != NULL && img < flat.b; img++) {
+        topk_(&classes[img * k], &logits.arr[img * n], n, k);
+        if (scores != NULL) topk_scores_(&scores[img * k], &classes[img * k], &logits.arr[img * n], n, k, activation);
+    }
+    arena_drop(arena, logits.arr, mark);
+    return res;
+}
+
+/**
+ * Workspace elements batch_convolution_into takes from its arena on the current backend, as winograd or in the
+ * frequency domain.
+ *
+ * @param input: batch of channels.
+ * @param kernels: convolutional kernels.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_convolution_workspace(const Batch *input, const Convolutional *kernels) {
+    if (conv_winograd(kernels)) return batch_conv_winograd_workspace(input, kernels, NULL);
+    if (conv_fft(input, kernels)) return batch_conv_fft_workspace(input, kernels);
+    if (conv_backend_ == CONV_IM2COL) return batch_conv_im2col_workspace(input, kernels);
+    return 0;
+}
+
+/**
+ * Batched convolutional layer function into a caller-provided batch. Runs as winograd or in the frequency domain
+ * when eligible (see set_conv_winograd and set_conv_fft), else on the backend selected with set_conv_backend. Kernel
+ * transforms are computed per call; plans compute them once.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param input: batch of channels.
+ * @param kernels: convolutional kernels; all kernels must share shape and stride.
+ * @param fn: activation function, applied once over the whole batch.
+ * @param arena: arena for workspace, or NULL to use the heap.
+ *
+ * @return: res. NULL for any failed operation or malloc fail.
+ */
+Batch *batch_convolution_into(Batch *res, const Batch *input, const Convolutional *kernels,
+    void (*fn)(const Tensor*), Arena *arena) {
+    // convolution operation
+    const Batch *out = conv_winograd(kernels) ? batch_conv_winograd_into(res, input, kernels, NULL, arena)
+        : conv_fft(input, kernels) ? batch_conv_fft_into(res, input, kernels, NULL, arena)
+        : conv_backend_ == CONV_IM2COL ? batch_conv_im2col_into(res, input, kernels, arena)
+        : batch_conv_direct_into(res, input, kernels);
+    if (out == NULL) {
+        fprintf(stderr, "Failed operation: internal conv fail.\n");
+        return NULL;
+    }
+
+    // activation function
+    const Tensor view = batch_view(res);
+    fn(&view);
+    return res;
+}
+
+/**
+ * Batched convolutional layer function fused with max pooling, into a caller-provided batch.
+ * See batch_convolution_pool for the constraints on fn.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param input: batch of channels.
+ * @param kernels: convolutional kernels.
+ * @param fn: element-wise, non-decreasing activation function.
+ * @param pooler: pooling kernel.
+ * @param arena: arena for workspace, or NULL to use the heap.
+ *
+ * @return: res. NULL for any failed operation or malloc fail.
+ */
+Batch *batch_convolution_pool_into(Batch *res, const Batch *input, const Convolutional *kernels,
+    void (*fn)(const Tensor*), const Pooler *pooler, Arena *arena) {
+    // fused conv and pool
+    if (batch_conv_pool_into(res, input, kernels, pooler, arena) == NULL) {
+        fprintf(stderr, "Failed operation: internal conv pool fail.\n");
+        return NULL;
+    }
+
+    // activation function
+    const Tensor view = batch_view(res);
+    fn(&view);
     return res;
 }
@@ -1,76 +1,378 @@
 #include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
 #include "types.h"
 #include "functional.h"
 #include "computational.h"
+#include "arena.h"
+#include "gemm.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+// winograd F(2x2, 3x3): 4x4 input tiles give 2x2 outputs; about this many tiles go through a band at once
+#define WINO_TILE 16
+#define WINO_BAND 128
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 
-static elm_t linear_sum_(const elm_t *vec, const elm_t *opp, const Tensor *t_opp, const size_t col) {
-    elm_t res = 0;
-    for (size_t elm = 0; elm < t_opp->m; elm ++) {
-        // sum accumulation
-        res += vec[elm] * opp[elm * t_opp->n + col];
+static void matmul_(elm_t *targ, const elm_t *main, const Tensor *t_main, const elm_t *opp, const Tensor *t_opp,
+    const GemmEpilogue *epi, elm_t *work) {
+    // lone matmul operation
+    gemm_epilogue_ws(targ, main, opp, t_main->m, t_opp->n, t_main->n, epi, work);
+}
+
+static void conv_row_(elm_t *out, const size_t n_res, const elm_t *main, const Tensor *t_main,
+    const elm_t *kernel, const Kernel *k_kernel, const size_t row, const SimdOps *ops) {
+    // dimension setup
+    const size_t n = t_main->n;
+    const size_t m_k = k_kernel->m, n_k = k_kernel->n;
+    const size_t n_stride = k_kernel->n_stride;
+
+    // single output row, one kernel element at a time across the whole row
+    for (size_t col = 0; col < n_res; col++) out[col] += k_kernel->bias;
+    for (size_t row_k = 0; row_k < m_k; row_k++) {
+        const elm_t *src = &main[(row * k_kernel->m_stride + row_k) * n];
+        for (size_t col_k = 0; col_k < n_k; col_k++) {
+            const elm_t weight = kernel[row_k * n_k + col_k];
+            if (n_stride == 1) {
+                ops->axpy(out, &src[col_k], weight, n_res);
+            } else {
+                for (size_t col = 0; col < n_res; col++) out[col] += weight * src[col * n_stride + col_k];
+            }
+        }
     }
-    return res;
 }
 
-static elm_t cdot_(const elm_t *mat, const Tensor *t_mat, const elm_t *kernel, const Kernel *k_kernel,
-    const size_t row, const size_t col) {
-    // dot product
-    elm_t res = 0;
-    for (size_t row_k = 0; row_k < k_kernel->m; row_k++) {
-        for (size_t col_k = 0; col_k < k_kernel->n; col_k++) {
-            // dot product accumulation
-            res += kernel[row_k * k_kernel->n + col_k] * mat[(row + row_k) * t_mat->n + (col + col_k)];
+static void conv_(const Tensor *targ, const elm_t *main, const Tensor *t_main,
+    const elm_t *kernel, const Kernel *k_kernel) {
+    // lone convolution operation
+    const SimdOps *ops = simd_ops();
+    for (size_t row = 0; row < targ->m; row++) {
+        conv_row_(&targ->arr[row * targ->n], targ->n, main, t_main, kernel, k_kernel, row, ops);
+    }
+}
+
+static void pool_(elm_t *targ, const Tensor *t_targ, const elm_t *main, const Tensor *t_main, const Pooler *pooler) {
+    // dimension setup
+    const SimdOps *ops = simd_ops();
+    const size_t m_res = t_targ->m, n_res = t_targ->n, n = t_main->n;
+    const size_t m_stride = pooler->m_stride, n_stride = pooler->n_stride;
+
+    // lone pooling operation, one pooling element at a time across a whole output row
+    for (size_t row = 0; row < m_res; row++) {
+        elm_t *out = &targ[row * n_res];
+        const elm_t *first = &main[row * m_stride * n];
+        for (size_t col = 0; col < n_res; col++) out[col] = first[col * n_stride];
+        for (size_t row_k = 0; row_k < pooler->m; row_k++) {
+            const elm_t *src = &main[(row * m_stride + row_k) * n];
+            for (size_t col_k = 0; col_k < pooler->n; col_k++) {
+                ops->max_stride(out, &src[col_k], n_res, n_stride);
+            }
         }
     }
-    return res;
 }
 
-static elm_t max_pool_(const elm_t *mat, const Tensor *t_mat, const Pooler *pooler,
-    const size_t row, const size_t col) {
-    // max pool
-    elm_t res = mat[row * t_mat->n + col];
-    for (size_t row_k = 0; row_k < pooler->m; row_k++) {
-        for (size_t col_k = 0; col_k < pooler->n; col_k++) {
-            // max_pool
-            const elm_t elm = mat[(row + row_k) * t_mat->n + (col + col_k)];
-            if (elm > res) res = elm;
+static void im2col_(elm_t *col, const elm_t *main, const Tensor *t_main, const Kernel *k_kernel,
+    const size_t m_res, const size_t n_res) {
+    // lower every kernel window into a column, one row per kernel element
+    const size_t cols = m_res * n_res;
+    for (size_t mat = 0; mat < t_main->o; mat++) {
+        const elm_t *chan = &main[mat * t_main->m * t_main->n];
+        for (size_t row_k = 0; row_k < k_kernel->m; row_k++) {
+            for (size_t col_k = 0; col_k < k_kernel->n; col_k++) {
+                elm_t *dst = &col[((mat * k_kernel->m + row_k) * k_kernel->n + col_k) * cols];
+                for (size_t row = 0; row < m_res; row++) {
+                    const elm_t *src = &chan[(row * k_kernel->m_stride + row_k) * t_main->n + col_k];
+                    for (size_t c = 0; c < n_res; c++) {
+                        dst[row * n_res + c] = src[c * k_kernel->n_stride];
+                    }
+                }
+            }
         }
     }
-    return res;
 }
 
-static void matmul_(elm_t *targ, const elm_t *main, const Tensor *t_main, const elm_t *opp, const Tensor *t_opp) {
-    // lone matmul operation
-    for (size_t row = 0; row < t_main->m; row++) {
-        for (size_t col = 0; col < t_opp->n; col++) {
-            // sum row and col
-            targ[row * t_opp->n + col] = linear_sum_(&main[row * t_main->n], opp, t_opp, col);
+static bool conv_dims_(const size_t m, const size_t n, const size_t o, const Kernel *kernels,
+    size_t *m_res, size_t *n_res) {
+    // dimensionality check
+    if (o != kernels->o || m < kernels->m || n < kernels->n) {
+        fprintf(stderr, "Invalid convolution: oversized kernel or channels (%zu) != kernels (%zu).\n", o, kernels->o);
+        return false;
+    }
+
+    // result dimension setup
+    *m_res = (m - kernels->m) / kernels->m_stride + 1;
+    *n_res = (n - kernels->n) / kernels->n_stride + 1;
+    return true;
+}
+
+static bool pool_dims_(const size_t m, const size_t n, const Pooler *pooler, size_t *m_res, size_t *n_res) {
+    // dimensionality check
+    if (m < pooler->m || n < pooler->n) {
+        fprintf(stderr, "Invalid pooling: oversized pooling kernel.\n");
+        return false;
+    }
+
+    // result dimension setup
+    *m_res = (m - pooler->m) / pooler->m_stride + 1;
+    *n_res = (n - pooler->n) / pooler->n_stride + 1;
+    return true;
+}
+
+static bool layer_dims_(const Convolutional *kernels) {
+    // every kernel of a layer shares shape and stride
+    const Kernel *k_ref = kernels->kernels[0];
+    for (size_t kern = 1; kern < kernels->num; kern++) {
+        const Kernel *k_cur = kernels->kernels[kern];
+        if (k_cur->m != k_ref->m || k_cur->n != k_ref->n || k_cur->o != k_ref->o
+            || k_cur->m_stride != k_ref->m_stride || k_cur->n_stride != k_ref->n_stride) {
+            fprintf(stderr, "Invalid convolution: kernel %zu differs in shape or stride.\n", kern);
+            return false;
         }
     }
+    return true;
 }
 
-static void conv_(const Tensor *targ, const elm_t *main, const Tensor *t_main,
-    const elm_t *kernel, const Kernel *k_kernel) {
-    // lone convolution operation
-    for (size_t row = 0; row < targ->m; row++) {
-        for (size_t col = 0; col < targ->n; col++) {
-            // dot product
-            const size_t row_s = row * k_kernel->m_stride, col_s = col * k_kernel->n_stride;
-            targ->arr[row * targ->n + col] += cdot_(main, t_main, kernel, k_kernel, row_s, col_s) + k_kernel->bias;
+// row bands of a layer convolution split across the compute pool
+typedef struct {
+    Batch *res;
+    const Batch *channels;
+    const Convolutional *kernels;
+    const Pooler *pooler;
+    const elm_t *wino;
+    size_t bands;
+    elm_t *rows;
+    size_t rows_stride;
+} ConvSplit;
+
+static size_t bands_(const size_t workers, const size_t items, const size_t rows) {
+    // enough row bands per item to give every worker about two tasks
+    if (workers == 1) return 1;
+    const size_t bands = (2 * workers + items - 1) / items;
+    return bands < rows ? bands : rows;
+}
+
+static size_t conv_work_(const Batch *channels, const Convolutional *kernels, const size_t rows, const size_t cols) {
+    // multiply-adds of rows x cols outputs per kernel and item
+    const Kernel *k_ref = kernels->kernels[0];
+    return channels->b * kernels->num * rows * cols * channels->o * k_ref->m * k_ref->n;
+}
+
+static void conv_direct_task_(void *ctx, const size_t task, const size_t worker) {
+    (void)worker;
+    const ConvSplit *split = ctx;
+    const Batch *channels = split->channels;
+    const Convolutional *kernels = split->kernels;
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t m = channels->m, n = channels->n, o = channels->o;
+    const size_t m_res = split->res->m, n_res = split->res->n, num = kernels->num;
+
+    // item and output row band
+    const size_t img = task / split->bands, band = task % split->bands;
+    const size_t lo = m_res * band / split->bands, hi = m_res * (band + 1) / split->bands;
+
+    // every kernel over the same input rows while they are in cache
+    const SimdOps *ops = simd_ops();
+    const Tensor t_main = {.m=m, .n=n, .o=o, .arr=channels->arr};
+    const elm_t *main = &channels->arr[img * m * n * o];
+    elm_t *targ = &split->res->arr[img * num * m_res * n_res];
+    for (size_t row = lo; row < hi; row++) {
+        for (size_t kern = 0; kern < num; kern++) {
+            const Kernel *kernel = kernels->kernels[kern];
+            elm_t *out = &targ[(kern * m_res + row) * n_res];
+            memset(out, 0, n_res * sizeof(elm_t));
+            for (size_t pair = 0; pair < o; pair++) {
+                conv_row_(out, n_res, &main[pair * m * n], &t_main, &kernel->arr[pair * k_ref->m * k_ref->n], kernel,
+                    row, ops);
+            }
         }
     }
 }
 
-static void pool_(elm_t *targ, const Tensor *t_targ, const elm_t *main, const Tensor *t_main, const Pooler *pooler) {
-    // lone pooling operation
-    for (size_t row = 0; row < t_targ->m; row++) {
-        for (size_t col = 0; col < t_targ->n; col++) {
-            // max pool
-            const size_t row_s = row * pooler->m_stride, col_s = col * pooler->n_stride;
-            targ[row * t_targ->n + col] = max_pool_(main, t_main, pooler, row_s, col_s);
+static void conv_pool_task_(void *ctx, const size_t task, const size_t worker) {
+    const ConvSplit *split = ctx;
+    const Batch *channels = split->channels;
+    const Convolutional *kernels = split->kernels;
+    const Pooler *pooler = split->pooler;
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t m = channels->m, n = channels->n, o = channels->o;
+    const size_t m_res = split->res->m, n_res = split->res->n, num = kernels->num;
+    const size_t n_conv = (n - k_ref->n) / k_ref->n_stride + 1;
+
+    // item and pooled row band
+    const size_t img = task / split->bands, band = task % split->bands;
+    const size_t lo = m_res * band / split->bands, hi = m_res * (band + 1) / split->bands;
+
+    // per-worker convolution row buffer
+    elm_t *rows = &split->rows[worker * split->rows_stride];
+    const SimdOps *ops = simd_ops();
+    const Tensor t_main = {.m=m, .n=n, .o=o, .arr=channels->arr};
+    const Tensor t_rows = {.m=pooler->m, .n=n_conv, .o=1, .arr=rows};
+    const Tensor t_targ = {.m=1, .n=n_res, .o=1, .arr=split->res->arr};
+    const elm_t *main = &channels->arr[img * m * n * o];
+    for (size_t kern = 0; kern < num; kern++) {
+        const Kernel *kernel = kernels->kernels[kern];
+        elm_t *targ = &split->res->arr[(img * num + kern) * m_res * n_res];
+        for (size_t row = lo; row < hi; row++) {
+            // convolution rows under the pooling window
+            memset(rows, 0, pooler->m * n_conv * sizeof(elm_t));
+            for (size_t row_p = 0; row_p < pooler->m; row_p++) {
+                for (size_t pair = 0; pair < o; pair++) {
+                    conv_row_(&rows[row_p * n_conv], n_conv, &main[pair * m * n], &t_main,
+                        &kernel->arr[pair * k_ref->m * k_ref->n], kernel, row * pooler->m_stride + row_p, ops);
+                }
+            }
+            // pooled row
+            pool_(&targ[row * n_res], &t_targ, rows, &t_rows, pooler);
+        }
+    }
+}
+
+static void wino_kernel_(elm_t *u, const elm_t *g) {
+    // u = G g G^T, G = [1 0 0; 1/2 1/2 1/2; 1/2 -1/2 1/2; 0 0 1]
+    elm_t tmp[4][3];
+    for (size_t col = 0; col < 3; col++) {
+        const elm_t g0 = g[col], g1 = g[3 + col], g2 = g[6 + col];
+        tmp[0][col] = g0;
+        tmp[1][col] = (g0 + g1 + g2) * 0.5f;
+        tmp[2][col] = (g0 - g1 + g2) * 0.5f;
+        tmp[3][col] = g2;
+    }
+    for (size_t row = 0; row < 4; row++) {
+        const elm_t t0 = tmp[row][0], t1 = tmp[row][1], t2 = tmp[row][2];
+        u[row * 4] = t0;
+        u[row * 4 + 1] = (t0 + t1 + t2) * 0.5f;
+        u[row * 4 + 2] = (t0 - t1 + t2) * 0.5f;
+        u[row * 4 + 3] = t2;
+    }
+}
+
+static void wino_rows_(elm_t *t, const size_t width, const size_t cols, const elm_t *d0, const elm_t *d1,
+    const elm_t *d2, const elm_t *d3) {
+    // rows of B^T d over a whole tile row at once, B^T = [1 0 -1 0; 0 1 1 0; 0 -1 1 0; 0 1 0 -1]
+    for (size_t col = 0; col < cols; col++) {
+        t[col] = d0[col] - d2[col];
+        t[width + col] = d1[col] + d2[col];
+        t[2 * width + col] = d2[col] - d1[col];
+        t[3 * width + col] = d1[col] - d3[col];
+    }
+}
+
+static void wino_cols_(elm_t *v, const size_t ld_v, const elm_t *t, const size_t width) {
+    // v = (B^T d) B of the tile whose columns start at t; element e lands at v[e * ld_v]
+    for (size_t row = 0; row < 4; row++) {
+        const elm_t t0 = t[row * width], t1 = t[row * width + 1], t2 = t[row * width + 2], t3 = t[row * width + 3];
+        v[(row * 4) * ld_v] = t0 - t2;
+        v[(row * 4 + 1) * ld_v] = t1 + t2;
+        v[(row * 4 + 2) * ld_v] = t2 - t1;
+        v[(row * 4 + 3) * ld_v] = t1 - t3;
+    }
+}
+
+static void wino_output_(elm_t *y, const elm_t *acc, const size_t ld_acc) {
+    // y = A^T acc A, A^T = [1 1 1 0; 0 1 -1 -1]; element e read from acc[e * ld_acc]
+    elm_t tmp[2][4];
+    for (size_t col = 0; col < 4; col++) {
+        const elm_t a0 = acc[col * ld_acc], a1 = acc[(4 + col) * ld_acc];
+        const elm_t a2 = acc[(8 + col) * ld_acc], a3 = acc[(12 + col) * ld_acc];
+        tmp[0][col] = a0 + a1 + a2;
+        tmp[1][col] = a1 - a2 - a3;
+    }
+    for (size_t row = 0; row < 2; row++) {
+        y[row * 2] = tmp[row][0] + tmp[row][1] + tmp[row][2];
+        y[row * 2 + 1] = tmp[row][1] - tmp[row][2] - tmp[row][3];
+    }
+}
+
+static size_t wino_bands_(const size_t workers, const size_t items, const size_t tiles_m, const size_t tiles_n) {
+    // enough bands for the workers, and few enough tiles per band for the transforms to stay in cache
+    const size_t rows_max = WINO_BAND / tiles_n > 1 ? WINO_BAND / tiles_n : 1;
+    const size_t bands = bands_(workers, items, tiles_m);
+    const size_t cache_bands = (tiles_m + rows_max - 1) / rows_max;
+    return bands > cache_bands ? bands : cache_bands;
+}
+
+static size_t wino_stride_(const size_t o, const size_t num, const size_t tiles, const size_t tiles_n) {
+    // per-worker transformed input, accumulators, four transformed rows and a zero row, whole cache lines
+    const size_t line = ELM_ALIGN / sizeof(elm_t);
+    const size_t width = 2 * tiles_n + 2;
+    return ((o + num) * WINO_TILE * tiles + 5 * width + line - 1) / line * line;
+}
+
+static void conv_wino_task_(void *ctx, const size_t task, const size_t worker) {
+    const ConvSplit *split = ctx;
+    const Batch *channels = split->channels;
+    const Convolutional *kernels = split->kernels;
+    const size_t m = channels->m, n = channels->n, o = channels->o;
+    const size_t m_res = split->res->m, n_res = split->res->n, num = kernels->num;
+    const size_t tiles_m = (m_res + 1) / 2, tiles_n = (n_res + 1) / 2;
+
+    // item and tile row band
+    const size_t img = task / split->bands, band = task % split->bands;
+    const size_t lo = tiles_m * band / split->bands, hi = tiles_m * (band + 1) / split->bands;
+    const size_t tiles = (hi - lo) * tiles_n;
+
+    // per-worker transformed input and accumulators, tiles innermost; tile rows padded to width with zeros
+    const size_t width = 2 * tiles_n + 2;
+    elm_t *v = &split->rows[worker * split->rows_stride];
+    elm_t *acc = &v[o * WINO_TILE * tiles];
+    elm_t *t = &acc[num * WINO_TILE * tiles];
+    elm_t *zero = &t[4 * width];
+    memset(zero, 0, width * sizeof(elm_t));
+    const SimdOps *ops = simd_ops();
+    const elm_t *main = &channels->arr[img * m * n * o];
+
+    // input tiles, one tile row at a time: rows transformed across the full width, then every tile's columns
+    for (size_t pair = 0; pair < o; pair++) {
+        const elm_t *chan = &main[pair * m * n];
+        for (size_t tile_row = lo; tile_row < hi; tile_row++) {
+            const elm_t *d[4];
+            for (size_t row_d = 0; row_d < 4; row_d++) {
+                d[row_d] = tile_row * 2 + row_d < m ? &chan[(tile_row * 2 + row_d) * n] : zero;
+            }
+            wino_rows_(t, width, n, d[0], d[1], d[2], d[3]);
+            for (size_t row_t = 0; row_t < 4; row_t++) {
+                memset(&t[row_t * width + n], 0, (width - n) * sizeof(elm_t));
+            }
+            const size_t first = (tile_row - lo) * tiles_n;
+            for (size_t tile_col = 0; tile_col < tiles_n; tile_col++) {
+                wino_cols_(&v[pair * WINO_TILE * tiles + first + tile_col], tiles, &t[tile_col * 2], width);
+            }
+        }
+    }
+
+    // element-wise products, summed over input channels, one transform element at a time across the band
+    memset(acc, 0, num * WINO_TILE * tiles * sizeof(elm_t));
+    for (size_t kern = 0; kern < num; kern++) {
+        for (size_t pair = 0; pair < o; pair++) {
+            const elm_t *u = &split->wino[(kern * o + pair) * WINO_TILE];
+            for (size_t elm = 0; elm < WINO_TILE; elm++) {
+                ops->axpy(&acc[(kern * WINO_TILE + elm) * tiles], &v[(pair * WINO_TILE + elm) * tiles], u[elm],
+                    tiles);
+            }
+        }
+    }
+
+    // output tiles, clipped at odd edges; bias accumulated once per input channel as in conv_
+    for (size_t kern = 0; kern < num; kern++) {
+        const elm_t bias = kernels->kernels[kern]->bias * (elm_t)o;
+        elm_t *targ = &split->res->arr[(img * num + kern) * m_res * n_res];
+        for (size_t tile = 0; tile < tiles; tile++) {
+            const size_t row = (lo + tile / tiles_n) * 2, col = tile % tiles_n * 2;
+            elm_t y[4];
+            wino_output_(y, &acc[kern * WINO_TILE * tiles + tile], tiles);
+            if (row + 1 < m_res && col + 1 < n_res) {
+                targ[row * n_res + col] = y[0] + bias;
+                targ[row * n_res + col + 1] = y[1] + bias;
+                targ[(row + 1) * n_res + col] = y[2] + bias;
+                targ[(row + 1) * n_res + col + 1] = y[3] + bias;
+                continue;
+            }
+            for (size_t row_y = 0; row_y < 2 && row + row_y < m_res; row_y++) {
+                for (size_t col_y = 0; col_y < 2 && col + col_y < n_res; col_y++) {
+                    targ[(row + row_y) * n_res + col + col_y] = y[row_y * 2 + col_y] + bias;
+                }
+            }
         }
     }
 }
@@ -78,15 +380,16 @@ static void pool_(elm_t *targ, const Tensor *t_targ, const elm_t *main, const Te
 /*--------------------------------------------------------------------------------------------------------------------*/
 
 /**
- * Sums an array of same-shaped tensors together.
- * Caller is responsible for freeing returned tensor & array.
+ * Sums an array of same-shaped tensors together into a caller-provided tensor.
+ * res->arr must hold the result; res dimensions are set by the call. res may alias tensors[0].
  *
+ * @param res: result tensor.
  * @param tensors: array of tensors to be summed.
  * @param num: number of tensors to be summed.
  *
- * @return: Pointer to summed tensors. NULL with any misshaped tensors or malloc fail.
+ * @return: res. NULL with any misshaped tensors.
  */
-Tensor *sum(Tensor **tensors, const size_t num) {
+Tensor *sum_into(Tensor *res, Tensor **tensors, const size_t num) {
     // dimension setup
     const size_t m = tensors[0]->m;
     const size_t n = tensors[0]->n;
@@ -101,42 +404,55 @@ Tensor *sum(Tensor **tensors, const size_t num) {
         }
     }
 
-    // malloc
-    const size_t out_size = m * n * o;
-    elm_t *res_arr = malloc(out_size * sizeof(elm_t));
-    Tensor *res = malloc(sizeof(Tensor));
-    if (res_arr == NULL || res == NULL) {
-        // malloc fail
-        fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", m, n, o);
-        free(res_arr); free_tensor(res);
-        return NULL;
-    }
-
     // sum operation
-    memcpy(res_arr, tensors[0]->arr, out_size * sizeof(elm_t));
+    const size_t out_size = m * n * o;
+    if (res->arr != tensors[0]->arr) memcpy(res->arr, tensors[0]->arr, out_size * sizeof(elm_t));
     for (size_t itm = 1; itm < num; itm++) {
         for (size_t elm = 0; elm < out_size; elm++) {
             // value accumulation
-            res_arr[elm] += tensors[itm]->arr[elm];
+            res->arr[elm] += tensors[itm]->arr[elm];
         }
     }
 
     // struct setup
     res->m = m; res->n = n; res->o = o;
-    res->arr = res_arr;
     return res;
 }
 
 /**
- * Matrix multiplication of two tensors, treating the 3rd dimension as a batch.
+ * Sums an array of same-shaped tensors together.
  * Caller is responsible for freeing returned tensor & array.
  *
+ * @param tensors: array of tensors to be summed.
+ * @param num: number of tensors to be summed.
+ *
+ * @return: Pointer to summed tensors. NULL with any misshaped tensors or malloc fail.
+ */
+Tensor *sum(Tensor **tensors, const size_t num) {
+    // malloc
+    Tensor *res = make_tensor(tensors[0]->m, tensors[0]->n, tensors[0]->o);
+    if (res == NULL) return NULL;
+
+    // sum operation
+    if (sum_into(res, tensors, num) == NULL) {
+        free_tensor(res);
+        return NULL;
+    }
+    return res;
+}
+
+/**
+ * Matrix multiplication of two tensors into a caller-provided tensor, treating the 3rd dimension as a batch.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result tensor.
  * @param main: main tensor.
  * @param opp: opposite tensor.
+ * @param arena: arena for gemm packing buffers, or NULL to use the heap.
  *
- * @return: matmul of tensors. NULL with any dimensional mismatch, failed operation, or malloc fail.
+ * @return: res. NULL with any dimensional mismatch.
  */
-Tensor *matmul(const Tensor *main, const Tensor *opp) {
+Tensor *matmul_into(Tensor *res, const Tensor *main, const Tensor *opp, Arena *arena) {
     // dimension setup
     const size_t m = main->m;
     const size_t t = main->n;
@@ -150,73 +466,119 @@ Tensor *matmul(const Tensor *main, const Tensor *opp) {
         return NULL;
     }
 
-    // malloc
-    const size_t out_size = m * n * o;
-    elm_t *res_arr = malloc(out_size * sizeof(elm_t));
-    Tensor *res = malloc(sizeof(Tensor));
-    if (res_arr == NULL || res == NULL) {
-        // malloc fail
-        fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", m, n, o);
-        free(res_arr); free_tensor(res);
-        return NULL;
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    const size_t work_size = gemm_workspace(m, n, t);
+    elm_t *work = work_size != 0 ? arena_scratch(arena, work_size) : NULL;
+
+    // matmul operation
+    for (size_t mat = 0; mat < o; mat++) {
+        matmul_(&res->arr[m * mat * n], &main->arr[mat * m * t], main, &opp->arr[mat * t * n], opp, NULL, work);
     }
 
     // struct setup
+    if (work != NULL) arena_drop(arena, work, mark);
     res->m = m; res->n = n; res->o = o;
-    res->arr = res_arr;
+    return res;
+}
+
+/**
+ * Matrix multiplication of two tensors, treating the 3rd dimension as a batch.
+ * Caller is responsible for freeing returned tensor & array.
+ *
+ * @param main: main tensor.
+ * @param opp: opposite tensor.
+ *
+ * @return: matmul of tensors. NULL with any dimensional mismatch, failed operation, or malloc fail.
+ */
+Tensor *matmul(const Tensor *main, const Tensor *opp) {
+    // malloc
+    Tensor *res = make_tensor(main->m, opp->n, main->o);
+    if (res == NULL) return NULL;
 
     // matmul operation
-    for (size_t mat = 0; mat < o; mat++) {
-        matmul_(&res->arr[m * mat * n], &main->arr[mat * m * t], main, &opp->arr[mat * t * n],  opp);
+    if (matmul_into(res, main, opp, NULL) == NULL) {
+        free_tensor(res);
+        return NULL;
     }
     return res;
 }
 
 /**
- * Convolution of a batch of tensors with a same-sized batch of kernels.
- * Caller is responsible for freeing returned tensor & array.
+ * Convolution of a batch of tensors with a same-sized batch of kernels into a caller-provided tensor.
+ * res->arr must hold the result; res dimensions are set by the call.
  *
+ * @param res: result tensor.
  * @param channels: tensors to be convolved.
  * @param kernels: convolutional kernels.
  *
- * @return: convolved tensors. NULL with any dimensional mismatch, failed operation, or malloc fail.
+ * @return: res. NULL with any dimensional mismatch.
  */
-Tensor *conv(const Tensor *channels, const Kernel *kernels) {
+Tensor *conv_into(Tensor *res, const Tensor *channels, const Kernel *kernels) {
     // dimension setup
     const size_t m = channels->m;
     const size_t n = channels->n;
-    const size_t m_k = kernels->m;
-    const size_t n_k = kernels->n;
     const size_t o = channels->o;
+    size_t m_res, n_res;
+    if (!conv_dims_(m, n, o, kernels, &m_res, &n_res)) return NULL;
 
-    // dimensionality check
-    if (o != kernels->o || m < m_k || n < n_k) {
-        fprintf(stderr, "Invalid convolution: oversized kernel or channels (%zu) != kernels (%zu).\n", o, kernels->o);
-        return NULL;
+    // struct setup
+    res->m = m_res; res->n = n_res; res->o = 1;
+    memset(res->arr, 0, m_res * n_res * sizeof(elm_t));
+
+    // convolution operation
+    for (size_t pair = 0; pair < o; pair++) {
+        conv_(res, &channels->arr[pair * m * n], channels, &kernels->arr[pair * kernels->m * kernels->n], kernels);
     }
+    return res;
+}
 
+/**
+ * Convolution of a batch of tensors with a same-sized batch of kernels.
+ * Caller is responsible for freeing returned tensor & array.
+ *
+ * @param channels: tensors to be convolved.
+ * @param kernels: convolutional kernels.
+ *
+ * @return: convolved tensors. NULL with any dimensional mismatch, failed operation, or malloc fail.
+ */
+Tensor *conv(const Tensor *channels, const Kernel *kernels) {
     // result dimension setup
-    const size_t m_res = (m - m_k) / kernels->m_stride + 1;
-    const size_t n_res = (n - n_k) / kernels->n_stride + 1;
+    size_t m_res, n_res;
+    if (!conv_dims_(channels->m, channels->n, channels->o, kernels, &m_res, &n_res)) return NULL;
 
     // malloc
-    const size_t out_size = m_res * n_res;
-    elm_t *res_arr = calloc(out_size, sizeof(elm_t));
-    Tensor *res = malloc(sizeof(Tensor));
-    if (res_arr == NULL || res == NULL) {
-        // malloc fail
-        fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", m_res, n_res, (size_t)1);
-        free(res_arr); free_tensor(res);
-        return NULL;
-    }
+    Tensor *res = make_tensor(m_res, n_res, 1);
+    if (res == NULL) return NULL;
+
+    // convolution operation
+    conv_into(res, channels, kernels);
+    return res;
+}
+
+/**
+ * Max pooling of tensors into a caller-provided tensor.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result tensor.
+ * @param main: tensor to be pooled.
+ * @param pooler: pooling kernel.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Tensor *pool_into(Tensor *res, const Tensor *main, const Pooler *pooler) {
+    // dimension setup
+    const size_t m = main->m;
+    const size_t n = main->n;
+    size_t m_res, n_res;
+    if (!pool_dims_(m, n, pooler, &m_res, &n_res)) return NULL;
 
     // struct setup
-    res->m = m_res; res->n = n_res; res->o = 1;
-    res->arr = res_arr;
+    res->m = m_res; res->n = n_res; res->o = main->o;
 
-    // convolution operation
-    for (size_t pair = 0; pair < o; pair++) {
-        conv_(res, &channels->arr[pair * m * n], channels, &kernels->arr[pair * m_k * n_k], kernels);
+    // pooling operation
+    for (size_t mat = 0; mat < main->o; mat++) {
+        pool_(&res->arr[mat * m_res * n_res], res, &main->arr[mat * m * n], main, pooler);
     }
     return res;
 }
@@ -231,38 +593,777 @@ Tensor *conv(const Tensor *channels, const Kernel *kernels) {
  * @return: pooled tensors. NULL with any dimensional mismatch, failed operation, or malloc fail.
  */
 Tensor *pool(const Tensor *main, const Pooler *pooler) {
+    // result dimension setup
+    size_t m_res, n_res;
+    if (!pool_dims_(main->m, main->n, pooler, &m_res, &n_res)) return NULL;
+
+    // malloc
+    Tensor *res = make_tensor(m_res, n_res, main->o);
+    if (res == NULL) return NULL;
+
+    // pooling operation
+    pool_into(res, main, pooler);
+    return res;
+}
+
+/**
+ * Sums a tensor onto every item of a batch, into a caller-provided batch.
+ * res->arr must hold the result; res dimensions are set by the call. res may alias main.
+ *
+ * @param res: result batch.
+ * @param main: batch of tensors.
+ * @param opp: tensor added to each item.
+ *
+ * @return: res. NULL with any misshaped tensors.
+ */
+Batch *batch_sum_into(Batch *res, const Batch *main, const Tensor *opp) {
     // dimension setup
     const size_t m = main->m;
     const size_t n = main->n;
+    const size_t o = main->o;
+    const size_t b = main->b;
 
     // dimensionality check
-    if (main->m < pooler->m || main->n < pooler->n) {
-        fprintf(stderr, "Invalid pooling: oversized pooling kernel.\n");
+    if (m != opp->m || n != opp->n || o != opp->o) {
+        fprintf(stderr, "Dimension mismatch: m (%zu) != m (%zu) || n (%zu) != n (%zu) || o (%zu) != o (%zu).\n",
+            m, opp->m, n, opp->n, o, opp->o);
+        return NULL;
+    }
+
+    // sum operation
+    const size_t item_size = m * n * o;
+    for (size_t img = 0; img < b; img++) {
+        for (size_t elm = 0; elm < item_size; elm++) {
+            // value accumulation
+            res->arr[img * item_size + elm] = main->arr[img * item_size + elm] + opp->arr[elm];
+        }
+    }
+
+    // struct setup
+    res->m = m; res->n = n; res->o = o; res->b = b;
+    return res;
+}
+
+/**
+ * Sums a tensor onto every item of a batch.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param main: batch of tensors.
+ * @param opp: tensor added to each item.
+ *
+ * @return: Pointer to summed batch. NULL with any misshaped tensors or malloc fail.
+ */
+Batch *batch_sum(const Batch *main, const Tensor *opp) {
+    // malloc
+    Batch *res = make_batch(main->m, main->n, main->o, main->b);
+    if (res == NULL) return NULL;
+
+    // sum operation
+    if (batch_sum_into(res, main, opp) == NULL) {
+        free_batch(res);
         return NULL;
     }
+    return res;
+}
+
+/**
+ * Workspace elements batch_matmul_into takes from its arena.
+ *
+ * @param main: main batch.
+ * @param opp: opposite tensor.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_matmul_workspace(const Batch *main, const Tensor *opp) {
+    const size_t rows = main->o == 1 ? main->m * main->b : main->m;
+    return gemm_workspace(rows, opp->n, main->n);
+}
+
+/**
+ * Matrix multiplication of every item of a batch with a shared tensor into a caller-provided batch, treating the 3rd
+ * dimension as a batch. Single-matrix items are stacked into one tall matrix, so the batch runs as a single matmul.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param main: main batch.
+ * @param opp: opposite tensor.
+ * @param arena: arena for gemm packing buffers, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Batch *batch_matmul_into(Batch *res, const Batch *main, const Tensor *opp, Arena *arena) {
+    return batch_matmul_epilogue_into(res, main, opp, NULL, arena);
+}
+
+/**
+ * Matrix multiplication of every item of a batch with a shared tensor as batch_matmul_into, with a gemm epilogue
+ * applied to every result row as its tiles complete; see gemm_epilogue_ws.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param main: main batch.
+ * @param opp: opposite tensor.
+ * @param epi: opp->n column biases and element-wise activation, or NULL for a plain product.
+ * @param arena: arena for gemm packing buffers, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Batch *batch_matmul_epilogue_into(Batch *res, const Batch *main, const Tensor *opp, const GemmEpilogue *epi,
+    Arena *arena) {
+    // dimension setup
+    const size_t m = main->m;
+    const size_t t = main->n;
+    const size_t n = opp->n;
+    const size_t o = main->o;
+    const size_t b = main->b;
+
+    // dimensionality check
+    if (o != opp->o || t != opp->m) {
+        fprintf(stderr, "Dimensional mismatch: a_o (%zu) != b_o: (%zu) || a_n (%zu) != b_m (%zu).\n",
+            o, opp->o, t, opp->m);
+        return NULL;
+    }
+
+    // struct setup
+    res->m = m; res->n = n; res->o = o; res->b = b;
+
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    const size_t work_size = batch_matmul_workspace(main, opp);
+    elm_t *work = work_size != 0 ? arena_scratch(arena, work_size) : NULL;
 
+    // matmul operation
+    if (o == 1) {
+        // stacked items
+        const Tensor t_main = {.m=m * b, .n=t, .o=1, .arr=main->arr};
+        matmul_(res->arr, main->arr, &t_main, opp->arr, opp, epi, work);
+    } else {
+        const Tensor t_main = {.m=m, .n=t, .o=o, .arr=main->arr};
+        for (size_t img = 0; img < b; img++) {
+            for (size_t mat = 0; mat < o; mat++) {
+                const size_t pos = img * o + mat;
+                matmul_(&res->arr[pos * m * n], &main->arr[pos * m * t], &t_main, &opp->arr[mat * t * n], opp, epi,
+                    work);
+            }
+        }
+    }
+    if (work != NULL) arena_drop(arena, work, mark);
+    return res;
+}
+
+/**
+ * Matrix multiplication of every item of a flattened batch with prepacked weights, with a gemm epilogue, into a
+ * caller-provided batch. Items are stacked into one tall matrix as batch_matmul_into and the gemm kernel reads the
+ * weight panels in place; see gemm_packed_b_ws.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param main: batch of single-matrix items.
+ * @param opp: weights packed as a right operand.
+ * @param epi: opp->cols column biases and element-wise activation, or NULL for a plain product.
+ * @param arena: arena for gemm packing buffers, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Batch *batch_matmul_packed_into(Batch *res, const Batch *main, const PackedWeights *opp, const GemmEpilogue *epi,
+    Arena *arena) {
+    // dimensionality check
+    if (main->o != 1 || main->n != opp->rows) {
+        fprintf(stderr, "Dimensional mismatch: a_o (%zu) != 1 || a_n (%zu) != b_m (%zu).\n", main->o, main->n,
+            opp->rows);
+        return NULL;
+    }
+
+    // struct setup
+    res->m = main->m; res->n = opp->cols; res->o = 1; res->b = main->b;
+
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    const size_t work_size = gemm_workspace(main->m * main->b, opp->cols, opp->rows);
+    elm_t *work = work_size != 0 ? arena_scratch(arena, work_size) : NULL;
+
+    // stacked items
+    gemm_packed_b_ws(res->arr, main->arr, opp, main->m * main->b, epi, work);
+    if (work != NULL) arena_drop(arena, work, mark);
+    return res;
+}
+
+/**
+ * Matrix multiplication of every item of a batch with a shared tensor, treating the 3rd dimension as a batch.
+ * Single-matrix items are stacked into one tall matrix, so the batch runs as a single matmul.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param main: main batch.
+ * @param opp: opposite tensor.
+ *
+ * @return: matmul of batch. NULL with any dimensional mismatch, failed operation, or malloc fail.
+ */
+Batch *batch_matmul(const Batch *main, const Tensor *opp) {
+    // malloc
+    Batch *res = make_batch(main->m, opp->n, main->o, main->b);
+    if (res == NULL) return NULL;
+
+    // matmul operation
+    if (batch_matmul_into(res, main, opp, NULL) == NULL) {
+        free_batch(res);
+        return NULL;
+    }
+    return res;
+}
+
+/**
+ * Convolution of every item of a batch with a same-sized batch of kernels into a caller-provided batch.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional kernels.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Batch *batch_conv_into(Batch *res, const Batch *channels, const Kernel *kernels) {
+    // dimension setup
+    const size_t m = channels->m;
+    const size_t n = channels->n;
+    const size_t o = channels->o;
+    const size_t b = channels->b;
+    size_t m_res, n_res;
+    if (!conv_dims_(m, n, o, kernels, &m_res, &n_res)) return NULL;
+
+    // struct setup
+    res->m = m_res; res->n = n_res; res->o = 1; res->b = b;
+    memset(res->arr, 0, m_res * n_res * b * sizeof(elm_t));
+
+    // convolution operation
+    const Tensor t_main = {.m=m, .n=n, .o=o, .arr=channels->arr};
+    for (size_t img = 0; img < b; img++) {
+        const Tensor targ = {.m=m_res, .n=n_res, .o=1, .arr=&res->arr[img * m_res * n_res]};
+        const elm_t *main = &channels->arr[img * m * n * o];
+        for (size_t pair = 0; pair < o; pair++) {
+            conv_(&targ, &main[pair * m * n], &t_main, &kernels->arr[pair * kernels->m * kernels->n], kernels);
+        }
+    }
+    return res;
+}
+
+/**
+ * Convolution of every item of a batch with a same-sized batch of kernels.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional kernels.
+ *
+ * @return: convolved batch. NULL with any dimensional mismatch, failed operation, or malloc fail.
+ */
+Batch *batch_conv(const Batch *channels, const Kernel *kernels) {
+    // result dimension setup
+    size_t m_res, n_res;
+    if (!conv_dims_(channels->m, channels->n, channels->o, kernels, &m_res, &n_res)) return NULL;
+
+    // malloc
+    Batch *res = make_batch(m_res, n_res, 1, channels->b);
+    if (res == NULL) return NULL;
+
+    // convolution operation
+    batch_conv_into(res, channels, kernels);
+    return res;
+}
+
+/**
+ * Max pooling of every item of a batch into a caller-provided batch.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param main: batch to be pooled.
+ * @param pooler: pooling kernel.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Batch *batch_pool_into(Batch *res, const Batch *main, const Pooler *pooler) {
+    // dimension setup
+    const size_t m = main->m;
+    const size_t n = main->n;
+    const size_t o = main->o;
+    const size_t b = main->b;
+    size_t m_res, n_res;
+    if (!pool_dims_(m, n, pooler, &m_res, &n_res)) return NULL;
+
+    // struct setup
+    res->m = m_res; res->n = n_res; res->o = o; res->b = b;
+
+    // pooling operation
+    const Tensor t_main = {.m=m, .n=n, .o=o, .arr=main->arr};
+    const Tensor t_targ = {.m=m_res, .n=n_res, .o=o, .arr=res->arr};
+    for (size_t mat = 0; mat < o * b; mat++) {
+        pool_(&res->arr[mat * m_res * n_res], &t_targ, &main->arr[mat * m * n], &t_main, pooler);
+    }
+    return res;
+}
+
+/**
+ * Max pooling of every item of a batch.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param main: batch to be pooled.
+ * @param pooler: pooling kernel.
+ *
+ * @return: pooled batch. NULL with any dimensional mismatch, failed operation, or malloc fail.
+ */
+Batch *batch_pool(const Batch *main, const Pooler *pooler) {
     // result dimension setup
-    const size_t m_res = (main->m - pooler->m) / pooler->m_stride + 1;
-    const size_t n_res = (main->n - pooler->n) / pooler->n_stride + 1;
+    size_t m_res, n_res;
+    if (!pool_dims_(main->m, main->n, pooler, &m_res, &n_res)) return NULL;
 
     // malloc
-    const size_t out_size = m_res * n_res * main->o;
-    elm_t *res_arr = malloc(out_size * sizeof(elm_t));
-    Tensor *res = malloc(sizeof(Tensor));
-    if (res_arr == NULL || res == NULL) {
+    Batch *res = make_batch(m_res, n_res, main->o, main->b);
+    if (res == NULL) return NULL;
+
+    // pooling operation
+    batch_pool_into(res, main, pooler);
+    return res;
+}
+
+/**
+ * Output shape of a convolutional layer over a batch. Only dimensions are set; arr is NULL.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ *
+ * @return: result shape. b = 0 with any dimensional mismatch.
+ */
+Batch batch_conv_shape(const Batch *channels, const Convolutional *kernels) {
+    Batch shape = {.m=0, .n=0, .o=kernels->num, .b=0, .arr=NULL};
+    if (layer_dims_(kernels) && conv_dims_(channels->m, channels->n, channels->o, kernels->kernels[0],
+        &shape.m, &shape.n)) {
+        shape.b = channels->b;
+    }
+    return shape;
+}
+
+/**
+ * Output shape of max pooling over a batch. Only dimensions are set; arr is NULL.
+ *
+ * @param main: batch to be pooled.
+ * @param pooler: pooling kernel.
+ *
+ * @return: result shape. b = 0 with any dimensional mismatch.
+ */
+Batch batch_pool_shape(const Batch *main, const Pooler *pooler) {
+    Batch shape = {.m=0, .n=0, .o=main->o, .b=0, .arr=NULL};
+    if (pool_dims_(main->m, main->n, pooler, &shape.m, &shape.n)) shape.b = main->b;
+    return shape;
+}
+
+/**
+ * Direct convolution of every item of a batch with a full convolutional layer into a caller-provided batch. Each output
+ * channel is written straight into its slice of res; for every output row, all kernels run over the same input rows
+ * while they are in cache. Matches batch_conv + batch_combine of the same layer.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ *
+ * @return: res. NULL with any dimensional mismatch.
+ */
+Batch *batch_conv_direct_into(Batch *res, const Batch *channels, const Convolutional *kernels) {
+    // dimension setup
+    const size_t b = channels->b;
+    const size_t num = kernels->num;
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != b) return NULL;
+    const size_t m_res = shape.m, n_res = shape.n;
+
+    // struct setup
+    res->m = m_res; res->n = n_res; res->o = num; res->b = b;
+
+    // convolution operation, split into item row bands above the parallel threshold
+    const size_t workers = compute_workers(conv_work_(channels, kernels, m_res, n_res));
+    ConvSplit split = {.res=res, .channels=channels, .kernels=kernels, .bands=bands_(workers, b, m_res)};
+    thread_pool_run(workers > 1 ? compute_pool() : NULL, b * split.bands, conv_direct_task_, &split);
+    return res;
+}
+
+/**
+ * Direct convolution of every item of a batch with a full convolutional layer. See batch_conv_direct_into.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ *
+ * @return: convolved batch with one channel per kernel. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_direct(const Batch *channels, const Convolutional *kernels) {
+    // result dimension setup
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != channels->b) return NULL;
+
+    // malloc
+    Batch *res = make_batch(shape.m, shape.n, shape.o, shape.b);
+    if (res == NULL) return NULL;
+
+    // convolution operation
+    batch_conv_direct_into(res, channels, kernels);
+    return res;
+}
+
+/**
+ * Workspace elements batch_conv_im2col_into takes from its arena.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_conv_im2col_workspace(const Batch *channels, const Convolutional *kernels) {
+    const Batch shape = batch_conv_shape(channels, kernels);
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t rows = channels->o * k_ref->m * k_ref->n;
+    const size_t cols = shape.m * shape.n;
+    return arena_bytes(kernels->num * rows) / sizeof(elm_t) + arena_bytes(rows * cols) / sizeof(elm_t)
+        + gemm_workspace(kernels->num, cols, rows);
+}
+
+/**
+ * Convolution of every item of a batch with a full convolutional layer, lowered to a matrix multiplication, into a
+ * caller-provided batch. Each item is unrolled into a column matrix once, and all output channels come from a single
+ * matmul with the stacked kernels. Matches batch_conv + batch_combine, including the per-channel bias accumulation.
+ * Layers prepacked at load (see pack_layers) skip stacking, are read from their panels in place and have their
+ * biases added in the gemm epilogue.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ * @param arena: arena for the column matrix, stacked kernels and gemm packing, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_im2col_into(Batch *res, const Batch *channels, const Convolutional *kernels, Arena *arena) {
+    // dimension setup
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t m = channels->m;
+    const size_t n = channels->n;
+    const size_t o = channels->o;
+    const size_t b = channels->b;
+    const size_t num = kernels->num;
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != b) return NULL;
+    const size_t m_res = shape.m, n_res = shape.n;
+    const size_t rows = o * k_ref->m * k_ref->n;
+    const size_t cols = m_res * n_res;
+
+    // prepacked layer
+    const PackedWeights *packed = kernels->packed;
+    if (packed != NULL && (packed->rows != num || packed->cols != rows)) packed = NULL;
+
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    const size_t work_size = gemm_workspace(num, cols, rows);
+    elm_t *weights = packed == NULL ? arena_scratch(arena, num * rows) : NULL;
+    elm_t *col = arena_scratch(arena, rows * cols);
+    elm_t *work = work_size != 0 ? arena_scratch(arena, work_size) : NULL;
+    if ((packed == NULL && weights == NULL) || col == NULL || (work_size != 0 && work == NULL)) {
         // malloc fail
-        fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", m_res, n_res, (size_t)1);
-        free(res_arr); free_tensor(res);
+        fprintf(stderr, "Failed malloc: im2col workspace sized %zu x %zu.\n", rows, cols);
+        if (work != NULL) arena_drop(arena, work, mark);
+        if (col != NULL) arena_drop(arena, col, mark);
+        if (weights != NULL) arena_drop(arena, weights, mark);
         return NULL;
     }
 
     // struct setup
-    res->m = m_res; res->n = n_res; res->o = main->o;
-    res->arr = res_arr;
+    res->m = m_res; res->n = n_res; res->o = num; res->b = b;
 
-    // pooling operation
-    for (size_t mat = 0; mat < main->o; mat++) {
-        pool_(&res->arr[mat * m_res * n_res], res, &main->arr[mat * m * n], main, pooler);
+    // convolution operation
+    const Tensor t_main = {.m=m, .n=n, .o=o, .arr=channels->arr};
+    if (packed != NULL) {
+        // kernel-bias vector, bias accumulated once per input channel as in conv_
+        const GemmEpilogue epi = {.row_bias=packed->bias};
+        for (size_t img = 0; img < b; img++) {
+            im2col_(col, &channels->arr[img * m * n * o], &t_main, k_ref, m_res, n_res);
+            gemm_packed_a_ws(&res->arr[img * num * cols], packed, col, cols, &epi, work);
+        }
+        if (work != NULL) arena_drop(arena, work, mark);
+        arena_drop(arena, col, mark);
+        return res;
+    }
+
+    // stack kernels into a num x rows matrix
+    for (size_t kern = 0; kern < num; kern++) {
+        memcpy(&weights[kern * rows], kernels->kernels[kern]->arr, rows * sizeof(elm_t));
+    }
+    const Tensor t_weights = {.m=num, .n=rows, .o=1, .arr=weights};
+    const Tensor t_col = {.m=rows, .n=cols, .o=1, .arr=col};
+    for (size_t img = 0; img < b; img++) {
+        elm_t *targ = &res->arr[img * num * cols];
+        im2col_(col, &channels->arr[img * m * n * o], &t_main, k_ref, m_res, n_res);
+        matmul_(targ, weights, &t_weights, col, &t_col, NULL, work);
+        // bias, accumulated once per input channel as in conv_
+        for (size_t kern = 0; kern < num; kern++) {
+            const elm_t bias = kernels->kernels[kern]->bias * (elm_t)o;
+            for (size_t elm = 0; elm < cols; elm++) targ[kern * cols + elm] += bias;
+        }
+    }
+
+    // free and return
+    if (work != NULL) arena_drop(arena, work, mark);
+    arena_drop(arena, col, mark);
+    arena_drop(arena, weights, mark);
+    return res;
+}
+
+/**
+ * Convolution of every item of a batch with a full convolutional layer, lowered to a matrix multiplication.
+ * See batch_conv_im2col_into.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ *
+ * @return: convolved batch with one channel per kernel. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_im2col(const Batch *channels, const Convolutional *kernels) {
+    // result dimension setup
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != channels->b) return NULL;
+
+    // malloc
+    Batch *res = make_batch(shape.m, shape.n, shape.o, shape.b);
+    if (res == NULL) return NULL;
+
+    // convolution operation
+    if (batch_conv_im2col_into(res, channels, kernels, NULL) == NULL) {
+        free_batch(res);
+        return NULL;
+    }
+    return res;
+}
+
+/**
+ * Workspace elements batch_conv_pool_into takes from its arena.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ * @param pooler: pooling kernel.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_conv_pool_workspace(const Batch *channels, const Convolutional *kernels, const Pooler *pooler) {
+    const Batch conv_shape = batch_conv_shape(channels, kernels);
+    const Batch shape = batch_pool_shape(&conv_shape, pooler);
+    const size_t workers = compute_workers(conv_work_(channels, kernels, shape.m * pooler->m, conv_shape.n));
+    // one cache-line aligned row buffer per worker
+    const size_t line = ELM_ALIGN / sizeof(elm_t);
+    return (pooler->m * conv_shape.n + line - 1) / line * line * workers;
+}
+
+/**
+ * Convolution of every item of a batch with a full convolutional layer, fused with max pooling, into a
+ * caller-provided batch. For every pooled row, only the convolution rows under the pooling window are computed, into
+ * a small buffer that stays in cache; the full convolution output is never materialized.
+ * Matches batch_pool on batch_conv + batch_combine of the same layer.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ * @param pooler: pooling kernel.
+ * @param arena: arena for the convolution row buffer, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_pool_into(Batch *res, const Batch *channels, const Convolutional *kernels, const Pooler *pooler,
+    Arena *arena) {
+    // dimension setup
+    const size_t b = channels->b;
+    const size_t num = kernels->num;
+    const Batch conv_shape = batch_conv_shape(channels, kernels);
+    if (conv_shape.b != b) return NULL;
+    const Batch shape = batch_pool_shape(&conv_shape, pooler);
+    if (shape.b != b) return NULL;
+    const size_t n_conv = conv_shape.n;
+    const size_t m_res = shape.m, n_res = shape.n;
+
+    // workspace, one row buffer per worker
+    const size_t workers = compute_workers(conv_work_(channels, kernels, m_res * pooler->m, n_conv));
+    const size_t line = ELM_ALIGN / sizeof(elm_t);
+    const size_t stride = (pooler->m * n_conv + line - 1) / line * line;
+    const size_t mark = arena != NULL ? arena->used : 0;
+    elm_t *rows = arena_scratch(arena, stride * workers);
+    if (rows == NULL) {
+        fprintf(stderr, "Failed malloc: conv pool row buffer sized %zu x %zu.\n", pooler->m, n_conv);
+        return NULL;
+    }
+
+    // struct setup
+    res->m = m_res; res->n = n_res; res->o = num; res->b = b;
+
+    // fused operation, split into item row bands above the parallel threshold
+    ConvSplit split = {.res=res, .channels=channels, .kernels=kernels, .pooler=pooler,
+        .bands=bands_(workers, b, m_res), .rows=rows, .rows_stride=stride};
+    thread_pool_run(workers > 1 ? compute_pool() : NULL, b * split.bands, conv_pool_task_, &split);
+
+    // free and return
+    arena_drop(arena, rows, mark);
+    return res;
+}
+
+/**
+ * Convolution of every item of a batch with a full convolutional layer, fused with max pooling.
+ * See batch_conv_pool_into.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ * @param pooler: pooling kernel.
+ *
+ * @return: pooled convolution with one channel per kernel. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_pool(const Batch *channels, const Convolutional *kernels, const Pooler *pooler) {
+    // result dimension setup
+    const Batch conv_shape = batch_conv_shape(channels, kernels);
+    if (conv_shape.b != channels->b) return NULL;
+    const Batch shape = batch_pool_shape(&conv_shape, pooler);
+    if (shape.b != channels->b) return NULL;
+
+    // malloc
+    Batch *res = make_batch(shape.m, shape.n, shape.o, shape.b);
+    if (res == NULL) return NULL;
+
+    // fused operation
+    if (batch_conv_pool_into(res, channels, kernels, pooler, NULL) == NULL) {
+        free_batch(res);
+        return NULL;
+    }
+    return res;
+}
+
+/**
+ * Whether a convolutional layer can run as winograd F(2x2, 3x3): 3x3 kernels with stride 1.
+ *
+ * @param kernels: convolutional layer.
+ *
+ * @return: 1 if batch_conv_winograd_into accepts the layer; 0 otherwise.
+ */
+int batch_conv_winograd_fits(const Convolutional *kernels) {
+    const Kernel *k_ref = kernels->kernels[0];
+    return k_ref->m == 3 && k_ref->n == 3 && k_ref->m_stride == 1 && k_ref->n_stride == 1 && layer_dims_(kernels);
+}
+
+/**
+ * Winograd transform of a layer's kernels, 16 elements per kernel and input channel, into a caller-provided array.
+ * Computed once per layer and reused by every batch_conv_winograd_into call.
+ *
+ * @param res: num x o x 16 elements.
+ * @param kernels: convolutional layer that fits batch_conv_winograd_fits.
+ *
+ * @return: res.
+ */
+elm_t *winograd_kernels_into(elm_t *res, const Convolutional *kernels) {
+    const size_t o = kernels->kernels[0]->o;
+    for (size_t kern = 0; kern < kernels->num; kern++) {
+        for (size_t pair = 0; pair < o; pair++) {
+            wino_kernel_(&res[(kern * o + pair) * WINO_TILE], &kernels->kernels[kern]->arr[pair * 9]);
+        }
     }
     return res;
 }
+
+/**
+ * Winograd transform of a layer's kernels. See winograd_kernels_into.
+ * Caller is responsible for freeing returned array with free.
+ *
+ * @param kernels: convolutional layer that fits batch_conv_winograd_fits.
+ *
+ * @return: num x o x 16 transformed kernels. NULL for a layer that does not fit or malloc fail.
+ */
+elm_t *winograd_kernels(const Convolutional *kernels) {
+    if (!batch_conv_winograd_fits(kernels)) return NULL;
+    elm_t *res = alloc_arr(kernels->num * kernels->kernels[0]->o * WINO_TILE);
+    if (res == NULL) {
+        fprintf(stderr, "Failed malloc: winograd kernels of %zu kernels.\n", kernels->num);
+        return NULL;
+    }
+    return winograd_kernels_into(res, kernels);
+}
+
+/**
+ * Workspace elements batch_conv_winograd_into takes from its arena.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ * @param transformed: kernels from winograd_kernels, or NULL to have them transformed per call.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_conv_winograd_workspace(const Batch *channels, const Convolutional *kernels, const elm_t *transformed) {
+    const Batch shape = batch_conv_shape(channels, kernels);
+    const size_t tiles_m = (shape.m + 1) / 2, tiles_n = (shape.n + 1) / 2;
+    const size_t workers = compute_workers(conv_work_(channels, kernels, shape.m, shape.n));
+    const size_t bands = wino_bands_(workers, channels->b, tiles_m, tiles_n);
+    // one buffer per worker, sized for the tallest band
+    const size_t tiles = (tiles_m + bands - 1) / bands * tiles_n;
+    const size_t stride = wino_stride_(channels->o, kernels->num, tiles, tiles_n);
+    const size_t own = transformed == NULL ? arena_bytes(kernels->num * channels->o * WINO_TILE) / sizeof(elm_t) : 0;
+    return stride * workers + own;
+}
+
+/**
+ * Winograd F(2x2, 3x3) convolution of every item of a batch with a full convolutional layer of 3x3 stride-1 kernels,
+ * into a caller-provided batch. Each 4x4 input tile is transformed once and shared by every kernel; a 2x2 output tile
+ * then takes 16 multiplies per input channel instead of 36. Matches batch_conv_direct_into to rounding, including the
+ * per-channel bias accumulation.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer that fits batch_conv_winograd_fits.
+ * @param transformed: kernels from winograd_kernels, or NULL to transform them per call.
+ * @param arena: arena for the tile buffers, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch, a layer that does not fit or malloc fail.
+ */
+Batch *batch_conv_winograd_into(Batch *res, const Batch *channels, const Convolutional *kernels,
+    const elm_t *transformed, Arena *arena) {
+    // dimension setup
+    const size_t b = channels->b;
+    const size_t num = kernels->num;
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != b) return NULL;
+    if (!batch_conv_winograd_fits(kernels)) {
+        fprintf(stderr, "Invalid winograd convolution: kernels are not 3x3 with stride 1.\n");
+        return NULL;
+    }
+    const size_t m_res = shape.m, n_res = shape.n;
+    const size_t tiles_m = (m_res + 1) / 2, tiles_n = (n_res + 1) / 2;
+
+    // workspace, one tile buffer per worker
+    const size_t workers = compute_workers(conv_work_(channels, kernels, m_res, n_res));
+    const size_t bands = wino_bands_(workers, b, tiles_m, tiles_n);
+    const size_t tiles = (tiles_m + bands - 1) / bands * tiles_n;
+    const size_t stride = wino_stride_(channels->o, num, tiles, tiles_n);
+    const size_t mark = arena != NULL ? arena->used : 0;
+    elm_t *own = transformed == NULL ? arena_scratch(arena, num * channels->o * WINO_TILE) : NULL;
+    elm_t *rows = arena_scratch(arena, stride * workers);
+    if ((transformed == NULL && own == NULL) || rows == NULL) {
+        fprintf(stderr, "Failed malloc: winograd tile buffer sized %zu x %zu.\n", stride, workers);
+        if (rows != NULL) arena_drop(arena, rows, mark);
+        if (own != NULL) arena_drop(arena, own, mark);
+        return NULL;
+    }
+    if (transformed == NULL) transformed = winograd_kernels_into(own, kernels);
+
+    // struct setup
+    res->m = m_res; res->n = n_res; res->o = num; res->b = b;
+
+    // convolution operation, split into item tile row bands
+    ConvSplit split = {.res=res, .channels=channels, .kernels=kernels, .wino=transformed, .bands=bands, .rows=rows,
+        .rows_stride=stride};
+    thread_pool_run(workers > 1 ? compute_pool() : NULL, b * bands, conv_wino_task_, &split);
+
+    // free and return
+    arena_drop(arena, rows, mark);
+    if (own != NULL) arena_drop(arena, own, mark);
+    return res;
+}
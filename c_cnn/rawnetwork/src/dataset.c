@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "dataset.h"
+
+// packed dataset layout, all fields little-endian u64:
+//   header (64 bytes): magic, version, count, m, n, o, stride (bytes per image record), labels offset (bytes)
+//   images: count records from byte 64, each m x n x o float32 values, zero padded to stride (a multiple of 64)
+//   labels: count u64 values at labels offset
+#define DATASET_MAGIC "CNNDATA"
+#define DATASET_VERSION 1
+#define DATASET_HEADER 64
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static int layout_ok_(const size_t *header, const size_t map_size) {
+    // nonzero dims, records and labels within the mapping; bounded by division, so no product below overflows
+    const size_t count = header[2], m = header[3], n = header[4], o = header[5];
+    const size_t stride = header[6], labels_off = header[7];
+    if (m == 0 || n == 0 || o == 0 || m > map_size / n || m * n > map_size / o
+        || m * n * o > map_size / sizeof(elm_t)) {
+        return 0;
+    }
+    return stride % ELM_ALIGN == 0 && stride >= m * n * o * sizeof(elm_t) && labels_off % sizeof(size_t) == 0
+        && labels_off >= DATASET_HEADER && labels_off <= map_size && count <= (labels_off - DATASET_HEADER) / stride
+        && count <= (map_size - labels_off) / sizeof(size_t);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Memory-maps a packed dataset file. Images and labels are used in place; nothing is copied.
+ * Caller is responsible for closing returned dataset with close_dataset.
+ *
+ * @param filename: packed dataset file, see py_cnn/helpers.py write_dataset.
+ *
+ * @return: mapped dataset. NULL for open, map or format fail.
+ */
+Dataset *open_dataset(const char *filename) {
+    // get file descriptor
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed opening file: %s.\n", filename);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < DATASET_HEADER) {
+        fprintf(stderr, "Invalid dataset: %s too small.\n", filename);
+        close(fd); return NULL;
+    }
+
+    // map whole file, read-only
+    const size_t map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed mmap: %s.\n", filename);
+        return NULL;
+    }
+
+    // header check
+    const size_t *header = map;
+    const size_t count = header[2], m = header[3], n = header[4], o = header[5];
+    const size_t stride = header[6], labels_off = header[7];
+    if (memcmp(map, DATASET_MAGIC, sizeof(DATASET_MAGIC)) != 0 || header[1] != DATASET_VERSION) {
+        fprintf(stderr, "Invalid dataset: %s has bad magic or version.\n", filename);
+        munmap(map, map_size); return NULL;
+    }
+    if (!layout_ok_(header, map_size)) {
+        fprintf(stderr, "Invalid dataset: %s has inconsistent layout.\n", filename);
+        munmap(map, map_size); return NULL;
+    }
+
+    // malloc
+    Dataset *dataset = malloc(sizeof(Dataset));
+    if (dataset == NULL) {
+        fprintf(stderr, "Failed malloc: Dataset.\n");
+        munmap(map, map_size); return NULL;
+    }
+
+    // struct setup
+    dataset->map = map; dataset->map_size = map_size;
+    dataset->count = count;
+    dataset->m = m; dataset->n = n; dataset->o = o;
+    dataset->stride = stride;
+    dataset->images = (const elm_t *)((const char *)map + DATASET_HEADER);
+    dataset->labels = (const size_t *)((const char *)map + labels_off);
+    return dataset;
+}
+
+/**
+ * Unmaps a dataset and frees its struct. Views handed out by the dataset become invalid. If dataset is NULL, passes.
+ *
+ * @param dataset: dataset to be closed.
+ */
+void close_dataset(Dataset *dataset) {
+    if (dataset == NULL) return;
+    munmap(dataset->map, dataset->map_size);
+    free(dataset);
+}
+
+/**
+ * Views a single image of a dataset as a tensor, without copying. The view is read-only.
+ *
+ * @param dataset: dataset.
+ * @param idx: image index, below dataset->count.
+ *
+ * @return: tensor view of the image.
+ */
+Tensor dataset_image(const Dataset *dataset, const size_t idx) {
+    const char *record = (const char *)dataset->images + idx * dataset->stride;
+    const Tensor view = {.m=dataset->m, .n=dataset->n, .o=dataset->o, .arr=(elm_t *)record};
+    return view;
+}
+
+/**
+ * Gets the label of a single image of a dataset.
+ *
+ * @param dataset: dataset.
+ * @param idx: image index.
+ *
+ * @return: label. (size_t) - 1 for an out of range index.
+ */
+size_t dataset_label(const Dataset *dataset, const size_t idx) {
+    if (idx >= dataset->count) {
+        fprintf(stderr, "Invalid dataset index: %zu >= %zu.\n", idx, dataset->count);
+        return (size_t) - 1;
+    }
+    return dataset->labels[idx];
+}
+
+/**
+ * Views a run of consecutive images as a batch, without copying. Only possible when records are unpadded, i.e. the
+ * record stride equals the image size. The view is read-only.
+ *
+ * @param dataset: dataset.
+ * @param start: first image index.
+ * @param num: number of images.
+ * @param batch: batch view, set on success.
+ *
+ * @return: 1 for a batch view; 0 when records are padded or the range is out of bounds.
+ */
+int dataset_batch(const Dataset *dataset, const size_t start, const size_t num, Batch *batch) {
+    if (dataset->stride != dataset->m * dataset->n * dataset->o * sizeof(elm_t) || start + num > dataset->count) {
+        return 0;
+    }
+    const Tensor first = dataset_image(dataset, start);
+    batch->m = dataset->m; batch->n = dataset->n; batch->o = dataset->o; batch->b = num;
+    batch->arr = first.arr;
+    return 1;
+}
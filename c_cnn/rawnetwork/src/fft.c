@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "types.h"
+#include "functional.h"
+#include "computational.h"
+#include "arena.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "fft.h"
+
+// flops of one radix-2 butterfly on split complex values and of one complex multiply-add; measured, these run at
+// about a third of the rate of direct convolution multiply-adds
+#define FFT_BUTTERFLY 5
+#define FFT_CMAC 4
+#define FFT_RATE 3
+#define FFT_PI 3.14159265358979323846
+
+// frequency-domain layer convolution, split across the compute pool in two phases
+typedef struct {
+    Batch *res;
+    const Batch *channels;
+    const Convolutional *kernels;
+    const FftKernels *spectra;
+    elm_t *inputs;
+    elm_t *bufs;
+    size_t bufs_stride;
+} FftSplit;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static size_t pow2_(const size_t size) {
+    size_t res = 1;
+    while (res < size) res *= 2;
+    return res;
+}
+
+static size_t log2_(size_t size) {
+    size_t res = 0;
+    while (size > 1) {
+        size /= 2;
+        res++;
+    }
+    return res;
+}
+
+static void fft_lanes_(elm_t *re, elm_t *im, const size_t len, const size_t lanes, const FftKernels *fk,
+    const int inverse) {
+    // in-place radix-2 transform of len rows, every butterfly applied across lanes contiguous values at once
+    const size_t tw_len = fk->m > fk->n ? fk->m : fk->n;
+    const elm_t *tw_re = fk->twiddles, *tw_im = &fk->twiddles[tw_len / 2];
+
+    // bit-reversed row order
+    for (size_t row = 1, rev = 0; row < len; row++) {
+        size_t bit = len >> 1;
+        for (; rev & bit; bit >>= 1) rev ^= bit;
+        rev ^= bit;
+        if (row >= rev) continue;
+        for (size_t lane = 0; lane < lanes; lane++) {
+            const elm_t t_re = re[row * lanes + lane], t_im = im[row * lanes + lane];
+            re[row * lanes + lane] = re[rev * lanes + lane];
+            im[row * lanes + lane] = im[rev * lanes + lane];
+            re[rev * lanes + lane] = t_re;
+            im[rev * lanes + lane] = t_im;
+        }
+    }
+
+    // butterflies, doubling span
+    const SimdOps *ops = simd_ops();
+    for (size_t half = 1; half < len; half *= 2) {
+        const size_t step = tw_len / (2 * half);
+        for (size_t start = 0; start < len; start += 2 * half) {
+            for (size_t elm = 0; elm < half; elm++) {
+                // inverse transforms run on conjugate twiddles
+                const elm_t w_re = tw_re[elm * step], w_im = inverse ? -tw_im[elm * step] : tw_im[elm * step];
+                const size_t a = (start + elm) * lanes, b = (start + elm + half) * lanes;
+                ops->butterfly(&re[a], &im[a], &re[b], &im[b], w_re, w_im, lanes);
+            }
+        }
+    }
+}
+
+static void fft2_(elm_t *dst, elm_t *src, const size_t rows, const size_t cols, const FftKernels *fk,
+    const int inverse) {
+    // 2D transform of rows x cols split planes in src (clobbered), into transposed cols x rows planes in dst
+    const size_t size = rows * cols;
+    fft_lanes_(src, &src[size], rows, cols, fk, inverse);
+    Tensor t_dst = {.arr=dst};
+    const Tensor t_src = {.m=rows, .n=cols, .o=2, .arr=src};
+    transpose_into(&t_dst, &t_src);
+    fft_lanes_(dst, &dst[size], cols, rows, fk, inverse);
+}
+
+static void forward_task_(void *ctx, const size_t task, const size_t worker) {
+    // spectra of two input channels of one item, packed as one complex transform
+    const FftSplit *split = ctx;
+    const Batch *channels = split->channels;
+    const FftKernels *fk = split->spectra;
+    const size_t m = channels->m, n = channels->n, o = channels->o;
+    const size_t p = fk->m, q = fk->n, size = p * q;
+    const size_t halves = (o + 1) / 2;
+    const size_t img = task / halves, first = task % halves * 2;
+    const int second = first + 1 < o;
+
+    // channel pair as real and imaginary parts, zero-padded
+    elm_t *packed = &split->bufs[worker * split->bufs_stride], *z = &packed[2 * size];
+    memset(packed, 0, 2 * size * sizeof(elm_t));
+    for (size_t part = 0; part < (second ? 2u : 1u); part++) {
+        const elm_t *chan = &channels->arr[(img * o + first + part) * m * n];
+        for (size_t row = 0; row < m; row++) {
+            memcpy(&packed[part * size + row * q], &chan[row * n], n * sizeof(elm_t));
+        }
+    }
+    fft2_(z, packed, p, q, fk, 0);
+
+    // split by conjugate symmetry, X_a = (Z[k] + conj Z[-k]) / 2, X_b = (Z[k] - conj Z[-k]) / 2i
+    elm_t *x_a = &split->inputs[(img * o + first) * 2 * size], *x_b = &x_a[2 * size];
+    const elm_t *z_re = z, *z_im = &z[size];
+    for (size_t row = 0; row < q; row++) {
+        const size_t row_n = (q - row) % q;
+        for (size_t col = 0; col < p; col++) {
+            const size_t elm = row * p + col, elm_n = row_n * p + (p - col) % p;
+            const elm_t re = z_re[elm], im = z_im[elm], re_n = z_re[elm_n], im_n = z_im[elm_n];
+            x_a[elm] = (re + re_n) * (elm_t)0.5;
+            x_a[size + elm] = (im - im_n) * (elm_t)0.5;
+            if (!second) continue;
+            x_b[elm] = (im + im_n) * (elm_t)0.5;
+            x_b[size + elm] = (re_n - re) * (elm_t)0.5;
+        }
+    }
+}
+
+static void product_task_(void *ctx, const size_t task, const size_t worker) {
+    // two output channels of one item: spectra summed over input channels, one inverse transform for both
+    const FftSplit *split = ctx;
+    const Convolutional *kernels = split->kernels;
+    const FftKernels *fk = split->spectra;
+    const size_t o = split->channels->o, num = kernels->num;
+    const size_t m_res = split->res->m, n_res = split->res->n;
+    const size_t p = fk->m, q = fk->n, size = p * q;
+    const size_t img = task / fk->pairs, pair = task % fk->pairs;
+    const SimdOps *ops = simd_ops();
+
+    // pointwise products of the packed kernel pair with every input channel
+    elm_t *acc = &split->bufs[worker * split->bufs_stride], *y = &acc[2 * size];
+    memset(acc, 0, 2 * size * sizeof(elm_t));
+    for (size_t chan = 0; chan < o; chan++) {
+        const elm_t *x = &split->inputs[(img * o + chan) * 2 * size];
+        const elm_t *w = &fk->spectra[(pair * o + chan) * 2 * size];
+        ops->cmac(acc, &acc[size], x, &x[size], w, &w[size], size);
+    }
+    fft2_(y, acc, q, p, fk, 1);
+
+    // real part is the first kernel's output, imaginary part the second's; bias once per input channel as in conv_
+    const elm_t scale = (elm_t)1 / (elm_t)size;
+    for (size_t part = 0; part < 2 && pair * 2 + part < num; part++) {
+        const size_t kern = pair * 2 + part;
+        const elm_t bias = kernels->kernels[kern]->bias * (elm_t)o;
+        elm_t *targ = &split->res->arr[(img * num + kern) * m_res * n_res];
+        const elm_t *src = &y[part * size];
+        for (size_t row = 0; row < m_res; row++) {
+            for (size_t col = 0; col < n_res; col++) targ[row * n_res + col] = src[row * q + col] * scale + bias;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Whether a convolutional layer can run in the frequency domain: every kernel with stride 1.
+ *
+ * @param kernels: convolutional layer.
+ *
+ * @return: 1 if batch_conv_fft_into accepts the layer; 0 otherwise.
+ */
+int batch_conv_fft_fits(const Convolutional *kernels) {
+    for (size_t kern = 0; kern < kernels->num; kern++) {
+        if (kernels->kernels[kern]->m_stride != 1 || kernels->kernels[kern]->n_stride != 1) return 0;
+    }
+    return kernels->num != 0;
+}
+
+/**
+ * Estimated work of batch_conv_fft_into, in direct convolution multiply-adds taking the same time: forward transforms
+ * of every input channel pair, pointwise products and inverse transforms of every kernel pair.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ *
+ * @return: estimated work.
+ */
+size_t batch_conv_fft_work(const Batch *channels, const Convolutional *kernels) {
+    const size_t p = pow2_(channels->m), q = pow2_(channels->n), size = p * q;
+    const size_t transform = FFT_BUTTERFLY * size / 2 * log2_(size) + 2 * size;
+    const size_t pairs = (kernels->num + 1) / 2, halves = (channels->o + 1) / 2;
+    return FFT_RATE * channels->b * (halves * transform + pairs * (channels->o * FFT_CMAC * size + transform));
+}
+
+/**
+ * Kernel spectra of a convolutional layer for inputs of one shape. Kernels are flipped, zero-padded to power-of-two
+ * transform sizes and packed two per complex transform, so that one pointwise product and one inverse transform give
+ * the outputs of two kernels. Computed once per layer and input shape and reused by every batch_conv_fft_into call.
+ * Caller is responsible for freeing returned spectra with free_fft_kernels.
+ *
+ * @param kernels: convolutional layer that fits batch_conv_fft_fits.
+ * @param m: input rows.
+ * @param n: input columns.
+ *
+ * @return: kernel spectra. NULL for a layer that does not fit, kernels larger than the input or malloc fail.
+ */
+FftKernels *fft_kernels(const Convolutional *kernels, const size_t m, const size_t n) {
+    // dimension setup
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t o = k_ref->o;
+    if (!batch_conv_fft_fits(kernels) || k_ref->m > m || k_ref->n > n) {
+        fprintf(stderr, "Invalid fft convolution: kernels of %zu x %zu do not fit %zu x %zu inputs.\n", k_ref->m,
+            k_ref->n, m, n);
+        return NULL;
+    }
+    const size_t p = pow2_(m), q = pow2_(n), size = p * q;
+    const size_t tw_len = p > q ? p : q;
+    const size_t pairs = (kernels->num + 1) / 2;
+
+    // malloc
+    FftKernels *fk = malloc(sizeof(FftKernels));
+    elm_t *twiddles = alloc_arr(tw_len);
+    elm_t *spectra = alloc_arr(pairs * o * 2 * size);
+    elm_t *work = alloc_arr(2 * size);
+    if (fk == NULL || twiddles == NULL || spectra == NULL || work == NULL) {
+        fprintf(stderr, "Failed malloc: fft kernel spectra sized %zu x %zu x %zu.\n", pairs * o, p, q);
+        free(fk); free(twiddles); free(spectra); free(work);
+        return NULL;
+    }
+    *fk = (FftKernels){.m=p, .n=q, .o=o, .pairs=pairs, .twiddles=twiddles, .spectra=spectra};
+
+    // twiddles exp(-2 pi i k / len) for the longer side, cosines then sines; shorter sides stride through them
+    for (size_t elm = 0; elm < tw_len / 2; elm++) {
+        const double angle = -2.0 * FFT_PI * (double)elm / (double)tw_len;
+        twiddles[elm] = (elm_t)cos(angle);
+        twiddles[tw_len / 2 + elm] = (elm_t)sin(angle);
+    }
+
+    // flipped kernel pair as real and imaginary parts, so products give correlation rather than convolution
+    for (size_t pair = 0; pair < pairs; pair++) {
+        for (size_t chan = 0; chan < o; chan++) {
+            memset(work, 0, 2 * size * sizeof(elm_t));
+            for (size_t part = 0; part < 2 && pair * 2 + part < kernels->num; part++) {
+                const Kernel *kernel = kernels->kernels[pair * 2 + part];
+                const elm_t *src = &kernel->arr[chan * kernel->m * kernel->n];
+                for (size_t row = 0; row < kernel->m; row++) {
+                    for (size_t col = 0; col < kernel->n; col++) {
+                        work[part * size + (p - row) % p * q + (q - col) % q] = src[row * kernel->n + col];
+                    }
+                }
+            }
+            fft2_(&spectra[(pair * o + chan) * 2 * size], work, p, q, fk, 0);
+        }
+    }
+    free(work);
+    return fk;
+}
+
+/**
+ * Frees all memory associated with kernel spectra. If fk is NULL, passes.
+ *
+ * @param fk: kernel spectra to be freed.
+ */
+void free_fft_kernels(FftKernels *fk) {
+    if (fk == NULL) return;
+    free(fk->twiddles);
+    free(fk->spectra);
+    free(fk);
+}
+
+/**
+ * Workspace elements batch_conv_fft_into takes from its arena.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_conv_fft_workspace(const Batch *channels, const Convolutional *kernels) {
+    const size_t size = pow2_(channels->m) * pow2_(channels->n);
+    const size_t workers = compute_workers(batch_conv_fft_work(channels, kernels));
+    // input spectra of the whole batch, plus two transform buffers per worker
+    return arena_bytes(channels->b * channels->o * 2 * size) / sizeof(elm_t)
+        + arena_bytes(4 * size) / sizeof(elm_t) * workers;
+}
+
+/**
+ * Frequency-domain convolution of every item of a batch with a full convolutional layer of stride-1 kernels, into a
+ * caller-provided batch. Input channels are transformed once per item and shared by every kernel; each output then
+ * costs a pointwise product per input channel instead of kernel-sized sums, which wins for large kernels and inputs.
+ * Matches batch_conv_direct_into to rounding, including the per-channel bias accumulation.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer that fits batch_conv_fft_fits.
+ * @param spectra: kernel spectra from fft_kernels for this input shape, or NULL to compute them per call.
+ * @param arena: arena for the input spectra and transform buffers, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch, a layer that does not fit or malloc fail.
+ */
+Batch *batch_conv_fft_into(Batch *res, const Batch *channels, const Convolutional *kernels,
+    const FftKernels *spectra, Arena *arena) {
+    // dimension setup
+    const size_t b = channels->b, o = channels->o;
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != b) return NULL;
+    const size_t size = pow2_(channels->m) * pow2_(channels->n);
+    if (spectra != NULL && (spectra->m != pow2_(channels->m) || spectra->n != pow2_(channels->n) || spectra->o != o)) {
+        fprintf(stderr, "Invalid fft convolution: spectra of %zu x %zu for a %zu x %zu input.\n", spectra->m,
+            spectra->n, channels->m, channels->n);
+        return NULL;
+    }
+
+    // per-call spectra
+    FftKernels *own = spectra == NULL ? fft_kernels(kernels, channels->m, channels->n) : NULL;
+    if (spectra == NULL && own == NULL) return NULL;
+    if (spectra == NULL) spectra = own;
+
+    // workspace, input spectra and one pair of transform buffers per worker
+    const size_t workers = compute_workers(batch_conv_fft_work(channels, kernels));
+    const size_t stride = arena_bytes(4 * size) / sizeof(elm_t);
+    const size_t mark = arena != NULL ? arena->used : 0;
+    elm_t *inputs = arena_scratch(arena, b * o * 2 * size);
+    elm_t *bufs = arena_scratch(arena, stride * workers);
+    if (inputs == NULL || bufs == NULL) {
+        fprintf(stderr, "Failed malloc: fft convolution workspace of %zu spectra.\n", b * o);
+        if (bufs != NULL) arena_drop(arena, bufs, mark);
+        if (inputs != NULL) arena_drop(arena, inputs, mark);
+        free_fft_kernels(own);
+        return NULL;
+    }
+
+    // struct setup
+    res->m = shape.m; res->n = shape.n; res->o = shape.o; res->b = b;
+
+    // input spectra of every item, then products and inverse transforms of every kernel pair
+    FftSplit split = {.res=res, .channels=channels, .kernels=kernels, .spectra=spectra, .inputs=inputs, .bufs=bufs,
+        .bufs_stride=stride};
+    ThreadPool *pool = workers > 1 ? compute_pool() : NULL;
+    thread_pool_run(pool, b * ((o + 1) / 2), forward_task_, &split);
+    thread_pool_run(pool, b * spectra->pairs, product_task_, &split);
+
+    // free and return
+    arena_drop(arena, bufs, mark);
+    arena_drop(arena, inputs, mark);
+    free_fft_kernels(own);
+    return res;
+}
@@ -1,8 +1,51 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "types.h"
 #include "functional.h"
 
+// element arrays allocated so far, read by profiling
+static atomic_size_t allocations_ = 0;
+
+/**
+ * Allocates an element array aligned to ELM_ALIGN bytes, so SIMD kernels can use full-width loads.
+ * Caller is responsible for freeing returned array with free.
+ *
+ * @param size: number of elements.
+ *
+ * @return: uninitialized array. NULL for malloc fail.
+ */
+elm_t *alloc_arr(const size_t size) {
+    // aligned_alloc requires a whole number of alignment blocks
+    size_t bytes = (size * sizeof(elm_t) + ELM_ALIGN - 1) / ELM_ALIGN * ELM_ALIGN;
+    if (bytes == 0) bytes = ELM_ALIGN;
+    atomic_fetch_add_explicit(&allocations_, 1, memory_order_relaxed);
+    return aligned_alloc(ELM_ALIGN, bytes);
+}
+
+/**
+ * Number of element arrays allocated with alloc_arr since program start, from every thread.
+ *
+ * @return: allocation count.
+ */
+size_t alloc_count(void) {
+    return atomic_load_explicit(&allocations_, memory_order_relaxed);
+}
+
+/**
+ * Allocates a zeroed element array aligned to ELM_ALIGN bytes.
+ * Caller is responsible for freeing returned array with free.
+ *
+ * @param size: number of elements.
+ *
+ * @return: zeroed array. NULL for malloc fail.
+ */
+elm_t *calloc_arr(const size_t size) {
+    elm_t *arr = alloc_arr(size);
+    if (arr != NULL) memset(arr, 0, size * sizeof(elm_t));
+    return arr;
+}
+
 /**
  * Frees all memory associated with a tensor. If tensor is NULL, passes.
  *
@@ -51,6 +94,70 @@ void free_convolutional(Convolutional *convolutional) {
     free(convolutional);
 }
 
+/**
+ * Frees all memory associated with a batch. If batch is NULL, passes.
+ *
+ * @param batch: batch to be freed.
+ */
+void free_batch(Batch *batch) {
+    if (batch == NULL) return;
+    free(batch->arr);
+    free(batch);
+}
+
+/**
+ * Allocates a tensor and its uninitialized array.
+ * Caller is responsible for freeing returned tensor & array.
+ *
+ * @param m: rows.
+ * @param n: columns.
+ * @param o: matrices.
+ *
+ * @return: uninitialized tensor. NULL for malloc fail.
+ */
+Tensor *make_tensor(const size_t m, const size_t n, const size_t o) {
+    // malloc
+    elm_t *res_arr = alloc_arr(m * n * o);
+    Tensor *res = malloc(sizeof(Tensor));
+    if (res_arr == NULL || res == NULL) {
+        fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", m, n, o);
+        free(res_arr); free(res);
+        return NULL;
+    }
+
+    // struct setup
+    res->m = m; res->n = n; res->o = o;
+    res->arr = res_arr;
+    return res;
+}
+
+/**
+ * Allocates a batch and its uninitialized array.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param m: rows.
+ * @param n: columns.
+ * @param o: matrices per item.
+ * @param b: items.
+ *
+ * @return: uninitialized batch. NULL for malloc fail.
+ */
+Batch *make_batch(const size_t m, const size_t n, const size_t o, const size_t b) {
+    // malloc
+    elm_t *res_arr = alloc_arr(m * n * o * b);
+    Batch *res = malloc(sizeof(Batch));
+    if (res_arr == NULL || res == NULL) {
+        fprintf(stderr, "Failed malloc: Batch sized %zu x %zu x %zu x %zu.\n", m, n, o, b);
+        free(res_arr); free(res);
+        return NULL;
+    }
+
+    // struct setup
+    res->m = m; res->n = n; res->o = o; res->b = b;
+    res->arr = res_arr;
+    return res;
+}
+
 /**
  * Combines an array of tensors with same-sized matrices into a single tensor.
  * Frees combined tensors.
@@ -80,7 +187,7 @@ Tensor *combine(Tensor **tensors, const size_t num) {
     }
 
     // malloc
-    elm_t *res_arr = realloc(tensors[0]->arr, m * n * o * sizeof(elm_t));
+    elm_t *res_arr = alloc_arr(m * n * o);
     if (res_arr == NULL) {
         // malloc fail
         fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", m, n, o);
@@ -88,6 +195,8 @@ Tensor *combine(Tensor **tensors, const size_t num) {
     }
 
     // tensor combination
+    memcpy(res_arr, tensors[0]->arr, m * n * tensors[0]->o * sizeof(elm_t));
+    free(tensors[0]->arr);
     elm_t *dst = res_arr + m * n * tensors[0]->o;
     for (size_t tens = 1; tens < num; tens++) {
         const size_t len = m * n * tensors[tens]->o;
@@ -105,29 +214,22 @@ Tensor *combine(Tensor **tensors, const size_t num) {
 }
 
 /**
- * Transposes a tensor.
- * Caller is responsible for freeing returned tensor & array.
+ * Transposes a tensor into a caller-provided tensor.
+ * res->arr must hold the result and must not alias tens; res dimensions are set by the call.
  *
+ * @param res: result tensor.
  * @param tens: tensor to transpose.
- * @return: transposed tensor.
+ *
+ * @return: res.
  */
-Tensor *transpose(const Tensor *tens) {
+Tensor *transpose_into(Tensor *res, const Tensor *tens) {
     // dimension setup
     const size_t m = tens->m;
     const size_t n = tens->n;
     const size_t o = tens->o;
 
-    // malloc
-    elm_t *res_arr = malloc(m * n * o * sizeof(elm_t));
-    Tensor *res = malloc(sizeof(Tensor));
-    if (res_arr == NULL || res == NULL) {
-        fprintf(stderr, "Failed malloc: Tensor sized %zu x %zu x %zu.\n", n, m, o);
-        free(res_arr); free(res);
-        return NULL;
-    }
     // struct setup
     res->m = n; res->n = m; res->o = o;
-    res->arr = res_arr;
 
     for (size_t mat = 0; mat < o; mat++) {
         // transpose matrix
@@ -140,6 +242,22 @@ Tensor *transpose(const Tensor *tens) {
     return res;
 }
 
+/**
+ * Transposes a tensor.
+ * Caller is responsible for freeing returned tensor & array.
+ *
+ * @param tens: tensor to transpose.
+ * @return: transposed tensor.
+ */
+Tensor *transpose(const Tensor *tens) {
+    // malloc
+    Tensor *res = make_tensor(tens->n, tens->m, tens->o);
+    if (res == NULL) return NULL;
+
+    // transpose operation
+    return transpose_into(res, tens);
+}
+
 /**
  * Flattens a tensor. If tensor is NULL, passes.
  *
@@ -176,3 +294,160 @@ size_t argmax(const Tensor *tensor) {
     }
     return max_idx;
 }
+
+/**
+ * Stacks an array of same-shaped tensors into a caller-provided batch. Stacked tensors are copied, not freed.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param tensors: tensors to be stacked.
+ * @param num: number of tensors.
+ *
+ * @return: res. NULL for any misshaped tensors.
+ */
+Batch *stack_into(Batch *res, Tensor **tensors, const size_t num) {
+    // dimension setup
+    const size_t m = tensors[0]->m;
+    const size_t n = tensors[0]->n;
+    const size_t o = tensors[0]->o;
+
+    // dimensionality check
+    for (size_t tens = 1; tens < num; tens++) {
+        if (m != tensors[tens]->m || n != tensors[tens]->n || o != tensors[tens]->o) {
+            fprintf(stderr, "Dimension mismatch: m (%zu) != m (%zu) || n (%zu) != n (%zu) || o (%zu) != o (%zu).\n",
+                m, tensors[tens]->m, n, tensors[tens]->n, o, tensors[tens]->o);
+            return NULL;
+        }
+    }
+
+    // tensor stacking
+    const size_t item_size = m * n * o;
+    for (size_t tens = 0; tens < num; tens++) {
+        memcpy(&res->arr[tens * item_size], tensors[tens]->arr, item_size * sizeof(elm_t));
+    }
+
+    // struct setup
+    res->m = m; res->n = n; res->o = o; res->b = num;
+    return res;
+}
+
+/**
+ * Stacks an array of same-shaped tensors into a batch. Stacked tensors are copied, not freed.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param tensors: tensors to be stacked.
+ * @param num: number of tensors.
+ *
+ * @return: stacked batch. NULL for any misshaped tensors or malloc fail.
+ */
+Batch *stack(Tensor **tensors, const size_t num) {
+    // malloc
+    Batch *res = make_batch(tensors[0]->m, tensors[0]->n, tensors[0]->o, num);
+    if (res == NULL) return NULL;
+
+    // tensor stacking
+    if (stack_into(res, tensors, num) == NULL) {
+        free_batch(res);
+        return NULL;
+    }
+    return res;
+}
+
+/**
+ * Combines an array of batches with same-sized matrices into a single batch, item by item.
+ * Frees combined batches.
+ * Caller is responsible for freeing returned batch & array.
+ *
+ * @param batches: batches to be combined.
+ * @param num: number of batches.
+ *
+ * @return: combined batch. NULL for any misshaped batches or malloc fail.
+ */
+Batch *batch_combine(Batch **batches, const size_t num) {
+    // dimension setup
+    const size_t m = batches[0]->m;
+    const size_t n = batches[0]->n;
+    const size_t b = batches[0]->b;
+
+    // dimensionality check and setup
+    size_t o = batches[0]->o;
+    for (size_t bat = 1; bat < num; bat++) {
+        if (m != batches[bat]->m || n != batches[bat]->n || b != batches[bat]->b) {
+            // dimension mismatch
+            fprintf(stderr, "Dimension mismatch: m (%zu) != m (%zu) || n (%zu) != n (%zu) || b (%zu) != b (%zu).\n",
+                m, batches[bat]->m, n, batches[bat]->n, b, batches[bat]->b);
+            return NULL;
+        }
+        // o accumulation
+        o += batches[bat]->o;
+    }
+
+    // malloc
+    elm_t *res_arr = alloc_arr(m * n * o * b);
+    if (res_arr == NULL) {
+        // malloc fail
+        fprintf(stderr, "Failed malloc: Batch sized %zu x %zu x %zu x %zu.\n", m, n, o, b);
+        return NULL;
+    }
+
+    // batch combination
+    elm_t *dst = res_arr;
+    for (size_t img = 0; img < b; img++) {
+        for (size_t bat = 0; bat < num; bat++) {
+            const size_t len = m * n * batches[bat]->o;
+            memcpy(dst, &batches[bat]->arr[img * len], len * sizeof(elm_t));
+            dst += len;
+        }
+    }
+
+    // free added batches
+    for (size_t bat = 1; bat < num; bat++) {
+        free_batch(batches[bat]);
+        batches[bat] = NULL;
+    }
+
+    // struct setup and return
+    free(batches[0]->arr);
+    batches[0]->arr = res_arr;
+    batches[0]->o = o;
+    return batches[0];
+}
+
+/**
+ * Flattens every item of a batch. If batch is NULL, passes.
+ *
+ * @param batch: batch to be flattened.
+ */
+void batch_flatten(Batch *batch) {
+    if (batch == NULL) return;
+    batch->n = batch->m * batch->n * batch->o;
+    batch->m = 1; batch->o = 1;
+}
+
+/**
+ * Views a whole batch as a single tensor, with items laid out along the o-th dimension.
+ * The view shares the batch array.
+ *
+ * @param batch: batch to be viewed.
+ *
+ * @return: tensor view of the batch.
+ */
+Tensor batch_view(const Batch *batch) {
+    const Tensor view = {.m=batch->m, .n=batch->n, .o=batch->o * batch->b, .arr=batch->arr};
+    return view;
+}
+
+/**
+ * Views a single item of a batch as a tensor.
+ * The view shares the batch array.
+ *
+ * @param batch: batch to be viewed.
+ * @param idx: item index.
+ *
+ * @return: tensor view of the item.
+ */
+Tensor batch_item(const Batch *batch, const size_t idx) {
+    const size_t item_size = batch->m * batch->n * batch->o;
+    const Tensor view = {.m=batch->m, .n=batch->n, .o=batch->o, .arr=&batch->arr[idx * item_size]};
+    return view;
+}
@@ -0,0 +1,508 @@
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "functional.h"
+#include "gemm.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+// cache blocks: kc x nr panel of b stays in L1, mc x kc block of a stays in L2
+// MC is a multiple of every register tile height (4, 6, 12)
+#define MC 72
+#define KC 256
+#define NC 2048
+
+// products below this size skip packing entirely
+#define SMALL_GEMM 32768
+// b narrower than this is multiplied column by column
+#define NARROW 8
+// elements per cache line
+#define LINE (ELM_ALIGN / sizeof(elm_t))
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void pack_a_(elm_t *dst, const elm_t *a, const size_t lda, const size_t mc, const size_t kc,
+    const size_t mr_tile) {
+    // row panels of mr_tile, element p of every row stored together, zero padded
+    for (size_t ir = 0; ir < mc; ir += mr_tile) {
+        const size_t mr = mc - ir < mr_tile ? mc - ir : mr_tile;
+        for (size_t p = 0; p < kc; p++) {
+            for (size_t i = 0; i < mr_tile; i++) {
+                *dst++ = i < mr ? a[(ir + i) * lda + p] : (elm_t)0;
+            }
+        }
+    }
+}
+
+static void pack_b_(elm_t *dst, const elm_t *b, const size_t ldb, const size_t kc, const size_t nc,
+    const size_t nr_tile) {
+    // column panels of nr_tile, row p of every panel stored contiguously, zero padded
+    for (size_t jr = 0; jr < nc; jr += nr_tile) {
+        const size_t nr = nc - jr < nr_tile ? nc - jr : nr_tile;
+        for (size_t p = 0; p < kc; p++) {
+            const elm_t *src = &b[p * ldb + jr];
+            for (size_t j = 0; j < nr_tile; j++) {
+                *dst++ = j < nr ? src[j] : (elm_t)0;
+            }
+        }
+    }
+}
+
+static void pack_b_half_(elm_t *dst, const uint16_t *b, const size_t ldb, const size_t kc, const size_t nc,
+    const size_t nr_tile, void (*widen)(elm_t *, const uint16_t *, size_t)) {
+    // as pack_b_, half-precision rows widened straight into the panel
+    for (size_t jr = 0; jr < nc; jr += nr_tile) {
+        const size_t nr = nc - jr < nr_tile ? nc - jr : nr_tile;
+        for (size_t p = 0; p < kc; p++) {
+            widen(dst, &b[p * ldb + jr], nr);
+            for (size_t j = nr; j < nr_tile; j++) dst[j] = (elm_t)0;
+            dst += nr_tile;
+        }
+    }
+}
+
+static void epilogue_(elm_t *c, const GemmEpilogue *epi, const size_t row, const size_t col, const size_t len) {
+    // finished run of len outputs of row row starting at column col, still in cache
+    if (epi == NULL) return;
+    if (epi->bias != NULL) simd_ops()->axpy(c, &epi->bias[col], 1, len);
+    if (epi->row_bias != NULL) {
+        const elm_t bias = epi->row_bias[row];
+        for (size_t elm = 0; elm < len; elm++) c[elm] += bias;
+    }
+    if (epi->fn != NULL) epi->fn(c, len);
+}
+
+static void gemm_small_(elm_t *c, const size_t ldc, const elm_t *a, const size_t lda, const elm_t *b,
+    const size_t ldb, const size_t m, const size_t n, const size_t k, const GemmEpilogue *epi) {
+    if (n < NARROW) {
+        // narrow b fits in cache, dot products keep the sum in a register
+        for (size_t row = 0; row < m; row++) {
+            for (size_t col = 0; col < n; col++) {
+                elm_t res = 0;
+                for (size_t p = 0; p < k; p++) res += a[row * lda + p] * b[p * ldb + col];
+                c[row * ldc + col] = res;
+            }
+            epilogue_(&c[row * ldc], epi, row, 0, n);
+        }
+        return;
+    }
+
+    // row-streaming loop order, b is read row-wise
+    for (size_t row = 0; row < m; row++) {
+        elm_t *dst = &c[row * ldc];
+        memset(dst, 0, n * sizeof(elm_t));
+        for (size_t p = 0; p < k; p++) {
+            const elm_t scale = a[row * lda + p];
+            for (size_t col = 0; col < n; col++) {
+                dst[col] += scale * b[p * ldb + col];
+            }
+        }
+        epilogue_(dst, epi, row, 0, n);
+    }
+}
+
+static size_t tile_workspace_(const size_t m, const size_t n, const size_t k, const int half) {
+    if (k == 0) return 0;
+    // small half-precision b is widened whole
+    if (m * n * k < SMALL_GEMM) return half ? (k * n + LINE - 1) / LINE * LINE : 0;
+    const SimdOps *ops = simd_ops();
+    const size_t mc_max = m < MC ? m : MC;
+    const size_t kc_max = k < KC ? k : KC;
+    const size_t nc_max = n < NC ? n : NC;
+    // packed b panel starts on its own cache line
+    return ((mc_max + ops->gemm_mr) * kc_max + LINE - 1) / LINE * LINE + (nc_max + ops->gemm_nr) * kc_max;
+}
+
+static void gemm_tile_(elm_t *c, const size_t ldc, const elm_t *a, const size_t lda, const elm_t *b,
+    const uint16_t *b_half, void (*widen)(elm_t *, const uint16_t *, size_t), size_t ldb, const elm_t *a_panels,
+    const elm_t *b_panels, const size_t m, const size_t n, const size_t k, const GemmEpilogue *epi, elm_t *work) {
+    if (m * n * k < SMALL_GEMM || k == 0) {
+        if (b_half != NULL) {
+            // widened into the workspace, then read as single-precision b
+            for (size_t p = 0; p < k; p++) widen(&work[p * n], &b_half[p * ldb], n);
+            b = work; ldb = n;
+        }
+        gemm_small_(c, ldc, a, lda, b, ldb, m, n, k, epi);
+        return;
+    }
+
+    // register tile
+    const SimdOps *ops = simd_ops();
+    const size_t mr_tile = ops->gemm_mr, nr_tile = ops->gemm_nr;
+
+    // packing buffers
+    const size_t mc_max = m < MC ? m : MC;
+    const size_t kc_max = k < KC ? k : KC;
+    elm_t *a_pack = work;
+    elm_t *b_pack = work + ((mc_max + mr_tile) * kc_max + LINE - 1) / LINE * LINE;
+
+    // blocked gemm
+    for (size_t jc = 0; jc < n; jc += NC) {
+        const size_t nc = n - jc < NC ? n - jc : NC;
+        for (size_t pc = 0; pc < k; pc += KC) {
+            const size_t kc = k - pc < KC ? k - pc : KC;
+            // prepacked panels are read in place, k block pc of a panel is its kc rows from row pc
+            if (b_half != NULL) {
+                pack_b_half_(b_pack, &b_half[pc * ldb + jc], ldb, kc, nc, nr_tile, widen);
+            } else if (b_panels == NULL) {
+                pack_b_(b_pack, &b[pc * ldb + jc], ldb, kc, nc, nr_tile);
+            }
+            for (size_t ic = 0; ic < m; ic += MC) {
+                const size_t mc = m - ic < MC ? m - ic : MC;
+                if (a_panels == NULL) pack_a_(a_pack, &a[ic * lda + pc], lda, mc, kc, mr_tile);
+                // register tiles
+                for (size_t jr = 0; jr < nc; jr += nr_tile) {
+                    const size_t nr = nc - jr < nr_tile ? nc - jr : nr_tile;
+                    const elm_t *b_tile = b_panels != NULL ? &b_panels[(jc + jr) * k + pc * nr_tile]
+                        : &b_pack[jr * kc];
+                    for (size_t ir = 0; ir < mc; ir += mr_tile) {
+                        const size_t mr = mc - ir < mr_tile ? mc - ir : mr_tile;
+                        const elm_t *a_tile = a_panels != NULL ? &a_panels[(ic + ir) * k + pc * mr_tile]
+                            : &a_pack[ir * kc];
+                        elm_t *tile = &c[(ic + ir) * ldc + jc + jr];
+                        ops->gemm_kernel(kc, a_tile, b_tile, tile, ldc, mr, nr, pc == 0);
+                        // epilogue on the tile just stored, after its last k block
+                        if (pc + kc == k) {
+                            for (size_t i = 0; i < mr; i++) epilogue_(&tile[i * ldc], epi, ic + ir + i, jc + jr, nr);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// output tiling of a gemm split across the compute pool
+typedef struct {
+    elm_t *c;
+    const elm_t *a;
+    const elm_t *b;
+    const uint16_t *b_half;
+    void (*widen)(elm_t *, const uint16_t *, size_t);
+    const elm_t *a_panels;
+    const elm_t *b_panels;
+    const GemmEpilogue *epi;
+    size_t m, n, k;
+    size_t tile_m, tile_n, tiles_n;
+    elm_t *work;
+    size_t work_stride;
+} GemmSplit;
+
+static void split_(const size_t m, const size_t n, const size_t workers, size_t *tile_m, size_t *tile_n) {
+    // row bands first, column bands once rows run out, both on register tile boundaries
+    const SimdOps *ops = simd_ops();
+    const size_t mr = ops->gemm_mr, nr = ops->gemm_nr;
+    const size_t panels_m = (m + mr - 1) / mr, panels_n = (n + nr - 1) / nr;
+    const size_t bands_m = workers < panels_m ? workers : panels_m;
+    size_t bands_n = (workers + bands_m - 1) / bands_m;
+    if (bands_n > panels_n) bands_n = panels_n;
+    *tile_m = (panels_m + bands_m - 1) / bands_m * mr;
+    *tile_n = (panels_n + bands_n - 1) / bands_n * nr;
+}
+
+static void gemm_split_task_(void *ctx, const size_t task, const size_t worker) {
+    const GemmSplit *split = ctx;
+    const size_t row = task / split->tiles_n * split->tile_m;
+    const size_t col = task % split->tiles_n * split->tile_n;
+    const size_t m = split->m - row < split->tile_m ? split->m - row : split->tile_m;
+    const size_t n = split->n - col < split->tile_n ? split->n - col : split->tile_n;
+    const elm_t *b = split->b != NULL ? &split->b[col] : NULL;
+    const uint16_t *b_half = split->b_half != NULL ? &split->b_half[col] : NULL;
+    // panels of rows row and column col on, both on register tile boundaries
+    const elm_t *a_panels = split->a_panels != NULL ? &split->a_panels[row * split->k] : NULL;
+    const elm_t *b_panels = split->b_panels != NULL ? &split->b_panels[col * split->k] : NULL;
+    // epilogue rows and columns relative to the tile
+    GemmEpilogue epi = split->epi != NULL ? *split->epi : (GemmEpilogue){.bias=NULL};
+    if (epi.bias != NULL) epi.bias += col;
+    if (epi.row_bias != NULL) epi.row_bias += row;
+    gemm_tile_(&split->c[row * split->n + col], split->n, &split->a[row * split->k], split->k, b, b_half,
+        split->widen, split->n, a_panels, b_panels, m, n, split->k, split->epi != NULL ? &epi : NULL,
+        split->work != NULL ? &split->work[worker * split->work_stride] : NULL);
+}
+
+static size_t workspace_(const size_t m, const size_t n, const size_t k, const int half) {
+    const size_t workers = compute_workers(m * n * k);
+    if (workers == 1) return tile_workspace_(m, n, k, half);
+    size_t tile_m, tile_n;
+    split_(m, n, workers, &tile_m, &tile_n);
+    // an edge tile can fall below SMALL_GEMM and widen all k rows of its half-precision b columns rather than pack
+    size_t tile = tile_workspace_(tile_m, tile_n, k, half);
+    const size_t widened = half ? (k * tile_n + LINE - 1) / LINE * LINE : 0;
+    if (widened > tile) tile = widened;
+    const size_t stride = (tile + LINE - 1) / LINE * LINE;
+    return stride * workers;
+}
+
+static void gemm_run_(elm_t *c, const elm_t *a, const elm_t *a_panels, const elm_t *b, const elm_t *b_panels,
+    const size_t m, const size_t n, const size_t k, const GemmEpilogue *epi, elm_t *work) {
+    const size_t workers = compute_workers(m * n * k);
+    const size_t size = workspace_(m, n, k, 0);
+    if (workers == 1 && size == 0) {
+        gemm_small_(c, n, a, k, b, n, m, n, k, epi);
+        return;
+    }
+
+    // packing buffers, not needed when every tile is small
+    elm_t *owned = NULL;
+    if (work == NULL && size != 0) {
+        owned = work = alloc_arr(size);
+        if (work == NULL) {
+            // fall back to the unpacked loop
+            fprintf(stderr, "Failed malloc: gemm packing buffers, using unblocked loop.\n");
+            gemm_small_(c, n, a, k, b, n, m, n, k, epi);
+            return;
+        }
+    }
+
+    if (workers == 1) {
+        gemm_tile_(c, n, a, k, b, NULL, NULL, n, a_panels, b_panels, m, n, k, epi, work);
+    } else {
+        // output tiles, one packing workspace per worker
+        GemmSplit split = {.c=c, .a=a, .b=b, .a_panels=a_panels, .b_panels=b_panels, .epi=epi, .m=m, .n=n, .k=k,
+            .work=work};
+        split_(m, n, workers, &split.tile_m, &split.tile_n);
+        split.tiles_n = (n + split.tile_n - 1) / split.tile_n;
+        split.work_stride = size / workers;
+        const size_t tiles = (m + split.tile_m - 1) / split.tile_m * split.tiles_n;
+        thread_pool_run(compute_pool(), tiles, gemm_split_task_, &split);
+    }
+
+    // free
+    free(owned);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Workspace elements gemm_ws needs for a product; 0 for products that skip packing. Products large enough to be split
+ * across the compute pool need one packing workspace per worker.
+ *
+ * @param m: rows of a and c.
+ * @param n: columns of b and c.
+ * @param k: columns of a, rows of b.
+ *
+ * @return: workspace size in elements.
+ */
+size_t gemm_workspace(const size_t m, const size_t n, const size_t k) {
+    return workspace_(m, n, k, 0);
+}
+
+/**
+ * Single-precision matrix multiplication c = a * b of contiguous row-major matrices, packing into a caller-provided
+ * workspace. Large products are cache blocked with packed panels and computed by the register tile of the host's
+ * SIMD kernel set; small products use a direct loop. Products above the parallel threshold are split into output
+ * tiles across the compute pool.
+ *
+ * @param c: m x n result, overwritten.
+ * @param a: m x k matrix.
+ * @param b: k x n matrix.
+ * @param m: rows of a and c.
+ * @param n: columns of b and c.
+ * @param k: columns of a, rows of b.
+ * @param work: workspace of gemm_workspace(m, n, k) elements. NULL to allocate one internally.
+ */
+void gemm_ws(elm_t *c, const elm_t *a, const elm_t *b, const size_t m, const size_t n, const size_t k, elm_t *work) {
+    gemm_epilogue_ws(c, a, b, m, n, k, NULL, work);
+}
+
+/**
+ * Single-precision matrix multiplication c = a * b as gemm_ws, with an epilogue applied to each output register tile
+ * right after its last k block is stored, while the tile is still in L1: the biases of its columns and rows are
+ * added, then the element-wise activation runs over it. Saves the separate passes over c a bias add and an activation
+ * would take.
+ *
+ * @param c: m x n result, overwritten.
+ * @param a: m x k matrix.
+ * @param b: k x n matrix.
+ * @param m: rows of a and c.
+ * @param n: columns of b and c.
+ * @param k: columns of a, rows of b.
+ * @param epi: n column biases, m row biases and activation, any member NULL to skip it; or NULL for a plain
+ * product.
+ * @param work: workspace of gemm_workspace(m, n, k) elements. NULL to allocate one internally.
+ */
+void gemm_epilogue_ws(elm_t *c, const elm_t *a, const elm_t *b, const size_t m, const size_t n, const size_t k,
+    const GemmEpilogue *epi, elm_t *work) {
+    gemm_run_(c, a, NULL, b, NULL, m, n, k, epi, work);
+}
+
+/**
+ * Single-precision matrix multiplication c = a * b of contiguous row-major matrices.
+ * See gemm_ws; packing buffers are allocated per call.
+ *
+ * @param c: m x n result, overwritten.
+ * @param a: m x k matrix.
+ * @param b: k x n matrix.
+ * @param m: rows of a and c.
+ * @param n: columns of b and c.
+ * @param k: columns of a, rows of b.
+ */
+void gemm(elm_t *c, const elm_t *a, const elm_t *b, const size_t m, const size_t n, const size_t k) {
+    gemm_ws(c, a, b, m, n, k, NULL);
+}
+
+/**
+ * Workspace elements gemm_half_ws needs for a product. Half-precision b is always widened, into packed panels or, for
+ * small products, whole; only empty products need none.
+ *
+ * @param m: rows of a and c.
+ * @param n: columns of b and c.
+ * @param k: columns of a, rows of b.
+ *
+ * @return: workspace size in elements.
+ */
+size_t gemm_half_workspace(const size_t m, const size_t n, const size_t k) {
+    return workspace_(m, n, k, 1);
+}
+
+/**
+ * Matrix multiplication c = a * b of contiguous row-major matrices with b stored in half precision. b is widened to
+ * single precision while it is packed into cache-resident panels, so it is read from memory at half the width and
+ * every product accumulates in single precision; small products widen b once and use the direct loop. Split across
+ * the compute pool as gemm_ws.
+ *
+ * @param c: m x n result, overwritten.
+ * @param a: m x k matrix.
+ * @param b: k x n half-precision matrix.
+ * @param prec: storage type of b, PREC_FP16 or PREC_BF16.
+ * @param m: rows of a and c.
+ * @param n: columns of b and c.
+ * @param k: columns of a, rows of b.
+ * @param work: workspace of gemm_half_workspace(m, n, k) elements. NULL to allocate one internally.
+ *
+ * @return: c. NULL for malloc fail.
+ */
+elm_t *gemm_half_ws(elm_t *c, const elm_t *a, const uint16_t *b, const Precision prec, const size_t m, const size_t n,
+    const size_t k, elm_t *work) {
+    const SimdOps *ops = simd_ops();
+    void (*widen)(elm_t *, const uint16_t *, size_t) = prec == PREC_BF16 ? ops->widen_bf16 : ops->widen_f16;
+    if (k == 0) {
+        memset(c, 0, m * n * sizeof(elm_t));
+        return c;
+    }
+
+    // packing buffers
+    const size_t workers = compute_workers(m * n * k);
+    const size_t size = gemm_half_workspace(m, n, k);
+    elm_t *owned = NULL;
+    if (work == NULL) {
+        owned = work = alloc_arr(size);
+        if (work == NULL) {
+            fprintf(stderr, "Failed malloc: gemm packing buffers sized %zu.\n", size);
+            return NULL;
+        }
+    }
+
+    if (workers == 1) {
+        gemm_tile_(c, n, a, k, NULL, b, widen, n, NULL, NULL, m, n, k, NULL, work);
+    } else {
+        // output tiles, one packing workspace per worker
+        GemmSplit split = {.c=c, .a=a, .b_half=b, .widen=widen, .m=m, .n=n, .k=k, .work=work};
+        split_(m, n, workers, &split.tile_m, &split.tile_n);
+        split.tiles_n = (n + split.tile_n - 1) / split.tile_n;
+        split.work_stride = size / workers;
+        const size_t tiles = (m + split.tile_m - 1) / split.tile_m * split.tiles_n;
+        thread_pool_run(compute_pool(), tiles, gemm_split_task_, &split);
+    }
+
+    // free
+    free(owned);
+    return c;
+}
+
+/**
+ * Elements gemm_pack_a packs an m x k left operand into: whole row panels of the host kernel's register tile height.
+ *
+ * @param m: rows.
+ * @param k: columns.
+ *
+ * @return: packed size in elements.
+ */
+size_t gemm_pack_a_size(const size_t m, const size_t k) {
+    const size_t mr = simd_ops()->gemm_mr;
+    return (m + mr - 1) / mr * mr * k;
+}
+
+/**
+ * Packs a left operand into the row panels the host's gemm kernel streams, as gemm_ws packs every cache block of it on
+ * each call: panels of gemm_mr rows with element p of every row stored together, the last panel zero padded. Panels
+ * run the full depth k, so any k block of them is read in place.
+ *
+ * @param dst: gemm_pack_a_size(m, k) elements.
+ * @param a: m x k matrix.
+ * @param lda: elements between rows of a.
+ * @param m: rows.
+ * @param k: columns.
+ *
+ * @return: dst.
+ */
+elm_t *gemm_pack_a(elm_t *dst, const elm_t *a, const size_t lda, const size_t m, const size_t k) {
+    pack_a_(dst, a, lda, m, k, simd_ops()->gemm_mr);
+    return dst;
+}
+
+/**
+ * Elements gemm_pack_b packs a k x n right operand into: whole column panels of the host kernel's register tile width.
+ *
+ * @param k: rows.
+ * @param n: columns.
+ *
+ * @return: packed size in elements.
+ */
+size_t gemm_pack_b_size(const size_t k, const size_t n) {
+    const size_t nr = simd_ops()->gemm_nr;
+    return (n + nr - 1) / nr * nr * k;
+}
+
+/**
+ * Packs a right operand into the column panels the host's gemm kernel streams: panels of gemm_nr columns with row p
+ * of every panel stored contiguously, the last panel zero padded. Panels run the full depth k, as gemm_pack_a.
+ *
+ * @param dst: gemm_pack_b_size(k, n) elements.
+ * @param b: k x n matrix.
+ * @param ldb: elements between rows of b.
+ * @param k: rows.
+ * @param n: columns.
+ *
+ * @return: dst.
+ */
+elm_t *gemm_pack_b(elm_t *dst, const elm_t *b, const size_t ldb, const size_t k, const size_t n) {
+    pack_b_(dst, b, ldb, k, n, simd_ops()->gemm_nr);
+    return dst;
+}
+
+/**
+ * Matrix multiplication c = a * b as gemm_epilogue_ws, with a prepacked left operand. The kernel reads a's panels in
+ * place, so only b is packed per call; small products use a's row-major matrix. Panels packed for another register
+ * tile height are ignored.
+ *
+ * @param c: a->rows x n result, overwritten.
+ * @param a: a->rows x a->cols weights, see gemm_pack_a.
+ * @param b: a->cols x n matrix.
+ * @param n: columns of b and c.
+ * @param epi: epilogue, or NULL for a plain product.
+ * @param work: workspace of gemm_workspace(a->rows, n, a->cols) elements. NULL to allocate one internally.
+ */
+void gemm_packed_a_ws(elm_t *c, const PackedWeights *a, const elm_t *b, const size_t n, const GemmEpilogue *epi,
+    elm_t *work) {
+    const elm_t *panels = a->tile == simd_ops()->gemm_mr ? a->panels : NULL;
+    gemm_run_(c, a->matrix, panels, b, NULL, a->rows, n, a->cols, epi, work);
+}
+
+/**
+ * Matrix multiplication c = a * b as gemm_epilogue_ws, with a prepacked right operand. The kernel reads b's panels in
+ * place, so only a is packed per call; small products use b's row-major matrix. Panels packed for another register
+ * tile width are ignored.
+ *
+ * @param c: m x b->cols result, overwritten.
+ * @param a: m x b->rows matrix.
+ * @param b: b->rows x b->cols weights, see gemm_pack_b.
+ * @param m: rows of a and c.
+ * @param epi: epilogue, or NULL for a plain product.
+ * @param work: workspace of gemm_workspace(m, b->cols, b->rows) elements. NULL to allocate one internally.
+ */
+void gemm_packed_b_ws(elm_t *c, const elm_t *a, const PackedWeights *b, const size_t m, const GemmEpilogue *epi,
+    elm_t *work) {
+    const elm_t *panels = b->tile == simd_ops()->gemm_nr ? b->panels : NULL;
+    gemm_run_(c, a, NULL, b->matrix, panels, m, b->cols, b->rows, epi, work);
+}
@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "functional.h"
+#include "computational.h"
+#include "components.h"
+#include "arena.h"
+#include "gemm.h"
+#include "simd.h"
+#include "half.h"
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static HalfWeights *make_half_(const Precision prec, const size_t rows, const size_t cols) {
+    // malloc, one contiguous block of rows x cols values
+    HalfWeights *half = malloc(sizeof(HalfWeights));
+    uint16_t *arr = malloc((rows * cols != 0 ? rows * cols : 1) * sizeof(uint16_t));
+    if (half == NULL || arr == NULL) {
+        fprintf(stderr, "Failed malloc: half-precision weights sized %zu x %zu.\n", rows, cols);
+        free(half); free(arr);
+        return NULL;
+    }
+    *half = (HalfWeights){.prec=prec, .rows=rows, .cols=cols, .stride=cols, .arr=arr, .owned=1};
+    return half;
+}
+
+static void narrow_arr_(uint16_t *dst, const elm_t *src, const size_t len, const Precision prec) {
+    for (size_t elm = 0; elm < len; elm++) dst[elm] = narrow_elm(src[elm], prec);
+}
+
+static size_t conv_inner_workspace_(const Batch *channels, const Convolutional *kernels, const Pooler *pooler) {
+    // workspace of the single-precision op a half-precision conv hands off to
+    if (pooler != NULL) return batch_conv_pool_workspace(channels, kernels, pooler);
+    return batch_convolution_workspace(channels, kernels);
+}
+
+static Convolutional *widen_conv_(const Convolutional *conv, const HalfWeights *half) {
+    // malloc, layer, kernel pointers, kernels and widened kernel arrays in one block
+    const size_t num = conv->num, len = half->cols;
+    const size_t head = sizeof(Convolutional) + num * (sizeof(Kernel*) + sizeof(Kernel));
+    char *block = malloc(head + num * len * sizeof(elm_t));
+    if (block == NULL) {
+        fprintf(stderr, "Failed malloc: widened Convolutional of %zu kernels.\n", num);
+        return NULL;
+    }
+    Convolutional *wide = (Convolutional *)block;
+    Kernel **ptrs = (Kernel **)(block + sizeof(Convolutional));
+    Kernel *kernels = (Kernel *)(block + sizeof(Convolutional) + num * sizeof(Kernel*));
+    elm_t *arrs = (elm_t *)(block + head);
+
+    // shapes and biases copied, rows widened
+    for (size_t kern = 0; kern < num; kern++) {
+        kernels[kern] = *conv->kernels[kern];
+        kernels[kern].arr = &arrs[kern * len];
+        widen_arr(kernels[kern].arr, &half->arr[kern * half->stride], len, half->prec);
+        ptrs[kern] = &kernels[kern];
+    }
+    *wide = (Convolutional){.kernels=ptrs, .num=num, .packed=NULL};
+    return wide;
+}
+
+static Dense *widen_dense_(const Dense *dense, const HalfWeights *half) {
+    // malloc, layer, weight tensor and widened weights in one block; biases stay shared
+    const size_t m = half->rows, n = half->cols;
+    const size_t head = sizeof(Dense) + sizeof(Tensor);
+    char *block = malloc(head + m * n * sizeof(elm_t));
+    if (block == NULL) {
+        fprintf(stderr, "Failed malloc: widened Dense sized %zu x %zu.\n", m, n);
+        return NULL;
+    }
+    Dense *wide = (Dense *)block;
+    Tensor *weights = (Tensor *)(block + sizeof(Dense));
+    elm_t *arr = (elm_t *)(block + head);
+    for (size_t row = 0; row < m; row++) widen_arr(&arr[row * n], &half->arr[row * half->stride], n, half->prec);
+    *weights = (Tensor){.m=m, .n=n, .o=1, .arr=arr};
+    *wide = (Dense){.weights=weights, .biases=dense->biases, .packed=NULL};
+    return wide;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Rounds a value to half precision, to nearest even. fp16 overflows to infinity; bf16 keeps the float32 range.
+ *
+ * @param val: value.
+ * @param prec: storage type, PREC_FP16 or PREC_BF16.
+ *
+ * @return: half-precision bits.
+ */
+uint16_t narrow_elm(const elm_t val, const Precision prec) {
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    if (prec == PREC_BF16) {
+        // quiet nans stay nans, everything else rounds on the dropped half
+        if ((bits & 0x7FFFFFFFu) > 0x7F800000u) return (uint16_t)(bits >> 16 | 0x40);
+        return (uint16_t)((bits + 0x7FFFu + (bits >> 16 & 1)) >> 16);
+    }
+
+    // fp16: 1 sign, 5 exponent, 10 mantissa bits
+    const uint16_t sign = (uint16_t)(bits >> 16 & 0x8000);
+    const uint32_t mag = bits & 0x7FFFFFFFu;
+    if (mag >= 0x7F800000u) return sign | (mag > 0x7F800000u ? 0x7E00 : 0x7C00);
+    if (mag >= 0x477FF000u) return sign | 0x7C00;
+    if (mag < 0x38800000u) {
+        // subnormal in units of 2^-24, rounded to nearest even by the float add; 1024 carries into the exponent
+        float abs;
+        memcpy(&abs, &mag, sizeof(abs));
+        volatile float shifted = abs * 0x1p24f + 0x1p23f;
+        return sign | (uint16_t)(shifted - 0x1p23f);
+    }
+    // normal, rebiased exponent with the carry of round to nearest even
+    return sign | (uint16_t)((mag + 0xC8000FFFu + (mag >> 13 & 1)) >> 13);
+}
+
+/**
+ * Widens half-precision values to elm_t.
+ *
+ * @param dst: len elements.
+ * @param src: len half-precision values.
+ * @param len: number of values.
+ * @param prec: storage type of src, PREC_FP16 or PREC_BF16.
+ */
+void widen_arr(elm_t *dst, const uint16_t *src, const size_t len, const Precision prec) {
+    const SimdOps *ops = simd_ops();
+    if (prec == PREC_BF16) {
+        ops->widen_bf16(dst, src, len);
+    } else {
+        ops->widen_f16(dst, src, len);
+    }
+}
+
+/**
+ * Stores the kernels of a convolutional layer in half precision, one row per kernel. Biases stay single precision.
+ * Caller is responsible for freeing returned weights with free_half.
+ *
+ * @param conv: convolutional layer; all kernels must share shape.
+ * @param prec: storage type, PREC_FP16 or PREC_BF16.
+ *
+ * @return: half-precision weights. NULL for malloc fail.
+ */
+HalfWeights *narrow_conv(const Convolutional *conv, const Precision prec) {
+    const Kernel *k_ref = conv->kernels[0];
+    const size_t len = k_ref->m * k_ref->n * k_ref->o;
+    HalfWeights *half = make_half_(prec, conv->num, len);
+    if (half == NULL) return NULL;
+    for (size_t kern = 0; kern < conv->num; kern++) {
+        narrow_arr_((uint16_t *)&half->arr[kern * len], conv->kernels[kern]->arr, len, prec);
+    }
+    return half;
+}
+
+/**
+ * Stores the weights of a dense layer in half precision, in the same layout. Biases stay single precision.
+ * Caller is responsible for freeing returned weights with free_half.
+ *
+ * @param dense: dense layer.
+ * @param prec: storage type, PREC_FP16 or PREC_BF16.
+ *
+ * @return: half-precision weights. NULL for malloc fail.
+ */
+HalfWeights *narrow_dense(const Dense *dense, const Precision prec) {
+    const Tensor *weights = dense->weights;
+    HalfWeights *half = make_half_(prec, weights->m, weights->n);
+    if (half == NULL) return NULL;
+    narrow_arr_((uint16_t *)half->arr, weights->arr, weights->m * weights->n, prec);
+    return half;
+}
+
+/**
+ * Frees half-precision weights. Values held in a mapping are not freed. If half is NULL, passes.
+ *
+ * @param half: weights to be freed.
+ */
+void free_half(HalfWeights *half) {
+    if (half == NULL) return;
+    if (half->owned) free((uint16_t *)half->arr);
+    free(half);
+}
+
+/**
+ * Copies a layer list with half-precision weights for every conv and dense layer, narrowed from the single-precision
+ * parameters, or from the widened half-precision weights of layers that already hold them. Copies share the layer
+ * structs with the originals.
+ * Caller is responsible for freeing returned layers with free_half_layers.
+ *
+ * @param layers: layers in forward order.
+ * @param num: number of layers.
+ * @param prec: storage type, PREC_FP16 or PREC_BF16.
+ *
+ * @return: layer list of num layers. NULL for malloc fail.
+ */
+Layer *narrow_layers(const Layer *layers, const size_t num, const Precision prec) {
+    Layer *narrowed = malloc((num != 0 ? num : 1) * sizeof(Layer));
+    if (narrowed == NULL) {
+        fprintf(stderr, "Failed malloc: %zu half-precision layers.\n", num);
+        return NULL;
+    }
+    for (size_t idx = 0; idx < num; idx++) {
+        narrowed[idx] = layers[idx];
+        narrowed[idx].half = NULL;
+        if (layers[idx].type != LAYER_CONV && layers[idx].type != LAYER_DENSE) continue;
+        // weights already held in half precision are widened for the copy only
+        Layer *wide = widen_layers(&layers[idx], 1);
+        if (wide != NULL) {
+            narrowed[idx].half = layers[idx].type == LAYER_CONV ? narrow_conv(wide->conv, prec)
+                : narrow_dense(wide->dense, prec);
+            free_wide_layers(wide, 1);
+        }
+        if (narrowed[idx].half == NULL) {
+            free_half_layers(narrowed, idx);
+            return NULL;
+        }
+    }
+    return narrowed;
+}
+
+/**
+ * Frees a layer list from narrow_layers. Shared single-precision parameters are not freed. If layers is NULL, passes.
+ *
+ * @param layers: layers to be freed.
+ * @param num: number of layers.
+ */
+void free_half_layers(Layer *layers, const size_t num) {
+    if (layers == NULL) return;
+    for (size_t idx = 0; idx < num; idx++) free_half(layers[idx].half);
+    free(layers);
+}
+
+/**
+ * Copies a layer list with single-precision weights widened from every half-precision conv and dense layer, for the
+ * consumers that read weights directly: quantization, narrowing to another type and visualization. Layers without
+ * half-precision weights are shared with the originals; widened copies keep their half-precision weights, so they
+ * still run on the half-precision ops. Meant to be short-lived, the single-precision weights are only held here.
+ * Caller is responsible for freeing returned layers with free_wide_layers.
+ *
+ * @param layers: layers in forward order.
+ * @param num: number of layers.
+ *
+ * @return: layer list of num layers. NULL for malloc fail.
+ */
+Layer *widen_layers(const Layer *layers, const size_t num) {
+    Layer *wide = malloc((num != 0 ? num : 1) * sizeof(Layer));
+    if (wide == NULL) {
+        fprintf(stderr, "Failed malloc: %zu widened layers.\n", num);
+        return NULL;
+    }
+    for (size_t idx = 0; idx < num; idx++) {
+        wide[idx] = layers[idx];
+        if (layers[idx].half == NULL) continue;
+        if (layers[idx].type == LAYER_CONV) {
+            wide[idx].conv = widen_conv_(layers[idx].conv, layers[idx].half);
+            if (wide[idx].conv != NULL) continue;
+        } else {
+            wide[idx].dense = widen_dense_(layers[idx].dense, layers[idx].half);
+            if (wide[idx].dense != NULL) continue;
+        }
+        free_wide_layers(wide, idx);
+        return NULL;
+    }
+    return wide;
+}
+
+/**
+ * Frees a layer list from widen_layers. Shared layers and half-precision weights are not freed. If layers is NULL,
+ * passes.
+ *
+ * @param layers: layers to be freed.
+ * @param num: number of layers.
+ */
+void free_wide_layers(Layer *layers, const size_t num) {
+    if (layers == NULL) return;
+    for (size_t idx = 0; idx < num; idx++) {
+        // single blocks
+        if (layers[idx].half == NULL) continue;
+        if (layers[idx].type == LAYER_CONV) free(layers[idx].conv);
+        if (layers[idx].type == LAYER_DENSE) free(layers[idx].dense);
+    }
+    free(layers);
+}
+
+/**
+ * Workspace elements batch_conv_half_into takes from its arena.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ * @param pooler: fused pooling kernel, or NULL.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_conv_half_workspace(const Batch *channels, const Convolutional *kernels, const Pooler *pooler) {
+    const Kernel *k_ref = kernels->kernels[0];
+    return arena_bytes(kernels->num * k_ref->m * k_ref->n * k_ref->o) / sizeof(elm_t)
+        + conv_inner_workspace_(channels, kernels, pooler);
+}
+
+/**
+ * Convolution of every item of a batch with a full convolutional layer stored in half precision, into a
+ * caller-provided batch. Kernels are widened into the arena once per call, then run on the single-precision backend
+ * selected with set_conv_backend, or fused with max pooling when pooler is set; accumulation is single precision.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; shapes, strides and biases are taken from here.
+ * @param half: half-precision weights of the layer, one row per kernel.
+ * @param pooler: fused pooling kernel, or NULL.
+ * @param arena: arena for the widened kernels and the op workspace, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_half_into(Batch *res, const Batch *channels, const Convolutional *kernels, const HalfWeights *half,
+    const Pooler *pooler, Arena *arena) {
+    // dimensionality check
+    const size_t num = kernels->num;
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t len = k_ref->m * k_ref->n * k_ref->o;
+    if (half->rows != num || half->cols != len) {
+        fprintf(stderr, "Dimensional mismatch: kernels (%zu x %zu) != half weights (%zu x %zu).\n", num, len,
+            half->rows, half->cols);
+        return NULL;
+    }
+
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    elm_t *wide = arena_scratch(arena, num * len);
+    if (wide == NULL) {
+        fprintf(stderr, "Failed malloc: widened kernels sized %zu x %zu.\n", num, len);
+        return NULL;
+    }
+
+    // widened kernels, shape and bias of the originals
+    Kernel set[num];
+    Kernel *ptrs[num];
+    for (size_t kern = 0; kern < num; kern++) {
+        widen_arr(&wide[kern * len], &half->arr[kern * half->stride], len, half->prec);
+        set[kern] = *kernels->kernels[kern];
+        set[kern].arr = &wide[kern * len];
+        ptrs[kern] = &set[kern];
+    }
+    const Convolutional widened = {.kernels=ptrs, .num=num};
+
+    // convolution operation
+    Batch *out;
+    if (pooler != NULL) {
+        out = batch_conv_pool_into(res, channels, &widened, pooler, arena);
+    } else if (get_conv_backend() == CONV_IM2COL) {
+        out = batch_conv_im2col_into(res, channels, &widened, arena);
+    } else {
+        out = batch_conv_direct_into(res, channels, &widened);
+    }
+
+    // free and return
+    arena_drop(arena, wide, mark);
+    return out;
+}
+
+/**
+ * Workspace elements batch_dense_half_into takes from its arena.
+ *
+ * @param input: flattened batch of activations.
+ * @param half: half-precision weights of the layer.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_dense_half_workspace(const Batch *input, const HalfWeights *half) {
+    return gemm_half_workspace(input->b, half->cols, half->rows);
+}
+
+/**
+ * Dense layer over every item of a flattened batch with weights stored in half precision, into a caller-provided
+ * batch. Weights are widened as gemm packs them; accumulation is single precision. The bias is added after.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param input: flattened batch of activations.
+ * @param dense: dense layer; biases are taken from here.
+ * @param half: half-precision weights of the layer.
+ * @param arena: arena for gemm packing buffers, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_dense_half_into(Batch *res, const Batch *input, const Dense *dense, const HalfWeights *half,
+    Arena *arena) {
+    // dimensionality check
+    const size_t t = input->m * input->n * input->o, b = input->b;
+    if (t != half->rows || half->stride != half->cols) {
+        fprintf(stderr, "Dimensional mismatch: input (%zu) != half weights (%zu).\n", t, half->rows);
+        return NULL;
+    }
+
+    // struct setup
+    res->m = 1; res->n = half->cols; res->o = 1; res->b = b;
+
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    const size_t work_size = batch_dense_half_workspace(input, half);
+    elm_t *work = work_size != 0 ? arena_scratch(arena, work_size) : NULL;
+    if (work_size != 0 && work == NULL) {
+        fprintf(stderr, "Failed malloc: gemm packing buffers sized %zu.\n", work_size);
+        return NULL;
+    }
+
+    // matmul, stacked items
+    const elm_t *ok = gemm_half_ws(res->arr, input->arr, half->arr, half->prec, b, half->cols, t, work);
+    if (work != NULL) arena_drop(arena, work, mark);
+    if (ok == NULL) return NULL;
+
+    // bias
+    return batch_sum_into(res, res, dense->biases);
+}
@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include "types.h"
 #include "functional.h"
+#include "view.h"
 #include "helpers.h"
 
 #include <string.h>
@@ -40,7 +41,7 @@ static void print_arr_(const elm_t *arr, const size_t m, const size_t n, const s
 
 static elm_t *read_arr_(FILE *f, const size_t size) {
     // malloc
-    elm_t *arr = malloc(size * sizeof(elm_t));
+    elm_t *arr = alloc_arr(size);
     if (arr == NULL) {
         fprintf(stderr, "Failed malloc: array sized %zu.\n", size);
         return NULL;
@@ -124,43 +125,46 @@ Kernel *read_kernel_(FILE *fp) {
     return kernel;
 }
 
-elm_t max_val_(const elm_t *arr, const size_t size) {
-    elm_t max_val = arr[0];
-    for (size_t elm = 1; elm < size; elm++) {
-        if (arr[elm] > max_val) max_val = arr[elm];
+elm_t max_val_(const View *view, const size_t chan) {
+    elm_t max_val = view_get(view, 0, 0, chan);
+    for (size_t elm = 1; elm < view->m * view->n; elm++) {
+        const elm_t val = view_get(view, elm / view->n, elm % view->n, chan);
+        if (val > max_val) max_val = val;
     }
     return max_val;
 }
 
-elm_t min_val_(const elm_t *arr, const size_t size) {
-    elm_t min_val = arr[0];
-    for (size_t elm = 1; elm < size; elm++) {
-        if (arr[elm] < min_val) min_val = arr[elm];
+elm_t min_val_(const View *view, const size_t chan) {
+    elm_t min_val = view_get(view, 0, 0, chan);
+    for (size_t elm = 1; elm < view->m * view->n; elm++) {
+        const elm_t val = view_get(view, elm / view->n, elm % view->n, chan);
+        if (val < min_val) min_val = val;
     }
     return min_val;
 }
 
-char *vis_mat_(const elm_t *mat, const Tensor *tens) {
+char *vis_mat_(const View *view, const size_t chan) {
     // setup out str
-    char *out_str = malloc(tens->m * tens->n * sizeof(char) + 1);
+    char *out_str = malloc(view->m * view->n * sizeof(char) + 1);
     if (out_str == NULL) {
-        fprintf(stderr, "Failed malloc: str of size %zu.\n", tens->m * tens->n + 1);
+        fprintf(stderr, "Failed malloc: str of size %zu.\n", view->m * view->n + 1);
         return NULL;
     }
-    out_str[tens->m * tens->n] = '\0';
+    out_str[view->m * view->n] = '\0';
 
     // setup reference
-    elm_t max_val = max_val_(mat, tens->m * tens->n);
-    elm_t min_val = min_val_(mat, tens->m * tens->n);
+    elm_t max_val = max_val_(view, chan);
+    elm_t min_val = min_val_(view, chan);
     if (max_val < 0.0) max_val = -max_val;
     if (min_val < 0.0) min_val = -min_val;
     const elm_t max_abs_val = max_val > min_val ? max_val : min_val;
 
     // create out str
-    for (size_t elm = 0; elm < tens->m * tens->n; elm++) {
+    for (size_t elm = 0; elm < view->m * view->n; elm++) {
         const char ref[] = " .,:-+=%$#";
         // abs elm
-        const elm_t ref_elm = 0 < mat[elm] ? mat[elm] : -mat[elm];
+        const elm_t val = view_get(view, elm / view->n, elm % view->n, chan);
+        const elm_t ref_elm = 0 < val ? val : -val;
         // scale elm
         const elm_t elm_adj = (elm_t)(ref_elm / max_abs_val * 10 - 1e-06);
         out_str[elm] = ref[(int)elm_adj];
@@ -168,17 +172,17 @@ char *vis_mat_(const elm_t *mat, const Tensor *tens) {
     return out_str;
 }
 
-bool *sgn_mat_(const elm_t *mat, const Tensor *tens) {
+bool *sgn_mat_(const View *view, const size_t chan) {
     // setup out arr
-    bool *sgn_arr = malloc(tens->m * tens->n * sizeof(bool));
+    bool *sgn_arr = malloc(view->m * view->n * sizeof(bool));
     if (sgn_arr == NULL) {
-        fprintf(stderr, "Failed malloc: arr of size %zu.\n", tens->m * tens->n);
+        fprintf(stderr, "Failed malloc: arr of size %zu.\n", view->m * view->n);
         return NULL;
     }
 
     // create sgn arr
-    for (size_t elm = 0; elm < tens->m * tens->n; elm++) {
-        sgn_arr[elm] = 0 < mat[elm];
+    for (size_t elm = 0; elm < view->m * view->n; elm++) {
+        sgn_arr[elm] = 0 < view_get(view, elm / view->n, elm % view->n, chan);
     }
     return sgn_arr;
 }
@@ -410,6 +414,7 @@ Dense *read_dense(const char *filename) {
     }
     dense->weights = weights;
     dense->biases = biases;
+    dense->packed = NULL;
     return dense;
 }
 
@@ -470,6 +475,7 @@ Convolutional *read_convolutional(const char *filename) {
     // struct setup
     convolutional->num = num;
     convolutional->kernels = kernels;
+    convolutional->packed = NULL;
     fclose(fp);
     return convolutional;
 }
@@ -499,37 +505,37 @@ size_t read_label(const char *filename) {
 }
 
 /**
- * Visualizes a tensor with an image.
+ * Visualizes a view with an image, one panel per channel. Strided views are read in place.
  *
- * @param tens: tensor.
+ * @param view: view.
  * @param label: image label.
  * @param h_stretch: image horizontal stretch.
  * @param v_stretch: image vertical stretch.
  */
-void vis_tensor(const Tensor *tens, const char *label, const size_t h_stretch, const size_t v_stretch) {
+void vis_view(const View *view, const char *label, const size_t h_stretch, const size_t v_stretch) {
     // label verification
     const size_t label_size = strlen(label);
-    if (h_stretch * tens->n < label_size) {
-        fprintf(stderr, "Oversized label: maximum label size %zu.\n", h_stretch * tens->n - 1);
+    if (h_stretch * view->n < label_size) {
+        fprintf(stderr, "Oversized label: maximum label size %zu.\n", h_stretch * view->n - 1);
         return;
     }
 
     // print top
     printf("+");
-    for (size_t j = 0; j < h_stretch * tens->n; j++) printf("-");
+    for (size_t j = 0; j < h_stretch * view->n; j++) printf("-");
     printf("+\n");
 
     // print tensors
-    for (size_t mat = 0; mat < tens->o; mat++) {
+    for (size_t mat = 0; mat < view->o; mat++) {
         // setup arrs
-        char *str_arr = vis_mat_(&tens->arr[mat * tens->m * tens->n], tens);
-        bool *sgn_arr = sgn_mat_(&tens->arr[mat * tens->m * tens->n], tens);
+        char *str_arr = vis_mat_(view, mat);
+        bool *sgn_arr = sgn_mat_(view, mat);
 
-        for (size_t row = 0; row < tens->m; row++) { for (size_t _v = 0; _v < v_stretch; _v++) {
+        for (size_t row = 0; row < view->m; row++) { for (size_t _v = 0; _v < v_stretch; _v++) {
             // border
             printf("|");
-            for (size_t col = 0; col < tens->n; col++) { for (size_t _h = 0; _h < h_stretch; _h++) {
-                const size_t elm = row * tens->n + col;
+            for (size_t col = 0; col < view->n; col++) { for (size_t _h = 0; _h < h_stretch; _h++) {
+                const size_t elm = row * view->n + col;
                 // color
                 sgn_arr[elm] ? printf("\x1b[0m") : printf("\x1b[37m");
                 // element
@@ -540,9 +546,9 @@ void vis_tensor(const Tensor *tens, const char *label, const size_t h_stretch, c
         }}
 
         // seperator
-        if (mat + 1 != tens->o) {
+        if (mat + 1 != view->o) {
             printf("+");
-            for (size_t j = 0; j < h_stretch * tens->n; j++) printf("-");
+            for (size_t j = 0; j < h_stretch * view->n; j++) printf("-");
             printf("+\n");
         }
 
@@ -552,14 +558,27 @@ void vis_tensor(const Tensor *tens, const char *label, const size_t h_stretch, c
 
     // bottom
     printf("+");
-    const size_t center = (h_stretch * tens->n - label_size) / 2;
+    const size_t center = (h_stretch * view->n - label_size) / 2;
     for (size_t b = 0; b < center; b++) printf("-");
     // label
     printf("%s", label);
-    for (size_t b = 0; b < h_stretch * tens->n - center - label_size; b++) printf("-");
+    for (size_t b = 0; b < h_stretch * view->n - center - label_size; b++) printf("-");
     printf("+\n");
 }
 
+/**
+ * Visualizes a tensor with an image.
+ *
+ * @param tens: tensor.
+ * @param label: image label.
+ * @param h_stretch: image horizontal stretch.
+ * @param v_stretch: image vertical stretch.
+ */
+void vis_tensor(const Tensor *tens, const char *label, const size_t h_stretch, const size_t v_stretch) {
+    const View view = tensor_view(tens);
+    vis_view(&view, label, h_stretch, v_stretch);
+}
+
 /**
  * Visualizes a dense layer with an image.
  *
@@ -568,11 +587,11 @@ void vis_tensor(const Tensor *tens, const char *label, const size_t h_stretch, c
  * @param v_stretch: image vertical stretch.
  */
 void vis_dense(const Dense *dense, const size_t h_stretch, const size_t v_stretch) {
-    // vis weights and biases
-    Tensor *w_transpose = transpose(dense->weights);
-    vis_tensor(w_transpose, "w^T", h_stretch, v_stretch);
+    // vis weights through a transposed view, and biases
+    const View weights = tensor_view(dense->weights);
+    const View w_transpose = view_transpose(&weights);
+    vis_view(&w_transpose, "w^T", h_stretch, v_stretch);
     vis_tensor(dense->biases, "b", h_stretch, v_stretch);
-    free_tensor(w_transpose);
 }
 
 /**
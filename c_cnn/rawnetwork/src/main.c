@@ -4,20 +4,269 @@
 #include "computational.h"
 #include "components.h"
 #include "activators.h"
+#include "simd.h"
+#include "arena.h"
+#include "thread_pool.h"
+#include "dataset.h"
+#include "prefetch.h"
+#include "model.h"
+#include "plan.h"
+#include "profile.h"
+#include "quant.h"
+#include "half.h"
+#include "pack.h"
 #include <stdio.h>
+#include <string.h>
+
+// per-worker state; nothing here is shared between threads
+typedef struct {
+    Arena *arena;
+    elm_t *region;
+    Tensor **imgs;
+    Sample *samples;
+    Batch input;
+    size_t *labels;
+    size_t correct;
+    int failed;
+} Worker;
+
+// shared state of a multithreaded evaluation
+typedef struct {
+    const Plan *plan;
+    const Dataset *dataset;
+    Worker *workers;
+    size_t number;
+    size_t batch;
+    // per-point results, written by whichever worker evaluates the point
+    size_t *labels;
+    elm_t *outputs;
+} Evaluation;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static int read_chunk_(Worker *worker, const Dataset *dataset, Prefetcher *prefetcher, const size_t start,
+    const size_t num) {
+    worker->input.arr = NULL;
+    for (size_t idx = 0; idx < num; idx++) {
+        // from the prefetch queue, or read in place; dataset samples are zero-copy views
+        const int ok = prefetcher != NULL ? prefetch_next(prefetcher, &worker->samples[idx])
+            : read_sample(dataset, start + idx, &worker->samples[idx]);
+        if (!ok) {
+            for (size_t prev = 0; prev < idx; prev++) free_sample(&worker->samples[prev]);
+            return 0;
+        }
+        worker->imgs[idx] = &worker->samples[idx].img;
+        worker->labels[idx] = worker->samples[idx].label;
+    }
+    // the whole chunk at once when dataset records are unpadded
+    if (dataset != NULL && !dataset_batch(dataset, start, num, &worker->input)) worker->input.arr = NULL;
+    return 1;
+}
+
+static void release_chunk_(Worker *worker, const size_t num) {
+    // dataset views are not owned
+    for (size_t idx = 0; idx < num; idx++) free_sample(&worker->samples[idx]);
+}
+
+static int input_shape_(const Dataset *dataset, Tensor *shape) {
+    // dims of the first point; the plan is compiled for this input shape
+    if (dataset != NULL) {
+        *shape = dataset_image(dataset, 0);
+        return 1;
+    }
+    Sample first;
+    if (!read_sample(NULL, 0, &first)) return 0;
+    *shape = first.img;
+    free_sample(&first);
+    return 1;
+}
+
+static int forward_(const Plan *plan, Profile *profile, Worker *worker, const size_t num, Batch *yhat) {
+    // activations, shapes and offsets fixed by the plan
+    worker->region = plan_begin(plan, worker->arena);
+    if (worker->region == NULL) return 0;
+    Batch x = worker->input;
+    if (x.arr == NULL) {
+        x = plan_value(plan, worker->region, 0, num);
+        if (stack_into(&x, worker->imgs, num) == NULL) return 0;
+    }
+    // timed per layer and op when profiling
+    const int ok = profile != NULL ? profile_run(profile, plan, worker->region, &x, worker->arena)
+        : plan_run(plan, worker->region, &x, worker->arena);
+    if (!ok) {
+        fprintf(stderr, "Failed forward pass.\n");
+        return 0;
+    }
+    *yhat = plan_value(plan, worker->region, plan->num_values - 1, num);
+    return 1;
+}
+
+static Layer *calibrate_(const Layer *layers, const size_t num_layers, const Tensor *x_shape, const Dataset *dataset,
+    Worker *worker, const size_t number, const size_t batch, const size_t calib, size_t *preds, size_t *correct) {
+    // fp32 plan keeping every value, so each layer input can be measured after a run
+    Plan *plan = make_plan(layers, num_layers, x_shape->m, x_shape->n, x_shape->o, batch, 0, 1, 0);
+    if (plan == NULL) return NULL;
+    worker->arena = make_arena(plan_arena_bytes(plan));
+    elm_t *ranges = calloc(plan->num_values, sizeof(elm_t));
+    int ok = worker->arena != NULL && ranges != NULL;
+
+    // fp32 reference predictions over every point, ranges over the first calib points
+    for (size_t start = 0; ok && start < number; start += batch) {
+        const size_t num = number - start < batch ? number - start : batch;
+        Batch yhat;
+        ok = read_chunk_(worker, dataset, NULL, start, num);
+        if (!ok) break;
+        // stacked into the region rather than viewed in place, so the input range is measured too
+        worker->input.arr = NULL;
+        ok = forward_(plan, NULL, worker, num, &yhat);
+        if (ok && start < calib) {
+            calibrate_plan(plan, worker->region, calib - start < num ? calib - start : num, ranges);
+        }
+        for (size_t idx = 0; ok && idx < num; idx++) {
+            const Tensor y_item = batch_item(&yhat, idx);
+            preds[start + idx] = argmax(&y_item);
+            if (preds[start + idx] == worker->labels[idx]) (*correct)++;
+        }
+        release_chunk_(worker, num);
+    }
+    Layer *quantized = ok ? quantize_layers(plan, ranges) : NULL;
+
+    // free
+    free(ranges);
+    free_arena(worker->arena);
+    worker->arena = NULL;
+    free_plan(plan);
+    return quantized;
+}
+
+static void report_(const char mode, const size_t pt, const size_t number, const size_t label,
+    const Tensor *y_item, const Tensor *img, const size_t correct) {
+    // terminal outputs
+    if (mode == 'n') {
+        // print current progress
+        const float acc = (float)correct / (float)(pt + 1);
+        printf("\r%zu/%zu points; %zu/%zu correct; %.4g%% accuracy;", pt + 1, number, correct, pt + 1, 100 * acc);
+    } else if (mode == 'd') {
+        // print output
+        printf("expected %zu; raw output [", label);
+        for (size_t elm = 0; elm < y_item->n - 1; elm++) {
+            printf("%f  ", y_item->arr[elm]);
+        }
+        printf("%f];\n", y_item->arr[y_item->n - 1]);
+    } else if (mode == 'i') {
+        // print image
+        char img_label[64];
+        snprintf(img_label, sizeof(img_label), "[yhat %zu | y %zu]", argmax(y_item), label);
+        printf("\n");
+        vis_tensor(img, img_label, 2, 1);
+    }
+}
+
+static void vis_activations_(const Plan *plan, elm_t *region, const Tensor *img, const size_t idx, const size_t pt,
+    const size_t label) {
+    char loop_label[32];
+    snprintf(loop_label, sizeof(loop_label), "\niteration %zu\n", pt + 1);
+    printf("%s", loop_label);
+    char img_label[32];
+    snprintf(img_label, sizeof(img_label), "[x | y%zu]", label);
+    vis_tensor(img, img_label, 2, 1);
+    // every step up to the output, conv activations numbered in order
+    size_t convs = 0;
+    for (size_t step = 0; step + 1 < plan->num_steps; step++) {
+        const LayerType type = plan->steps[step].layer->type;
+        if (type == LAYER_CONV) convs++;
+        const Batch out = plan_value(plan, region, plan->steps[step].out, idx + 1);
+        const Tensor item = batch_item(&out, idx);
+        char act_label[32];
+        if (type == LAYER_CONV && plan->steps[step].pool == NULL) {
+            snprintf(act_label, sizeof(act_label), "[a%zu]", convs);
+        } else if (type == LAYER_DENSE) {
+            snprintf(act_label, sizeof(act_label), "[d%zu]", step + 1);
+        } else {
+            snprintf(act_label, sizeof(act_label), "[pool  a%zu]", convs);
+        }
+        vis_tensor(&item, act_label, type == LAYER_DENSE ? 1 : 2, 1);
+    }
+    // flattened input of the output layer
+    const PlanStep *last = &plan->steps[plan->num_steps - 1];
+    if (last->layer->type == LAYER_DENSE) {
+        Batch flat = plan_value(plan, region, last->in, idx + 1);
+        batch_flatten(&flat);
+        const Tensor flat_item = batch_item(&flat, idx);
+        char flat_label[32];
+        snprintf(flat_label, sizeof(flat_label), "[flat  a%zu]", convs);
+        vis_tensor(&flat_item, flat_label, 1, 1);
+    }
+}
+
+static void evaluate_chunk_(void *ctx, const size_t task, const size_t worker_idx) {
+    Evaluation *eval = ctx;
+    Worker *worker = &eval->workers[worker_idx];
+    if (worker->failed) return;
+
+    // read and run one batch chunk
+    const size_t start = task * eval->batch;
+    const size_t num = eval->number - start < eval->batch ? eval->number - start : eval->batch;
+    Batch yhat;
+    if (!read_chunk_(worker, eval->dataset, NULL, start, num)) {
+        worker->failed = 1;
+        return;
+    }
+    worker->failed = !forward_(eval->plan, NULL, worker, num, &yhat);
+
+    // record per-point results
+    const size_t classes = yhat.m * yhat.n * yhat.o;
+    for (size_t idx = 0; idx < num; idx++) {
+        if (!worker->failed) {
+            const Tensor y_item = batch_item(&yhat, idx);
+            memcpy(&eval->outputs[(start + idx) * classes], y_item.arr, classes * sizeof(elm_t));
+            eval->labels[start + idx] = worker->labels[idx];
+            if (argmax(&y_item) == worker->labels[idx]) worker->correct++;
+        }
+    }
+    release_chunk_(worker, num);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
 
 /**
  * Main program. Runs forward pass for DATAPTS datapoints.
  *
  * @param argc: num args.
- * @param argv: two arguments. mode to execute: n=normal, d=debug, i=images, f=full images; and number of points.
+ * @param argv: two arguments. mode to execute: n=normal, d=debug, i=images, f=full images, p=profile per layer and op;
+ *              and number of points.
+ *              optional flags: -b <batch> number of images per forward pass (default 1);
+ *              -c <backend> convolution backend, direct or im2col (default direct);
+ *              -g <winograd> 3x3 stride-1 conv layers as winograd on kernels transformed at load, on or off; other
+ *              layers run on the -c backend (default on);
+ *              -t <fft> stride-1 conv layers in the frequency domain on kernel spectra computed at load, auto when
+ *              estimated cheaper than direct convolution, on or off; winograd takes precedence (default auto);
+ *              -l <layout> activations between conv and pool layers channel-major, or blocked in groups of 8
+ *              channels computed 8 kernels per vector; blocked conv layers take precedence over -g and -t, and
+ *              i and f modes stay channel-major (default planar);
+ *              -j <threads> worker threads evaluating batches in parallel, a lone batch instead split within
+ *              each layer (default 1, f and p modes always run serially);
+ *              -d <path> packed dataset file, memory-mapped (default one file per image and label in ../data);
+ *              -w <work> minimum multiply-adds of a layer op before it is split across threads (default 1048576);
+ *              -p <depth> read points ahead on a producer thread, up to depth queued (default off, serial runs only);
+ *              -m <path> model container file, memory-mapped (default one file per layer in parameters);
+ *              -k <cache> weights prepacked for the gemm kernels cached next to the model container, on or off
+ *              (default on; layers run in int8 or half precision are not packed);
+ *              -q <calib> run conv and dense layers in int8, input ranges calibrated on the first calib points with the
+ *              fp32 layers, and report accuracy against fp32 (default off);
+ *              -s <storage> conv and dense weights stored as fp16 or bf16 and widened as read, accumulation stays fp32
+ *              (default fp32, or as stored in the model container);
+ *              -e <exp> exp in sigmoid and softmax, fast vectorized polynomial or exact double precision
+ *              (default fast).
  *
  * @return: exit code: -1 for model load fail; 1 for run fail; 2 for start fail; 0 for complete run.
  */
 int main(const int argc, const char *argv[]) {
     // arguments
-    if (argc != 3) {
-        printf("Usage: %s <mode> <number>\n", argv[0]);
+    if (argc < 3) {
+        printf("Usage: %s <mode> <number> [-b batch] [-c direct|im2col] [-j threads] [-w work] [-d dataset]"
+            " [-p depth] [-m model] [-k on|off] [-q calib] [-s fp16|bf16] [-e fast|exact] [-g on|off]"
+            " [-t auto|on|off] [-l planar|blocked]\n", argv[0]);
         return 2;
     }
     // get arguments (we ignore strtol errors here)
@@ -26,123 +275,349 @@ int main(const int argc, const char *argv[]) {
     const long val = strtol(argv[2], &ptr, 10);
     const size_t number = (size_t)val;
 
-    // read parameters
-    Convolutional *conv1 = read_convolutional("parameters/conv1.bin");
-    Pooler *pool1 = read_pool("parameters/pool1.bin");
-    Convolutional *conv2 = read_convolutional("parameters/conv2.bin");
-    Pooler *pool2 = read_pool("parameters/pool2.bin");
-    Dense *dense1 = read_dense("parameters/dense1.bin");
-    // check errors
-    if (conv1 == NULL || pool1 == NULL || conv2 == NULL || pool2 == NULL || dense1 == NULL) {
-        fprintf(stderr, "Error reading network parameters.\n");
-        return -1;
+    // get flags
+    size_t batch = 1;
+    size_t threads = 1;
+    size_t depth = 0;
+    size_t calib = 0;
+    Precision storage = PREC_FP32;
+    int pack_cache = 1;
+    const char *data_path = NULL;
+    const char *model_path = NULL;
+    for (int arg = 3; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc) {
+            batch = (size_t)strtol(argv[++arg], &ptr, 10);
+        } else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "direct") == 0) {
+            set_conv_backend(CONV_DIRECT); arg++;
+        } else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "im2col") == 0) {
+            set_conv_backend(CONV_IM2COL); arg++;
+        } else if (strcmp(argv[arg], "-g") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "on") == 0) {
+            set_conv_winograd(1); arg++;
+        } else if (strcmp(argv[arg], "-g") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "off") == 0) {
+            set_conv_winograd(0); arg++;
+        } else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "auto") == 0) {
+            set_conv_fft(FFT_AUTO); arg++;
+        } else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "on") == 0) {
+            set_conv_fft(FFT_ON); arg++;
+        } else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "off") == 0) {
+            set_conv_fft(FFT_OFF); arg++;
+        } else if (strcmp(argv[arg], "-l") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "planar") == 0) {
+            set_conv_layout(LAYOUT_PLANAR); arg++;
+        } else if (strcmp(argv[arg], "-l") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "blocked") == 0) {
+            set_conv_layout(LAYOUT_BLOCKED); arg++;
+        } else if (strcmp(argv[arg], "-e") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "fast") == 0) {
+            set_exp_mode(EXP_FAST); arg++;
+        } else if (strcmp(argv[arg], "-e") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "exact") == 0) {
+            set_exp_mode(EXP_EXACT); arg++;
+        } else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            threads = (size_t)strtol(argv[++arg], &ptr, 10);
+        } else if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc) {
+            data_path = argv[++arg];
+        } else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) {
+            set_parallel_threshold((size_t)strtol(argv[++arg], &ptr, 10));
+        } else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            model_path = argv[++arg];
+        } else if (strcmp(argv[arg], "-k") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "on") == 0) {
+            pack_cache = 1; arg++;
+        } else if (strcmp(argv[arg], "-k") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "off") == 0) {
+            pack_cache = 0; arg++;
+        } else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) {
+            depth = (size_t)strtol(argv[++arg], &ptr, 10);
+        } else if (strcmp(argv[arg], "-q") == 0 && arg + 1 < argc) {
+            calib = (size_t)strtol(argv[++arg], &ptr, 10);
+        } else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "fp16") == 0) {
+            storage = PREC_FP16; arg++;
+        } else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "bf16") == 0) {
+            storage = PREC_BF16; arg++;
+        } else {
+            printf("Usage: %s <mode> <number> [-b batch] [-c direct|im2col] [-j threads] [-w work] [-d dataset]"
+            " [-p depth] [-m model] [-k on|off] [-q calib] [-s fp16|bf16] [-e fast|exact] [-g on|off]"
+            " [-t auto|on|off] [-l planar|blocked]\n", argv[0]);
+            return 2;
+        }
     }
+    if (batch == 0) batch = 1;
+    if (threads == 0 || mode == 'f' || mode == 'p') threads = 1;
 
-    // testing loop
-    size_t correct = 0;
-    for (size_t pt = 0; pt < number; pt++) {
-        // setup image and label location
-        char pt_filename[64];
-        char label_filename[64];
-        snprintf(pt_filename, sizeof(pt_filename), "../data/images/img_%zu.bin", pt);
-        snprintf(label_filename, sizeof(label_filename), "../data/labels/img_%zu.bin", pt);
-        // read image and label
-        Tensor *img = read_tensor(pt_filename);
-        const size_t label = read_label(label_filename);
-        if (img == NULL || label == (size_t) - 1) {
-            // error reading img or label
-            fprintf(stderr, "Error reading image data.\n");
+    // pick kernels for the host cpu
+    simd_init();
+
+    // read parameters, from a mapped model container or one file per layer
+    Model *model = NULL;
+    Convolutional *conv1 = NULL, *conv2 = NULL;
+    Pooler *pool1 = NULL, *pool2 = NULL;
+    Dense *dense1 = NULL;
+    Layer files[5];
+    const Layer *layers = files;
+    size_t num_layers = 5;
+    if (model_path != NULL) {
+        model = open_model(model_path);
+        if (model == NULL) {
+            fprintf(stderr, "Error reading network parameters.\n");
+            return -1;
+        }
+        layers = model->layers;
+        num_layers = model->num;
+    } else {
+        conv1 = read_convolutional("parameters/conv1.bin");
+        pool1 = read_pool("parameters/pool1.bin");
+        conv2 = read_convolutional("parameters/conv2.bin");
+        pool2 = read_pool("parameters/pool2.bin");
+        dense1 = read_dense("parameters/dense1.bin");
+        // check errors
+        if (conv1 == NULL || pool1 == NULL || conv2 == NULL || pool2 == NULL || dense1 == NULL) {
+            fprintf(stderr, "Error reading network parameters.\n");
+            return -1;
+        }
+        files[0] = (Layer){.type=LAYER_CONV, .activation=ACT_RELU, .conv=conv1};
+        files[1] = (Layer){.type=LAYER_POOL, .activation=ACT_NONE, .pool=pool1};
+        files[2] = (Layer){.type=LAYER_CONV, .activation=ACT_SIGMOID, .conv=conv2};
+        files[3] = (Layer){.type=LAYER_POOL, .activation=ACT_NONE, .pool=pool2};
+        files[4] = (Layer){.type=LAYER_DENSE, .activation=ACT_SOFTMAX, .dense=dense1};
+    }
+
+    // weights prepacked for the gemm kernels, cached next to a model container; not for layers about to be replaced
+    // by int8 or half-precision copies
+    char *cache = NULL;
+    Packs *packs = NULL;
+    const int pack = calib == 0 && storage == PREC_FP32;
+    if (pack && model_path != NULL && pack_cache) {
+        const size_t len = strlen(model_path) + sizeof(".pack");
+        cache = malloc(len);
+        if (cache == NULL) {
+            fprintf(stderr, "Failed malloc: pack cache path.\n");
+            return 1;
+        }
+        snprintf(cache, len, "%s.pack", model_path);
+    }
+    if (pack) {
+        packs = pack_layers(layers, num_layers, cache, model != NULL ? model_fingerprint(model) : 0);
+        if (packs == NULL) return 1;
+    }
+
+    // half-precision weight storage
+    Layer *narrowed = NULL;
+    if (storage != PREC_FP32) {
+        narrowed = narrow_layers(layers, num_layers, storage);
+        if (narrowed == NULL) return -1;
+        layers = narrowed;
+    }
+
+    // packed dataset
+    Dataset *dataset = NULL;
+    if (data_path != NULL) {
+        dataset = open_dataset(data_path);
+        if (dataset == NULL) return 1;
+        if (number > dataset->count) {
+            fprintf(stderr, "Invalid number: dataset holds %zu points.\n", dataset->count);
+            return 1;
+        }
+    }
+
+    // per-worker batch buffers
+    Worker *workers = calloc(threads, sizeof(Worker));
+    if (workers == NULL) {
+        fprintf(stderr, "Failed malloc: %zu workers.\n", threads);
+        return 1;
+    }
+    for (size_t worker = 0; worker < threads; worker++) {
+        workers[worker].imgs = malloc(batch * sizeof(Tensor*));
+        workers[worker].samples = malloc(batch * sizeof(Sample));
+        workers[worker].labels = malloc(batch * sizeof(size_t));
+        if (workers[worker].imgs == NULL || workers[worker].samples == NULL || workers[worker].labels == NULL) {
+            fprintf(stderr, "Failed malloc: batch of %zu.\n", batch);
             return 1;
         }
+    }
 
-        // full loop label
-        if (mode == 'f') {
-            char loop_label[32];
-            snprintf(loop_label, sizeof(loop_label), "\niteration %zu\n", pt + 1);
-            printf("%s", loop_label);
-            char img_label[32];
-            snprintf(img_label, sizeof(img_label), "[x | y%zu]", label);
-            vis_tensor(img, img_label, 2, 1);
-        }
-
-        // forward pass
-        // conv1, pool1
-        Tensor *a1_t = convolution(img, conv1, relu);
-        Tensor *a1 = pool(a1_t, pool1);
-        // full vis
-        if (mode == 'f') vis_tensor(a1_t, "[a1]", 2, 1);
-        if (mode == 'f') vis_tensor(a1, "[pool  a1]", 2, 1);
-        free_tensor(a1_t);
-        // conv2, pool2
-        Tensor *a2_t = convolution(a1, conv2, sigmoid);
-        free_tensor(a1);
-        // full vis
-        Tensor *a2 = pool(a2_t, pool2);
-        if (mode == 'f') vis_tensor(a2_t, "[a2]", 2, 1);
-        if (mode == 'f') vis_tensor(a2, "[pool  a2]", 2, 1);
-        free_tensor(a2_t);
-        // flatten
-        flatten(a2);
-        if (mode == 'f') vis_tensor(a2, "[flat  a2]", 1, 1);
-        // dense1
-        Tensor *yhat = dense(a2, dense1, softmax);
-        free_tensor(a2);
-        if (yhat == NULL) {
-            // forward pass fail
-            fprintf(stderr, "Failed forward pass.\n");
+    // persistent pool, shared by batch-level and layer-level parallelism; layer ops only split when not already
+    // running on a pool worker
+    ThreadPool *pool = NULL;
+    if (threads > 1) {
+        pool = make_thread_pool(threads);
+        if (pool == NULL) return 1;
+        set_compute_pool(pool);
+    }
+
+    // execution plan, shapes and buffers fixed once; conv and pool fused unless pre-pool activations are visualized
+    // or every layer is profiled on its own
+    Tensor x_shape;
+    if (!input_shape_(dataset, &x_shape)) return 1;
+
+    // int8 layers, calibrated and checked against fp32 predictions on a serial reference pass
+    Layer *quantized = NULL;
+    size_t *preds = NULL, ref_correct = 0;
+    if (calib != 0) {
+        preds = malloc((number != 0 ? number : 1) * sizeof(size_t));
+        if (preds == NULL) {
+            fprintf(stderr, "Failed malloc: predictions for %zu points.\n", number);
             return 1;
         }
-        // determine accuracy
-        if (argmax(yhat) == label) correct++;
-
-        // terminal outputs
-        if (mode == 'n') {
-            // print current progress
-            const float acc = (float)correct / (float)(pt + 1);
-            printf("\r%zu/%zu points; %zu/%zu correct; %.4g%% accuracy;", pt + 1, number, correct, pt + 1, 100 * acc);
-        } else if (mode == 'd') {
-            // print output
-            printf("expected %zu; raw output [", label);
-            for (size_t idx = 0; idx < yhat->n - 1; idx++) {
-                printf("%f  ", yhat->arr[idx]);
+        quantized = calibrate_(layers, num_layers, &x_shape, dataset, &workers[0], number, batch, calib, preds,
+            &ref_correct);
+        if (quantized == NULL) return 1;
+        layers = quantized;
+    }
+    const int vis = mode == 'f';
+    const int fused = !vis && mode != 'p' && get_conv_backend() == CONV_DIRECT;
+    // n and i modes only report the predicted class, d mode prints the whole output
+    const int top = mode == 'n' || mode == 'i';
+    Plan *plan = make_plan(layers, num_layers, x_shape.m, x_shape.n, x_shape.o, batch, fused, vis, top);
+    if (plan == NULL) return -1;
+    for (size_t worker = 0; worker < threads; worker++) {
+        workers[worker].arena = make_arena(plan_arena_bytes(plan));
+        if (workers[worker].arena == NULL) return 1;
+    }
+    Profile *profile = NULL;
+    if (mode == 'p') {
+        profile = make_profile(plan);
+        if (profile == NULL) return 1;
+    }
+
+    // testing loop
+    size_t correct = 0, agree = 0;
+    if (threads == 1) {
+        // serial, results reported as they are computed; points are read ahead on a producer thread with -p
+        Worker *worker = &workers[0];
+        Prefetcher *prefetcher = NULL;
+        if (depth != 0) {
+            prefetcher = make_prefetcher(dataset, number, depth);
+            if (prefetcher == NULL) return 1;
+        }
+        for (size_t start = 0; start < number; start += batch) {
+            const size_t num = number - start < batch ? number - start : batch;
+            Batch yhat;
+            if (!read_chunk_(worker, dataset, prefetcher, start, num)) return 1;
+            if (!forward_(plan, profile, worker, num, &yhat)) return 1;
+
+            for (size_t idx = 0; idx < num; idx++) {
+                const size_t pt = start + idx;
+                const size_t label = worker->labels[idx];
+                const Tensor y_item = batch_item(&yhat, idx);
+
+                // full vis
+                if (mode == 'f') vis_activations_(plan, worker->region, worker->imgs[idx], idx, pt, label);
+
+                // determine accuracy
+                if (argmax(&y_item) == label) correct++;
+                if (preds != NULL && argmax(&y_item) == preds[pt]) agree++;
+
+                // terminal outputs
+                report_(mode, pt, number, label, &y_item, worker->imgs[idx], correct);
+                if (mode == 'f') vis_tensor(&y_item, "0123456789", 1, 1);
             }
-            printf("%f];\n", yhat->arr[yhat->n - 1]);
-        } else if (mode == 'i') {
-            // print image
-            char img_label[64];
-            snprintf(img_label, sizeof(img_label), "[yhat %zu | y %zu]", argmax(yhat), label);
-            printf("\n");
-            vis_tensor(img, img_label, 2, 1);
+
+            // free
+            release_chunk_(worker, num);
+        }
+        if (prefetcher != NULL) {
+            // queue stats, a mean depth near 0 with many consumer stalls means reading is the bottleneck
+            const PrefetchStats stats = prefetch_stats(prefetcher);
+            const double mean = stats.taken != 0 ? (double)stats.depth_sum / (double)stats.taken : 0.0;
+            printf("\nprefetch: %zu taken; %.3g mean depth; %zu max depth; %zu consumer stalls; %zu producer stalls;",
+                stats.taken, mean, stats.depth_max, stats.consumer_stalls, stats.producer_stalls);
+            free_prefetcher(prefetcher);
+        }
+        if (profile != NULL) print_profile(profile);
+    } else {
+        // parallel, batch chunks distributed over a work-stealing pool
+        const PlanValue *output = &plan->values[plan->num_values - 1];
+        const size_t classes = output->m * output->n * output->o;
+        size_t *labels = malloc(number * sizeof(size_t));
+        elm_t *outputs = alloc_arr(number * classes);
+        if (labels == NULL || outputs == NULL) {
+            fprintf(stderr, "Failed malloc: results for %zu points.\n", number);
+            return 1;
         }
-        if (mode == 'f') vis_tensor(yhat, "0123456789", 1, 1);
+        Evaluation eval = {.plan=plan, .dataset=dataset, .workers=workers, .number=number, .batch=batch,
+            .labels=labels, .outputs=outputs};
+        thread_pool_run(pool, (number + batch - 1) / batch, evaluate_chunk_, &eval);
 
-        // free
-        free_tensor(img);
-        free_tensor(yhat);
+        // reduce per-worker counters
+        for (size_t worker = 0; worker < threads; worker++) {
+            if (workers[worker].failed) return 1;
+            correct += workers[worker].correct;
+        }
+
+        // results reported in point order
+        size_t running = 0;
+        for (size_t pt = 0; pt < number; pt++) {
+            const Tensor y_item = {.m=1, .n=classes, .o=1, .arr=&outputs[pt * classes]};
+            Tensor *img = NULL;
+            Tensor view;
+            if (mode == 'i' && dataset != NULL) {
+                view = dataset_image(dataset, pt);
+                img = &view;
+            } else if (mode == 'i') {
+                // images are not kept past their chunk, read again for display
+                char pt_filename[64];
+                snprintf(pt_filename, sizeof(pt_filename), "../data/images/img_%zu.bin", pt);
+                img = read_tensor(pt_filename);
+                if (img == NULL) return 1;
+            }
+            if (argmax(&y_item) == labels[pt]) running++;
+            if (preds != NULL && argmax(&y_item) == preds[pt]) agree++;
+            report_(mode, pt, number, labels[pt], &y_item, img, running);
+            if (dataset == NULL) free_tensor(img);
+        }
+        free(labels); free(outputs);
+    }
+    for (size_t worker = 0; worker < threads; worker++) {
+        free(workers[worker].imgs); free(workers[worker].samples); free(workers[worker].labels);
+        free_arena(workers[worker].arena);
     }
+    free(workers);
+    set_compute_pool(NULL);
+    free_thread_pool(pool);
+    close_dataset(dataset);
 
     if (mode == 'f') {
         printf("\nparameter visualization\n");
 
-        // vis conv1
-        printf("\nconv1\n");
-        vis_conv(conv1, 2, 1);
-
-        // vis conv2
-        printf("\nconv2\n");
-        vis_conv(conv2, 2, 1);
+        // vis conv and dense layers, numbered per type; half-precision weights widened for the vis only
+        Layer *wide = widen_layers(layers, num_layers);
+        if (wide == NULL) return 1;
+        size_t convs = 0, denses = 0;
+        for (size_t idx = 0; idx < num_layers; idx++) {
+            if (wide[idx].type == LAYER_CONV) {
+                printf("\nconv%zu\n", ++convs);
+                vis_conv(wide[idx].conv, 2, 1);
+            } else if (wide[idx].type == LAYER_DENSE) {
+                printf("\ndense%zu\n", ++denses);
+                vis_dense(wide[idx].dense, 1, 1);
+            }
+        }
+        free_wide_layers(wide, num_layers);
+    }
 
-        // vis dense1
-        printf("\ndense1\n");
-        vis_dense(dense1, 1, 1);
+    if (quantized != NULL) {
+        // int8 against the fp32 reference pass, weight sizes over conv and dense layers
+        size_t fp32_bytes = 0, int8_bytes = 0;
+        for (size_t idx = 0; idx < num_layers; idx++) {
+            const QuantWeights *quant = quantized[idx].quant;
+            if (quant == NULL) continue;
+            fp32_bytes += quant->num * quant->len * sizeof(elm_t);
+            int8_bytes += quant->num * (quant->len + sizeof(elm_t));
+        }
+        const float ref_acc = (float)ref_correct / (float)number, int8_acc = (float)correct / (float)number;
+        printf("\nquant: %zu calibration points; fp32 %.4g%% accuracy; int8 %.4g%% accuracy; %+.4g%% delta; "
+            "%zu/%zu agree; %zu fp32 weight bytes; %zu int8 weight bytes;", calib < number ? calib : number,
+            100 * ref_acc, 100 * int8_acc, 100 * (int8_acc - ref_acc), agree, number, fp32_bytes, int8_bytes);
     }
 
     // print final results
     const float acc = (float)correct / (float)number;
     printf("\nend: %zu correct; %zu total; %.4g%% accuracy;\n", correct, number, 100 * acc);
     // free memory and end program
+    free_packs(packs); free(cache);
     free_convolutional(conv1); free(pool1);
     free_convolutional(conv2); free(pool2);
     free_dense(dense1);
+    free_model(model);
+    free_profile(profile);
+    free_plan(plan);
+    free_quant_layers(quantized, num_layers);
+    free_half_layers(narrowed, num_layers);
+    free(preds);
     return 0;
 }
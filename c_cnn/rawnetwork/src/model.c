@@ -0,0 +1,306 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "half.h"
+#include "model.h"
+
+// model container layout, all fields little-endian u64:
+//   header (64 bytes): magic, version, layer count, table offset, table crc32, file size, 2 reserved
+//   layer table: one 128 byte entry per layer
+//     [type, activation, num, m, n, o, m_stride, n_stride, section offset, section bytes, section crc32, dtype,
+//      4 reserved], dtype one of 0 float32, 1 float16, 2 bfloat16
+//   sections: one per layer with weights, each starting on a 64 byte boundary
+//     conv: num float32 biases, then num kernels of m x n x o dtype values, every array padded to 64 bytes
+//     dense: m x n dtype weights, then n float32 biases, both padded to 64 bytes
+//     pool: no section
+#define MODEL_MAGIC "CNNMODL"
+#define MODEL_VERSION 1
+#define MODEL_HEADER 64
+#define MODEL_ENTRY 16
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static uint32_t crc32_(const unsigned char *bytes, const size_t size) {
+    // reflected ieee crc32, as zlib.crc32
+    uint32_t table[256];
+    for (uint32_t idx = 0; idx < 256; idx++) {
+        uint32_t crc = idx;
+        for (int bit = 0; bit < 8; bit++) crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        table[idx] = crc;
+    }
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t byte = 0; byte < size; byte++) crc = table[(crc ^ bytes[byte]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static size_t padded_(const size_t size, const size_t elm_size) {
+    // bytes of size values, rounded up to a whole number of 64 byte lines
+    return (size * elm_size + ELM_ALIGN - 1) / ELM_ALIGN * ELM_ALIGN;
+}
+
+static size_t elm_size_(const size_t *entry) {
+    // bytes per stored weight of a table entry
+    return entry[11] == PREC_FP32 ? sizeof(elm_t) : sizeof(uint16_t);
+}
+
+static HalfWeights *map_half_(const size_t *entry, const char *arr, const size_t rows, const size_t cols,
+    const size_t stride) {
+    // half-precision weights left in the mapping
+    HalfWeights *half = malloc(sizeof(HalfWeights));
+    if (half == NULL) {
+        fprintf(stderr, "Failed malloc: half-precision weights sized %zu x %zu.\n", rows, cols);
+        return NULL;
+    }
+    *half = (HalfWeights){.prec=(Precision)entry[11], .rows=rows, .cols=cols, .stride=stride,
+        .arr=(const uint16_t *)arr, .owned=0};
+    return half;
+}
+
+static Convolutional *map_conv_(const size_t *entry, const char *section, HalfWeights **half) {
+    const size_t num = entry[2], m = entry[3], n = entry[4], o = entry[5], len = m * n * o;
+    const size_t elm_size = elm_size_(entry);
+    const int narrow = elm_size != sizeof(elm_t);
+
+    // malloc, layer, kernel pointers and kernels in one block
+    char *block = malloc(sizeof(Convolutional) + num * (sizeof(Kernel*) + sizeof(Kernel)));
+    if (block == NULL) {
+        fprintf(stderr, "Failed malloc: Convolutional of %zu kernels.\n", num);
+        return NULL;
+    }
+    Convolutional *conv = (Convolutional *)block;
+    Kernel **ptrs = (Kernel **)(block + sizeof(Convolutional));
+    Kernel *kernels = (Kernel *)(block + sizeof(Convolutional) + num * sizeof(Kernel*));
+
+    // struct setup, float32 kernel arrays point into the mapping, narrower ones have none (see widen_layers)
+    const elm_t *biases = (const elm_t *)section;
+    const char *arrs = section + padded_(num, sizeof(elm_t));
+    for (size_t k = 0; k < num; k++) {
+        kernels[k].m = m; kernels[k].n = n; kernels[k].o = o;
+        kernels[k].m_stride = entry[6]; kernels[k].n_stride = entry[7];
+        kernels[k].bias = biases[k];
+        kernels[k].arr = narrow ? NULL : (elm_t *)(arrs + k * padded_(len, elm_size));
+        ptrs[k] = &kernels[k];
+    }
+    conv->kernels = ptrs;
+    conv->num = num;
+    conv->packed = NULL;
+
+    // narrow weights used in place
+    if (narrow) {
+        *half = map_half_(entry, arrs, num, len, padded_(len, elm_size) / elm_size);
+        if (*half == NULL) {
+            free(block);
+            return NULL;
+        }
+    }
+    return conv;
+}
+
+static Dense *map_dense_(const size_t *entry, const char *section, HalfWeights **half) {
+    const size_t m = entry[3], n = entry[4];
+    const size_t elm_size = elm_size_(entry);
+    const int narrow = elm_size != sizeof(elm_t);
+
+    // malloc, layer and both tensors in one block
+    char *block = malloc(sizeof(Dense) + 2 * sizeof(Tensor));
+    if (block == NULL) {
+        fprintf(stderr, "Failed malloc: Dense sized %zu x %zu.\n", m, n);
+        return NULL;
+    }
+    Dense *dense = (Dense *)block;
+    Tensor *tensors = (Tensor *)(block + sizeof(Dense));
+
+    // struct setup, float32 arrays point into the mapping, narrower weights have none (see widen_layers)
+    tensors[0] = (Tensor){.m=m, .n=n, .o=1, .arr=narrow ? NULL : (elm_t *)section};
+    tensors[1] = (Tensor){.m=1, .n=n, .o=1, .arr=(elm_t *)(section + padded_(m * n, elm_size))};
+    dense->weights = &tensors[0];
+    dense->biases = &tensors[1];
+    dense->packed = NULL;
+
+    // narrow weights used in place
+    if (narrow) {
+        *half = map_half_(entry, section, m, n, n);
+        if (*half == NULL) {
+            free(block);
+            return NULL;
+        }
+    }
+    return dense;
+}
+
+static int entry_dims_(const size_t *entry, const size_t map_size) {
+    // nonzero dimensions and strides, and weight counts that fit the mapping, so no product below overflows
+    const size_t num = entry[2], m = entry[3], n = entry[4], o = entry[5];
+    if (m == 0 || n == 0 || m > map_size / n) return 0;
+    if (entry[0] == LAYER_CONV) {
+        return num != 0 && o != 0 && entry[6] != 0 && entry[7] != 0 && m * n <= map_size / o
+            && num <= map_size / (m * n * o);
+    }
+    if (entry[0] == LAYER_POOL) return entry[6] != 0 && entry[7] != 0;
+    return 1;
+}
+
+static size_t section_bytes_(const size_t *entry) {
+    // minimum section size of a table entry
+    const size_t num = entry[2], m = entry[3], n = entry[4], o = entry[5], elm_size = elm_size_(entry);
+    if (entry[0] == LAYER_CONV) return padded_(num, sizeof(elm_t)) + num * padded_(m * n * o, elm_size);
+    if (entry[0] == LAYER_DENSE) return padded_(m * n, elm_size) + padded_(n, sizeof(elm_t));
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Memory-maps a model container file. Header, layer table and every weight section are checked against their
+ * checksums; float32 weights are then used in place, nothing is copied. Half-precision weights are used in place by
+ * the half-precision ops and get no single-precision copy; consumers that need one widen them on demand, see
+ * widen_layers. Mapped pages are shared between processes loading the same file. Layers of a model are read-only and
+ * must not be freed individually.
+ * Caller is responsible for freeing returned model with free_model.
+ *
+ * @param filename: model container file, see py_cnn/helpers.py write_model.
+ *
+ * @return: mapped model. NULL for open, map, format or checksum fail.
+ */
+Model *open_model(const char *filename) {
+    // get file descriptor
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed opening file: %s.\n", filename);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < MODEL_HEADER) {
+        fprintf(stderr, "Invalid model: %s too small.\n", filename);
+        close(fd); return NULL;
+    }
+
+    // map whole file, read-only
+    const size_t map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed mmap: %s.\n", filename);
+        return NULL;
+    }
+    const char *bytes = map;
+
+    // header check
+    const size_t *header = map;
+    const size_t num = header[2], table_off = header[3];
+    if (memcmp(map, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0 || header[1] != MODEL_VERSION) {
+        fprintf(stderr, "Invalid model: %s has bad magic or version.\n", filename);
+        munmap(map, map_size); return NULL;
+    }
+    if (header[5] != map_size || table_off % sizeof(size_t) != 0 || table_off < MODEL_HEADER || table_off > map_size
+        || num > (map_size - table_off) / (MODEL_ENTRY * sizeof(size_t))) {
+        fprintf(stderr, "Invalid model: %s has inconsistent layout.\n", filename);
+        munmap(map, map_size); return NULL;
+    }
+    if (crc32_((const unsigned char *)bytes + table_off, num * MODEL_ENTRY * sizeof(size_t)) != header[4]) {
+        fprintf(stderr, "Invalid model: %s layer table checksum mismatch.\n", filename);
+        munmap(map, map_size); return NULL;
+    }
+
+    // malloc
+    Model *model = malloc(sizeof(Model));
+    Layer *layers = calloc(num != 0 ? num : 1, sizeof(Layer));
+    if (model == NULL || layers == NULL) {
+        fprintf(stderr, "Failed malloc: Model of %zu layers.\n", num);
+        free(model); free(layers);
+        munmap(map, map_size); return NULL;
+    }
+    model->map = map; model->map_size = map_size;
+    model->num = 0;
+    model->layers = layers;
+
+    // layer table
+    const size_t *table = (const size_t *)(bytes + table_off);
+    for (size_t idx = 0; idx < num; idx++) {
+        const size_t *entry = &table[idx * MODEL_ENTRY];
+        const size_t offset = entry[8], size = entry[9];
+        if ((entry[0] != LAYER_CONV && entry[0] != LAYER_POOL && entry[0] != LAYER_DENSE) || entry[1] > ACT_SOFTMAX
+            || entry[11] > PREC_BF16 || !entry_dims_(entry, map_size) || offset % ELM_ALIGN != 0 || offset > map_size
+            || size > map_size - offset || size < section_bytes_(entry)) {
+            fprintf(stderr, "Invalid model: %s layer %zu has a bad table entry.\n", filename, idx);
+            free_model(model); return NULL;
+        }
+        if (crc32_((const unsigned char *)bytes + offset, size) != entry[10]) {
+            fprintf(stderr, "Invalid model: %s layer %zu checksum mismatch.\n", filename, idx);
+            free_model(model); return NULL;
+        }
+
+        // layer setup
+        Layer *layer = &layers[idx];
+        layer->type = (LayerType)entry[0];
+        layer->activation = (Activation)entry[1];
+        if (layer->type == LAYER_CONV) {
+            layer->conv = map_conv_(entry, bytes + offset, &layer->half);
+        } else if (layer->type == LAYER_DENSE) {
+            layer->dense = map_dense_(entry, bytes + offset, &layer->half);
+        } else {
+            layer->pool = malloc(sizeof(Pooler));
+            if (layer->pool != NULL) {
+                layer->pool->m = entry[3]; layer->pool->n = entry[4];
+                layer->pool->m_stride = entry[6]; layer->pool->n_stride = entry[7];
+            } else {
+                fprintf(stderr, "Failed malloc: Pooling kernel sized %zu x %zu.\n", entry[3], entry[4]);
+            }
+        }
+        if (layer->conv == NULL && layer->dense == NULL && layer->pool == NULL) {
+            free_model(model); return NULL;
+        }
+        model->num++;
+    }
+    return model;
+}
+
+/**
+ * Identifies the weights of a mapped model: the layer table checksum, which covers every section checksum, and the
+ * file size. Equal fingerprints mean equal weights.
+ *
+ * @param model: mapped model.
+ *
+ * @return: table checksum in the low 32 bits, file size above.
+ */
+uint64_t model_fingerprint(const Model *model) {
+    const size_t *header = model->map;
+    return (uint64_t)header[5] << 32 | (uint64_t)header[4];
+}
+
+/**
+ * Reflected ieee crc32 of a byte array, as zlib.crc32; the checksum model containers are verified with.
+ *
+ * @param bytes: bytes.
+ * @param size: number of bytes.
+ *
+ * @return: checksum.
+ */
+uint32_t model_crc32(const void *bytes, const size_t size) {
+    return crc32_(bytes, size);
+}
+
+/**
+ * Unmaps a model and frees its layer structs. Layers handed out by the model become invalid. If model is NULL, passes.
+ *
+ * @param model: model to be freed.
+ */
+void free_model(Model *model) {
+    if (model == NULL) return;
+    for (size_t idx = 0; idx < model->num; idx++) {
+        // single blocks, arrays belong to the mapping or the block
+        free_half(model->layers[idx].half);
+        free(model->layers[idx].conv);
+        free(model->layers[idx].pool);
+        free(model->layers[idx].dense);
+    }
+    munmap(model->map, model->map_size);
+    free(model->layers);
+    free(model);
+}
@@ -0,0 +1,242 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "types.h"
+#include "gemm.h"
+#include "simd.h"
+#include "model.h"
+#include "pack.h"
+
+// pack cache layout, all header fields little-endian u64:
+//   header (64 bytes): magic, version, layer count, model fingerprint, gemm_mr, gemm_nr, payload crc32, file size
+//   payload, in layer order, every array starting on a 64 byte boundary:
+//     conv: num x rows stacked kernels, their row panels, then num kernel biases scaled by the input channels
+//     dense: column panels of the weights
+//     pool: nothing
+// the payload layout follows from the layers and the register tile alone, so it needs no table
+#define PACK_MAGIC "CNNPACK"
+#define PACK_VERSION 1
+#define PACK_HEADER 64
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static size_t padded_(const size_t size) {
+    // bytes of size elements, rounded up to a whole number of 64 byte lines
+    return (size * sizeof(elm_t) + ELM_ALIGN - 1) / ELM_ALIGN * ELM_ALIGN;
+}
+
+static size_t conv_rows_(const Convolutional *conv) {
+    // elements per stacked kernel, 0 for a layer whose kernels differ in shape
+    if (conv->num == 0) return 0;
+    const Kernel *k_ref = conv->kernels[0];
+    for (size_t kern = 1; kern < conv->num; kern++) {
+        const Kernel *kernel = conv->kernels[kern];
+        if (kernel->m != k_ref->m || kernel->n != k_ref->n || kernel->o != k_ref->o) return 0;
+    }
+    return k_ref->m * k_ref->n * k_ref->o;
+}
+
+static size_t layer_bytes_(const Layer *layer) {
+    // payload bytes of one layer; half-precision layers run on their own ops and have no fp32 weights to pack
+    if (layer->half != NULL) return 0;
+    if (layer->type == LAYER_CONV && layer->conv != NULL && conv_rows_(layer->conv) != 0) {
+        const size_t num = layer->conv->num, rows = conv_rows_(layer->conv);
+        return padded_(num * rows) + padded_(gemm_pack_a_size(num, rows)) + padded_(num);
+    }
+    if (layer->type == LAYER_DENSE && layer->dense != NULL) {
+        return padded_(gemm_pack_b_size(layer->dense->weights->m, layer->dense->weights->n));
+    }
+    return 0;
+}
+
+static void attach_(Packs *packs, char *payload, const int fill) {
+    // points every packable layer at its payload arrays, packing them first when fill is set
+    const SimdOps *ops = simd_ops();
+    for (size_t idx = 0; idx < packs->num; idx++) {
+        const Layer *layer = &packs->layers[idx];
+        PackedWeights *packed = &packs->packed[idx];
+        const size_t bytes = layer_bytes_(layer);
+        if (bytes == 0) continue;
+        if (layer->type == LAYER_CONV) {
+            // stacked kernels, row panels, kernel-bias vector
+            Convolutional *conv = layer->conv;
+            const size_t num = conv->num, rows = conv_rows_(conv);
+            elm_t *matrix = (elm_t *)payload;
+            elm_t *panels = (elm_t *)(payload + padded_(num * rows));
+            elm_t *bias = (elm_t *)(payload + padded_(num * rows) + padded_(gemm_pack_a_size(num, rows)));
+            if (fill) {
+                for (size_t kern = 0; kern < num; kern++) {
+                    memcpy(&matrix[kern * rows], conv->kernels[kern]->arr, rows * sizeof(elm_t));
+                    // accumulated once per input channel as in conv_
+                    bias[kern] = conv->kernels[kern]->bias * (elm_t)conv->kernels[kern]->o;
+                }
+                gemm_pack_a(panels, matrix, rows, num, rows);
+            }
+            *packed = (PackedWeights){.rows=num, .cols=rows, .tile=ops->gemm_mr, .matrix=matrix, .panels=panels,
+                .bias=bias};
+            conv->packed = packed;
+        } else {
+            // column panels, row-major weights and biases stay with the layer
+            Dense *dense = layer->dense;
+            const Tensor *weights = dense->weights;
+            elm_t *panels = (elm_t *)payload;
+            if (fill) gemm_pack_b(panels, weights->arr, weights->n, weights->m, weights->n);
+            *packed = (PackedWeights){.rows=weights->m, .cols=weights->n, .tile=ops->gemm_nr, .matrix=weights->arr,
+                .panels=panels, .bias=dense->biases->arr};
+            dense->packed = packed;
+        }
+        payload += bytes;
+    }
+}
+
+static void header_(size_t *header, const size_t num, const uint64_t key, const char *payload, const size_t size) {
+    // cache header of a payload
+    const SimdOps *ops = simd_ops();
+    memset(header, 0, PACK_HEADER);
+    memcpy(header, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header[1] = PACK_VERSION; header[2] = num; header[3] = (size_t)key;
+    header[4] = ops->gemm_mr; header[5] = ops->gemm_nr;
+    header[6] = model_crc32(payload, size);
+    header[7] = PACK_HEADER + size;
+}
+
+static char *map_cache_(Packs *packs, const char *filename, const uint64_t key, const size_t size) {
+    // payload of a valid cache file, mapped read-only; NULL for a missing or stale file
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != PACK_HEADER + size) {
+        fprintf(stderr, "Stale pack cache: %s has the wrong size, repacking.\n", filename);
+        close(fd); return NULL;
+    }
+    const size_t map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed mmap: %s.\n", filename);
+        return NULL;
+    }
+
+    // same layers, weights and register tile, payload intact
+    char *payload = (char *)map + PACK_HEADER;
+    size_t expected[PACK_HEADER / sizeof(size_t)];
+    header_(expected, packs->num, key, payload, size);
+    if (memcmp(map, expected, PACK_HEADER) != 0) {
+        fprintf(stderr, "Stale pack cache: %s does not match the model or kernels, repacking.\n", filename);
+        munmap(map, map_size); return NULL;
+    }
+    packs->map = map; packs->map_size = map_size;
+    return payload;
+}
+
+static void write_cache_(const char *filename, const size_t num, const uint64_t key, const char *payload,
+    const size_t size) {
+    // written under a temporary name and renamed, so readers see a whole file or none
+    const size_t len = strlen(filename) + 32;
+    char *tmp = malloc(len);
+    if (tmp == NULL) {
+        fprintf(stderr, "Failed malloc: pack cache path.\n");
+        return;
+    }
+
+    // a directory that cannot take the file is noted rather than failed, packing in memory works the same
+    const char *slash = strrchr(filename, '/');
+    if (slash == NULL) {
+        snprintf(tmp, len, ".");
+    } else {
+        snprintf(tmp, len, "%.*s", (int)(slash - filename + 1), filename);
+    }
+    if (access(tmp, W_OK) != 0) {
+        fprintf(stderr, "Pack cache: %s is not writable, packing in memory only (-k off skips the cache).\n", tmp);
+        free(tmp);
+        return;
+    }
+    snprintf(tmp, len, "%s.%ld.tmp", filename, (long)getpid());
+    size_t header[PACK_HEADER / sizeof(size_t)];
+    header_(header, num, key, payload, size);
+    FILE *fp = fopen(tmp, "wb");
+    int ok = fp != NULL && fwrite(header, PACK_HEADER, 1, fp) == 1 && (size == 0 || fwrite(payload, size, 1, fp) == 1);
+    if (fp != NULL && fclose(fp) != 0) ok = 0;
+    if (!ok || rename(tmp, filename) != 0) {
+        fprintf(stderr, "Failed writing pack cache: %s.\n", filename);
+        remove(tmp);
+    }
+    free(tmp);
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Prepacks the weights of a network once, at load, into the order the host's gemm kernel streams them. Conv layers get
+ * their kernels stacked into one matrix, packed into row panels (see gemm_pack_a), and a kernel-bias vector; dense
+ * layers get their weights packed into column panels (see gemm_pack_b). The im2col conv and dense ops then read the
+ * panels in place instead of repacking the weights on every call.
+ * With a cache file, the packed weights are mapped from it when it was written for the same weights (key) and the
+ * same register tile and its checksum holds; otherwise they are packed and the cache is rewritten, unless its
+ * directory is not writable. Mapped pages are shared between processes loading the same cache.
+ * Layers must outlive the packs. Caller is responsible for freeing returned packs with free_packs.
+ *
+ * @param layers: network layers; their conv and dense layers are pointed at the packed weights.
+ * @param num: number of layers.
+ * @param cache: cache file, or NULL to pack in memory only.
+ * @param key: fingerprint of the weights the cache must match, see model_fingerprint.
+ *
+ * @return: packed weights. NULL for malloc fail.
+ */
+Packs *pack_layers(const Layer *layers, const size_t num, const char *cache, const uint64_t key) {
+    // malloc
+    Packs *packs = malloc(sizeof(Packs));
+    PackedWeights *packed = calloc(num != 0 ? num : 1, sizeof(PackedWeights));
+    if (packs == NULL || packed == NULL) {
+        fprintf(stderr, "Failed malloc: packs of %zu layers.\n", num);
+        free(packs); free(packed);
+        return NULL;
+    }
+    *packs = (Packs){.map=NULL, .map_size=0, .block=NULL, .num=num, .layers=layers, .packed=packed};
+
+    // payload size
+    size_t size = 0;
+    for (size_t idx = 0; idx < num; idx++) size += layer_bytes_(&layers[idx]);
+
+    // mapped from a valid cache; nothing to cache when no layer is packable
+    if (size == 0) cache = NULL;
+    char *payload = cache != NULL ? map_cache_(packs, cache, key, size) : NULL;
+    if (payload != NULL) {
+        attach_(packs, payload, 0);
+        return packs;
+    }
+
+    // packed now, then cached
+    packs->block = aligned_alloc(ELM_ALIGN, size != 0 ? size : ELM_ALIGN);
+    if (packs->block == NULL) {
+        fprintf(stderr, "Failed malloc: packed weights sized %zu.\n", size);
+        free(packed); free(packs);
+        return NULL;
+    }
+    attach_(packs, packs->block, 1);
+    if (cache != NULL) write_cache_(cache, num, key, packs->block, size);
+    return packs;
+}
+
+/**
+ * Detaches packed weights from their layers, then unmaps or frees them. If packs is NULL, passes.
+ *
+ * @param packs: packs to be freed.
+ */
+void free_packs(Packs *packs) {
+    if (packs == NULL) return;
+    for (size_t idx = 0; idx < packs->num; idx++) {
+        // layers fall back to their row-major weights
+        const Layer *layer = &packs->layers[idx];
+        if (layer->conv != NULL && layer->conv->packed == &packs->packed[idx]) layer->conv->packed = NULL;
+        if (layer->dense != NULL && layer->dense->packed == &packs->packed[idx]) layer->dense->packed = NULL;
+    }
+    if (packs->map != NULL) munmap(packs->map, packs->map_size);
+    free(packs->block);
+    free(packs->packed);
+    free(packs);
+}
@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "functional.h"
+#include "computational.h"
+#include "components.h"
+#include "activators.h"
+#include "arena.h"
+#include "quant.h"
+#include "half.h"
+#include "fft.h"
+#include "blocked.h"
+#include "plan.h"
+
+// elements per cache line, every value starts on its own line
+#define LINE (ELM_ALIGN / sizeof(elm_t))
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static size_t value_size_(const PlanValue *value, const size_t batch) {
+    // elements of a value at full batch size, channels padded to whole blocks in the blocked layout, whole cache lines
+    const size_t o = value->blocked ? chan_blocks(value->o) * CHAN_BLOCK : value->o;
+    return (value->m * value->n * o * batch + LINE - 1) / LINE * LINE;
+}
+
+static void assign_offsets_(Plan *plan) {
+    // largest values first, each at the lowest offset clear of every placed value it is live alongside
+    const size_t num = plan->num_values;
+    size_t order[num];
+    int placed[num];
+    for (size_t idx = 0; idx < num; idx++) {
+        order[idx] = idx;
+        placed[idx] = 0;
+    }
+    for (size_t idx = 1; idx < num; idx++) {
+        const size_t key = order[idx];
+        size_t pos = idx;
+        while (pos > 0 && value_size_(&plan->values[order[pos - 1]], plan->batch)
+            < value_size_(&plan->values[key], plan->batch)) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = key;
+    }
+
+    plan->region = 0;
+    for (size_t idx = 0; idx < num; idx++) {
+        PlanValue *value = &plan->values[order[idx]];
+        const size_t size = value_size_(value, plan->batch);
+        size_t offset = 0;
+        for (int moved = 1; moved;) {
+            // bump past any overlapping live value until a full pass finds none
+            moved = 0;
+            for (size_t other = 0; other < num; other++) {
+                const PlanValue *live = &plan->values[other];
+                if (!placed[other] || live->last < value->first || value->last < live->first) continue;
+                const size_t live_size = value_size_(live, plan->batch);
+                if (offset < live->offset + live_size && live->offset < offset + size) {
+                    offset = live->offset + live_size;
+                    moved = 1;
+                }
+            }
+        }
+        value->offset = offset;
+        placed[order[idx]] = 1;
+        if (offset + size > plan->region) plan->region = offset + size;
+    }
+}
+
+static size_t top_classes_(const size_t batch) {
+    // workspace elements of the class indices of a top-1 step
+    return arena_bytes((batch * sizeof(size_t) + sizeof(elm_t) - 1) / sizeof(elm_t)) / sizeof(elm_t);
+}
+
+static int top1_into_(Batch *res, const Batch *input, const Dense *dense, const Activation activation,
+    Arena *arena) {
+    // one-hot top-1 class of each item over the output value, ranked without activating the row
+    const size_t mark = arena->used;
+    elm_t *work = arena_scratch(arena, top_classes_(input->b));
+    size_t *classes = (size_t *)work;
+    const int ok = work != NULL && batch_dense_topk_into(classes, NULL, input, dense, activation, 1, arena) != NULL;
+    const size_t n = dense->weights->n;
+    for (size_t img = 0; ok && img < input->b; img++) {
+        memset(&res->arr[img * n], 0, n * sizeof(elm_t));
+        res->arr[img * n + classes[img]] = 1;
+    }
+    if (work != NULL) arena_drop(arena, work, mark);
+    return ok;
+}
+
+static int infer_step_(Plan *plan, PlanStep *step, const PlanValue *in, PlanValue *out) {
+    // output shape and workspace of a step at full batch size
+    const Layer *layer = step->layer;
+    const Batch in_shape = {.m=in->m, .n=in->n, .o=in->o, .b=plan->batch};
+    Batch shape = {.b=0};
+    if (layer->type == LAYER_CONV) {
+        shape = batch_conv_shape(&in_shape, layer->conv);
+        if (step->block != NULL && shape.b != 0) {
+            step->work = batch_conv_blocked_workspace(&in_shape, layer->conv);
+        } else if (layer->quant != NULL && shape.b != 0) {
+            step->work = batch_conv_quant_workspace(&in_shape, layer->conv, layer->quant);
+        } else if (layer->half != NULL && shape.b != 0) {
+            if (step->pool != NULL) shape = batch_pool_shape(&shape, step->pool);
+            step->work = batch_conv_half_workspace(&in_shape, layer->conv, step->pool);
+        } else if (step->wino != NULL && shape.b != 0) {
+            step->work = batch_conv_winograd_workspace(&in_shape, layer->conv, step->wino);
+        } else if (step->fft != NULL && shape.b != 0) {
+            step->work = batch_conv_fft_workspace(&in_shape, layer->conv);
+        } else if (step->pool != NULL && shape.b != 0) {
+            shape = batch_pool_shape(&shape, step->pool);
+            step->work = batch_conv_pool_workspace(&in_shape, layer->conv, step->pool);
+        } else {
+            step->work = batch_convolution_workspace(&in_shape, layer->conv);
+        }
+    } else if (layer->type == LAYER_POOL) {
+        shape = batch_pool_shape(&in_shape, layer->pool);
+        step->work = 0;
+    } else if (layer->type == LAYER_DENSE) {
+        // flattened input
+        Batch flat = in_shape;
+        batch_flatten(&flat);
+        if (flat.n == layer->dense->weights->m && layer->dense->biases->n == layer->dense->weights->n) {
+            shape = (Batch){.m=1, .n=layer->dense->weights->n, .o=1, .b=plan->batch};
+        }
+        if (layer->quant != NULL) {
+            step->work = batch_dense_quant_workspace(layer->quant);
+        } else if (layer->half != NULL) {
+            step->work = batch_dense_half_workspace(&flat, layer->half);
+        } else if (step->top) {
+            step->work = top_classes_(plan->batch) + batch_dense_topk_workspace(&flat, layer->dense);
+        } else {
+            step->work = batch_matmul_workspace(&flat, layer->dense->weights);
+        }
+    }
+    if (shape.b == 0) return 0;
+    out->m = shape.m; out->n = shape.n; out->o = shape.o;
+    if (in->blocked && step->block == NULL && !out->blocked) {
+        // leaving the blocked layout, the input is unblocked into scratch ahead of the op workspace
+        step->work += (in->m * in->n * in->o * plan->batch + LINE - 1) / LINE * LINE;
+    }
+    return 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Compiles a layer list into an execution plan for inputs of a fixed shape. Every intermediate shape is inferred and
+ * validated once here; op workspaces are sized for the current conv backend and compute pool, so compile after both
+ * are set. Activations are assigned offsets within one shared region by lifetime, so values that are never live at
+ * the same time share memory. Dense layers flatten their input in place. Layers with int8 weights run the int8 ops and
+ * are never fused. Conv layers run as winograd or in the frequency domain (see conv_winograd and conv_fft) get their
+ * kernel transforms computed once here, for the inferred input shape, and are not fused either. With the blocked
+ * layout (see conv_blocked), single-precision conv layers and the pool layers after them keep their outputs blocked
+ * until a step that needs channel-major input, which unblocks its input first; the last layer, softmax layers and
+ * plans with keep stay channel-major throughout. With top, a single-precision dense output layer without relu writes
+ * only the top-1 class of each item, as a one-hot row (see batch_dense_topk_into), for callers that need no more than
+ * the argmax.
+ * Caller is responsible for freeing returned plan with free_plan; layers must outlive the plan.
+ *
+ * @param layers: layers in forward order.
+ * @param num: number of layers.
+ * @param m: input rows.
+ * @param n: input columns.
+ * @param o: input channels.
+ * @param batch: maximum number of items per run.
+ * @param fuse: run a conv followed by a pool as one fused step.
+ * @param keep: keep every value live to the end of the run, e.g. to inspect intermediate activations.
+ * @param top: one-hot top-1 output in place of the activated output layer; profile_run still runs it in full.
+ *
+ * @return: execution plan. NULL for malloc fail or any shape mismatch.
+ */
+Plan *make_plan(const Layer *layers, const size_t num, const size_t m, const size_t n, const size_t o,
+    const size_t batch, const int fuse, const int keep, const int top) {
+    // malloc, at most one step and one output value per layer
+    Plan *plan = malloc(sizeof(Plan));
+    PlanStep *steps = malloc((num != 0 ? num : 1) * sizeof(PlanStep));
+    PlanValue *values = malloc((num + 1) * sizeof(PlanValue));
+    if (plan == NULL || steps == NULL || values == NULL) {
+        fprintf(stderr, "Failed malloc: Plan of %zu layers.\n", num);
+        free(plan); free(steps); free(values);
+        return NULL;
+    }
+    plan->batch = batch != 0 ? batch : 1;
+    plan->steps = steps;
+    plan->values = values;
+    plan->num_steps = 0;
+    plan->num_values = 1;
+    plan->work = 0;
+    values[0] = (PlanValue){.m=m, .n=n, .o=o, .first=0};
+
+    // steps and shapes
+    for (size_t idx = 0; idx < num; idx++) {
+        PlanStep *step = &steps[plan->num_steps];
+        step->layer = &layers[idx];
+        step->pool = NULL;
+        step->wino = NULL;
+        step->fft = NULL;
+        step->block = NULL;
+        step->fn = activator(layers[idx].activation);
+        // ranked on the logits, which only matches argmax of the output under strictly increasing activations;
+        // relu clamps every negative logit to a tie at 0
+        const Activation act = layers[idx].activation;
+        step->top = top && idx + 1 == num && layers[idx].type == LAYER_DENSE && layers[idx].quant == NULL
+            && layers[idx].half == NULL && (act == ACT_NONE || act == ACT_SIGMOID || act == ACT_SOFTMAX);
+        const PlanValue *in = &values[plan->num_values - 1];
+        // blocked values only between layers, activations of any blocked value applied over padding lanes too
+        const int blockable = !keep && idx + 1 < num && layers[idx].activation != ACT_SOFTMAX;
+        if (layers[idx].type == LAYER_CONV && layers[idx].quant == NULL && layers[idx].half == NULL) {
+            // packed kernels or kernel transforms for the shape this layer sees
+            const Batch in_shape = {.m=in->m, .n=in->n, .o=in->o, .b=plan->batch};
+            if (blockable && conv_blocked(layers[idx].conv)) {
+                step->block = blocked_kernels(layers[idx].conv);
+                if (step->block == NULL) {
+                    free_plan(plan);
+                    return NULL;
+                }
+            } else if (conv_winograd(layers[idx].conv)) {
+                step->wino = winograd_kernels(layers[idx].conv);
+                if (step->wino == NULL) {
+                    free_plan(plan);
+                    return NULL;
+                }
+            } else if (conv_fft(&in_shape, layers[idx].conv)) {
+                step->fft = fft_kernels(layers[idx].conv, in->m, in->n);
+                if (step->fft == NULL) {
+                    free_plan(plan);
+                    return NULL;
+                }
+            }
+        }
+        const int transformed = step->wino != NULL || step->fft != NULL || step->block != NULL;
+        // pooling before the activation only commutes for element-wise ones, so softmax conv layers stay unfused
+        if (fuse && layers[idx].type == LAYER_CONV && layers[idx].quant == NULL && !transformed && idx + 1 < num
+            && layers[idx].activation != ACT_SOFTMAX && layers[idx + 1].type == LAYER_POOL
+            && layers[idx + 1].activation == ACT_NONE) {
+            step->pool = layers[++idx].pool;
+        }
+        step->in = plan->num_values - 1;
+        step->out = plan->num_values;
+        values[step->out].blocked = step->block != NULL
+            || (layers[idx].type == LAYER_POOL && in->blocked && blockable);
+        if (!infer_step_(plan, step, &values[step->in], &values[step->out])) {
+            fprintf(stderr, "Invalid plan: layer %zu does not fit its %zu x %zu x %zu input.\n", idx,
+                values[step->in].m, values[step->in].n, values[step->in].o);
+            free(step->wino);
+            free_fft_kernels(step->fft);
+            free(step->block);
+            free_plan(plan);
+            return NULL;
+        }
+        if (step->work > plan->work) plan->work = step->work;
+
+        // lifetimes in steps, input value live through this step
+        values[step->in].last = plan->num_steps;
+        values[step->out].first = plan->num_steps;
+        plan->num_steps++;
+        plan->num_values++;
+    }
+
+    // output value, and every value with keep, live past the last step
+    values[plan->num_values - 1].last = plan->num_steps;
+    if (keep) {
+        for (size_t idx = 0; idx < plan->num_values; idx++) values[idx].last = plan->num_steps;
+    }
+    assign_offsets_(plan);
+    return plan;
+}
+
+/**
+ * Frees all memory associated with a plan. Layers are not freed. If plan is NULL, passes.
+ *
+ * @param plan: plan to be freed.
+ */
+void free_plan(Plan *plan) {
+    if (plan == NULL) return;
+    for (size_t idx = 0; idx < plan->num_steps; idx++) {
+        free(plan->steps[idx].wino);
+        free_fft_kernels(plan->steps[idx].fft);
+        free(plan->steps[idx].block);
+    }
+    free(plan->steps);
+    free(plan->values);
+    free(plan);
+}
+
+/**
+ * Arena size, in bytes, a plan runs in: the shared activation region plus the largest step workspace.
+ *
+ * @param plan: execution plan.
+ *
+ * @return: arena size in bytes.
+ */
+size_t plan_arena_bytes(const Plan *plan) {
+    return arena_bytes(plan->region) + arena_bytes(plan->work);
+}
+
+/**
+ * Resets an arena and takes the shared activation region of a plan from it.
+ *
+ * @param plan: execution plan.
+ * @param arena: arena of at least plan_arena_bytes.
+ *
+ * @return: activation region. NULL for an arena too small.
+ */
+elm_t *plan_begin(const Plan *plan, Arena *arena) {
+    arena_reset(arena);
+    return arena_alloc(arena, plan->region);
+}
+
+/**
+ * Views a value of a plan within its activation region. Value 0 is the input; value i is the output of step i - 1.
+ * Dimensions are those of the channel-major value; a value with blocked set holds them in the blocked layout.
+ *
+ * @param plan: execution plan.
+ * @param region: activation region from plan_begin.
+ * @param idx: value index.
+ * @param num: number of items.
+ *
+ * @return: batch view of the value.
+ */
+Batch plan_value(const Plan *plan, elm_t *region, const size_t idx, const size_t num) {
+    const PlanValue *value = &plan->values[idx];
+    const Batch view = {.m=value->m, .n=value->n, .o=value->o, .b=num, .arr=region + value->offset};
+    return view;
+}
+
+/**
+ * Runs every step of a plan. Values are written into the activation region; op workspaces come from the arena.
+ * No shapes are inferred here.
+ *
+ * @param plan: execution plan.
+ * @param region: activation region from plan_begin.
+ * @param x: input batch of at most plan->batch items, either plan_value 0 or any other batch of the input shape.
+ * @param arena: arena the region was taken from.
+ *
+ * @return: 1 for a complete run; 0 for a mismatched input or an op fail.
+ */
+int plan_run(const Plan *plan, elm_t *region, const Batch *x, Arena *arena) {
+    const PlanValue *input = &plan->values[0];
+    if (x->m != input->m || x->n != input->n || x->o != input->o || x->b == 0 || x->b > plan->batch) {
+        fprintf(stderr, "Invalid plan input: %zu x %zu x %zu x %zu.\n", x->m, x->n, x->o, x->b);
+        return 0;
+    }
+
+    for (size_t idx = 0; idx < plan->num_steps; idx++) {
+        const PlanStep *step = &plan->steps[idx];
+        const Layer *layer = step->layer;
+        Batch in = step->in == 0 ? *x : plan_value(plan, region, step->in, x->b);
+        Batch out = plan_value(plan, region, step->out, x->b);
+        const int in_blocked = plan->values[step->in].blocked, out_blocked = plan->values[step->out].blocked;
+        const size_t mark = arena->used;
+        elm_t *planar = NULL;
+        if (in_blocked && step->block == NULL && !out_blocked) {
+            // leaving the blocked layout
+            planar = arena_scratch(arena, in.m * in.n * in.o * in.b);
+            if (planar == NULL) {
+                fprintf(stderr, "Failed plan step %zu.\n", idx);
+                return 0;
+            }
+            const Batch blocked = in;
+            in.arr = planar;
+            batch_unblock_into(&in, &blocked);
+        }
+        int ok;
+        if (step->block != NULL) {
+            // blocked conv on the kernels packed at plan time, from either layout
+            ok = batch_conv_blocked_into(&out, &in, in_blocked, layer->conv, step->block, arena) != NULL;
+            const Tensor view = blocked_view(&out);
+            if (ok) step->fn(&view);
+        } else if (out_blocked) {
+            // blocked pool
+            ok = batch_pool_blocked_into(&out, &in, layer->pool) != NULL;
+            const Tensor view = blocked_view(&out);
+            if (ok) step->fn(&view);
+        } else if (layer->quant != NULL) {
+            // int8 conv or dense, bias applied on dequantization
+            if (layer->type == LAYER_DENSE) batch_flatten(&in);
+            ok = (layer->type == LAYER_CONV ? batch_conv_quant_into(&out, &in, layer->conv, layer->quant, arena)
+                : batch_dense_quant_into(&out, &in, layer->quant, arena)) != NULL;
+            const Tensor view = batch_view(&out);
+            if (ok) step->fn(&view);
+        } else if (layer->half != NULL) {
+            // half-precision weights widened as the op reads them, single-precision accumulation
+            if (layer->type == LAYER_DENSE) batch_flatten(&in);
+            ok = (layer->type == LAYER_CONV
+                ? batch_conv_half_into(&out, &in, layer->conv, layer->half, step->pool, arena)
+                : batch_dense_half_into(&out, &in, layer->dense, layer->half, arena)) != NULL;
+            const Tensor view = batch_view(&out);
+            if (ok) step->fn(&view);
+        } else if (step->wino != NULL) {
+            // winograd conv on the kernels transformed at plan time
+            ok = batch_conv_winograd_into(&out, &in, layer->conv, step->wino, arena) != NULL;
+            const Tensor view = batch_view(&out);
+            if (ok) step->fn(&view);
+        } else if (step->fft != NULL) {
+            // frequency-domain conv on the kernel spectra computed at plan time
+            ok = batch_conv_fft_into(&out, &in, layer->conv, step->fft, arena) != NULL;
+            const Tensor view = batch_view(&out);
+            if (ok) step->fn(&view);
+        } else if (layer->type == LAYER_CONV && step->pool != NULL) {
+            ok = batch_convolution_pool_into(&out, &in, layer->conv, step->fn, step->pool, arena) != NULL;
+        } else if (layer->type == LAYER_CONV) {
+            ok = batch_convolution_into(&out, &in, layer->conv, step->fn, arena) != NULL;
+        } else if (layer->type == LAYER_POOL) {
+            ok = batch_pool_into(&out, &in, layer->pool) != NULL;
+            const Tensor view = batch_view(&out);
+            if (ok) step->fn(&view);
+        } else if (step->top) {
+            // top-1 class only
+            batch_flatten(&in);
+            ok = top1_into_(&out, &in, layer->dense, layer->activation, arena);
+        } else {
+            batch_flatten(&in);
+            ok = batch_dense_into(&out, &in, layer->dense, step->fn, arena) != NULL;
+        }
+        if (planar != NULL) arena_drop(arena, planar, mark);
+        if (!ok) {
+            fprintf(stderr, "Failed plan step %zu.\n", idx);
+            return 0;
+        }
+    }
+    return 1;
+}
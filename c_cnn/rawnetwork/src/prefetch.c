@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "types.h"
+#include "functional.h"
+#include "helpers.h"
+#include "dataset.h"
+#include "prefetch.h"
+
+// bytes between page touches when pulling a mapped record into memory
+#define PAGE 4096
+
+struct Prefetcher {
+    const Dataset *dataset;
+    size_t number;
+    pthread_t thread;
+    // ring buffer of depth samples, head is the next one to take
+    Sample *ring;
+    size_t depth;
+    size_t head;
+    size_t count;
+    // producer state
+    size_t produced;
+    int failed;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t drained;
+    PrefetchStats stats;
+};
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void touch_(const Sample *sample) {
+    // fault mapped pages in on the producer thread
+    const volatile char *bytes = (const volatile char *)sample->img.arr;
+    const size_t size = sample->img.m * sample->img.n * sample->img.o * sizeof(elm_t);
+    for (size_t byte = 0; byte < size; byte += PAGE) (void)bytes[byte];
+    if (size != 0) (void)bytes[size - 1];
+}
+
+static void *produce_(void *arg) {
+    Prefetcher *prefetcher = arg;
+    for (size_t pt = 0; pt < prefetcher->number; pt++) {
+        // read, decode and validate outside the lock
+        Sample sample;
+        const int ok = read_sample(prefetcher->dataset, pt, &sample);
+        if (ok && !sample.owned) touch_(&sample);
+
+        pthread_mutex_lock(&prefetcher->lock);
+        if (!ok) {
+            prefetcher->failed = 1;
+            pthread_cond_signal(&prefetcher->filled);
+            pthread_mutex_unlock(&prefetcher->lock);
+            return NULL;
+        }
+        // wait for a free slot
+        if (prefetcher->count == prefetcher->depth && !prefetcher->stop) prefetcher->stats.producer_stalls++;
+        while (prefetcher->count == prefetcher->depth && !prefetcher->stop) {
+            pthread_cond_wait(&prefetcher->drained, &prefetcher->lock);
+        }
+        if (prefetcher->stop) {
+            pthread_mutex_unlock(&prefetcher->lock);
+            free_sample(&sample);
+            return NULL;
+        }
+        prefetcher->ring[(prefetcher->head + prefetcher->count) % prefetcher->depth] = sample;
+        prefetcher->count++;
+        prefetcher->produced++;
+        pthread_cond_signal(&prefetcher->filled);
+        pthread_mutex_unlock(&prefetcher->lock);
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Reads a single data point, either as a view into a mapped dataset or from the per-file ../data layout.
+ * Release with free_sample.
+ *
+ * @param dataset: packed dataset, or NULL for one file per image and label.
+ * @param pt: data point index.
+ * @param sample: sample, set on success.
+ *
+ * @return: 1 for a valid sample; 0 for a read fail or invalid label.
+ */
+int read_sample(const Dataset *dataset, const size_t pt, Sample *sample) {
+    if (dataset != NULL) {
+        // zero-copy view
+        sample->img = dataset_image(dataset, pt);
+        sample->label = dataset_label(dataset, pt);
+        sample->owned = 0;
+        return sample->label != (size_t) - 1;
+    }
+
+    // setup image and label location
+    char pt_filename[64];
+    char label_filename[64];
+    snprintf(pt_filename, sizeof(pt_filename), "../data/images/img_%zu.bin", pt);
+    snprintf(label_filename, sizeof(label_filename), "../data/labels/img_%zu.bin", pt);
+    // read image and label
+    Tensor *img = read_tensor(pt_filename);
+    const size_t label = read_label(label_filename);
+    if (img == NULL || label == (size_t) - 1) {
+        // error reading img or label
+        fprintf(stderr, "Error reading image data.\n");
+        free_tensor(img);
+        return 0;
+    }
+    sample->img = *img;
+    sample->label = label;
+    sample->owned = 1;
+    free(img);
+    return 1;
+}
+
+/**
+ * Frees the image array of a sample if the sample owns it. Dataset views are left alone.
+ *
+ * @param sample: sample to be released.
+ */
+void free_sample(Sample *sample) {
+    if (sample->owned) free(sample->img.arr);
+    sample->img.arr = NULL;
+    sample->owned = 0;
+}
+
+/**
+ * Starts a producer thread that reads data points 0 .. number - 1 in order into a bounded ring buffer, ahead of the
+ * consumer. Reading, decoding and validation happen on the producer; mapped dataset records are paged in there too.
+ * Caller is responsible for freeing returned prefetcher with free_prefetcher.
+ *
+ * @param dataset: packed dataset, or NULL for one file per image and label.
+ * @param number: number of data points.
+ * @param depth: ring buffer capacity in samples, at least 1.
+ *
+ * @return: running prefetcher. NULL for malloc or thread creation fail.
+ */
+Prefetcher *make_prefetcher(const Dataset *dataset, const size_t number, size_t depth) {
+    if (depth == 0) depth = 1;
+
+    // malloc
+    Prefetcher *prefetcher = calloc(1, sizeof(Prefetcher));
+    Sample *ring = malloc(depth * sizeof(Sample));
+    if (prefetcher == NULL || ring == NULL) {
+        fprintf(stderr, "Failed malloc: Prefetcher of depth %zu.\n", depth);
+        free(prefetcher); free(ring);
+        return NULL;
+    }
+
+    // struct setup
+    prefetcher->dataset = dataset;
+    prefetcher->number = number;
+    prefetcher->ring = ring;
+    prefetcher->depth = depth;
+    pthread_mutex_init(&prefetcher->lock, NULL);
+    pthread_cond_init(&prefetcher->filled, NULL);
+    pthread_cond_init(&prefetcher->drained, NULL);
+
+    // start producer
+    if (pthread_create(&prefetcher->thread, NULL, produce_, prefetcher) != 0) {
+        fprintf(stderr, "Failed thread creation: prefetch producer.\n");
+        pthread_mutex_destroy(&prefetcher->lock);
+        pthread_cond_destroy(&prefetcher->filled);
+        pthread_cond_destroy(&prefetcher->drained);
+        free(ring); free(prefetcher);
+        return NULL;
+    }
+    return prefetcher;
+}
+
+/**
+ * Stops and joins the producer, then frees all memory associated with a prefetcher, including samples not yet taken.
+ * If prefetcher is NULL, passes.
+ *
+ * @param prefetcher: prefetcher to be freed.
+ */
+void free_prefetcher(Prefetcher *prefetcher) {
+    if (prefetcher == NULL) return;
+
+    // stop producer
+    pthread_mutex_lock(&prefetcher->lock);
+    prefetcher->stop = 1;
+    pthread_cond_signal(&prefetcher->drained);
+    pthread_mutex_unlock(&prefetcher->lock);
+    pthread_join(prefetcher->thread, NULL);
+
+    // free
+    for (size_t idx = 0; idx < prefetcher->count; idx++) {
+        free_sample(&prefetcher->ring[(prefetcher->head + idx) % prefetcher->depth]);
+    }
+    pthread_mutex_destroy(&prefetcher->lock);
+    pthread_cond_destroy(&prefetcher->filled);
+    pthread_cond_destroy(&prefetcher->drained);
+    free(prefetcher->ring);
+    free(prefetcher);
+}
+
+/**
+ * Takes the next data point, blocking until the producer has read it. Ownership of the sample passes to the caller.
+ *
+ * @param prefetcher: prefetcher.
+ * @param sample: sample, set on success.
+ *
+ * @return: 1 for a sample; 0 when the producer failed or every data point has been taken.
+ */
+int prefetch_next(Prefetcher *prefetcher, Sample *sample) {
+    pthread_mutex_lock(&prefetcher->lock);
+    const int ended = prefetcher->failed || prefetcher->produced == prefetcher->number;
+    if (prefetcher->count == 0 && !ended) prefetcher->stats.consumer_stalls++;
+    while (prefetcher->count == 0 && !prefetcher->failed && prefetcher->produced < prefetcher->number) {
+        pthread_cond_wait(&prefetcher->filled, &prefetcher->lock);
+    }
+    if (prefetcher->count == 0) {
+        pthread_mutex_unlock(&prefetcher->lock);
+        return 0;
+    }
+
+    // queue depth seen by the consumer
+    prefetcher->stats.taken++;
+    prefetcher->stats.depth_sum += prefetcher->count;
+    if (prefetcher->count > prefetcher->stats.depth_max) prefetcher->stats.depth_max = prefetcher->count;
+
+    *sample = prefetcher->ring[prefetcher->head];
+    prefetcher->head = (prefetcher->head + 1) % prefetcher->depth;
+    prefetcher->count--;
+    pthread_cond_signal(&prefetcher->drained);
+    pthread_mutex_unlock(&prefetcher->lock);
+    return 1;
+}
+
+/**
+ * Gets the queue-depth and stall counters of a prefetcher so far.
+ *
+ * @param prefetcher: prefetcher.
+ *
+ * @return: counters.
+ */
+PrefetchStats prefetch_stats(Prefetcher *prefetcher) {
+    pthread_mutex_lock(&prefetcher->lock);
+    const PrefetchStats stats = prefetcher->stats;
+    pthread_mutex_unlock(&prefetcher->lock);
+    return stats;
+}
@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "types.h"
+#include "functional.h"
+#include "computational.h"
+#include "components.h"
+#include "activators.h"
+#include "arena.h"
+#include "plan.h"
+#include "quant.h"
+#include "half.h"
+#include "fft.h"
+#include "blocked.h"
+#include "profile.h"
+
+// samples a row starts with, grown by doubling
+#define ROW_SAMPLES 64
+
+// one layer or op: per-call wall times and run totals
+typedef struct {
+    char name[32];
+    int is_op;
+    double *times;
+    size_t count;
+    size_t cap;
+    double flops;
+    double read;
+    double written;
+    size_t allocs;
+} ProfileRow;
+
+struct Profile {
+    ProfileRow *rows;
+    size_t num;
+    // first row of every plan step
+    size_t *step_rows;
+};
+
+static const char *act_names_[] = {"none", "relu", "sigmoid", "softmax"};
+// conv and matmul op names per weight precision
+static const char *half_names_[][2] = {{"conv", "matmul"}, {"conv_fp16", "matmul_fp16"}, {"conv_bf16", "matmul_bf16"}};
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static double now_(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int add_row_(Profile *profile, const int is_op, const char *name) {
+    ProfileRow *row = &profile->rows[profile->num++];
+    snprintf(row->name, sizeof(row->name), "%s%s", is_op ? "  " : "", name);
+    row->is_op = is_op;
+    row->times = malloc(ROW_SAMPLES * sizeof(double));
+    row->cap = ROW_SAMPLES;
+    if (row->times == NULL) {
+        fprintf(stderr, "Failed malloc: profile row %s.\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+static void record_(ProfileRow *row, const double time, const double flops, const double read, const double written,
+    const size_t allocs) {
+    // grow on demand, a failed grow drops the sample but keeps the totals
+    if (row->count == row->cap) {
+        double *grown = realloc(row->times, 2 * row->cap * sizeof(double));
+        if (grown != NULL) {
+            row->times = grown;
+            row->cap *= 2;
+        }
+    }
+    if (row->count < row->cap) row->times[row->count++] = time;
+    row->flops += flops; row->read += read; row->written += written;
+    row->allocs += allocs;
+}
+
+static int compare_doubles_(const void *a, const void *b) {
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double rank_(const double *sorted, const size_t num, const size_t pct) {
+    // nearest-rank percentile
+    size_t rank = (num * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    return sorted[rank - 1];
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Sets up per-layer and per-op profiling rows for every step of a plan. Layers are named by type and position
+ * (conv1, pool1, conv2, ...); a dense layer is preceded by its flatten, and a layer leaving the blocked layout by the
+ * unblock of its input.
+ * Caller is responsible for freeing returned profile with free_profile.
+ *
+ * @param plan: execution plan to profile.
+ *
+ * @return: empty profile. NULL for malloc fail.
+ */
+Profile *make_profile(const Plan *plan) {
+    // malloc, at most 6 rows per step plus the whole pass
+    Profile *profile = malloc(sizeof(Profile));
+    ProfileRow *rows = calloc(6 * plan->num_steps + 1, sizeof(ProfileRow));
+    size_t *step_rows = malloc((plan->num_steps + 1) * sizeof(size_t));
+    if (profile == NULL || rows == NULL || step_rows == NULL) {
+        fprintf(stderr, "Failed malloc: Profile of %zu steps.\n", plan->num_steps);
+        free(profile); free(rows); free(step_rows);
+        return NULL;
+    }
+    profile->rows = rows;
+    profile->num = 0;
+    profile->step_rows = step_rows;
+
+    // rows per step
+    size_t convs = 0, pools = 0, denses = 0;
+    int ok = 1;
+    for (size_t idx = 0; idx < plan->num_steps && ok; idx++) {
+        const PlanStep *step = &plan->steps[idx];
+        const Layer *layer = step->layer;
+        step_rows[idx] = profile->num;
+        char name[32];
+        if (plan->values[step->in].blocked && step->block == NULL && !plan->values[step->out].blocked) {
+            ok = add_row_(profile, 0, "unblock");
+        }
+        if (layer->type == LAYER_CONV && step->pool != NULL) {
+            convs++; pools++;
+            snprintf(name, sizeof(name), "conv%zu+pool%zu", convs, pools);
+            ok = add_row_(profile, 0, name) && add_row_(profile, 1, "conv_pool");
+        } else if (layer->type == LAYER_CONV) {
+            snprintf(name, sizeof(name), "conv%zu", ++convs);
+            const char *op = layer->quant != NULL ? "conv_int8"
+                : layer->half != NULL ? half_names_[layer->half->prec][0]
+                : step->block != NULL ? "conv_blocked"
+                : step->wino != NULL ? "conv_winograd"
+                : step->fft != NULL ? "conv_fft"
+                : get_conv_backend() == CONV_IM2COL ? "conv_im2col" : "conv_direct";
+            ok = add_row_(profile, 0, name) && add_row_(profile, 1, op);
+        } else if (layer->type == LAYER_POOL) {
+            snprintf(name, sizeof(name), "pool%zu", ++pools);
+            const char *op = plan->values[step->out].blocked ? "max_blocked" : "max";
+            ok = add_row_(profile, 0, name) && add_row_(profile, 1, op);
+        } else if (layer->quant != NULL) {
+            // bias applied on dequantization
+            snprintf(name, sizeof(name), "dense%zu", ++denses);
+            ok = add_row_(profile, 0, "flatten") && add_row_(profile, 0, name) && add_row_(profile, 1, "matmul_int8");
+        } else if (layer->half != NULL) {
+            // bias added within the op
+            snprintf(name, sizeof(name), "dense%zu", ++denses);
+            ok = add_row_(profile, 0, "flatten") && add_row_(profile, 0, name)
+                && add_row_(profile, 1, half_names_[layer->half->prec][1]);
+        } else {
+            snprintf(name, sizeof(name), "dense%zu", ++denses);
+            ok = add_row_(profile, 0, "flatten") && add_row_(profile, 0, name) && add_row_(profile, 1, "matmul")
+                && add_row_(profile, 1, "bias");
+        }
+        if (layer->activation != ACT_NONE) ok = ok && add_row_(profile, 1, act_names_[layer->activation]);
+    }
+    step_rows[plan->num_steps] = profile->num;
+    if (!ok || !add_row_(profile, 0, "forward")) {
+        free_profile(profile);
+        return NULL;
+    }
+    return profile;
+}
+
+/**
+ * Frees all memory associated with a profile. If profile is NULL, passes.
+ *
+ * @param profile: profile to be freed.
+ */
+void free_profile(Profile *profile) {
+    if (profile == NULL) return;
+    for (size_t idx = 0; idx < profile->num; idx++) free(profile->rows[idx].times);
+    free(profile->rows);
+    free(profile->step_rows);
+    free(profile);
+}
+
+/**
+ * Runs every step of a plan like plan_run, timing each layer and each op within it with a monotonic clock.
+ * Ops run separately here, e.g. conv then activation, matmul then bias then activation, with the same results.
+ * FLOPs count a multiply-add as 2 and every bias add, pool comparison and activated element as 1. Bytes are the
+ * compulsory traffic of each op: inputs and weights read once, outputs written once. Allocations are alloc_arr calls.
+ *
+ * @param profile: profile from make_profile of the same plan.
+ * @param plan: execution plan.
+ * @param region: activation region from plan_begin.
+ * @param x: input batch, as for plan_run.
+ * @param arena: arena the region was taken from.
+ *
+ * @return: 1 for a complete run; 0 for a mismatched input or an op fail.
+ */
+int profile_run(Profile *profile, const Plan *plan, elm_t *region, const Batch *x, Arena *arena) {
+    const PlanValue *input = &plan->values[0];
+    if (x->m != input->m || x->n != input->n || x->o != input->o || x->b == 0 || x->b > plan->batch) {
+        fprintf(stderr, "Invalid plan input: %zu x %zu x %zu x %zu.\n", x->m, x->n, x->o, x->b);
+        return 0;
+    }
+    const double esize = sizeof(elm_t);
+    const double pass_start = now_();
+    const size_t pass_allocs = alloc_count();
+    double pass_flops = 0, pass_read = 0, pass_written = 0;
+
+    for (size_t idx = 0; idx < plan->num_steps; idx++) {
+        const PlanStep *step = &plan->steps[idx];
+        const Layer *layer = step->layer;
+        ProfileRow *row = &profile->rows[profile->step_rows[idx]];
+        Batch in = step->in == 0 ? *x : plan_value(plan, region, step->in, x->b);
+        Batch out = plan_value(plan, region, step->out, x->b);
+        const int in_blocked = plan->values[step->in].blocked, out_blocked = plan->values[step->out].blocked;
+        const double in_elms = (double)(in.m * in.n * in.o * in.b);
+        int ok = 1;
+
+        const size_t mark = arena->used;
+        elm_t *planar = NULL;
+        if (in_blocked && step->block == NULL && !out_blocked) {
+            // leaving the blocked layout, padding lanes read too
+            double start = now_();
+            planar = arena_scratch(arena, in.m * in.n * in.o * in.b);
+            if (planar == NULL) {
+                fprintf(stderr, "Failed plan step %zu.\n", idx);
+                return 0;
+            }
+            const Batch blocked = in;
+            in.arr = planar;
+            batch_unblock_into(&in, &blocked);
+            const double padded = (double)batch_blocked_size(&blocked);
+            record_(row++, now_() - start, 0, padded * esize, in_elms * esize, 0);
+            pass_read += padded * esize; pass_written += in_elms * esize;
+        }
+        if (layer->type == LAYER_DENSE) {
+            // flatten, a view
+            double start = now_();
+            batch_flatten(&in);
+            record_(row++, now_() - start, 0, 0, 0, 0);
+        }
+        ProfileRow *layer_row = row++;
+        const double layer_start = now_();
+        const size_t layer_allocs = alloc_count();
+        double flops = 0, read = 0, written = 0;
+
+        // main op
+        double start = now_();
+        size_t allocs = alloc_count();
+        double op_flops, op_read, op_written;
+        // int8 weights read as bytes plus a scale and bias per output channel
+        const QuantWeights *quant = layer->quant;
+        const double quant_bytes = quant != NULL ? (double)(quant->num * (quant->len + 2 * sizeof(elm_t))) : 0;
+        // half-precision weights read as 16 bit values
+        const HalfWeights *half = layer->half;
+        const double half_bytes = half != NULL ? (double)(half->rows * half->cols * sizeof(uint16_t)) : 0;
+        if (layer->type == LAYER_CONV) {
+            const Kernel *kernel = layer->conv->kernels[0];
+            // winograd reads 4x4 transformed kernels, fft a complex spectrum per kernel pair
+            const FftKernels *fk = step->fft;
+            const size_t kernel_elms = step->wino != NULL ? 16 * kernel->o
+                : fk != NULL ? fk->m * fk->n * kernel->o : kernel->m * kernel->n * kernel->o;
+            const double weights = (double)(layer->conv->num * (kernel_elms + 1)) * esize;
+            if (step->block != NULL) {
+                ok = batch_conv_blocked_into(&out, &in, in_blocked, layer->conv, step->block, arena) != NULL;
+            } else if (quant != NULL) {
+                ok = batch_conv_quant_into(&out, &in, layer->conv, quant, arena) != NULL;
+            } else if (half != NULL) {
+                ok = batch_conv_half_into(&out, &in, layer->conv, half, step->pool, arena) != NULL;
+            } else if (step->wino != NULL) {
+                ok = batch_conv_winograd_into(&out, &in, layer->conv, step->wino, arena) != NULL;
+            } else if (fk != NULL) {
+                ok = batch_conv_fft_into(&out, &in, layer->conv, fk, arena) != NULL;
+            } else if (step->pool != NULL) {
+                ok = batch_conv_pool_into(&out, &in, layer->conv, step->pool, arena) != NULL;
+            } else if (get_conv_backend() == CONV_IM2COL) {
+                ok = batch_conv_im2col_into(&out, &in, layer->conv, arena) != NULL;
+            } else {
+                ok = batch_conv_direct_into(&out, &in, layer->conv) != NULL;
+            }
+            // macs counted over the pre-pool output at direct convolution cost, whatever the backend
+            const Batch conv_shape = batch_conv_shape(&in, layer->conv);
+            const double conv_elms = (double)(conv_shape.m * conv_shape.n * conv_shape.o * conv_shape.b);
+            op_flops = conv_elms * (2.0 * (double)(kernel->m * kernel->n * kernel->o) + (double)kernel->o);
+            op_read = in_elms * esize + (quant != NULL ? quant_bytes
+                : half != NULL ? half_bytes + (double)layer->conv->num * esize : weights);
+        } else if (layer->type == LAYER_POOL) {
+            ok = (out_blocked ? batch_pool_blocked_into(&out, &in, layer->pool)
+                : batch_pool_into(&out, &in, layer->pool)) != NULL;
+            op_flops = ok ? (double)(out.m * out.n * out.o * out.b * layer->pool->m * layer->pool->n) : 0;
+            op_read = in_elms * esize;
+        } else if (quant != NULL) {
+            ok = batch_dense_quant_into(&out, &in, quant, arena) != NULL;
+            op_flops = (2.0 * in_elms + (double)in.b) * (double)quant->num;
+            op_read = in_elms * esize + quant_bytes;
+        } else if (half != NULL) {
+            ok = batch_dense_half_into(&out, &in, layer->dense, half, arena) != NULL;
+            op_flops = (2.0 * in_elms + (double)in.b) * (double)half->cols;
+            op_read = in_elms * esize + half_bytes + (double)half->cols * esize;
+        } else {
+            ok = batch_matmul_into(&out, &in, layer->dense->weights, arena) != NULL;
+            const double weights = (double)(layer->dense->weights->m * layer->dense->weights->n);
+            op_flops = 2.0 * in_elms * (double)layer->dense->weights->n;
+            op_read = (in_elms + weights) * esize;
+        }
+        const double out_elms = (double)(out.m * out.n * out.o * out.b);
+        op_written = out_elms * esize;
+        record_(row++, now_() - start, op_flops, op_read, op_written, alloc_count() - allocs);
+        flops += op_flops; read += op_read; written += op_written;
+
+        // bias
+        if (ok && layer->type == LAYER_DENSE && quant == NULL && half == NULL) {
+            start = now_();
+            allocs = alloc_count();
+            ok = batch_sum_into(&out, &out, layer->dense->biases) != NULL;
+            const double biases = (double)layer->dense->biases->n;
+            record_(row++, now_() - start, out_elms, (out_elms + biases) * esize, out_elms * esize,
+                alloc_count() - allocs);
+            flops += out_elms; read += (out_elms + biases) * esize; written += out_elms * esize;
+        }
+
+        // activation
+        if (ok && layer->activation != ACT_NONE) {
+            start = now_();
+            allocs = alloc_count();
+            const Tensor view = out_blocked ? blocked_view(&out) : batch_view(&out);
+            step->fn(&view);
+            record_(row++, now_() - start, out_elms, out_elms * esize, out_elms * esize, alloc_count() - allocs);
+            flops += out_elms; read += out_elms * esize; written += out_elms * esize;
+        }
+        if (planar != NULL) arena_drop(arena, planar, mark);
+        if (!ok) {
+            fprintf(stderr, "Failed plan step %zu.\n", idx);
+            return 0;
+        }
+        record_(layer_row, now_() - layer_start, flops, read, written, alloc_count() - layer_allocs);
+        pass_flops += flops; pass_read += read; pass_written += written;
+    }
+    record_(&profile->rows[profile->num - 1], now_() - pass_start, pass_flops, pass_read, pass_written,
+        alloc_count() - pass_allocs);
+    return 1;
+}
+
+/**
+ * Prints a profile as a table: per layer and op, the number of calls, mean and p50/p95/p99 wall time per call, and
+ * run totals of FLOPs, bytes read and written, and allocations.
+ *
+ * @param profile: profile.
+ */
+void print_profile(const Profile *profile) {
+    printf("\n%-18s %6s %10s %10s %10s %10s | %10s %10s %10s %7s %8s\n", "layer / op", "calls", "mean us", "p50 us",
+        "p95 us", "p99 us", "MFLOP", "MB read", "MB written", "allocs", "GFLOP/s");
+    for (size_t idx = 0; idx < profile->num; idx++) {
+        const ProfileRow *row = &profile->rows[idx];
+        if (row->count == 0) continue;
+
+        // percentiles over a sorted copy
+        double sorted[row->count];
+        memcpy(sorted, row->times, row->count * sizeof(double));
+        qsort(sorted, row->count, sizeof(double), compare_doubles_);
+        double total = 0;
+        for (size_t call = 0; call < row->count; call++) total += sorted[call];
+        const double mean = total / (double)row->count;
+
+        if (!row->is_op && idx + 1 == profile->num) printf("\n");
+        printf("%-18s %6zu %10.3f %10.3f %10.3f %10.3f | %10.3f %10.3f %10.3f %7zu %8.3f\n", row->name, row->count,
+            mean * 1e6, rank_(sorted, row->count, 50) * 1e6, rank_(sorted, row->count, 95) * 1e6,
+            rank_(sorted, row->count, 99) * 1e6, row->flops * 1e-6, row->read * 1e-6, row->written * 1e-6,
+            row->allocs, total > 0 ? row->flops / total * 1e-9 : 0.0);
+    }
+}
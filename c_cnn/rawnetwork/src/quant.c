@@ -0,0 +1,364 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "functional.h"
+#include "computational.h"
+#include "arena.h"
+#include "simd.h"
+#include "half.h"
+#include "plan.h"
+#include "quant.h"
+
+// int8 rows are zero-padded to whole 32-byte vectors, so dot products run without tails
+#define QUANT_LANES 32
+
+// largest quantized magnitude, symmetric so zero maps to zero
+#define QUANT_MAX 127
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static size_t quant_stride_(const size_t len) {
+    return (len + QUANT_LANES - 1) / QUANT_LANES * QUANT_LANES;
+}
+
+static int8_t quantize_(const elm_t val, const elm_t inv_scale) {
+    // saturated, then rounded half away from zero; no libm call in the inner loops
+    const elm_t scaled = val * inv_scale;
+    if (scaled >= QUANT_MAX) return QUANT_MAX;
+    if (scaled <= -QUANT_MAX) return -QUANT_MAX;
+    return (int8_t)(scaled + (scaled >= 0 ? (elm_t)0.5 : (elm_t)-0.5));
+}
+
+static size_t int8_elms_(const size_t bytes) {
+    // elm_t workspace holding bytes of int8
+    return (bytes + sizeof(elm_t) - 1) / sizeof(elm_t);
+}
+
+static QuantWeights *make_quant_(const size_t num, const size_t len, const elm_t range) {
+    // malloc
+    QuantWeights *quant = malloc(sizeof(QuantWeights));
+    const size_t stride = quant_stride_(len);
+    int8_t *weights = calloc(num * stride, sizeof(int8_t));
+    elm_t *scales = alloc_arr(num);
+    elm_t *biases = alloc_arr(num);
+    if (quant == NULL || weights == NULL || scales == NULL || biases == NULL) {
+        fprintf(stderr, "Failed malloc: int8 weights sized %zu x %zu.\n", num, len);
+        free(quant); free(weights); free(scales); free(biases);
+        return NULL;
+    }
+    quant->num = num;
+    quant->len = len;
+    quant->stride = stride;
+    quant->weights = weights;
+    quant->scales = scales;
+    quant->biases = biases;
+    quant->in_scale = range > 0 ? range / QUANT_MAX : 1;
+    return quant;
+}
+
+static void quantize_row_(QuantWeights *quant, const size_t row, const elm_t *src, const size_t step) {
+    // per output channel scale from the largest weight magnitude
+    elm_t range = 0;
+    for (size_t elm = 0; elm < quant->len; elm++) {
+        const elm_t mag = fabsf(src[elm * step]);
+        if (mag > range) range = mag;
+    }
+    const elm_t scale = range > 0 ? range / QUANT_MAX : 1;
+    int8_t *dst = &quant->weights[row * quant->stride];
+    for (size_t elm = 0; elm < quant->len; elm++) dst[elm] = quantize_(src[elm * step], 1 / scale);
+    // folded with the input scale, one multiply dequantizes an accumulator
+    quant->scales[row] = scale * quant->in_scale;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Quantizes the kernels of a convolutional layer to int8, symmetric with one scale per output channel.
+ * Caller is responsible for freeing returned weights with free_quant.
+ *
+ * @param conv: convolutional layer; all kernels must share shape.
+ * @param range: calibrated largest input magnitude of the layer.
+ *
+ * @return: int8 weights, one zero-padded row per kernel. NULL for malloc fail.
+ */
+QuantWeights *quantize_conv(const Convolutional *conv, const elm_t range) {
+    const Kernel *k_ref = conv->kernels[0];
+    QuantWeights *quant = make_quant_(conv->num, k_ref->m * k_ref->n * k_ref->o, range);
+    if (quant == NULL) return NULL;
+    for (size_t kern = 0; kern < conv->num; kern++) {
+        quantize_row_(quant, kern, conv->kernels[kern]->arr, 1);
+        // bias accumulated once per input channel, as in the fp32 path
+        quant->biases[kern] = conv->kernels[kern]->bias * (elm_t)k_ref->o;
+    }
+    return quant;
+}
+
+/**
+ * Quantizes the weights of a dense layer to int8, symmetric with one scale per output neuron. Weights are stored
+ * transposed, one row per output neuron.
+ * Caller is responsible for freeing returned weights with free_quant.
+ *
+ * @param dense: dense layer.
+ * @param range: calibrated largest input magnitude of the layer.
+ *
+ * @return: int8 weights. NULL for malloc fail.
+ */
+QuantWeights *quantize_dense(const Dense *dense, const elm_t range) {
+    const size_t t = dense->weights->m, n = dense->weights->n;
+    QuantWeights *quant = make_quant_(n, t, range);
+    if (quant == NULL) return NULL;
+    for (size_t col = 0; col < n; col++) {
+        quantize_row_(quant, col, &dense->weights->arr[col], n);
+        quant->biases[col] = dense->biases->arr[col];
+    }
+    return quant;
+}
+
+/**
+ * Frees all memory associated with int8 weights. If quant is NULL, passes.
+ *
+ * @param quant: weights to be freed.
+ */
+void free_quant(QuantWeights *quant) {
+    if (quant == NULL) return;
+    free(quant->weights);
+    free(quant->scales);
+    free(quant->biases);
+    free(quant);
+}
+
+/**
+ * Widens the calibrated range of every value of a plan with the items of the last run: the largest magnitude seen.
+ *
+ * @param plan: execution plan compiled with keep, so every value is intact after the run.
+ * @param region: activation region of the run.
+ * @param num: number of items in the run.
+ * @param ranges: one range per plan value, start at zero.
+ */
+void calibrate_plan(const Plan *plan, elm_t *region, const size_t num, elm_t *ranges) {
+    for (size_t idx = 0; idx < plan->num_values; idx++) {
+        const Batch value = plan_value(plan, region, idx, num);
+        const size_t size = value.m * value.n * value.o * value.b;
+        for (size_t elm = 0; elm < size; elm++) {
+            const elm_t mag = fabsf(value.arr[elm]);
+            if (mag > ranges[idx]) ranges[idx] = mag;
+        }
+    }
+}
+
+/**
+ * Copies a layer list with int8 weights for every conv and dense layer, each scaled for its calibrated input range.
+ * Copies share the fp32 parameters of the originals.
+ * Caller is responsible for freeing returned layers with free_quant_layers.
+ *
+ * @param plan: unfused execution plan of the layers the ranges were calibrated on.
+ * @param ranges: one range per plan value, from calibrate_plan.
+ *
+ * @return: layer list of plan->num_steps layers. NULL for malloc fail.
+ */
+Layer *quantize_layers(const Plan *plan, const elm_t *ranges) {
+    Layer *layers = malloc((plan->num_steps != 0 ? plan->num_steps : 1) * sizeof(Layer));
+    if (layers == NULL) {
+        fprintf(stderr, "Failed malloc: %zu quantized layers.\n", plan->num_steps);
+        return NULL;
+    }
+    for (size_t idx = 0; idx < plan->num_steps; idx++) {
+        const PlanStep *step = &plan->steps[idx];
+        layers[idx] = *step->layer;
+        layers[idx].quant = NULL;
+        if (step->layer->type != LAYER_CONV && step->layer->type != LAYER_DENSE) continue;
+        // half-precision weights widened for the quantization only
+        Layer *wide = widen_layers(step->layer, 1);
+        if (wide != NULL) {
+            layers[idx].quant = wide->type == LAYER_CONV ? quantize_conv(wide->conv, ranges[step->in])
+                : quantize_dense(wide->dense, ranges[step->in]);
+            free_wide_layers(wide, 1);
+        }
+        if (layers[idx].quant == NULL) {
+            free_quant_layers(layers, idx);
+            return NULL;
+        }
+    }
+    return layers;
+}
+
+/**
+ * Frees a layer list from quantize_layers. Shared fp32 parameters are not freed. If layers is NULL, passes.
+ *
+ * @param layers: layers to be freed.
+ * @param num: number of layers.
+ */
+void free_quant_layers(Layer *layers, const size_t num) {
+    if (layers == NULL) return;
+    for (size_t idx = 0; idx < num; idx++) free_quant(layers[idx].quant);
+    free(layers);
+}
+
+/**
+ * Workspace elements batch_conv_quant_into takes from its arena.
+ *
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer.
+ * @param quant: int8 weights of the layer.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_conv_quant_workspace(const Batch *channels, const Convolutional *kernels, const QuantWeights *quant) {
+    const Batch shape = batch_conv_shape(channels, kernels);
+    return arena_bytes(int8_elms_(channels->m * channels->n * channels->o)) / sizeof(elm_t)
+        + arena_bytes(int8_elms_(shape.m * shape.n * quant->stride)) / sizeof(elm_t)
+        + arena_bytes(quant->num) / sizeof(elm_t);
+}
+
+/**
+ * Convolution of every item of a batch with a full convolutional layer in int8, into a caller-provided batch. Each item
+ * is quantized with the calibrated input scale and unrolled into one zero-padded int8 window per output position;
+ * every output is an int8 dot product accumulated in int32, then dequantized and biased as in the fp32 path.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param channels: batch of tensors to be convolved.
+ * @param kernels: convolutional layer; all kernels must share shape and stride.
+ * @param quant: int8 weights of the layer.
+ * @param arena: arena for the int8 input, windows and int32 accumulators, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_conv_quant_into(Batch *res, const Batch *channels, const Convolutional *kernels,
+    const QuantWeights *quant, Arena *arena) {
+    // dimension setup
+    const Kernel *k_ref = kernels->kernels[0];
+    const size_t m = channels->m, n = channels->n, o = channels->o, b = channels->b;
+    const size_t num = kernels->num;
+    const Batch shape = batch_conv_shape(channels, kernels);
+    if (shape.b != b || quant->num != num || quant->len != o * k_ref->m * k_ref->n) return NULL;
+    const size_t m_res = shape.m, n_res = shape.n, cols = m_res * n_res;
+    const size_t stride = quant->stride;
+
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    elm_t *in_work = arena_scratch(arena, int8_elms_(m * n * o));
+    elm_t *col_work = arena_scratch(arena, int8_elms_(cols * stride));
+    elm_t *acc_work = arena_scratch(arena, num);
+    if (in_work == NULL || col_work == NULL || acc_work == NULL) {
+        fprintf(stderr, "Failed malloc: int8 conv workspace sized %zu x %zu.\n", cols, stride);
+        if (acc_work != NULL) arena_drop(arena, acc_work, mark);
+        if (col_work != NULL) arena_drop(arena, col_work, mark);
+        if (in_work != NULL) arena_drop(arena, in_work, mark);
+        return NULL;
+    }
+    int8_t *q_in = (int8_t *)in_work;
+    int8_t *q_col = (int8_t *)col_work;
+    int32_t *acc = (int32_t *)acc_work;
+    memset(q_col, 0, cols * stride);
+
+    // struct setup
+    res->m = m_res; res->n = n_res; res->o = num; res->b = b;
+
+    // convolution operation
+    const SimdOps *ops = simd_ops();
+    const elm_t inv_scale = 1 / quant->in_scale;
+    for (size_t img = 0; img < b; img++) {
+        // quantized item
+        const elm_t *main = &channels->arr[img * m * n * o];
+        for (size_t elm = 0; elm < m * n * o; elm++) q_in[elm] = quantize_(main[elm], inv_scale);
+
+        // one window per output position, in kernel order
+        for (size_t row = 0; row < m_res; row++) {
+            for (size_t col = 0; col < n_res; col++) {
+                int8_t *dst = &q_col[(row * n_res + col) * stride];
+                for (size_t mat = 0; mat < o; mat++) {
+                    for (size_t row_k = 0; row_k < k_ref->m; row_k++) {
+                        const int8_t *src = &q_in[(mat * m + row * k_ref->m_stride + row_k) * n
+                            + col * k_ref->n_stride];
+                        int8_t *dst_row = &dst[(mat * k_ref->m + row_k) * k_ref->n];
+                        for (size_t col_k = 0; col_k < k_ref->n; col_k++) dst_row[col_k] = src[col_k];
+                    }
+                }
+            }
+        }
+
+        // every kernel against each window in int32, dequantized per output channel
+        elm_t *targ = &res->arr[img * num * cols];
+        for (size_t pos = 0; pos < cols; pos++) {
+            ops->dot_s8(acc, &q_col[pos * stride], quant->weights, stride, num);
+            for (size_t kern = 0; kern < num; kern++) {
+                targ[kern * cols + pos] = (elm_t)acc[kern] * quant->scales[kern] + quant->biases[kern];
+            }
+        }
+    }
+
+    // free and return
+    arena_drop(arena, acc_work, mark);
+    arena_drop(arena, col_work, mark);
+    arena_drop(arena, in_work, mark);
+    return res;
+}
+
+/**
+ * Workspace elements batch_dense_quant_into takes from its arena.
+ *
+ * @param quant: int8 weights of the layer.
+ *
+ * @return: workspace size in elements.
+ */
+size_t batch_dense_quant_workspace(const QuantWeights *quant) {
+    return arena_bytes(int8_elms_(quant->stride)) / sizeof(elm_t) + arena_bytes(quant->num) / sizeof(elm_t);
+}
+
+/**
+ * Dense layer over every item of a flattened batch in int8, into a caller-provided batch. Each item is quantized with
+ * the calibrated input scale; every output is an int8 dot product accumulated in int32, then dequantized and biased.
+ * res->arr must hold the result; res dimensions are set by the call.
+ *
+ * @param res: result batch.
+ * @param input: flattened batch of activations.
+ * @param quant: int8 weights of the layer.
+ * @param arena: arena for the int8 input and int32 accumulators, or NULL to use the heap.
+ *
+ * @return: res. NULL with any dimensional mismatch or malloc fail.
+ */
+Batch *batch_dense_quant_into(Batch *res, const Batch *input, const QuantWeights *quant, Arena *arena) {
+    // dimensionality check
+    const size_t t = input->m * input->n * input->o, b = input->b;
+    if (t != quant->len) {
+        fprintf(stderr, "Dimensional mismatch: input (%zu) != int8 weights (%zu).\n", t, quant->len);
+        return NULL;
+    }
+
+    // workspace
+    const size_t mark = arena != NULL ? arena->used : 0;
+    elm_t *in_work = arena_scratch(arena, int8_elms_(quant->stride));
+    elm_t *acc_work = arena_scratch(arena, quant->num);
+    if (in_work == NULL || acc_work == NULL) {
+        fprintf(stderr, "Failed malloc: int8 dense workspace sized %zu.\n", quant->stride);
+        if (acc_work != NULL) arena_drop(arena, acc_work, mark);
+        if (in_work != NULL) arena_drop(arena, in_work, mark);
+        return NULL;
+    }
+    int8_t *q_in = (int8_t *)in_work;
+    int32_t *acc = (int32_t *)acc_work;
+    memset(q_in, 0, quant->stride);
+
+    // struct setup
+    res->m = 1; res->n = quant->num; res->o = 1; res->b = b;
+
+    // dense operation
+    const SimdOps *ops = simd_ops();
+    const elm_t inv_scale = 1 / quant->in_scale;
+    for (size_t img = 0; img < b; img++) {
+        const elm_t *main = &input->arr[img * t];
+        for (size_t elm = 0; elm < t; elm++) q_in[elm] = quantize_(main[elm], inv_scale);
+        ops->dot_s8(acc, q_in, quant->weights, quant->stride, quant->num);
+        elm_t *targ = &res->arr[img * quant->num];
+        for (size_t col = 0; col < quant->num; col++) {
+            targ[col] = (elm_t)acc[col] * quant->scales[col] + quant->biases[col];
+        }
+    }
+
+    // free and return
+    arena_drop(arena, acc_work, mark);
+    arena_drop(arena, in_work, mark);
+    return res;
+}
@@ -0,0 +1,1041 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+// cephes expf constants; the polynomial exp is within 1 ulp (relative error below 1e-7) over [-87.3, 88.3],
+// flushes to 0 below and saturates at 2.4e38 above, never inf or nan
+#define EXP_HI 88.3762626647949f
+#define EXP_LO -88.3762626647949f
+#define LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 -2.12194440e-4f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static void axpy_scalar_(elm_t *y, const elm_t *x, const elm_t alpha, const size_t len) {
+    for (size_t elm = 0; elm < len; elm++) y[elm] += alpha * x[elm];
+}
+
+static void max_stride_scalar_(elm_t *y, const elm_t *x, const size_t len, const size_t stride) {
+    for (size_t elm = 0; elm < len; elm++) {
+        if (x[elm * stride] > y[elm]) y[elm] = x[elm * stride];
+    }
+}
+
+static void relu_scalar_(elm_t *arr, const size_t len) {
+    for (size_t elm = 0; elm < len; elm++) {
+        if (arr[elm] < 0.0) arr[elm] = (elm_t)0.0;
+    }
+}
+
+static elm_t exp_scalar_(elm_t x) {
+    // as exp_sse_, one lane
+    x = x < EXP_LO ? EXP_LO : x > EXP_HI ? EXP_HI : x;
+    const elm_t fx = floorf(x * LOG2E + 0.5f);
+    x = x - fx * EXP_C1;
+    x = x - fx * EXP_C2;
+    elm_t y = EXP_P0;
+    y = y * x + EXP_P1;
+    y = y * x + EXP_P2;
+    y = y * x + EXP_P3;
+    y = y * x + EXP_P4;
+    y = y * x + EXP_P5;
+    y = y * (x * x) + x + 1.0f;
+    const uint32_t bits = (uint32_t)((int32_t)fx + 127) << 23;
+    elm_t pow2n;
+    memcpy(&pow2n, &bits, sizeof(pow2n));
+    return y * pow2n;
+}
+
+static elm_t max_scalar_(const elm_t *arr, const size_t len) {
+    elm_t max = -INFINITY;
+    for (size_t elm = 0; elm < len; elm++) {
+        if (arr[elm] > max) max = arr[elm];
+    }
+    return max;
+}
+
+static void sigmoid_scalar_(elm_t *arr, const size_t len) {
+    for (size_t elm = 0; elm < len; elm++) {
+        arr[elm] = 1.0f / (1.0f + exp_scalar_(-arr[elm]));
+    }
+}
+
+static void softmax_scalar_(elm_t *arr, const size_t len) {
+    // max-subtracted, exps stored on the way to the sum
+    const elm_t max = max_scalar_(arr, len);
+    elm_t sum = 0;
+    for (size_t elm = 0; elm < len; elm++) {
+        arr[elm] = exp_scalar_(arr[elm] - max);
+        sum += arr[elm];
+    }
+    const elm_t inv = 1.0f / sum;
+    for (size_t elm = 0; elm < len; elm++) arr[elm] *= inv;
+}
+
+static void gemm_kernel_scalar_(const size_t kc, const elm_t *a, const elm_t *b, elm_t *c, const size_t ldc,
+    const size_t mr, const size_t nr, const int first) {
+    // 4 x 8 register tile
+    elm_t acc[4][8] = {{0}};
+    for (size_t p = 0; p < kc; p++) {
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 8; j++) {
+                acc[i][j] += a[p * 4 + i] * b[p * 8 + j];
+            }
+        }
+    }
+
+    // write back edge-clipped tile
+    for (size_t i = 0; i < mr; i++) {
+        for (size_t j = 0; j < nr; j++) {
+            c[i * ldc + j] = first ? acc[i][j] : c[i * ldc + j] + acc[i][j];
+        }
+    }
+}
+
+static void dot_s8_scalar_(int32_t *res, const int8_t *a, const int8_t *b, const size_t len, const size_t rows) {
+    for (size_t row = 0; row < rows; row++) {
+        int32_t acc = 0;
+        for (size_t elm = 0; elm < len; elm++) acc += (int32_t)a[elm] * (int32_t)b[row * len + elm];
+        res[row] = acc;
+    }
+}
+
+static void widen_f16_scalar_(elm_t *dst, const uint16_t *src, const size_t len) {
+    for (size_t elm = 0; elm < len; elm++) {
+        // ieee half: 1 sign, 5 exponent, 10 mantissa bits
+        const uint32_t sign = (uint32_t)(src[elm] & 0x8000) << 16;
+        const uint32_t exp = (src[elm] >> 10) & 0x1F, man = src[elm] & 0x3FF;
+        uint32_t bits;
+        if (exp == 0x1F) {
+            bits = sign | 0x7F800000u | man << 13;
+        } else if (exp != 0) {
+            bits = sign | (exp + 112) << 23 | man << 13;
+        } else {
+            // zero or subnormal, man * 2^-24
+            const float val = (float)man * 5.9604644775390625e-8f;
+            memcpy(&bits, &val, sizeof(bits));
+            bits |= sign;
+        }
+        memcpy(&dst[elm], &bits, sizeof(bits));
+    }
+}
+
+static void widen_bf16_scalar_(elm_t *dst, const uint16_t *src, const size_t len) {
+    // upper half of a float32
+    for (size_t elm = 0; elm < len; elm++) {
+        const uint32_t bits = (uint32_t)src[elm] << 16;
+        memcpy(&dst[elm], &bits, sizeof(bits));
+    }
+}
+
+static void butterfly_scalar_(elm_t *a_re, elm_t *a_im, elm_t *b_re, elm_t *b_im, const elm_t w_re,
+    const elm_t w_im, const size_t len) {
+    for (size_t elm = 0; elm < len; elm++) {
+        const elm_t t_re = w_re * b_re[elm] - w_im * b_im[elm], t_im = w_re * b_im[elm] + w_im * b_re[elm];
+        b_re[elm] = a_re[elm] - t_re;
+        b_im[elm] = a_im[elm] - t_im;
+        a_re[elm] += t_re;
+        a_im[elm] += t_im;
+    }
+}
+
+static void cmac_scalar_(elm_t *y_re, elm_t *y_im, const elm_t *x_re, const elm_t *x_im, const elm_t *w_re,
+    const elm_t *w_im, const size_t len) {
+    for (size_t elm = 0; elm < len; elm++) {
+        y_re[elm] += x_re[elm] * w_re[elm] - x_im[elm] * w_im[elm];
+        y_im[elm] += x_re[elm] * w_im[elm] + x_im[elm] * w_re[elm];
+    }
+}
+
+static void conv_block_scalar_(elm_t *y, const elm_t *x, const size_t *offs, const elm_t *w, const size_t taps,
+    const size_t cols, const size_t stride) {
+    for (size_t col = 0; col < cols; col++) {
+        elm_t *out = &y[col * CHAN_BLOCK];
+        for (size_t tap = 0; tap < taps; tap++) {
+            const elm_t val = x[offs[tap] + col * stride];
+            for (size_t lane = 0; lane < CHAN_BLOCK; lane++) out[lane] += val * w[tap * CHAN_BLOCK + lane];
+        }
+    }
+}
+
+static void max_block_scalar_(elm_t *y, const elm_t *x, const size_t cols, const size_t stride) {
+    for (size_t col = 0; col < cols; col++) {
+        elm_t *out = &y[col * CHAN_BLOCK];
+        const elm_t *src = &x[col * stride];
+        for (size_t lane = 0; lane < CHAN_BLOCK; lane++) {
+            if (src[lane] > out[lane]) out[lane] = src[lane];
+        }
+    }
+}
+
+static void tile_store_(elm_t *c, const size_t ldc, const elm_t *acc, const size_t ld_acc,
+    const size_t mr, const size_t nr, const int first) {
+    // edge-clipped write back of a spilled register tile
+    for (size_t i = 0; i < mr; i++) {
+        for (size_t j = 0; j < nr; j++) {
+            c[i * ldc + j] = first ? acc[i * ld_acc + j] : c[i * ldc + j] + acc[i * ld_acc + j];
+        }
+    }
+}
+
+static const SimdOps scalar_ops_ = {
+    .name="scalar",
+    .axpy=axpy_scalar_, .max_stride=max_stride_scalar_,
+    .relu=relu_scalar_, .sigmoid=sigmoid_scalar_, .softmax=softmax_scalar_,
+    .gemm_kernel=gemm_kernel_scalar_, .gemm_mr=4, .gemm_nr=8,
+    .dot_s8=dot_s8_scalar_,
+    .widen_f16=widen_f16_scalar_, .widen_bf16=widen_bf16_scalar_,
+    .butterfly=butterfly_scalar_, .cmac=cmac_scalar_,
+    .conv_block=conv_block_scalar_, .max_block=max_block_scalar_,
+};
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+#ifdef SIMD_X86
+
+// sse
+
+__attribute__((target("sse2")))
+static __m128 exp_sse_(__m128 x) {
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_LO)), _mm_set1_ps(EXP_HI));
+    // n = floor(x * log2e + 0.5)
+    __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E)), _mm_set1_ps(0.5f));
+    __m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    fx = _mm_sub_ps(tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), _mm_set1_ps(1.0f)));
+    // r = x - n * ln2
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(EXP_C2)));
+    // polynomial
+    __m128 y = _mm_set1_ps(EXP_P0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(EXP_P5));
+    y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), x), _mm_set1_ps(1.0f));
+    // scale by 2^n
+    const __m128i pow2n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+}
+
+__attribute__((target("sse2")))
+static elm_t hsum_sse_(const __m128 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+}
+
+__attribute__((target("sse2")))
+static void axpy_sse_(elm_t *y, const elm_t *x, const elm_t alpha, const size_t len) {
+    const __m128 va = _mm_set1_ps(alpha);
+    size_t elm = 0;
+    for (; elm + 4 <= len; elm += 4) {
+        _mm_storeu_ps(&y[elm], _mm_add_ps(_mm_loadu_ps(&y[elm]), _mm_mul_ps(va, _mm_loadu_ps(&x[elm]))));
+    }
+    for (; elm < len; elm++) y[elm] += alpha * x[elm];
+}
+
+__attribute__((target("sse2")))
+static void max_stride_sse_(elm_t *y, const elm_t *x, const size_t len, const size_t stride) {
+    size_t elm = 0;
+    if (stride == 1) {
+        for (; elm + 4 <= len; elm += 4) {
+            _mm_storeu_ps(&y[elm], _mm_max_ps(_mm_loadu_ps(&y[elm]), _mm_loadu_ps(&x[elm])));
+        }
+    } else if (stride == 2) {
+        // strict bound keeps the odd-lane load inside the input
+        for (; elm + 4 < len; elm += 4) {
+            const __m128 lo = _mm_loadu_ps(&x[2 * elm]), hi = _mm_loadu_ps(&x[2 * elm + 4]);
+            const __m128 even = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+            _mm_storeu_ps(&y[elm], _mm_max_ps(_mm_loadu_ps(&y[elm]), even));
+        }
+    }
+    max_stride_scalar_(&y[elm], &x[elm * stride], len - elm, stride);
+}
+
+__attribute__((target("sse2")))
+static void relu_sse_(elm_t *arr, const size_t len) {
+    const __m128 zero = _mm_setzero_ps();
+    size_t elm = 0;
+    for (; elm + 4 <= len; elm += 4) _mm_storeu_ps(&arr[elm], _mm_max_ps(_mm_loadu_ps(&arr[elm]), zero));
+    relu_scalar_(&arr[elm], len - elm);
+}
+
+__attribute__((target("sse2")))
+static __m128 sigmoid_sse_v_(const __m128 x) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    return _mm_div_ps(one, _mm_add_ps(one, exp_sse_(_mm_sub_ps(_mm_setzero_ps(), x))));
+}
+
+__attribute__((target("sse2")))
+static void sigmoid_sse_(elm_t *arr, const size_t len) {
+    size_t elm = 0;
+    for (; elm + 4 <= len; elm += 4) _mm_storeu_ps(&arr[elm], sigmoid_sse_v_(_mm_loadu_ps(&arr[elm])));
+    if (elm < len) {
+        // padded tail keeps the whole array on the vector path
+        elm_t tail[4] = {0};
+        memcpy(tail, &arr[elm], (len - elm) * sizeof(elm_t));
+        _mm_storeu_ps(tail, sigmoid_sse_v_(_mm_loadu_ps(tail)));
+        memcpy(&arr[elm], tail, (len - elm) * sizeof(elm_t));
+    }
+}
+
+__attribute__((target("sse2")))
+static void softmax_sse_(elm_t *arr, const size_t len) {
+    // row max, so every exp argument is at most 0
+    __m128 vmax = _mm_set1_ps(-INFINITY);
+    size_t elm = 0;
+    for (; elm + 4 <= len; elm += 4) vmax = _mm_max_ps(vmax, _mm_loadu_ps(&arr[elm]));
+    __m128 shuf = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+    shuf = _mm_max_ss(shuf, _mm_movehl_ps(shuf, shuf));
+    const elm_t tail_max = max_scalar_(&arr[elm], len - elm), vec_max = _mm_cvtss_f32(shuf);
+    const __m128 max = _mm_set1_ps(tail_max > vec_max ? tail_max : vec_max);
+
+    // exps stored on the way to the sum
+    __m128 acc = _mm_setzero_ps();
+    for (elm = 0; elm + 4 <= len; elm += 4) {
+        const __m128 e = exp_sse_(_mm_sub_ps(_mm_loadu_ps(&arr[elm]), max));
+        _mm_storeu_ps(&arr[elm], e);
+        acc = _mm_add_ps(acc, e);
+    }
+    elm_t sum = hsum_sse_(acc);
+    if (elm < len) {
+        elm_t tail[4] = {0};
+        memcpy(tail, &arr[elm], (len - elm) * sizeof(elm_t));
+        _mm_storeu_ps(tail, exp_sse_(_mm_sub_ps(_mm_loadu_ps(tail), max)));
+        for (size_t idx = 0; idx < len - elm; idx++) sum += tail[idx];
+        memcpy(&arr[elm], tail, (len - elm) * sizeof(elm_t));
+    }
+    // normalize
+    const __m128 inv = _mm_set1_ps(1.0f / sum);
+    for (elm = 0; elm + 4 <= len; elm += 4) _mm_storeu_ps(&arr[elm], _mm_mul_ps(_mm_loadu_ps(&arr[elm]), inv));
+    for (; elm < len; elm++) arr[elm] /= sum;
+}
+
+__attribute__((target("sse2")))
+static void gemm_kernel_sse_(const size_t kc, const elm_t *a, const elm_t *b, elm_t *c, const size_t ldc,
+    const size_t mr, const size_t nr, const int first) {
+    // 4 x 8 register tile
+    __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps(), c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+    __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps(), c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+    for (size_t p = 0; p < kc; p++) {
+        const __m128 b0 = _mm_loadu_ps(&b[p * 8]), b1 = _mm_loadu_ps(&b[p * 8 + 4]);
+        __m128 av = _mm_set1_ps(a[p * 4]);
+        c00 = _mm_add_ps(c00, _mm_mul_ps(av, b0)); c01 = _mm_add_ps(c01, _mm_mul_ps(av, b1));
+        av = _mm_set1_ps(a[p * 4 + 1]);
+        c10 = _mm_add_ps(c10, _mm_mul_ps(av, b0)); c11 = _mm_add_ps(c11, _mm_mul_ps(av, b1));
+        av = _mm_set1_ps(a[p * 4 + 2]);
+        c20 = _mm_add_ps(c20, _mm_mul_ps(av, b0)); c21 = _mm_add_ps(c21, _mm_mul_ps(av, b1));
+        av = _mm_set1_ps(a[p * 4 + 3]);
+        c30 = _mm_add_ps(c30, _mm_mul_ps(av, b0)); c31 = _mm_add_ps(c31, _mm_mul_ps(av, b1));
+    }
+
+    // spill and write back
+    elm_t acc[4 * 8];
+    _mm_storeu_ps(&acc[0], c00); _mm_storeu_ps(&acc[4], c01);
+    _mm_storeu_ps(&acc[8], c10); _mm_storeu_ps(&acc[12], c11);
+    _mm_storeu_ps(&acc[16], c20); _mm_storeu_ps(&acc[20], c21);
+    _mm_storeu_ps(&acc[24], c30); _mm_storeu_ps(&acc[28], c31);
+    tile_store_(c, ldc, acc, 8, mr, nr, first);
+}
+
+__attribute__((target("sse2")))
+static void dot_s8_sse_(int32_t *res, const int8_t *a, const int8_t *b, const size_t len, const size_t rows) {
+    // sign-extend 16 bytes into two halves of int16, multiply pairs and add into int32 lanes
+    for (size_t row = 0; row < rows; row++) {
+        const int8_t *b_row = &b[row * len];
+        __m128i acc = _mm_setzero_si128();
+        for (size_t elm = 0; elm < len; elm += 16) {
+            const __m128i va = _mm_loadu_si128((const __m128i *)&a[elm]);
+            const __m128i vb = _mm_loadu_si128((const __m128i *)&b_row[elm]);
+            const __m128i a_lo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+            const __m128i a_hi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+            const __m128i b_lo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+            const __m128i b_hi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(a_lo, b_lo));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(a_hi, b_hi));
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        res[row] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+}
+
+__attribute__((target("sse2")))
+static void widen_bf16_sse_(elm_t *dst, const uint16_t *src, const size_t len) {
+    // interleaved below zero halves, each value lands in the upper half of a lane
+    const __m128i zero = _mm_setzero_si128();
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) {
+        const __m128i half = _mm_loadu_si128((const __m128i *)&src[elm]);
+        _mm_storeu_si128((__m128i *)&dst[elm], _mm_unpacklo_epi16(zero, half));
+        _mm_storeu_si128((__m128i *)&dst[elm + 4], _mm_unpackhi_epi16(zero, half));
+    }
+    widen_bf16_scalar_(&dst[elm], &src[elm], len - elm);
+}
+
+__attribute__((target("sse2")))
+static void butterfly_sse_(elm_t *a_re, elm_t *a_im, elm_t *b_re, elm_t *b_im, const elm_t w_re, const elm_t w_im,
+    const size_t len) {
+    const __m128 wr = _mm_set1_ps(w_re), wi = _mm_set1_ps(w_im);
+    size_t elm = 0;
+    for (; elm + 4 <= len; elm += 4) {
+        const __m128 br = _mm_loadu_ps(&b_re[elm]), bi = _mm_loadu_ps(&b_im[elm]);
+        const __m128 ar = _mm_loadu_ps(&a_re[elm]), ai = _mm_loadu_ps(&a_im[elm]);
+        const __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, br), _mm_mul_ps(wi, bi));
+        const __m128 ti = _mm_add_ps(_mm_mul_ps(wr, bi), _mm_mul_ps(wi, br));
+        _mm_storeu_ps(&b_re[elm], _mm_sub_ps(ar, tr));
+        _mm_storeu_ps(&b_im[elm], _mm_sub_ps(ai, ti));
+        _mm_storeu_ps(&a_re[elm], _mm_add_ps(ar, tr));
+        _mm_storeu_ps(&a_im[elm], _mm_add_ps(ai, ti));
+    }
+    butterfly_scalar_(&a_re[elm], &a_im[elm], &b_re[elm], &b_im[elm], w_re, w_im, len - elm);
+}
+
+__attribute__((target("sse2")))
+static void cmac_sse_(elm_t *y_re, elm_t *y_im, const elm_t *x_re, const elm_t *x_im, const elm_t *w_re,
+    const elm_t *w_im, const size_t len) {
+    size_t elm = 0;
+    for (; elm + 4 <= len; elm += 4) {
+        const __m128 xr = _mm_loadu_ps(&x_re[elm]), xi = _mm_loadu_ps(&x_im[elm]);
+        const __m128 wr = _mm_loadu_ps(&w_re[elm]), wi = _mm_loadu_ps(&w_im[elm]);
+        const __m128 yr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+        const __m128 yi = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+        _mm_storeu_ps(&y_re[elm], _mm_add_ps(_mm_loadu_ps(&y_re[elm]), yr));
+        _mm_storeu_ps(&y_im[elm], _mm_add_ps(_mm_loadu_ps(&y_im[elm]), yi));
+    }
+    cmac_scalar_(&y_re[elm], &y_im[elm], &x_re[elm], &x_im[elm], &w_re[elm], &w_im[elm], len - elm);
+}
+
+__attribute__((target("sse2")))
+static void conv_block_sse_(elm_t *y, const elm_t *x, const size_t *offs, const elm_t *w, const size_t taps,
+    const size_t cols, const size_t stride) {
+    size_t col = 0;
+    for (; col + 4 <= cols; col += 4) {
+        // four columns, each two registers of lanes
+        elm_t *out = &y[col * CHAN_BLOCK];
+        __m128 c0 = _mm_loadu_ps(&out[0]), c1 = _mm_loadu_ps(&out[4]), c2 = _mm_loadu_ps(&out[8]);
+        __m128 c3 = _mm_loadu_ps(&out[12]), c4 = _mm_loadu_ps(&out[16]), c5 = _mm_loadu_ps(&out[20]);
+        __m128 c6 = _mm_loadu_ps(&out[24]), c7 = _mm_loadu_ps(&out[28]);
+        const elm_t *base = &x[col * stride];
+        for (size_t tap = 0; tap < taps; tap++) {
+            const elm_t *src = &base[offs[tap]];
+            const __m128 w0 = _mm_loadu_ps(&w[tap * CHAN_BLOCK]), w1 = _mm_loadu_ps(&w[tap * CHAN_BLOCK + 4]);
+            __m128 v = _mm_set1_ps(src[0]);
+            c0 = _mm_add_ps(c0, _mm_mul_ps(v, w0)); c1 = _mm_add_ps(c1, _mm_mul_ps(v, w1));
+            v = _mm_set1_ps(src[stride]);
+            c2 = _mm_add_ps(c2, _mm_mul_ps(v, w0)); c3 = _mm_add_ps(c3, _mm_mul_ps(v, w1));
+            v = _mm_set1_ps(src[2 * stride]);
+            c4 = _mm_add_ps(c4, _mm_mul_ps(v, w0)); c5 = _mm_add_ps(c5, _mm_mul_ps(v, w1));
+            v = _mm_set1_ps(src[3 * stride]);
+            c6 = _mm_add_ps(c6, _mm_mul_ps(v, w0)); c7 = _mm_add_ps(c7, _mm_mul_ps(v, w1));
+        }
+        _mm_storeu_ps(&out[0], c0); _mm_storeu_ps(&out[4], c1); _mm_storeu_ps(&out[8], c2);
+        _mm_storeu_ps(&out[12], c3); _mm_storeu_ps(&out[16], c4); _mm_storeu_ps(&out[20], c5);
+        _mm_storeu_ps(&out[24], c6); _mm_storeu_ps(&out[28], c7);
+    }
+    conv_block_scalar_(&y[col * CHAN_BLOCK], &x[col * stride], offs, w, taps, cols - col, stride);
+}
+
+__attribute__((target("sse2")))
+static void max_block_sse_(elm_t *y, const elm_t *x, const size_t cols, const size_t stride) {
+    for (size_t col = 0; col < cols; col++) {
+        elm_t *out = &y[col * CHAN_BLOCK];
+        const elm_t *src = &x[col * stride];
+        _mm_storeu_ps(&out[0], _mm_max_ps(_mm_loadu_ps(&out[0]), _mm_loadu_ps(&src[0])));
+        _mm_storeu_ps(&out[4], _mm_max_ps(_mm_loadu_ps(&out[4]), _mm_loadu_ps(&src[4])));
+    }
+}
+
+static const SimdOps sse_ops_ = {
+    .name="sse",
+    .axpy=axpy_sse_, .max_stride=max_stride_sse_,
+    .relu=relu_sse_, .sigmoid=sigmoid_sse_, .softmax=softmax_sse_,
+    .gemm_kernel=gemm_kernel_sse_, .gemm_mr=4, .gemm_nr=8,
+    .dot_s8=dot_s8_sse_,
+    .widen_f16=widen_f16_scalar_, .widen_bf16=widen_bf16_sse_,
+    .butterfly=butterfly_sse_, .cmac=cmac_sse_,
+    .conv_block=conv_block_sse_, .max_block=max_block_sse_,
+};
+
+// avx2
+
+__attribute__((target("avx2,fma")))
+static __m256 exp_avx2_(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_LO)), _mm256_set1_ps(EXP_HI));
+    // n = floor(x * log2e + 0.5)
+    __m256 fx = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(LOG2E), _mm256_set1_ps(0.5f)));
+    // r = x - n * ln2
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C1), x);
+    x = _mm256_fnmadd_ps(fx, _mm256_set1_ps(EXP_C2), x);
+    // polynomial
+    __m256 y = _mm256_set1_ps(EXP_P0);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P1));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P2));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P3));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P4));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(EXP_P5));
+    y = _mm256_add_ps(_mm256_fmadd_ps(y, _mm256_mul_ps(x, x), x), _mm256_set1_ps(1.0f));
+    // scale by 2^n
+    const __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(fx), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(pow2n));
+}
+
+__attribute__((target("avx2,fma")))
+static elm_t hsum_avx2_(const __m256 v) {
+    __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+    sums = _mm_add_ss(sums, _mm_shuffle_ps(sums, sums, 1));
+    return _mm_cvtss_f32(sums);
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2_(elm_t *y, const elm_t *x, const elm_t alpha, const size_t len) {
+    const __m256 va = _mm256_set1_ps(alpha);
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) {
+        _mm256_storeu_ps(&y[elm], _mm256_fmadd_ps(va, _mm256_loadu_ps(&x[elm]), _mm256_loadu_ps(&y[elm])));
+    }
+    for (; elm < len; elm++) y[elm] += alpha * x[elm];
+}
+
+__attribute__((target("avx2,fma")))
+static void max_stride_avx2_(elm_t *y, const elm_t *x, const size_t len, const size_t stride) {
+    size_t elm = 0;
+    if (stride == 1) {
+        for (; elm + 8 <= len; elm += 8) {
+            _mm256_storeu_ps(&y[elm], _mm256_max_ps(_mm256_loadu_ps(&y[elm]), _mm256_loadu_ps(&x[elm])));
+        }
+    } else if (stride == 2) {
+        // strict bound keeps the odd-lane load inside the input
+        for (; elm + 8 < len; elm += 8) {
+            const __m256 lo = _mm256_loadu_ps(&x[2 * elm]), hi = _mm256_loadu_ps(&x[2 * elm + 8]);
+            const __m256 mixed = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m256 even = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mixed), 0xD8));
+            _mm256_storeu_ps(&y[elm], _mm256_max_ps(_mm256_loadu_ps(&y[elm]), even));
+        }
+    }
+    max_stride_scalar_(&y[elm], &x[elm * stride], len - elm, stride);
+}
+
+__attribute__((target("avx2,fma")))
+static void relu_avx2_(elm_t *arr, const size_t len) {
+    const __m256 zero = _mm256_setzero_ps();
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) _mm256_storeu_ps(&arr[elm], _mm256_max_ps(_mm256_loadu_ps(&arr[elm]), zero));
+    relu_scalar_(&arr[elm], len - elm);
+}
+
+__attribute__((target("avx2,fma")))
+static __m256 sigmoid_avx2_v_(const __m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    return _mm256_div_ps(one, _mm256_add_ps(one, exp_avx2_(_mm256_sub_ps(_mm256_setzero_ps(), x))));
+}
+
+__attribute__((target("avx2,fma")))
+static void sigmoid_avx2_(elm_t *arr, const size_t len) {
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) _mm256_storeu_ps(&arr[elm], sigmoid_avx2_v_(_mm256_loadu_ps(&arr[elm])));
+    if (elm < len) {
+        // padded tail keeps the whole array on the vector path
+        elm_t tail[8] = {0};
+        memcpy(tail, &arr[elm], (len - elm) * sizeof(elm_t));
+        _mm256_storeu_ps(tail, sigmoid_avx2_v_(_mm256_loadu_ps(tail)));
+        memcpy(&arr[elm], tail, (len - elm) * sizeof(elm_t));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void softmax_avx2_(elm_t *arr, const size_t len) {
+    // row max, so every exp argument is at most 0
+    __m256 vmax = _mm256_set1_ps(-INFINITY);
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(&arr[elm]));
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1));
+    half = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(2, 3, 0, 1)));
+    half = _mm_max_ss(half, _mm_movehl_ps(half, half));
+    elm_t row_max = _mm_cvtss_f32(half);
+    for (size_t idx = elm; idx < len; idx++) {
+        if (arr[idx] > row_max) row_max = arr[idx];
+    }
+    const __m256 max = _mm256_set1_ps(row_max);
+
+    // exps stored on the way to the sum
+    __m256 acc = _mm256_setzero_ps();
+    for (elm = 0; elm + 8 <= len; elm += 8) {
+        const __m256 e = exp_avx2_(_mm256_sub_ps(_mm256_loadu_ps(&arr[elm]), max));
+        _mm256_storeu_ps(&arr[elm], e);
+        acc = _mm256_add_ps(acc, e);
+    }
+    elm_t sum = hsum_avx2_(acc);
+    if (elm < len) {
+        elm_t tail[8] = {0};
+        memcpy(tail, &arr[elm], (len - elm) * sizeof(elm_t));
+        _mm256_storeu_ps(tail, exp_avx2_(_mm256_sub_ps(_mm256_loadu_ps(tail), max)));
+        for (size_t idx = 0; idx < len - elm; idx++) sum += tail[idx];
+        memcpy(&arr[elm], tail, (len - elm) * sizeof(elm_t));
+    }
+    // normalize
+    const __m256 inv = _mm256_set1_ps(1.0f / sum);
+    for (elm = 0; elm + 8 <= len; elm += 8) {
+        _mm256_storeu_ps(&arr[elm], _mm256_mul_ps(_mm256_loadu_ps(&arr[elm]), inv));
+    }
+    for (; elm < len; elm++) arr[elm] /= sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2_(const size_t kc, const elm_t *a, const elm_t *b, elm_t *c, const size_t ldc,
+    const size_t mr, const size_t nr, const int first) {
+    // 6 x 16 register tile
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps(), c10 = _mm256_setzero_ps();
+    __m256 c11 = _mm256_setzero_ps(), c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps(), c40 = _mm256_setzero_ps();
+    __m256 c41 = _mm256_setzero_ps(), c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for (size_t p = 0; p < kc; p++) {
+        const __m256 b0 = _mm256_loadu_ps(&b[p * 16]), b1 = _mm256_loadu_ps(&b[p * 16 + 8]);
+        const elm_t *ap = &a[p * 6];
+        __m256 av = _mm256_broadcast_ss(&ap[0]);
+        c00 = _mm256_fmadd_ps(av, b0, c00); c01 = _mm256_fmadd_ps(av, b1, c01);
+        av = _mm256_broadcast_ss(&ap[1]);
+        c10 = _mm256_fmadd_ps(av, b0, c10); c11 = _mm256_fmadd_ps(av, b1, c11);
+        av = _mm256_broadcast_ss(&ap[2]);
+        c20 = _mm256_fmadd_ps(av, b0, c20); c21 = _mm256_fmadd_ps(av, b1, c21);
+        av = _mm256_broadcast_ss(&ap[3]);
+        c30 = _mm256_fmadd_ps(av, b0, c30); c31 = _mm256_fmadd_ps(av, b1, c31);
+        av = _mm256_broadcast_ss(&ap[4]);
+        c40 = _mm256_fmadd_ps(av, b0, c40); c41 = _mm256_fmadd_ps(av, b1, c41);
+        av = _mm256_broadcast_ss(&ap[5]);
+        c50 = _mm256_fmadd_ps(av, b0, c50); c51 = _mm256_fmadd_ps(av, b1, c51);
+    }
+
+    // spill and write back
+    elm_t acc[6 * 16];
+    _mm256_storeu_ps(&acc[0], c00); _mm256_storeu_ps(&acc[8], c01);
+    _mm256_storeu_ps(&acc[16], c10); _mm256_storeu_ps(&acc[24], c11);
+    _mm256_storeu_ps(&acc[32], c20); _mm256_storeu_ps(&acc[40], c21);
+    _mm256_storeu_ps(&acc[48], c30); _mm256_storeu_ps(&acc[56], c31);
+    _mm256_storeu_ps(&acc[64], c40); _mm256_storeu_ps(&acc[72], c41);
+    _mm256_storeu_ps(&acc[80], c50); _mm256_storeu_ps(&acc[88], c51);
+    tile_store_(c, ldc, acc, 16, mr, nr, first);
+}
+
+__attribute__((target("avx2,fma")))
+static void dot_s8_avx2_(int32_t *res, const int8_t *a, const int8_t *b, const size_t len, const size_t rows) {
+    // four rows per pass share every load of a and one horizontal reduction
+    size_t row = 0;
+    for (; row + 4 <= rows; row += 4) {
+        const int8_t *b_row = &b[row * len];
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+        for (size_t elm = 0; elm < len; elm += 16) {
+            // sign-extend 16 bytes to int16, multiply pairs and add into int32 lanes
+            const __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&a[elm]));
+            const __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&b_row[elm]));
+            const __m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&b_row[len + elm]));
+            const __m256i b2 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&b_row[2 * len + elm]));
+            const __m256i b3 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&b_row[3 * len + elm]));
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(va, b0));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(va, b1));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(va, b2));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(va, b3));
+        }
+        const __m256i sums = _mm256_hadd_epi32(_mm256_hadd_epi32(acc0, acc1), _mm256_hadd_epi32(acc2, acc3));
+        const __m128i quad = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        _mm_storeu_si128((__m128i *)&res[row], quad);
+    }
+    for (; row < rows; row++) {
+        const int8_t *b_row = &b[row * len];
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t elm = 0; elm < len; elm += 16) {
+            const __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&a[elm]));
+            const __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)&b_row[elm]));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+        }
+        const __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, half);
+        res[row] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static void widen_f16_avx2_(elm_t *dst, const uint16_t *src, const size_t len) {
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) {
+        _mm256_storeu_ps(&dst[elm], _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)&src[elm])));
+    }
+    if (elm == len) return;
+    // tail through a padded lane, staying in vex code
+    uint16_t part[8] = {0};
+    elm_t wide[8];
+    memcpy(part, &src[elm], (len - elm) * sizeof(uint16_t));
+    _mm256_storeu_ps(wide, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)part)));
+    memcpy(&dst[elm], wide, (len - elm) * sizeof(elm_t));
+}
+
+__attribute__((target("avx2,fma")))
+static void widen_bf16_avx2_(elm_t *dst, const uint16_t *src, const size_t len) {
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) {
+        const __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)&src[elm]));
+        _mm256_storeu_si256((__m256i *)&dst[elm], _mm256_slli_epi32(wide, 16));
+    }
+    if (elm == len) return;
+    // tail through a padded lane, as widen_f16_avx2_
+    uint16_t part[8] = {0};
+    elm_t tail[8];
+    memcpy(part, &src[elm], (len - elm) * sizeof(uint16_t));
+    const __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)part));
+    _mm256_storeu_si256((__m256i *)tail, _mm256_slli_epi32(wide, 16));
+    memcpy(&dst[elm], tail, (len - elm) * sizeof(elm_t));
+}
+
+__attribute__((target("avx2,fma")))
+static void butterfly_avx2_(elm_t *a_re, elm_t *a_im, elm_t *b_re, elm_t *b_im, const elm_t w_re, const elm_t w_im,
+    const size_t len) {
+    const __m256 wr = _mm256_set1_ps(w_re), wi = _mm256_set1_ps(w_im);
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) {
+        const __m256 br = _mm256_loadu_ps(&b_re[elm]), bi = _mm256_loadu_ps(&b_im[elm]);
+        const __m256 ar = _mm256_loadu_ps(&a_re[elm]), ai = _mm256_loadu_ps(&a_im[elm]);
+        const __m256 tr = _mm256_fmsub_ps(wr, br, _mm256_mul_ps(wi, bi));
+        const __m256 ti = _mm256_fmadd_ps(wr, bi, _mm256_mul_ps(wi, br));
+        _mm256_storeu_ps(&b_re[elm], _mm256_sub_ps(ar, tr));
+        _mm256_storeu_ps(&b_im[elm], _mm256_sub_ps(ai, ti));
+        _mm256_storeu_ps(&a_re[elm], _mm256_add_ps(ar, tr));
+        _mm256_storeu_ps(&a_im[elm], _mm256_add_ps(ai, ti));
+    }
+    // tail inline, no call into non-vex code
+    for (; elm < len; elm++) {
+        const elm_t t_re = w_re * b_re[elm] - w_im * b_im[elm], t_im = w_re * b_im[elm] + w_im * b_re[elm];
+        b_re[elm] = a_re[elm] - t_re;
+        b_im[elm] = a_im[elm] - t_im;
+        a_re[elm] += t_re;
+        a_im[elm] += t_im;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void cmac_avx2_(elm_t *y_re, elm_t *y_im, const elm_t *x_re, const elm_t *x_im, const elm_t *w_re,
+    const elm_t *w_im, const size_t len) {
+    size_t elm = 0;
+    for (; elm + 8 <= len; elm += 8) {
+        const __m256 xr = _mm256_loadu_ps(&x_re[elm]), xi = _mm256_loadu_ps(&x_im[elm]);
+        const __m256 wr = _mm256_loadu_ps(&w_re[elm]), wi = _mm256_loadu_ps(&w_im[elm]);
+        const __m256 yr = _mm256_fnmadd_ps(xi, wi, _mm256_fmadd_ps(xr, wr, _mm256_loadu_ps(&y_re[elm])));
+        const __m256 yi = _mm256_fmadd_ps(xi, wr, _mm256_fmadd_ps(xr, wi, _mm256_loadu_ps(&y_im[elm])));
+        _mm256_storeu_ps(&y_re[elm], yr);
+        _mm256_storeu_ps(&y_im[elm], yi);
+    }
+    for (; elm < len; elm++) {
+        y_re[elm] += x_re[elm] * w_re[elm] - x_im[elm] * w_im[elm];
+        y_im[elm] += x_re[elm] * w_im[elm] + x_im[elm] * w_re[elm];
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void conv_block_avx2_(elm_t *y, const elm_t *x, const size_t *offs, const elm_t *w, const size_t taps,
+    const size_t cols, const size_t stride) {
+    size_t col = 0;
+    for (; col + 8 <= cols; col += 8) {
+        // eight columns in registers across every tap, one weight load per tap
+        elm_t *out = &y[col * CHAN_BLOCK];
+        __m256 c0 = _mm256_loadu_ps(&out[0]), c1 = _mm256_loadu_ps(&out[8]), c2 = _mm256_loadu_ps(&out[16]);
+        __m256 c3 = _mm256_loadu_ps(&out[24]), c4 = _mm256_loadu_ps(&out[32]), c5 = _mm256_loadu_ps(&out[40]);
+        __m256 c6 = _mm256_loadu_ps(&out[48]), c7 = _mm256_loadu_ps(&out[56]);
+        const elm_t *base = &x[col * stride];
+        for (size_t tap = 0; tap < taps; tap++) {
+            const elm_t *src = &base[offs[tap]];
+            const __m256 wv = _mm256_loadu_ps(&w[tap * CHAN_BLOCK]);
+            c0 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[0]), wv, c0);
+            c1 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[stride]), wv, c1);
+            c2 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[2 * stride]), wv, c2);
+            c3 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[3 * stride]), wv, c3);
+            c4 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[4 * stride]), wv, c4);
+            c5 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[5 * stride]), wv, c5);
+            c6 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[6 * stride]), wv, c6);
+            c7 = _mm256_fmadd_ps(_mm256_broadcast_ss(&src[7 * stride]), wv, c7);
+        }
+        _mm256_storeu_ps(&out[0], c0); _mm256_storeu_ps(&out[8], c1); _mm256_storeu_ps(&out[16], c2);
+        _mm256_storeu_ps(&out[24], c3); _mm256_storeu_ps(&out[32], c4); _mm256_storeu_ps(&out[40], c5);
+        _mm256_storeu_ps(&out[48], c6); _mm256_storeu_ps(&out[56], c7);
+    }
+    // column tail inline, no call into non-vex code
+    for (; col < cols; col++) {
+        elm_t *out = &y[col * CHAN_BLOCK];
+        __m256 acc = _mm256_loadu_ps(out);
+        const elm_t *base = &x[col * stride];
+        for (size_t tap = 0; tap < taps; tap++) {
+            acc = _mm256_fmadd_ps(_mm256_broadcast_ss(&base[offs[tap]]), _mm256_loadu_ps(&w[tap * CHAN_BLOCK]), acc);
+        }
+        _mm256_storeu_ps(out, acc);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void max_block_avx2_(elm_t *y, const elm_t *x, const size_t cols, const size_t stride) {
+    for (size_t col = 0; col < cols; col++) {
+        elm_t *out = &y[col * CHAN_BLOCK];
+        _mm256_storeu_ps(out, _mm256_max_ps(_mm256_loadu_ps(out), _mm256_loadu_ps(&x[col * stride])));
+    }
+}
+
+static const SimdOps avx2_ops_ = {
+    .name="avx2",
+    .axpy=axpy_avx2_, .max_stride=max_stride_avx2_,
+    .relu=relu_avx2_, .sigmoid=sigmoid_avx2_, .softmax=softmax_avx2_,
+    .gemm_kernel=gemm_kernel_avx2_, .gemm_mr=6, .gemm_nr=16,
+    .dot_s8=dot_s8_avx2_,
+    .widen_f16=widen_f16_avx2_, .widen_bf16=widen_bf16_avx2_,
+    .butterfly=butterfly_avx2_, .cmac=cmac_avx2_,
+    .conv_block=conv_block_avx2_, .max_block=max_block_avx2_,
+};
+
+// avx-512
+
+__attribute__((target("avx512f")))
+static __m512 exp_avx512_(__m512 x) {
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_LO)), _mm512_set1_ps(EXP_HI));
+    // n = floor(x * log2e + 0.5)
+    __m512 fx = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(LOG2E), _mm512_set1_ps(0.5f)),
+        _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    // r = x - n * ln2
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C1), x);
+    x = _mm512_fnmadd_ps(fx, _mm512_set1_ps(EXP_C2), x);
+    // polynomial
+    __m512 y = _mm512_set1_ps(EXP_P0);
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P1));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P2));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P3));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P4));
+    y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(EXP_P5));
+    y = _mm512_add_ps(_mm512_fmadd_ps(y, _mm512_mul_ps(x, x), x), _mm512_set1_ps(1.0f));
+    // scale by 2^n
+    return _mm512_scalef_ps(y, fx);
+}
+
+__attribute__((target("avx512f")))
+static void axpy_avx512_(elm_t *y, const elm_t *x, const elm_t alpha, const size_t len) {
+    const __m512 va = _mm512_set1_ps(alpha);
+    size_t elm = 0;
+    for (; elm + 16 <= len; elm += 16) {
+        _mm512_storeu_ps(&y[elm], _mm512_fmadd_ps(va, _mm512_loadu_ps(&x[elm]), _mm512_loadu_ps(&y[elm])));
+    }
+    if (elm < len) {
+        // masked tail
+        const __mmask16 mask = (__mmask16)((1u << (len - elm)) - 1);
+        const __m512 yv = _mm512_maskz_loadu_ps(mask, &y[elm]), xv = _mm512_maskz_loadu_ps(mask, &x[elm]);
+        _mm512_mask_storeu_ps(&y[elm], mask, _mm512_fmadd_ps(va, xv, yv));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void max_stride_avx512_(elm_t *y, const elm_t *x, const size_t len, const size_t stride) {
+    size_t elm = 0;
+    if (stride == 1) {
+        for (; elm + 16 <= len; elm += 16) {
+            _mm512_storeu_ps(&y[elm], _mm512_max_ps(_mm512_loadu_ps(&y[elm]), _mm512_loadu_ps(&x[elm])));
+        }
+    } else if (stride == 2) {
+        // strict bound keeps the odd-lane load inside the input
+        const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+        for (; elm + 16 < len; elm += 16) {
+            const __m512 lo = _mm512_loadu_ps(&x[2 * elm]), hi = _mm512_loadu_ps(&x[2 * elm + 16]);
+            const __m512 vals = _mm512_permutex2var_ps(lo, even, hi);
+            _mm512_storeu_ps(&y[elm], _mm512_max_ps(_mm512_loadu_ps(&y[elm]), vals));
+        }
+    }
+    max_stride_scalar_(&y[elm], &x[elm * stride], len - elm, stride);
+}
+
+__attribute__((target("avx512f")))
+static void relu_avx512_(elm_t *arr, const size_t len) {
+    const __m512 zero = _mm512_setzero_ps();
+    size_t elm = 0;
+    for (; elm + 16 <= len; elm += 16) _mm512_storeu_ps(&arr[elm], _mm512_max_ps(_mm512_loadu_ps(&arr[elm]), zero));
+    if (elm < len) {
+        const __mmask16 mask = (__mmask16)((1u << (len - elm)) - 1);
+        _mm512_mask_storeu_ps(&arr[elm], mask, _mm512_max_ps(_mm512_maskz_loadu_ps(mask, &arr[elm]), zero));
+    }
+}
+
+__attribute__((target("avx512f")))
+static __m512 sigmoid_avx512_v_(const __m512 x) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    return _mm512_div_ps(one, _mm512_add_ps(one, exp_avx512_(_mm512_sub_ps(_mm512_setzero_ps(), x))));
+}
+
+__attribute__((target("avx512f")))
+static void sigmoid_avx512_(elm_t *arr, const size_t len) {
+    size_t elm = 0;
+    for (; elm + 16 <= len; elm += 16) _mm512_storeu_ps(&arr[elm], sigmoid_avx512_v_(_mm512_loadu_ps(&arr[elm])));
+    if (elm < len) {
+        const __mmask16 mask = (__mmask16)((1u << (len - elm)) - 1);
+        _mm512_mask_storeu_ps(&arr[elm], mask, sigmoid_avx512_v_(_mm512_maskz_loadu_ps(mask, &arr[elm])));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void softmax_avx512_(elm_t *arr, const size_t len) {
+    // row max, so every exp argument is at most 0
+    const __mmask16 mask = (__mmask16)((1u << (len % 16)) - 1);
+    __m512 vmax = _mm512_set1_ps(-INFINITY);
+    size_t elm = 0;
+    for (; elm + 16 <= len; elm += 16) vmax = _mm512_max_ps(vmax, _mm512_loadu_ps(&arr[elm]));
+    if (elm < len) vmax = _mm512_max_ps(vmax, _mm512_mask_loadu_ps(vmax, mask, &arr[elm]));
+    const __m512 max = _mm512_set1_ps(_mm512_reduce_max_ps(vmax));
+
+    // exps stored on the way to the sum
+    __m512 acc = _mm512_setzero_ps();
+    for (elm = 0; elm + 16 <= len; elm += 16) {
+        const __m512 e = exp_avx512_(_mm512_sub_ps(_mm512_loadu_ps(&arr[elm]), max));
+        _mm512_storeu_ps(&arr[elm], e);
+        acc = _mm512_add_ps(acc, e);
+    }
+    if (elm < len) {
+        const __m512 e = exp_avx512_(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &arr[elm]), max));
+        _mm512_mask_storeu_ps(&arr[elm], mask, e);
+        acc = _mm512_mask_add_ps(acc, mask, acc, e);
+    }
+    const elm_t sum = _mm512_reduce_add_ps(acc);
+
+    // normalize
+    const __m512 inv = _mm512_set1_ps(1.0f / sum);
+    for (elm = 0; elm + 16 <= len; elm += 16) {
+        _mm512_storeu_ps(&arr[elm], _mm512_mul_ps(_mm512_loadu_ps(&arr[elm]), inv));
+    }
+    for (; elm < len; elm++) arr[elm] /= sum;
+}
+
+__attribute__((target("avx512f")))
+static void gemm_kernel_avx512_(const size_t kc, const elm_t *a, const elm_t *b, elm_t *c, const size_t ldc,
+    const size_t mr, const size_t nr, const int first) {
+    // 12 x 16 register tile
+    __m512 c0 = _mm512_setzero_ps(), c1 = _mm512_setzero_ps(), c2 = _mm512_setzero_ps();
+    __m512 c3 = _mm512_setzero_ps(), c4 = _mm512_setzero_ps(), c5 = _mm512_setzero_ps();
+    __m512 c6 = _mm512_setzero_ps(), c7 = _mm512_setzero_ps(), c8 = _mm512_setzero_ps();
+    __m512 c9 = _mm512_setzero_ps(), c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    for (size_t p = 0; p < kc; p++) {
+        const __m512 bv = _mm512_loadu_ps(&b[p * 16]);
+        const elm_t *ap = &a[p * 12];
+        c0 = _mm512_fmadd_ps(_mm512_set1_ps(ap[0]), bv, c0);
+        c1 = _mm512_fmadd_ps(_mm512_set1_ps(ap[1]), bv, c1);
+        c2 = _mm512_fmadd_ps(_mm512_set1_ps(ap[2]), bv, c2);
+        c3 = _mm512_fmadd_ps(_mm512_set1_ps(ap[3]), bv, c3);
+        c4 = _mm512_fmadd_ps(_mm512_set1_ps(ap[4]), bv, c4);
+        c5 = _mm512_fmadd_ps(_mm512_set1_ps(ap[5]), bv, c5);
+        c6 = _mm512_fmadd_ps(_mm512_set1_ps(ap[6]), bv, c6);
+        c7 = _mm512_fmadd_ps(_mm512_set1_ps(ap[7]), bv, c7);
+        c8 = _mm512_fmadd_ps(_mm512_set1_ps(ap[8]), bv, c8);
+        c9 = _mm512_fmadd_ps(_mm512_set1_ps(ap[9]), bv, c9);
+        c10 = _mm512_fmadd_ps(_mm512_set1_ps(ap[10]), bv, c10);
+        c11 = _mm512_fmadd_ps(_mm512_set1_ps(ap[11]), bv, c11);
+    }
+
+    // spill and write back
+    elm_t acc[12 * 16];
+    _mm512_storeu_ps(&acc[0], c0); _mm512_storeu_ps(&acc[16], c1); _mm512_storeu_ps(&acc[32], c2);
+    _mm512_storeu_ps(&acc[48], c3); _mm512_storeu_ps(&acc[64], c4); _mm512_storeu_ps(&acc[80], c5);
+    _mm512_storeu_ps(&acc[96], c6); _mm512_storeu_ps(&acc[112], c7); _mm512_storeu_ps(&acc[128], c8);
+    _mm512_storeu_ps(&acc[144], c9); _mm512_storeu_ps(&acc[160], c10); _mm512_storeu_ps(&acc[176], c11);
+    tile_store_(c, ldc, acc, 16, mr, nr, first);
+}
+
+__attribute__((target("avx512f")))
+static void butterfly_avx512_(elm_t *a_re, elm_t *a_im, elm_t *b_re, elm_t *b_im, const elm_t w_re, const elm_t w_im,
+    const size_t len) {
+    const __m512 wr = _mm512_set1_ps(w_re), wi = _mm512_set1_ps(w_im);
+    for (size_t elm = 0; elm < len; elm += 16) {
+        // masked tail
+        const __mmask16 mask = len - elm >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (len - elm)) - 1);
+        const __m512 br = _mm512_maskz_loadu_ps(mask, &b_re[elm]), bi = _mm512_maskz_loadu_ps(mask, &b_im[elm]);
+        const __m512 ar = _mm512_maskz_loadu_ps(mask, &a_re[elm]), ai = _mm512_maskz_loadu_ps(mask, &a_im[elm]);
+        const __m512 tr = _mm512_fmsub_ps(wr, br, _mm512_mul_ps(wi, bi));
+        const __m512 ti = _mm512_fmadd_ps(wr, bi, _mm512_mul_ps(wi, br));
+        _mm512_mask_storeu_ps(&b_re[elm], mask, _mm512_sub_ps(ar, tr));
+        _mm512_mask_storeu_ps(&b_im[elm], mask, _mm512_sub_ps(ai, ti));
+        _mm512_mask_storeu_ps(&a_re[elm], mask, _mm512_add_ps(ar, tr));
+        _mm512_mask_storeu_ps(&a_im[elm], mask, _mm512_add_ps(ai, ti));
+    }
+}
+
+__attribute__((target("avx512f")))
+static void cmac_avx512_(elm_t *y_re, elm_t *y_im, const elm_t *x_re, const elm_t *x_im, const elm_t *w_re,
+    const elm_t *w_im, const size_t len) {
+    for (size_t elm = 0; elm < len; elm += 16) {
+        // masked tail
+        const __mmask16 mask = len - elm >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (len - elm)) - 1);
+        const __m512 xr = _mm512_maskz_loadu_ps(mask, &x_re[elm]), xi = _mm512_maskz_loadu_ps(mask, &x_im[elm]);
+        const __m512 wr = _mm512_maskz_loadu_ps(mask, &w_re[elm]), wi = _mm512_maskz_loadu_ps(mask, &w_im[elm]);
+        const __m512 yr = _mm512_fnmadd_ps(xi, wi, _mm512_fmadd_ps(xr, wr, _mm512_maskz_loadu_ps(mask, &y_re[elm])));
+        const __m512 yi = _mm512_fmadd_ps(xi, wr, _mm512_fmadd_ps(xr, wi, _mm512_maskz_loadu_ps(mask, &y_im[elm])));
+        _mm512_mask_storeu_ps(&y_re[elm], mask, yr);
+        _mm512_mask_storeu_ps(&y_im[elm], mask, yi);
+    }
+}
+
+static const SimdOps avx512_ops_ = {
+    .name="avx512",
+    .axpy=axpy_avx512_, .max_stride=max_stride_avx512_,
+    .relu=relu_avx512_, .sigmoid=sigmoid_avx512_, .softmax=softmax_avx512_,
+    .gemm_kernel=gemm_kernel_avx512_, .gemm_mr=12, .gemm_nr=16,
+    // int16 multiply-adds need avx512bw
+    .dot_s8=dot_s8_avx2_,
+    .widen_f16=widen_f16_avx2_, .widen_bf16=widen_bf16_avx2_,
+    .butterfly=butterfly_avx512_, .cmac=cmac_avx512_,
+    // blocks are one ymm register wide
+    .conv_block=conv_block_avx2_, .max_block=max_block_avx2_,
+};
+
+#endif // SIMD_X86
+
+static const SimdOps *ops_ = NULL;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Picks the widest kernel set supported by the host CPU.
+ * The CNN_SIMD environment variable (scalar, sse, avx2, avx512) caps the selection, e.g. for testing fallbacks.
+ * Called once at startup; simd_ops calls it lazily otherwise.
+ */
+void simd_init(void) {
+    const char *cap = getenv("CNN_SIMD");
+    ops_ = &scalar_ops_;
+    if (cap != NULL && strcmp(cap, "scalar") == 0) return;
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) ops_ = &sse_ops_;
+    if (cap != NULL && strcmp(cap, "sse") == 0) return;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c")) {
+        ops_ = &avx2_ops_;
+    }
+    if (cap != NULL && strcmp(cap, "avx2") == 0) return;
+    // the avx-512 set borrows avx2 kernels for int8, half widening and the blocked layout
+    if (ops_ == &avx2_ops_ && __builtin_cpu_supports("avx512f")) ops_ = &avx512_ops_;
+#endif
+}
+
+/**
+ * Gets the kernel set selected for the host CPU.
+ *
+ * @return: kernel dispatch table.
+ */
+const SimdOps *simd_ops(void) {
+    if (ops_ == NULL) simd_init();
+    return ops_;
+}
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "types.h"
+#include "thread_pool.h"
+
+// per-worker range of task indices [next, end); the owner takes from the front, thieves take from the back
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+    char pad[ELM_ALIGN];
+} TaskQueue;
+
+struct ThreadPool {
+    size_t size;
+    pthread_t *threads;
+    TaskQueue *queues;
+    // job hand-off
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    size_t generation;
+    size_t active;
+    int stop;
+    void (*fn)(void *ctx, size_t task, size_t worker);
+    void *ctx;
+};
+
+typedef struct {
+    ThreadPool *pool;
+    size_t worker;
+} WorkerArg;
+
+// pool used to split single ops, and the minimum work (multiply-adds) worth splitting
+static ThreadPool *compute_pool_ = NULL;
+static size_t parallel_threshold_ = (size_t)1 << 20;
+// set while the thread is running pool tasks; nested runs go serial
+static _Thread_local int in_pool_ = 0;
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static int take_(TaskQueue *queue, size_t *task) {
+    // front of own range
+    pthread_mutex_lock(&queue->lock);
+    const int found = queue->next < queue->end;
+    if (found) *task = queue->next++;
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static int steal_(ThreadPool *pool, const size_t worker) {
+    // back half of the first non-empty victim, moved into own range
+    for (size_t off = 1; off < pool->size; off++) {
+        TaskQueue *victim = &pool->queues[(worker + off) % pool->size];
+        pthread_mutex_lock(&victim->lock);
+        const size_t left = victim->end - victim->next;
+        if (left == 0) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        const size_t count = (left + 1) / 2;
+        victim->end -= count;
+        const size_t lo = victim->end;
+        pthread_mutex_unlock(&victim->lock);
+
+        TaskQueue *own = &pool->queues[worker];
+        pthread_mutex_lock(&own->lock);
+        own->next = lo; own->end = lo + count;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    return 0;
+}
+
+static void work_(ThreadPool *pool, const size_t worker) {
+    // drain own range, then steal until every range is empty
+    size_t task;
+    do {
+        while (take_(&pool->queues[worker], &task)) pool->fn(pool->ctx, task, worker);
+    } while (steal_(pool, worker));
+}
+
+static void *worker_main_(void *arg) {
+    ThreadPool *pool = ((WorkerArg *)arg)->pool;
+    const size_t worker = ((WorkerArg *)arg)->worker;
+    free(arg);
+    in_pool_ = 1;
+
+    size_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        // wait for the next job
+        while (!pool->stop && pool->generation == seen) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        work_(pool, worker);
+
+        // report completion
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Creates a persistent thread pool. The calling thread takes part in every run as worker 0, so threads - 1 workers
+ * are spawned.
+ * Caller is responsible for freeing returned pool with free_thread_pool.
+ *
+ * @param threads: total number of workers, at least 1.
+ *
+ * @return: idle thread pool. NULL for malloc or thread creation fail.
+ */
+ThreadPool *make_thread_pool(size_t threads) {
+    if (threads == 0) threads = 1;
+
+    // malloc
+    ThreadPool *pool = malloc(sizeof(ThreadPool));
+    TaskQueue *queues = malloc(threads * sizeof(TaskQueue));
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+    if (pool == NULL || queues == NULL || handles == NULL) {
+        fprintf(stderr, "Failed malloc: ThreadPool of %zu.\n", threads);
+        free(pool); free(queues); free(handles);
+        return NULL;
+    }
+
+    // struct setup
+    pool->size = 1;
+    pool->threads = handles;
+    pool->queues = queues;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->generation = 0;
+    pool->active = 0;
+    pool->stop = 0;
+    pool->fn = NULL;
+    pool->ctx = NULL;
+    for (size_t worker = 0; worker < threads; worker++) {
+        pthread_mutex_init(&queues[worker].lock, NULL);
+        queues[worker].next = 0; queues[worker].end = 0;
+    }
+
+    // spawn workers
+    for (size_t worker = 1; worker < threads; worker++) {
+        WorkerArg *arg = malloc(sizeof(WorkerArg));
+        if (arg != NULL) {
+            arg->pool = pool; arg->worker = worker;
+        }
+        if (arg == NULL || pthread_create(&handles[worker], NULL, worker_main_, arg) != 0) {
+            fprintf(stderr, "Failed thread creation: worker %zu of %zu.\n", worker, threads);
+            free(arg);
+            free_thread_pool(pool);
+            return NULL;
+        }
+        pool->size++;
+    }
+    return pool;
+}
+
+/**
+ * Stops and joins all workers, then frees all memory associated with a thread pool. If pool is NULL, passes.
+ *
+ * @param pool: thread pool to be freed.
+ */
+void free_thread_pool(ThreadPool *pool) {
+    if (pool == NULL) return;
+
+    // stop workers
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t worker = 1; worker < pool->size; worker++) pthread_join(pool->threads[worker], NULL);
+
+    // free
+    for (size_t worker = 0; worker < pool->size; worker++) pthread_mutex_destroy(&pool->queues[worker].lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->queues);
+    free(pool->threads);
+    free(pool);
+}
+
+/**
+ * Number of workers in a thread pool, including the calling thread. 1 for a NULL pool.
+ *
+ * @param pool: thread pool, or NULL.
+ *
+ * @return: worker count.
+ */
+size_t thread_pool_size(const ThreadPool *pool) {
+    return pool != NULL ? pool->size : 1;
+}
+
+/**
+ * Runs fn once for every task index in [0, tasks) and blocks until all have finished. Tasks are dealt out to workers
+ * in contiguous ranges; a worker that runs out steals the back half of another worker's remaining range.
+ * With a NULL pool, a single task, or when called from inside another run, tasks run in order on the calling thread.
+ *
+ * @param pool: thread pool, or NULL.
+ * @param tasks: number of tasks.
+ * @param fn: task function, called with ctx, the task index and the index of the worker running it.
+ * @param ctx: shared task context.
+ */
+void thread_pool_run(ThreadPool *pool, const size_t tasks, void (*fn)(void *ctx, size_t task, size_t worker),
+    void *ctx) {
+    if (pool == NULL || pool->size == 1 || tasks <= 1 || in_pool_) {
+        // serial
+        for (size_t task = 0; task < tasks; task++) fn(ctx, task, 0);
+        return;
+    }
+
+    // deal contiguous ranges
+    for (size_t worker = 0; worker < pool->size; worker++) {
+        pool->queues[worker].next = tasks * worker / pool->size;
+        pool->queues[worker].end = tasks * (worker + 1) / pool->size;
+    }
+
+    // wake workers
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->active = pool->size - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    // join in as worker 0, then wait for the rest
+    in_pool_ = 1;
+    work_(pool, 0);
+    in_pool_ = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active != 0) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Sets the pool that large ops split their work across. NULL keeps every op on the calling thread.
+ *
+ * @param pool: thread pool, or NULL.
+ */
+void set_compute_pool(ThreadPool *pool) {
+    compute_pool_ = pool;
+}
+
+/**
+ * Gets the pool that large ops split their work across.
+ *
+ * @return: compute pool, or NULL.
+ */
+ThreadPool *compute_pool(void) {
+    return compute_pool_;
+}
+
+/**
+ * Sets the minimum work of an op, in multiply-adds, before it is split across the compute pool.
+ *
+ * @param work: work threshold.
+ */
+void set_parallel_threshold(const size_t work) {
+    parallel_threshold_ = work;
+}
+
+/**
+ * Number of workers an op of the given size should be split into. 1 below the work threshold, without a compute
+ * pool, or when already running inside a pool, so ops never nest parallel runs.
+ *
+ * @param work: op size in multiply-adds.
+ *
+ * @return: worker count.
+ */
+size_t compute_workers(const size_t work) {
+    if (compute_pool_ == NULL || in_pool_ || work < parallel_threshold_) return 1;
+    return compute_pool_->size;
+}
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <string.h>
+#include "types.h"
+#include "functional.h"
+#include "view.h"
+
+// rows and columns per tile of a strided copy, so both the reads and the writes stay within a few cache lines
+#define VIEW_TILE 16
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+static View empty_(void) {
+    // invalid window, m = 0
+    const View view = {.m=0};
+    return view;
+}
+
+static void copy_mat_(elm_t *dst, const elm_t *src, const View *view) {
+    // one channel into a packed m x n matrix
+    const size_t m = view->m, n = view->n;
+    if (view->n_stride == 1) {
+        for (size_t row = 0; row < m; row++) memcpy(&dst[row * n], &src[row * view->m_stride], n * sizeof(elm_t));
+        return;
+    }
+    for (size_t row_t = 0; row_t < m; row_t += VIEW_TILE) {
+        const size_t row_end = row_t + VIEW_TILE < m ? row_t + VIEW_TILE : m;
+        for (size_t col_t = 0; col_t < n; col_t += VIEW_TILE) {
+            const size_t col_end = col_t + VIEW_TILE < n ? col_t + VIEW_TILE : n;
+            for (size_t row = row_t; row < row_end; row++) {
+                for (size_t col = col_t; col < col_end; col++) {
+                    dst[row * n + col] = src[row * view->m_stride + col * view->n_stride];
+                }
+            }
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/**
+ * Views a whole tensor. The view shares the tensor array.
+ *
+ * @param tens: tensor to be viewed.
+ *
+ * @return: contiguous view of the tensor.
+ */
+View tensor_view(const Tensor *tens) {
+    const View view = {.m=tens->m, .n=tens->n, .o=tens->o, .m_stride=tens->n, .n_stride=1,
+        .o_stride=tens->m * tens->n, .offset=0, .owned=0, .arr=tens->arr};
+    return view;
+}
+
+/**
+ * Transposes every channel of a view by swapping its row and column strides. O(1), no element is moved.
+ *
+ * @param view: view to transpose.
+ *
+ * @return: transposed view, sharing the array.
+ */
+View view_transpose(const View *view) {
+    View res = *view;
+    res.m = view->n; res.n = view->m;
+    res.m_stride = view->n_stride; res.n_stride = view->m_stride;
+    res.owned = 0;
+    return res;
+}
+
+/**
+ * Views a window of rows and columns across every channel of a view. O(1).
+ *
+ * @param view: view to slice.
+ * @param row: first row.
+ * @param rows: number of rows.
+ * @param col: first column.
+ * @param cols: number of columns.
+ *
+ * @return: window view, sharing the array. Empty (m = 0) for a window out of range.
+ */
+View view_slice(const View *view, const size_t row, const size_t rows, const size_t col, const size_t cols) {
+    if (rows == 0 || cols == 0 || row + rows > view->m || col + cols > view->n) {
+        fprintf(stderr, "Invalid slice: %zu x %zu at %zu, %zu of a %zu x %zu view.\n", rows, cols, row, col, view->m,
+            view->n);
+        return empty_();
+    }
+    View res = *view;
+    res.m = rows; res.n = cols;
+    res.offset = view->offset + row * view->m_stride + col * view->n_stride;
+    res.owned = 0;
+    return res;
+}
+
+/**
+ * Views a run of consecutive channels of a view. O(1).
+ *
+ * @param view: view to select from.
+ * @param chan: first channel.
+ * @param num: number of channels.
+ *
+ * @return: channel view, sharing the array. Empty (m = 0) for channels out of range.
+ */
+View view_channels(const View *view, const size_t chan, const size_t num) {
+    if (num == 0 || chan + num > view->o) {
+        fprintf(stderr, "Invalid channels: %zu at %zu of %zu.\n", num, chan, view->o);
+        return empty_();
+    }
+    View res = *view;
+    res.o = num;
+    res.offset = view->offset + chan * view->o_stride;
+    res.owned = 0;
+    return res;
+}
+
+/**
+ * Views the elements of a contiguous view under new dimensions, e.g. 1 x (m * n * o) x 1 to flatten. O(1).
+ * Strided views have no such reinterpretation; copy them with view_copy first.
+ *
+ * @param view: contiguous view to reshape.
+ * @param m: rows.
+ * @param n: columns.
+ * @param o: channels.
+ *
+ * @return: reshaped view, sharing the array. Empty (m = 0) for a strided view or a different element count.
+ */
+View view_reshape(const View *view, const size_t m, const size_t n, const size_t o) {
+    if (!view_contiguous(view) || m * n * o != view->m * view->n * view->o) {
+        fprintf(stderr, "Invalid reshape: %zu x %zu x %zu view to %zu x %zu x %zu.\n", view->m, view->n, view->o, m,
+            n, o);
+        return empty_();
+    }
+    View res = *view;
+    res.m = m; res.n = n; res.o = o;
+    res.m_stride = n; res.n_stride = 1; res.o_stride = m * n;
+    res.owned = 0;
+    return res;
+}
+
+/**
+ * Whether a view is laid out like a tensor: channel-major planes of packed rows, no gaps. Dimensions of size 1 may
+ * have any stride.
+ *
+ * @param view: view.
+ *
+ * @return: 1 for a contiguous view; 0 otherwise.
+ */
+int view_contiguous(const View *view) {
+    return (view->n <= 1 || view->n_stride == 1) && (view->m <= 1 || view->m_stride == view->n)
+        && (view->o <= 1 || view->o_stride == view->m * view->n);
+}
+
+/**
+ * Reads one element of a view.
+ *
+ * @param view: view.
+ * @param row: row.
+ * @param col: column.
+ * @param chan: channel.
+ *
+ * @return: element.
+ */
+elm_t view_get(const View *view, const size_t row, const size_t col, const size_t chan) {
+    return view->arr[view->offset + row * view->m_stride + col * view->n_stride + chan * view->o_stride];
+}
+
+/**
+ * Copies the elements of a view into a caller-provided tensor, packed. Tiled, so transposed views are read and
+ * written a few cache lines at a time.
+ * res->arr must hold m x n x o elements; res dimensions are set by the call.
+ *
+ * @param res: result tensor.
+ * @param view: view to copy.
+ *
+ * @return: res.
+ */
+Tensor *view_copy_into(Tensor *res, const View *view) {
+    res->m = view->m; res->n = view->n; res->o = view->o;
+    if (view_contiguous(view)) {
+        memcpy(res->arr, &view->arr[view->offset], view->m * view->n * view->o * sizeof(elm_t));
+        return res;
+    }
+    for (size_t mat = 0; mat < view->o; mat++) {
+        copy_mat_(&res->arr[mat * view->m * view->n], &view->arr[view->offset + mat * view->o_stride], view);
+    }
+    return res;
+}
+
+/**
+ * Gets a view as a tensor, for ops that need contiguous input. A contiguous view is returned in place, sharing its
+ * array; any other view is copied into scratch.
+ *
+ * @param res: result tensor.
+ * @param view: view.
+ * @param scratch: m x n x o elements for a strided view, or NULL to accept contiguous views only.
+ *
+ * @return: res. NULL for a strided view without scratch.
+ */
+Tensor *view_tensor_into(Tensor *res, const View *view, elm_t *scratch) {
+    if (view_contiguous(view)) {
+        res->m = view->m; res->n = view->n; res->o = view->o;
+        res->arr = &view->arr[view->offset];
+        return res;
+    }
+    if (scratch == NULL) {
+        fprintf(stderr, "Invalid view: %zu x %zu x %zu view is not contiguous.\n", view->m, view->n, view->o);
+        return NULL;
+    }
+    res->arr = scratch;
+    return view_copy_into(res, view);
+}
+
+/**
+ * Copies a view into a new contiguous view that owns its array.
+ * Caller is responsible for freeing returned view with free_view.
+ *
+ * @param view: view to copy.
+ *
+ * @return: owning contiguous view. Empty (m = 0) for malloc fail.
+ */
+View view_copy(const View *view) {
+    Tensor tens = {.arr=alloc_arr(view->m * view->n * view->o)};
+    if (tens.arr == NULL) {
+        fprintf(stderr, "Failed malloc: View sized %zu x %zu x %zu.\n", view->m, view->n, view->o);
+        return empty_();
+    }
+    view_copy_into(&tens, view);
+    View res = tensor_view(&tens);
+    res.owned = 1;
+    return res;
+}
+
+/**
+ * Frees the array of an owning view and empties it. Views that do not own their array are only emptied.
+ *
+ * @param view: view to be freed.
+ */
+void free_view(View *view) {
+    if (view == NULL) return;
+    if (view->owned) free(view->arr);
+    *view = empty_();
+}
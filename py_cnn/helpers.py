@@ -1,4 +1,5 @@
 import struct
+import zlib
 import numpy as np
 from numpy.typing import NDArray
 
@@ -99,3 +100,122 @@ def write_label(label: int, file: str) -> None:
     with open(file=file, mode="wb") as f:
         f.write(struct.pack("Q", label))
     return None
+
+
+def write_dataset(images: NDArray[np.float32], labels: NDArray[np.int32], file: str) -> None:
+    r"""
+    Writes a whole dataset to a single packed bin file, memory-mapped by the C side.
+    Layout (little-endian u64 fields): 64 byte header [magic, version, count, m, n, o, stride, labels offset], then one
+    float32 record per image zero padded to a 64 byte stride, then one u64 label per image.
+
+    :param images: NDArray of images, shaped (count, m, n) or (count, o, m, n).
+    :param labels: NDArray of labels, shaped (count,).
+    :param file: bin file to write to.
+    """
+    # dims
+    if images.ndim not in (3, 4): raise ValueError("Dimension error: images must be 3D or 4D.")
+    if images.ndim == 3: images = images[:, None, :, :]
+    count, o, m, n = (int(dim) for dim in images.shape)
+    if labels.shape != (count,): raise ValueError("Dimension error: one label per image.")
+    if np.any(labels < 0): raise ValueError("Invalid label: label must be positive.")
+
+    # records padded to a whole number of 64 byte lines
+    align: int = 64
+    item: int = m * n * o
+    stride: int = (item * 4 + align - 1) // align * align
+    records: NDArray[np.float32] = np.zeros((count, stride // 4), dtype="<f4")
+    records[:, :item] = images.reshape(count, item)
+    labels_offset: int = align + count * stride
+
+    # write bin
+    with open(file=file, mode="wb") as f:
+        f.write(struct.pack("<8s7Q", b"CNNDATA", 1, count, m, n, o, stride, labels_offset))
+        f.write(records.tobytes())
+        f.write(labels.astype("<u8").tobytes())
+    return None
+
+
+def write_model(layers: list[dict], file: str, dtype: str = "float32") -> None:
+    r"""
+    Writes a whole model to a single container file, memory-mapped by the C side with weights used in place.
+    Layout (little-endian u64 fields): 64 byte header [magic, version, layer count, table offset, table crc32, file
+    size, 2 reserved], then one 128 byte table entry per layer [type, activation, num, m, n, o, m stride, n stride,
+    section offset, section bytes, section crc32, dtype, 4 reserved], then one weight section per conv or dense layer.
+    Sections and every array within them start on a 64 byte boundary. Kernels and dense weights are stored as dtype,
+    biases always as float32.
+    Layers are dicts, in forward order:
+        {"type": "conv", "kernels": (num, o, m, n), "biases": (num,), "stride": (m, n), "activation": str}
+        {"type": "pool", "dims": (m, n), "stride": (m, n)}
+        {"type": "dense", "weights": (out, in), "biases": (out,), "activation": str}
+    with activation one of "none", "relu", "sigmoid", "softmax".
+
+    :param layers: list of layer dicts.
+    :param file: bin file to write to.
+    :param dtype: weight storage type, one of "float32", "float16", "bfloat16".
+    """
+    align: int = 64
+    dtypes: dict[str, int] = {"float32": 0, "float16": 1, "bfloat16": 2}
+    if dtype not in dtypes: raise ValueError(f"Invalid dtype: {dtype}.")
+    types: dict[str, int] = {"conv": 1, "pool": 2, "dense": 3}
+    activations: dict[str, int] = {"none": 0, "relu": 1, "sigmoid": 2, "softmax": 3}
+
+    def padded(array: NDArray[np.float32]) -> bytes:
+        # float32 values zero padded to a whole number of 64 byte lines
+        raw: bytes = np.ascontiguousarray(array, dtype="<f4").tobytes()
+        return raw + bytes(-len(raw) % align)
+
+    def narrowed(array: NDArray[np.float32]) -> bytes:
+        # weights as dtype, rounded to nearest even, zero padded to a whole number of 64 byte lines
+        if dtype == "float32": return padded(array)
+        if dtype == "float16":
+            raw = np.ascontiguousarray(array, dtype="<f2").tobytes()
+        else:
+            bits: NDArray[np.uint32] = np.ascontiguousarray(array, dtype="<f4").view(np.uint32)
+            rounded: NDArray[np.uint32] = (bits + 0x7FFF + ((bits >> 16) & 1)) >> 16
+            rounded = np.where((bits & 0x7FFFFFFF) > 0x7F800000, (bits >> 16) | 0x40, rounded)
+            raw = rounded.astype("<u2").tobytes()
+        return raw + bytes(-len(raw) % align)
+
+    # table entries and sections
+    entries: list[list[int]] = []
+    sections: list[bytes] = []
+    for layer in layers:
+        kind: str = layer["type"]
+        if kind not in types: raise ValueError(f"Invalid layer type: {kind}.")
+        activation: int = activations[layer.get("activation", "none")]
+        if kind == "conv":
+            kernels: NDArray[np.float32] = layer["kernels"]
+            num, o, m, n = (int(dim) for dim in kernels.shape)
+            section: bytes = padded(layer["biases"].flatten()) + b"".join(narrowed(k.flatten()) for k in kernels)
+            params: list[int] = [num, m, n, o, layer["stride"][0], layer["stride"][1]]
+        elif kind == "pool":
+            section = b""
+            params = [0, layer["dims"][0], layer["dims"][1], 0, layer["stride"][0], layer["stride"][1]]
+        else:
+            weights: NDArray[np.float32] = layer["weights"].T
+            m, n = (int(dim) for dim in weights.shape)
+            section = narrowed(weights) + padded(layer["biases"].flatten())
+            params = [0, m, n, 1, 0, 0]
+        entries.append([types[kind], activation] + params)
+        sections.append(section)
+
+    # offsets, sections follow the table
+    table_offset: int = align
+    offset: int = table_offset + len(layers) * 128
+    offset += -offset % align
+    table: bytes = b""
+    for entry, section in zip(entries, sections):
+        section_offset: int = offset if section else 0
+        table += struct.pack("<16Q", *entry, section_offset, len(section), zlib.crc32(section),
+                             dtypes[dtype] if section else 0, 0, 0, 0, 0)
+        offset += len(section)
+    size: int = offset
+
+    # write bin
+    with open(file=file, mode="wb") as f:
+        f.write(struct.pack("<8s7Q", b"CNNMODL", 1, len(layers), table_offset, zlib.crc32(table), size, 0, 0))
+        f.write(table)
+        f.write(bytes(-f.tell() % align))
+        for section in sections:
+            f.write(section)
+    return None
@@ -5,7 +5,7 @@ from torch import nn
 from torch.utils.data import DataLoader
 from torchvision import datasets, transforms
 from network import CNN
-from helpers import write_conv, write_pool, write_dense
+from helpers import write_conv, write_pool, write_dense, write_model
 
 
 def main() -> None:
@@ -101,6 +101,21 @@ def main() -> None:
         file=os.path.join(param_dir, "dense1.bin")
     )
 
+    # whole model, single mapped container
+    write_model(
+        layers=[
+            {"type": "conv", "kernels": params["conv1.weight"], "biases": params["conv1.bias"], "stride": (1, 1),
+             "activation": "relu"},
+            {"type": "pool", "dims": (2, 2), "stride": (2, 2)},
+            {"type": "conv", "kernels": params["conv2.weight"], "biases": params["conv2.bias"], "stride": (1, 1),
+             "activation": "sigmoid"},
+            {"type": "pool", "dims": (2, 2), "stride": (2, 2)},
+            {"type": "dense", "weights": params["dense1.weight"], "biases": params["dense1.bias"],
+             "activation": "softmax"}
+        ],
+        file=os.path.join(param_dir, "model.bin")
+    )
+
     # write dict
     torch.save(model.state_dict(), os.path.join(os.path.dirname(__file__), "parameters_torch", "params.pth"))
 
@@ -2,25 +2,33 @@ import os
 import numpy as np
 from numpy.typing import NDArray
 from tensorflow.keras.datasets import mnist
-from helpers import write_tensor, write_label
+from helpers import write_tensor, write_label, write_dataset
 
 out_dir: str = os.path.join(os.path.dirname(os.path.dirname(__file__)), "c_cnn", "data")
 data_pts: int = -1
 
 
-def bin_mnist(path: str = out_dir, num: int = 1) -> None:
+def bin_mnist(path: str = out_dir, num: int = 1, packed: bool = False) -> None:
     r"""
     Reads mnist images and saves them as bin files in specified directory.
 
     :param path: directory location.
-    :param num: number of items.
+    :param num: number of items, -1 for all.
+    :param packed: write a single packed dataset file (mnist.bin), read by main with -d, instead of one file per image
+        and label, read by main by default.
     """
     # load mnist data
     (x_train, y_train), (x_test, y_test) = mnist.load_data()
     # combine mnist data (we love p-hacking)
     images: NDArray[np.float32] = np.float32(np.concatenate([x_train, x_test], axis=0).astype(np.float32) / 255.0)
     labels: NDArray[np.int32] = np.concatenate([y_train, y_test], axis=0).astype(np.int32)
+    if num >= 0: images, labels = images[:num], labels[:num]
 
+    if packed:
+        # single vectorized write
+        os.makedirs(path, exist_ok=True)
+        write_dataset(images=images, labels=labels, file=os.path.join(path, "mnist.bin"))
+        return None
 
     # make dirs
     os.makedirs(f"{path}/images", exist_ok=True)